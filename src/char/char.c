@@ -58,6 +58,7 @@
 #include "common/core.h"
 #include "common/db.h"
 #include "common/extraconf.h"
+#include "common/grfio.h"
 #include "common/memmgr.h"
 #include "common/mapindex.h"
 #include "common/mmo.h"
@@ -146,6 +147,7 @@ static bool char_aegis_rename = false; // whether or not the player can be renam
 static int max_connect_user = -1;
 static int gm_allow_group = -1;
 int autosave_interval = DEFAULT_CHAR_AUTOSAVE_INTERVAL;
+int guild_save_budget = DEFAULT_GUILD_SAVE_BUDGET;
 static int start_zeny = 0;
 
 /// Start items for new characters
@@ -1472,7 +1474,7 @@ static int char_mmo_char_fromsql(int char_id, struct mmo_charstatus *p, bool loa
 //==========================================================================================================
 static int char_mmo_char_sql_init(void)
 {
-	chr->char_db_= idb_alloc(DB_OPT_RELEASE_DATA);
+	chr->char_db_= idb_alloc(DB_OPT_RELEASE_DATA|DB_OPT_OPEN_ADDRESSING);
 
 	//the 'set offline' part is now in check_login_conn ...
 	//if the server connects to loginserver
@@ -3259,35 +3261,116 @@ static void char_save_character_ack(int fd, int aid, int cid)
 	WFIFOSET(fd,10);
 }
 
-static void char_parse_frommap_save_character(int fd)
+/**
+ * Asks the map-server to resend a character's full status (0x2b05).
+ * Sent when a delta save (0x2b04) does not apply to the cached status.
+ */
+static void char_save_character_full_req(int fd, int aid, int cid)
+{
+	WFIFOHEAD(fd,10);
+	WFIFOW(fd,0) = 0x2b05;
+	WFIFOL(fd,2) = aid;
+	WFIFOL(fd,6) = cid;
+	WFIFOSET(fd,10);
+}
+
+/**
+ * Stores a character's status received from the map-server.
+ *
+ * @param fd     Map-server connection.
+ * @param aid    Account ID.
+ * @param cid    Character ID.
+ * @param final  Whether the character is quitting.
+ * @param status Status to store.
+ */
+static void char_save_character(int fd, int aid, int cid, bool final, struct mmo_charstatus *status)
 {
-	int aid = RFIFOL(fd,4), cid = RFIFOL(fd,8), size = RFIFOW(fd,2);
 	struct online_char_data* character;
 
-	if (size - 13 != sizeof(struct mmo_charstatus)) {
-		ShowError("parse_from_map (save-char): Size mismatch! %d != %"PRIuS"\n", size-13, sizeof(struct mmo_charstatus));
-		RFIFOSKIP(fd,size);
-		return;
-	}
+	nullpo_retv(status);
+
 	//Check account only if this ain't final save. Final-save goes through because of the char-map reconnect
-	if (RFIFOB(fd,12)
+	if (final
 	 || ( (character = (struct online_char_data*)idb_get(chr->online_char_db, aid)) != NULL
 	    && character->char_id == cid)
 	) {
-		struct mmo_charstatus char_dat;
-		memcpy(&char_dat, RFIFOP(fd,13), sizeof(struct mmo_charstatus));
-		chr->mmo_char_tosql(cid, &char_dat);
+		chr->mmo_char_tosql(cid, status);
 	} else {
 		//This may be valid on char-server reconnection, when re-sending characters that already logged off.
 		ShowError("parse_from_map (save-char): Received data for non-existing/offline character (%d:%d).\n", aid, cid);
 		chr->set_char_online(false, cid, aid, false);
 	}
 
-	if (RFIFOB(fd,12)) {
+	if (final) {
 		//Flag, set character offline after saving. [Skotlex]
 		chr->set_char_offline(cid, aid);
 		chr->save_character_ack(fd, aid, cid);
 	}
+}
+
+static void char_parse_frommap_save_character(int fd)
+{
+	int aid = RFIFOL(fd,4), cid = RFIFOL(fd,8), size = RFIFOW(fd,2);
+	struct mmo_charstatus char_dat;
+
+	if (size - 13 != sizeof(struct mmo_charstatus)) {
+		ShowError("parse_from_map (save-char): Size mismatch! %d != %"PRIuS"\n", size-13, sizeof(struct mmo_charstatus));
+		RFIFOSKIP(fd,size);
+		return;
+	}
+
+	memcpy(&char_dat, RFIFOP(fd,13), sizeof(struct mmo_charstatus));
+	chr->save_character(fd, aid, cid, RFIFOB(fd,12) != 0, &char_dat);
+	RFIFOSKIP(fd,size);
+}
+
+/**
+ * Receives the blocks of a character's status that changed since the
+ * last save (0x2b04) and applies them to the cached status.
+ * If the character is not cached or the patched status does not match
+ * the map-server's checksum, a full save is requested instead.
+ */
+static void char_parse_frommap_save_character_delta(int fd)
+{
+	int aid = RFIFOL(fd,4), cid = RFIFOL(fd,8), size = RFIFOW(fd,2);
+	bool final = (RFIFOB(fd,12) != 0);
+	uint32 checksum = RFIFOL(fd,13);
+	int pos = 19;
+	const struct mmo_charstatus *cp;
+	struct mmo_charstatus char_dat;
+
+	if (size < 19 || RFIFOW(fd,17) != sizeof(struct mmo_charstatus)) {
+		ShowError("parse_from_map (save-char-delta): Size mismatch! %d != %"PRIuS"\n", size >= 19 ? RFIFOW(fd,17) : -1, sizeof(struct mmo_charstatus));
+		RFIFOSKIP(fd,size);
+		return;
+	}
+
+	if ((cp = (struct mmo_charstatus *)idb_get(chr->char_db_, cid)) == NULL) {
+		chr->save_character_full_req(fd, aid, cid);
+		RFIFOSKIP(fd,size);
+		return;
+	}
+
+	memcpy(&char_dat, cp, sizeof(struct mmo_charstatus));
+	while (pos + 4 <= size) {
+		int offset = RFIFOW(fd,pos);
+		int length = RFIFOW(fd,pos+2);
+
+		if (pos + 4 + length > size || offset + length > (int)sizeof(struct mmo_charstatus)) {
+			ShowError("parse_from_map (save-char-delta): Invalid block %d+%d for character (%d:%d).\n", offset, length, aid, cid);
+			break;
+		}
+		memcpy((uint8 *)&char_dat + offset, RFIFOP(fd,pos+4), length);
+		pos += 4 + length;
+	}
+
+	if (pos != size || (uint32)grfio->crc32((const unsigned char *)&char_dat, sizeof(struct mmo_charstatus)) != checksum) {
+		chr->save_character_full_req(fd, aid, cid);
+		RFIFOSKIP(fd,size);
+		return;
+	}
+
+	chr->save_character(fd, aid, cid, final, &char_dat);
 	RFIFOSKIP(fd,size);
 }
 
@@ -3953,6 +4036,14 @@ static int char_parse_frommap(int fd)
 			}
 			break;
 
+			case 0x2b04: // Receive changed character data from map-server for saving
+				if (RFIFOREST(fd) < 4 || RFIFOREST(fd) < RFIFOW(fd,2))
+					return 0;
+			{
+				chr->parse_frommap_save_character_delta(fd);
+			}
+			break;
+
 			case 0x2b02: // req char selection
 				if( RFIFOREST(fd) < 22 )
 					return 0;
@@ -5747,6 +5838,10 @@ static bool char_config_read_database(const char *filename, const struct config_
 		if (autosave_interval <= 0)
 			autosave_interval = DEFAULT_CHAR_AUTOSAVE_INTERVAL;
 	}
+	if (libconfig->setting_lookup_int(setting, "guild_save_budget", &guild_save_budget) == CONFIG_TRUE) {
+		if (guild_save_budget < 0)
+			guild_save_budget = DEFAULT_GUILD_SAVE_BUDGET;
+	}
 	libconfig->setting_lookup_mutable_string(setting, "db_path", chr->db_path, sizeof(chr->db_path));
 	libconfig->set_db_path(chr->db_path);
 	libconfig->setting_lookup_bool_real(setting, "log_char", &chr->enable_logs);
@@ -6540,7 +6635,10 @@ void char_defaults(void)
 	chr->parse_frommap_set_users_count = char_parse_frommap_set_users_count;
 	chr->parse_frommap_set_users = char_parse_frommap_set_users;
 	chr->save_character_ack = char_save_character_ack;
+	chr->save_character_full_req = char_save_character_full_req;
+	chr->save_character = char_save_character;
 	chr->parse_frommap_save_character = char_parse_frommap_save_character;
+	chr->parse_frommap_save_character_delta = char_parse_frommap_save_character_delta;
 	chr->select_ack = char_select_ack;
 	chr->parse_frommap_char_select_req = char_parse_frommap_char_select_req;
 	chr->parse_frommap_remove_friend = char_parse_frommap_remove_friend;
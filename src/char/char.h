@@ -90,6 +90,7 @@ struct mmo_map_server {
 };
 
 #define DEFAULT_CHAR_AUTOSAVE_INTERVAL (300*1000)
+#define DEFAULT_GUILD_SAVE_BUDGET 10
 
 enum inventory_table_type {
 	TABLE_INVENTORY,
@@ -211,7 +212,10 @@ struct char_interface {
 	void (*parse_frommap_set_users_count) (int fd);
 	void (*parse_frommap_set_users) (int fd);
 	void (*save_character_ack) (int fd, int aid, int cid);
+	void (*save_character_full_req) (int fd, int aid, int cid);
+	void (*save_character) (int fd, int aid, int cid, bool final, struct mmo_charstatus *status);
 	void (*parse_frommap_save_character) (int fd);
+	void (*parse_frommap_save_character_delta) (int fd);
 	void (*select_ack) (int fd, int account_id, uint8 flag);
 	void (*parse_frommap_char_select_req) (int fd);
 	void (*parse_frommap_remove_friend) (int fd);
@@ -321,6 +325,7 @@ extern int char_name_option;
 extern char char_name_letters[];
 extern bool char_gm_read;
 extern int autosave_interval;
+extern int guild_save_budget;
 extern char db_path[];
 extern char char_db[256];
 extern char scdata_db[256];
@@ -57,32 +57,65 @@ struct inter_guild_interface *inter_guild;
 
 static const char dataToHex[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
 
+/**
+ * Marks data of a guild for saving and queues the guild if it was not
+ * queued yet.
+ *
+ * The guild is saved by inter_guild_save_timer autosave_interval after it
+ * was queued, so later changes are written together with this one.
+ *
+ * @param g    Guild that changed.
+ * @param flag What changed (enum guild_save_types).
+ */
+static void inter_guild_set_dirty(struct guild *g, int flag)
+{
+	struct inter_guild_save_entry entry;
+
+	nullpo_retv(g);
+
+	g->save_flag |= flag;
+	if ((g->save_flag & GS_QUEUED) != 0)
+		return;
+
+	g->save_flag |= GS_QUEUED;
+	entry.guild_id = g->guild_id;
+	entry.tick = timer->gettick();
+	VECTOR_ENSURE(inter_guild->save_queue, 1, 64);
+	VECTOR_PUSH(inter_guild->save_queue, entry);
+}
+
+/**
+ * Saves the guilds at the front of the save queue that were queued at
+ * least autosave_interval ago, and unloads the ones nobody uses anymore.
+ *
+ * At least one guild is saved per call, then saving stops once
+ * guild_save_budget milliseconds were spent; the rest waits for the next
+ * call.
+ */
 static int inter_guild_save_timer(int tid, int64 tick, int id, intptr_t data)
 {
-	static int last_id = 0; //To know in which guild we were.
-	int state = 0; //0: Have not reached last guild. 1: Reached last guild, ready for save. 2: Some guild saved, don't do further saving.
-	struct DBIterator *iter = db_iterator(inter_guild->guild_db);
-	union DBKey key;
-	struct guild* g;
+	const int64 start = timer->gettick_nocache();
+	int head = inter_guild->save_queue_head;
+	int saved = 0;
 
-	if( last_id == 0 ) //Save the first guild in the list.
-		state = 1;
+	while (head < VECTOR_LENGTH(inter_guild->save_queue)) {
+		const struct inter_guild_save_entry *entry = &VECTOR_INDEX(inter_guild->save_queue, head);
+		struct guild *g;
 
-	for( g = DB->data2ptr(iter->first(iter, &key)); dbi_exists(iter); g = DB->data2ptr(iter->next(iter, &key)) )
-	{
-		if (!g)
-			continue;
-		if( state == 0 && g->guild_id == last_id )
-			state++; //Save next guild in the list.
-		else
-		if( state == 1 && g->save_flag&GS_MASK )
-		{
-			inter_guild->tosql(g, g->save_flag&GS_MASK);
-			g->save_flag &= ~GS_MASK;
+		if (DIFF_TICK(tick, entry->tick) < autosave_interval)
+			break; // The rest of the queue changed later
+		if (saved > 0 && DIFF_TICK(timer->gettick_nocache(), start) >= guild_save_budget)
+			break;
+
+		head++;
+		if ((g = idb_get(inter_guild->guild_db, entry->guild_id)) == NULL)
+			continue; // Disbanded or already unloaded
 
-			//Some guild saved.
-			last_id = g->guild_id;
-			state++;
+		g->save_flag &= ~GS_QUEUED;
+		if ((g->save_flag & GS_MASK) != 0) {
+			inter_guild->tosql(g, g->save_flag & GS_MASK);
+			g->save_flag &= ~GS_MASK;
+			saved++;
 		}
 
 		if (g->save_flag == GS_REMOVE) {
@@ -90,17 +123,20 @@ static int inter_guild_save_timer(int tid, int64 tick, int id, intptr_t data)
 			if (chr->show_save_log)
 				ShowInfo("Guild Unloaded (%d - %s)\n", g->guild_id, g->name);
 			aFree(g->emblem_data);
-			db_remove(inter_guild->guild_db, key);
+			idb_remove(inter_guild->guild_db, g->guild_id);
 		}
 	}
-	dbi_destroy(iter);
 
-	if( state != 2 ) //Reached the end of the guild db without saving.
-		last_id = 0; //Reset guild saved, return to beginning.
+	if (head == VECTOR_LENGTH(inter_guild->save_queue)) {
+		VECTOR_TRUNCATE(inter_guild->save_queue);
+		head = 0;
+	} else if (head >= 64 && head * 2 >= VECTOR_LENGTH(inter_guild->save_queue)) {
+		VECTOR_ERASEN(inter_guild->save_queue, 0, head);
+		head = 0;
+	}
+	inter_guild->save_queue_head = head;
 
-	state = inter_guild->guild_db->size(inter_guild->guild_db);
-	if( state < 1 ) state = 1; //Calculate the time slot for the next save.
-	timer->add(tick + autosave_interval/state, inter_guild->save_timer, 0, 0);
+	timer->add(tick + GUILD_SAVE_INTERVAL, inter_guild->save_timer, 0, 0);
 	return 0;
 }
 
@@ -562,7 +598,7 @@ static struct guild *inter_guild_fromsql(int guild_id)
 	SQL->FreeResult(inter->sql_handle);
 
 	idb_put(inter_guild->guild_db, guild_id, g); //Add to cache
-	g->save_flag |= GS_REMOVE; //But set it to be removed, in case it is not needed for long.
+	inter_guild->set_dirty(g, GS_REMOVE); //But set it to be removed, in case it is not needed for long.
 
 	if (chr->show_save_log)
 		ShowInfo("Guild loaded (%d - %s)\n", guild_id, g->name);
@@ -762,7 +798,7 @@ static int inter_guild_CharOffline(int char_id, int guild_id)
 
 	// Remove guild from memory if no players online
 	if( online_count == 0 )
-		g->save_flag |= GS_REMOVE;
+		inter_guild->set_dirty(g, GS_REMOVE);
 
 	return 1;
 }
@@ -773,6 +809,8 @@ static int inter_guild_sql_init(void)
 	//Initialize the guild cache
 	inter_guild->guild_db= idb_alloc(DB_OPT_RELEASE_DATA);
 	inter_guild->castle_db = idb_alloc(DB_OPT_RELEASE_DATA);
+	VECTOR_INIT(inter_guild->save_queue);
+	inter_guild->save_queue_head = 0;
 
 	//Read exp file
 	sv->readdb(chr->db_path, DBPATH"exp_guild.txt", ',', 1, 1, MAX_GUILDLEVEL, inter_guild->exp_parse_row);
@@ -802,6 +840,7 @@ static void inter_guild_sql_final(void)
 {
 	inter_guild->guild_db->destroy(inter_guild->guild_db, inter_guild->db_final);
 	db_destroy(inter_guild->castle_db);
+	VECTOR_CLEAR(inter_guild->save_queue);
 	return;
 }
 
@@ -939,7 +978,7 @@ static int inter_guild_calcinfo(struct guild *g)
 	 || g->skill_point != before.skill_point
 	 || g->max_storage != before.max_storage
 	) {
-		g->save_flag |= GS_LEVEL;
+		inter_guild->set_dirty(g, GS_LEVEL);
 		mapif->guild_info(g);
 		return 1;
 	}
@@ -1047,7 +1086,7 @@ static bool inter_guild_add_member(int guild_id, const struct guild_member *memb
 			if (!inter_guild->calcinfo(g)) //Send members if it was not invoked.
 				mapif->guild_info(g);
 
-			g->save_flag |= GS_MEMBER;
+			inter_guild->set_dirty(g, GS_MEMBER);
 			if (g->save_flag&GS_REMOVE)
 				g->save_flag&=~GS_REMOVE;
 			return true;
@@ -1109,7 +1148,7 @@ static bool inter_guild_leave(int guild_id, int account_id, int char_id, int fla
 		//Update member info.
 		if (!inter_guild->calcinfo(g))
 			mapif->guild_info(g);
-		g->save_flag |= GS_EXPULSION;
+		inter_guild->set_dirty(g, GS_EXPULSION);
 	}
 
 	return true;
@@ -1157,11 +1196,11 @@ static bool inter_guild_update_member_info_short(int guild_id, int account_id, i
 	if (c != 0) { // this check should always succeed...
 		g->average_lv = sum / c;
 		if (g->connect_member != prev_count || g->average_lv != prev_alv)
-			g->save_flag |= GS_CONNECT;
+			inter_guild->set_dirty(g, GS_CONNECT);
 		if (g->save_flag & GS_REMOVE)
 			g->save_flag &= ~GS_REMOVE;
 	}
-	g->save_flag |= GS_MEMBER; //Update guild member data
+	inter_guild->set_dirty(g, GS_MEMBER); //Update guild member data
 	return true;
 }
 
@@ -1259,7 +1298,7 @@ static bool inter_guild_update_basic_info(int guild_id, enum guild_basic_info ty
 			memcpy(&(g->skill[(gd_skill.id - GD_SKILLBASE)]), &gd_skill, sizeof(gd_skill));
 			if( !inter_guild->calcinfo(g) )
 				mapif->guild_info(g);
-			g->save_flag |= GS_SKILL;
+			inter_guild->set_dirty(g, GS_SKILL);
 			mapif->guild_skillupack(g->guild_id, gd_skill.id, 0);
 			break;
 
@@ -1268,7 +1307,7 @@ static bool inter_guild_update_basic_info(int guild_id, enum guild_basic_info ty
 			return false;
 	}
 	mapif->guild_info(g);
-	g->save_flag |= GS_LEVEL;
+	inter_guild->set_dirty(g, GS_LEVEL);
 
 	return true;
 }
@@ -1305,7 +1344,7 @@ static bool inter_guild_update_member_info(int guild_id, int account_id, int cha
 			g->member[i].position = *(const short *)data;
 			g->member[i].modified = GS_MEMBER_MODIFIED;
 			mapif->guild_memberinfochanged(guild_id,account_id,char_id,type,data,len);
-			g->save_flag |= GS_MEMBER;
+			inter_guild->set_dirty(g, GS_MEMBER);
 			break;
 		}
 		case GMI_EXP:
@@ -1328,10 +1367,10 @@ static bool inter_guild_update_member_info(int guild_id, int account_id, int cha
 
 				inter_guild->calcinfo(g);
 				mapif->guild_basicinfochanged(guild_id,GBI_EXP,&g->exp,sizeof(g->exp));
-				g->save_flag |= GS_LEVEL;
+				inter_guild->set_dirty(g, GS_LEVEL);
 			}
 			mapif->guild_memberinfochanged(guild_id,account_id,char_id,type,data,len);
-			g->save_flag |= GS_MEMBER;
+			inter_guild->set_dirty(g, GS_MEMBER);
 			break;
 		}
 		case GMI_HAIR:
@@ -1339,7 +1378,7 @@ static bool inter_guild_update_member_info(int guild_id, int account_id, int cha
 			g->member[i].hair = *(const short *)data;
 			g->member[i].modified = GS_MEMBER_MODIFIED;
 			mapif->guild_memberinfochanged(guild_id,account_id,char_id,type,data,len);
-			g->save_flag |= GS_MEMBER; //Save new data.
+			inter_guild->set_dirty(g, GS_MEMBER); //Save new data.
 			break;
 		}
 		case GMI_HAIR_COLOR:
@@ -1347,7 +1386,7 @@ static bool inter_guild_update_member_info(int guild_id, int account_id, int cha
 			g->member[i].hair_color = *(const short *)data;
 			g->member[i].modified = GS_MEMBER_MODIFIED;
 			mapif->guild_memberinfochanged(guild_id,account_id,char_id,type,data,len);
-			g->save_flag |= GS_MEMBER; //Save new data.
+			inter_guild->set_dirty(g, GS_MEMBER); //Save new data.
 			break;
 		}
 		case GMI_GENDER:
@@ -1355,7 +1394,7 @@ static bool inter_guild_update_member_info(int guild_id, int account_id, int cha
 			g->member[i].gender = *(const short *)data;
 			g->member[i].modified = GS_MEMBER_MODIFIED;
 			mapif->guild_memberinfochanged(guild_id,account_id,char_id,type,data,len);
-			g->save_flag |= GS_MEMBER; //Save new data.
+			inter_guild->set_dirty(g, GS_MEMBER); //Save new data.
 			break;
 		}
 		case GMI_CLASS:
@@ -1363,7 +1402,7 @@ static bool inter_guild_update_member_info(int guild_id, int account_id, int cha
 			g->member[i].class = *(const int16 *)data;
 			g->member[i].modified = GS_MEMBER_MODIFIED;
 			mapif->guild_memberinfochanged(guild_id,account_id,char_id,type,data,len);
-			g->save_flag |= GS_MEMBER; //Save new data.
+			inter_guild->set_dirty(g, GS_MEMBER); //Save new data.
 			break;
 		}
 		case GMI_LEVEL:
@@ -1371,7 +1410,7 @@ static bool inter_guild_update_member_info(int guild_id, int account_id, int cha
 			g->member[i].lv = *(const short *)data;
 			g->member[i].modified = GS_MEMBER_MODIFIED;
 			mapif->guild_memberinfochanged(guild_id,account_id,char_id,type,data,len);
-			g->save_flag |= GS_MEMBER; //Save new data.
+			inter_guild->set_dirty(g, GS_MEMBER); //Save new data.
 			break;
 		}
 		default:
@@ -1438,7 +1477,7 @@ static bool inter_guild_update_position(int guild_id, int idx, const struct guil
 	memcpy(&g->position[idx],p,sizeof(struct guild_position));
 	mapif->guild_position(g,idx);
 	g->position[idx].modified = GS_POSITION_MODIFIED;
-	g->save_flag |= GS_POSITION; // Change guild_position
+	inter_guild->set_dirty(g, GS_POSITION); // Change guild_position
 	return true;
 }
 
@@ -1458,7 +1497,7 @@ static bool inter_guild_use_skill_point(int guild_id, uint16 skill_id, int accou
 		if (!inter_guild->calcinfo(g))
 			mapif->guild_info(g);
 		mapif->guild_skillupack(guild_id,skill_id,account_id);
-		g->save_flag |= (GS_LEVEL|GS_SKILL); // Change guild & guild_skill
+		inter_guild->set_dirty(g, GS_LEVEL|GS_SKILL); // Change guild & guild_skill
 	}
 	return true;
 }
@@ -1478,7 +1517,7 @@ static bool inter_guild_remove_alliance(struct guild *g, int guild_id, int accou
 	g->alliance[i].guild_id=0;
 
 	mapif->guild_alliance(g->guild_id,guild_id,account_id1,account_id2,flag,g->name,name);
-	g->save_flag |= GS_ALLIANCE;
+	inter_guild->set_dirty(g, GS_ALLIANCE);
 	return true;
 }
 
@@ -1522,8 +1561,8 @@ static bool inter_guild_change_alliance(int guild_id1, int guild_id2, int accoun
 	mapif->guild_alliance(guild_id1,guild_id2,account_id1,account_id2,flag,g[0]->name,g[1]->name);
 
 	// Mark the two guild to be saved
-	g[0]->save_flag |= GS_ALLIANCE;
-	g[1]->save_flag |= GS_ALLIANCE;
+	inter_guild->set_dirty(g[0], GS_ALLIANCE);
+	inter_guild->set_dirty(g[1], GS_ALLIANCE);
 	return true;
 }
 
@@ -1540,7 +1579,7 @@ static bool inter_guild_update_notice(int guild_id, const char *mes1, const char
 
 	memcpy(g->mes1,mes1,MAX_GUILDMES1);
 	memcpy(g->mes2,mes2,MAX_GUILDMES2);
-	g->save_flag |= GS_MES; //Change mes of guild
+	inter_guild->set_dirty(g, GS_MES); //Change mes of guild
 	mapif->guild_notice(g);
 	return true;
 }
@@ -1559,7 +1598,7 @@ static bool inter_guild_update_emblem(int len, int guild_id, const char *data)
 	memcpy(g->emblem_data, data, len);
 	g->emblem_len = len;
 	g->emblem_id++;
-	g->save_flag |= GS_EMBLEM; //Change guild
+	inter_guild->set_dirty(g, GS_EMBLEM); //Change guild
 	mapif->guild_emblem(g);
 	return true;
 }
@@ -1637,7 +1676,7 @@ static bool inter_guild_change_leader(int guild_id, const char *name, int len)
 		g->master[len] = '\0';
 
 	ShowInfo("int_guild: Guildmaster Changed to %s (Guild %d - %s)\n",g->master, guild_id, g->name);
-	g->save_flag |= (GS_BASIC|GS_MEMBER); //Save main data and member data.
+	inter_guild->set_dirty(g, GS_BASIC|GS_MEMBER); //Save main data and member data.
 	mapif->guild_master_changed(g, g->member[0].account_id, g->member[0].char_id);
 	return true;
 }
@@ -1709,6 +1748,7 @@ void inter_guild_defaults(void)
 	inter_guild->castle_db = NULL;
 	memset(inter_guild->exp, 0, sizeof(inter_guild->exp));
 
+	inter_guild->set_dirty = inter_guild_set_dirty;
 	inter_guild->save_timer = inter_guild_save_timer;
 	inter_guild->removemember_tosql = inter_guild_removemember_tosql;
 	inter_guild->tosql = inter_guild_tosql;
@@ -37,9 +37,19 @@ enum guild_save_types {
 	GS_MES = 0x0200,
 	GS_MASK = 0x03FF,
 	GS_BASIC_MASK = (GS_BASIC | GS_EMBLEM | GS_CONNECT | GS_LEVEL | GS_MES),
+	GS_QUEUED = 0x4000, ///< The guild is in inter_guild->save_queue.
 	GS_REMOVE = 0x8000,
 };
 
+/// How often the guild save queue is processed (ms).
+#define GUILD_SAVE_INTERVAL 100
+
+/** Guild waiting in the save queue. */
+struct inter_guild_save_entry {
+	int guild_id;
+	int64 tick; ///< When the guild was queued.
+};
+
 /**
  * inter_guild interface
  **/
@@ -47,7 +57,10 @@ struct inter_guild_interface {
 	struct DBMap *guild_db; // int guild_id -> struct guild*
 	struct DBMap *castle_db;
 	unsigned int exp[MAX_GUILDLEVEL];
+	VECTOR_DECL(struct inter_guild_save_entry) save_queue; ///< Changed guilds, in the order they changed.
+	int save_queue_head; ///< First entry of save_queue not processed yet.
 
+	void (*set_dirty) (struct guild *g, int flag);
 	int (*save_timer) (int tid, int64 tick, int id, intptr_t data);
 	int (*removemember_tosql) (int account_id, int char_id);
 	bool (*tosql) (struct guild *g, int flag);
@@ -337,15 +337,145 @@ static void inter_accinfo2(bool success, int map_fd, int u_fd, int u_aid, int ac
 
 	return;
 }
+/**
+ * Starts collecting the registry updates of one account and character.
+ *
+ * Until inter_savereg_flush is called, inter_savereg queues the values of
+ * this account and character into one REPLACE and one DELETE per table.
+ *
+ * @param account_id Account the values belong to.
+ * @param char_id    Character the values belong to.
+ **/
+static void inter_savereg_begin(int account_id, int char_id)
+{
+	struct inter_reg_batch *batch = &inter->reg_batch;
+
+	if (batch->active)
+		inter->savereg_flush();
+
+	batch->active = true;
+	batch->in_transaction = false;
+	batch->single = false;
+	batch->result = true;
+	batch->account_id = account_id;
+	batch->char_id = char_id;
+	batch->values = 0;
+	batch->statements = 0;
+	batch->start = timer->gettick_nocache();
+}
+
+/**
+ * Runs the queued REPLACE or DELETE statement of a registry table.
+ *
+ * The transaction is opened by the first statement of the batch, unless
+ * it is the only one. After an error the remaining statements are dropped
+ * and the batch is rolled back.
+ *
+ * @param table   Registry table (enum inter_reg_table).
+ * @param replace true for the REPLACE statement, false for the DELETE.
+ **/
+static void inter_savereg_execute(int table, bool replace)
+{
+	struct inter_reg_batch *batch = &inter->reg_batch;
+	StringBuf *buf = replace ? &batch->replace[table] : &batch->remove[table];
+	int *count = replace ? &batch->replace_count[table] : &batch->remove_count[table];
+
+	Assert_retv(table >= 0 && table < INTER_REG_TABLE_MAX);
+
+	if (*count == 0)
+		return;
+
+	if (!replace)
+		StrBuf->AppendStr(buf, ")");
+
+	if (batch->result && !batch->in_transaction && !batch->single) {
+		if (SQL_ERROR == SQL->QueryStr(inter->sql_handle, "START TRANSACTION")) {
+			Sql_ShowDebug(inter->sql_handle);
+			batch->result = false;
+		} else {
+			batch->in_transaction = true;
+		}
+		batch->statements++;
+	}
+	if (batch->result) {
+		if (SQL_ERROR == SQL->QueryStr(inter->sql_handle, StrBuf->Value(buf))) {
+			Sql_ShowDebug(inter->sql_handle);
+			batch->result = false;
+		}
+		batch->statements++;
+	}
+
+	StrBuf->Clear(buf);
+	*count = 0;
+}
+
+/**
+ * Saves the queued registry updates in one transaction and ends the batch.
+ *
+ * A batch that comes down to a single statement is run on its own.
+ **/
+static void inter_savereg_flush(void)
+{
+	struct inter_reg_batch *batch = &inter->reg_batch;
+	struct inter_reg_stats *stats = &inter->reg_stats;
+	int64 elapsed;
+	int i, pending = 0;
+
+	if (!batch->active)
+		return;
+
+	for (i = 0; i < INTER_REG_TABLE_MAX; i++) {
+		if (batch->replace_count[i] != 0)
+			pending++;
+		if (batch->remove_count[i] != 0)
+			pending++;
+	}
+	batch->single = (!batch->in_transaction && pending == 1);
+
+	for (i = 0; i < INTER_REG_TABLE_MAX; i++) {
+		inter->savereg_execute(i, false);
+		inter->savereg_execute(i, true);
+	}
+
+	if (batch->in_transaction) {
+		if (SQL_ERROR == SQL->QueryStr(inter->sql_handle, batch->result ? "COMMIT" : "ROLLBACK")) {
+			Sql_ShowDebug(inter->sql_handle);
+			batch->result = false;
+		}
+		batch->statements++;
+	}
+	if (!batch->result)
+		ShowError("inter_savereg_flush: Failed to save %d registry values for AID:%d CID:%d\n", batch->values, batch->account_id, batch->char_id);
+
+	elapsed = DIFF_TICK(timer->gettick_nocache(), batch->start);
+	stats->values += batch->values;
+	stats->statements += batch->statements;
+	stats->flushes++;
+	stats->flush_time += elapsed;
+	if (elapsed > stats->flush_time_max)
+		stats->flush_time_max = elapsed;
+
+	batch->active = false;
+}
+
 /**
  * Handles save reg data from map server and distributes accordingly.
  *
+ * Values of the account and character of an open batch (inter_savereg_begin)
+ * are queued, anything else is saved right away.
+ *
  * @param val either str or int, depending on type
  * @param type false when int, true otherwise
  **/
 static void inter_savereg(int account_id, int char_id, const char *key, unsigned int index, intptr_t val, bool is_string)
 {
-	char val_esq[1000];
+	static const char *const columns[INTER_REG_TABLE_MAX] = { "account_id", "account_id", "char_id", "char_id" };
+	struct inter_reg_batch *batch = &inter->reg_batch;
+	const char *tables[INTER_REG_TABLE_MAX] = { acc_reg_num_db, acc_reg_str_db, char_reg_num_db, char_reg_str_db };
+	bool single;
+	int table, id;
+	StringBuf *buf;
+
 	nullpo_retv(key);
 	/* to login server we go! */
 	if( key[0] == '#' && key[1] == '#' ) {/* global account reg */
@@ -354,45 +484,51 @@ static void inter_savereg(int account_id, int char_id, const char *key, unsigned
 		else {
 			ShowError("Login server unavailable, cant perform update on '%s' variable for AID:%d CID:%d\n",key,account_id,char_id);
 		}
-	} else if ( key[0] == '#' ) {/* local account reg */
-		if( is_string ) {
-			if( val ) {
-				SQL->EscapeString(inter->sql_handle, val_esq, (char*)val);
-				if( SQL_ERROR == SQL->Query(inter->sql_handle, "REPLACE INTO `%s` (`account_id`,`key`,`index`,`value`) VALUES ('%d','%s','%u','%s')", acc_reg_str_db, account_id, key, index, val_esq) )
-					Sql_ShowDebug(inter->sql_handle);
-			} else {
-				if( SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE `account_id` = '%d' AND `key` = '%s' AND `index` = '%u' LIMIT 1", acc_reg_str_db, account_id, key, index) )
-					Sql_ShowDebug(inter->sql_handle);
-			}
-		} else {
-			if( val ) {
-				if( SQL_ERROR == SQL->Query(inter->sql_handle, "REPLACE INTO `%s` (`account_id`,`key`,`index`,`value`) VALUES ('%d','%s','%u','%d')", acc_reg_num_db, account_id, key, index, (int)val) )
-					Sql_ShowDebug(inter->sql_handle);
-			} else {
-				if( SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE `account_id` = '%d' AND `key` = '%s' AND `index` = '%u' LIMIT 1", acc_reg_num_db, account_id, key, index) )
-					Sql_ShowDebug(inter->sql_handle);
-			}
-		}
+		return;
+	}
+
+	single = !batch->active || batch->account_id != account_id || batch->char_id != char_id;
+	if (single)
+		inter->savereg_begin(account_id, char_id);
+
+	if (key[0] == '#') {/* local account reg */
+		table = is_string ? INTER_REG_ACC_STR : INTER_REG_ACC_NUM;
+		id = account_id;
 	} else { /* char reg */
-		if( is_string ) {
-			if( val ) {
-				SQL->EscapeString(inter->sql_handle, val_esq, (char*)val);
-				if( SQL_ERROR == SQL->Query(inter->sql_handle, "REPLACE INTO `%s` (`char_id`,`key`,`index`,`value`) VALUES ('%d','%s','%u','%s')", char_reg_str_db, char_id, key, index, val_esq) )
-					Sql_ShowDebug(inter->sql_handle);
-			} else {
-				if( SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE `char_id` = '%d' AND `key` = '%s' AND `index` = '%u' LIMIT 1", char_reg_str_db, char_id, key, index) )
-					Sql_ShowDebug(inter->sql_handle);
-			}
+		table = is_string ? INTER_REG_CHAR_STR : INTER_REG_CHAR_NUM;
+		id = char_id;
+	}
+
+	if (val != 0) {
+		buf = &batch->replace[table];
+		if (batch->replace_count[table]++ == 0)
+			StrBuf->Printf(buf, "REPLACE INTO `%s` (`%s`,`key`,`index`,`value`) VALUES ", tables[table], columns[table]);
+		else
+			StrBuf->AppendStr(buf, ",");
+
+		if (is_string) {
+			char val_esq[1000];
+			SQL->EscapeString(inter->sql_handle, val_esq, (char*)val);
+			StrBuf->Printf(buf, "('%d','%s','%u','%s')", id, key, index, val_esq);
 		} else {
-			if( val ) {
-				if( SQL_ERROR == SQL->Query(inter->sql_handle, "REPLACE INTO `%s` (`char_id`,`key`,`index`,`value`) VALUES ('%d','%s','%u','%d')", char_reg_num_db, char_id, key, index, (int)val) )
-					Sql_ShowDebug(inter->sql_handle);
-			} else {
-				if( SQL_ERROR == SQL->Query(inter->sql_handle, "DELETE FROM `%s` WHERE `char_id` = '%d' AND `key` = '%s' AND `index` = '%u' LIMIT 1", char_reg_num_db, char_id, key, index) )
-					Sql_ShowDebug(inter->sql_handle);
-			}
+			StrBuf->Printf(buf, "('%d','%s','%u','%d')", id, key, index, (int)val);
 		}
+	} else {
+		buf = &batch->remove[table];
+		if (batch->remove_count[table]++ == 0)
+			StrBuf->Printf(buf, "DELETE FROM `%s` WHERE `%s` = '%d' AND (`key`,`index`) IN (", tables[table], columns[table], id);
+		else
+			StrBuf->AppendStr(buf, ",");
+		StrBuf->Printf(buf, "('%s','%u')", key, index);
 	}
+	batch->values++;
+
+	// Keep statements well below max_allowed_packet.
+	if (StrBuf->Length(buf) >= INTER_REG_BATCH_LENGTH)
+		inter->savereg_execute(table, val != 0);
+
+	if (single)
+		inter->savereg_flush();
 }
 
 // Load account_reg from sql (type=2)
@@ -718,6 +854,8 @@ static int inter_log(char *fmt, ...)
 // initialize
 static int inter_init_sql(const char *file)
 {
+	int i;
+
 	inter->config_read(file, false);
 
 	//DB connection initialized
@@ -747,6 +885,11 @@ static int inter_init_sql(const char *file)
 	inter_rodex->sql_init();
 	inter_achievement->sql_init();
 
+	for (i = 0; i < INTER_REG_TABLE_MAX; i++) {
+		StrBuf->Init(&inter->reg_batch.replace[i]);
+		StrBuf->Init(&inter->reg_batch.remove[i]);
+	}
+
 	geoip->init();
 	inter->msg_config_read("conf/messages.conf", false);
 	return 0;
@@ -755,6 +898,19 @@ static int inter_init_sql(const char *file)
 // finalize
 static void inter_final(void)
 {
+	const struct inter_reg_stats *stats = &inter->reg_stats;
+	int i;
+
+	inter->savereg_flush();
+	for (i = 0; i < INTER_REG_TABLE_MAX; i++) {
+		StrBuf->Destroy(&inter->reg_batch.replace[i]);
+		StrBuf->Destroy(&inter->reg_batch.remove[i]);
+	}
+	if (stats->flushes > 0)
+		ShowInfo("Registry saves: %"PRIu64" values in %"PRIu64" queries (%"PRIu64" saved), %"PRIu64" batches, %.2f ms average, %"PRId64" ms max.\n",
+		         stats->values, stats->statements, stats->values > stats->statements ? stats->values - stats->statements : 0, stats->flushes,
+		         (double)stats->flush_time / stats->flushes, stats->flush_time_max);
+
 	inter_guild->sql_final();
 	inter_storage->sql_final();
 	inter_party->sql_final();
@@ -854,6 +1010,9 @@ void inter_defaults(void)
 	inter->job_name = inter_job_name;
 	inter->vmsg_to_fd = inter_vmsg_to_fd;
 	inter->msg_to_fd = inter_msg_to_fd;
+	inter->savereg_begin = inter_savereg_begin;
+	inter->savereg_execute = inter_savereg_execute;
+	inter->savereg_flush = inter_savereg_flush;
 	inter->savereg = inter_savereg;
 	inter->accreg_fromsql = inter_accreg_fromsql;
 	inter->config_read = inter_config_read;
@@ -24,6 +24,7 @@
 #include "common/hercules.h"
 #include "common/db.h"
 #include "common/packets_struct.h"
+#include "common/strlib.h"
 
 #include <stdarg.h>
 
@@ -31,18 +32,61 @@
 struct Sql; // common/sql.h
 struct config_t; // common/conf.h
 
+/// Length after which a queued registry statement is run (bytes).
+#define INTER_REG_BATCH_LENGTH 32768
+
+/** Registry tables handled by the char-server. */
+enum inter_reg_table {
+	INTER_REG_ACC_NUM,
+	INTER_REG_ACC_STR,
+	INTER_REG_CHAR_NUM,
+	INTER_REG_CHAR_STR,
+	INTER_REG_TABLE_MAX
+};
+
+/** Registry updates of one account and character, saved in one transaction. */
+struct inter_reg_batch {
+	bool active;         ///< Whether inter->savereg queues values.
+	bool in_transaction; ///< Whether START TRANSACTION was sent.
+	bool single;         ///< Whether only one statement is left, run without a transaction.
+	bool result;         ///< false after a query failed.
+	int account_id;
+	int char_id;
+	int values;          ///< Values queued so far.
+	int statements;      ///< Statements run so far, transaction control included.
+	int64 start;         ///< Tick the batch was opened at.
+	StringBuf replace[INTER_REG_TABLE_MAX]; ///< Multi-row REPLACE per table.
+	StringBuf remove[INTER_REG_TABLE_MAX];  ///< DELETE ... IN (...) per table.
+	int replace_count[INTER_REG_TABLE_MAX];
+	int remove_count[INTER_REG_TABLE_MAX];
+};
+
+/** Counters of the registry batches since startup. */
+struct inter_reg_stats {
+	uint64 values;         ///< Registry values saved.
+	uint64 statements;     ///< Statements used to save them, transaction control included.
+	uint64 flushes;        ///< Batches saved.
+	int64 flush_time;      ///< Time spent in all batches (ms).
+	int64 flush_time_max;  ///< Longest batch (ms).
+};
+
 /**
  * inter interface
  **/
 struct inter_interface {
 	bool enable_logs; ///< Whether to log inter-server operations.
 	struct Sql *sql_handle;
+	struct inter_reg_batch reg_batch;
+	struct inter_reg_stats reg_stats;
 	const char* (*msg_txt) (int msg_number);
 	bool (*msg_config_read) (const char *cfg_name, bool allow_override);
 	void (*do_final_msg) (void);
 	const char* (*job_name) (int class);
 	void (*vmsg_to_fd) (int fd, int u_fd, int aid, char* msg, va_list ap) __attribute__((format(printf, 4, 0)));
 	void (*msg_to_fd) (int fd, int u_fd, int aid, char *msg, ...) __attribute__((format(printf, 4, 5)));
+	void (*savereg_begin) (int account_id, int char_id);
+	void (*savereg_execute) (int table, bool replace);
+	void (*savereg_flush) (void);
 	void (*savereg) (int account_id, int char_id, const char *key, unsigned int index, intptr_t val, bool is_string);
 	int (*accreg_fromsql) (int account_id,int char_id, int fd, int type);
 	int (*vlog) (char* fmt, va_list ap) __attribute__((format(printf, 1, 0)));
@@ -2087,6 +2087,7 @@ static int mapif_parse_Registry(int fd)
 		if (isLoginActive)
 			chr->global_accreg_to_login_start(account_id, char_id);
 
+		inter->savereg_begin(account_id, char_id);
 		for (i = 0; i < count; i++) {
 			unsigned int index;
 			int len = RFIFOB(fd, cursor);
@@ -2117,9 +2118,11 @@ static int mapif_parse_Registry(int fd)
 				break;
 			default:
 				ShowError("mapif->parse_Registry: unknown type %d\n", RFIFOB(fd, cursor - 1));
+				inter->savereg_flush();
 				return 1;
 			}
 		}
+		inter->savereg_flush();
 
 		if (isLoginActive)
 			chr->global_accreg_to_login_send();
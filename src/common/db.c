@@ -45,6 +45,13 @@
  *  readjusted in <code>O(lg(n))</code> time.
  *  {@link http://www.cs.mcgill.ca/~cs251/OldCourses/1997/topic18/}
  *
+ *  Databases allocated with DB_OPT_OPEN_ADDRESSING use a single resizable
+ *  hashtable with linear probing instead. Each slot caches the hash of its
+ *  key, removed entries leave a tombstone behind and the table is rebuilt
+ *  when tombstones and live entries go over 3/4 of the capacity. While the
+ *  database is locked (iterators, foreach) entries are never moved, the
+ *  rebuild is postponed until the last lock is released.
+ *
  *  <B>How to add new database types:</B>
  *  1. Add the identifier of the new database type to the enum DBType
  *  2. If not already there, add the data type of the key to the union DBKey
@@ -65,6 +72,7 @@
  *  - create a db that organizes itself by splaying
  *
  *  HISTORY:
+ *    2026/10/16 - Added the open-addressing hashtable backend (DB_OPT_OPEN_ADDRESSING)
  *    2013/08/25 - Added int64/uint64 support for keys [Ind/Hercules]
  *    2013/04/27 - Added ERS to speed up iterator memory allocation [Ind/Hercules]
  *    2012/03/09 - Added enum for data types (int, uint, void*)
@@ -134,6 +142,69 @@ struct db_interface *DB;
  */
 #define HASH_SIZE (256+27)
 
+/**
+ * Initial number of slots of open-addressing databases (power of two).
+ * @private
+ * @see struct DBMap_impl#slots
+ */
+#define DBH_MIN_CAPACITY 16
+
+/**
+ * Returns true if an open-addressing table with <code>used</code> occupied
+ * slots (live entries and tombstones) must be rebuilt (load factor > 3/4).
+ * @private
+ */
+#define DBH_OVERLOADED(used, capacity) ( (uint64)(used)*4 > (uint64)(capacity)*3 )
+
+/**
+ * Returns true if an open-addressing table is too full to take more entries
+ * while the database is locked (less than 1/8 free slots). The entries
+ * inserted past this point go to the overflow slots until the last unlock.
+ * @private
+ */
+#define DBH_EXHAUSTED(used, capacity) ( (uint64)(used)*8 >= (uint64)(capacity)*7 )
+
+/**
+ * Number of overflow slots allocated at once. Overflow slots are allocated
+ * in chunks so that the existing ones never move.
+ * @private
+ * @see struct DBMap_impl#overflow
+ */
+#define DBH_OVERFLOW_CHUNK 64
+
+/**
+ * State of a slot of an open-addressing database.
+ * @param DBH_SLOT_EMPTY Never used since the last rebuild, ends a probe
+ * @param DBH_SLOT_USED Contains a live entry
+ * @param DBH_SLOT_DELETED Tombstone of a removed entry
+ * @param DBH_SLOT_PENDING Tombstone that still owns a duplicated key, which
+ *          is freed when the database is unlocked
+ * @private
+ * @see struct DBHashSlot
+ */
+enum DBHashSlotState {
+	DBH_SLOT_EMPTY = 0,
+	DBH_SLOT_USED,
+	DBH_SLOT_DELETED,
+	DBH_SLOT_PENDING,
+};
+
+/**
+ * A slot of an open-addressing database.
+ * @param key Key of this database entry
+ * @param data Data of this database entry
+ * @param hash Cached hash of the key (avoids most key comparisons)
+ * @param state State of the slot
+ * @private
+ * @see struct DBMap_impl#slots
+ */
+struct DBHashSlot {
+	union DBKey key;
+	struct DBData data;
+	uint32 hash;
+	uint8 state;
+};
+
 /**
  * The color of individual nodes.
  * @private
@@ -195,6 +266,14 @@ struct db_free {
  * @param hash Hasher of the database
  * @param release Releaser of the database
  * @param ht Hashtable of RED-BLACK trees
+ * @param slots Table of open-addressing databases
+ * @param capacity Number of slots (power of two, 0 until the first insertion)
+ * @param tombstones Number of deleted slots in the table
+ * @param pending Number of tombstones holding a key to be freed on unlock
+ * @param overflow Chunks of slots holding the entries inserted while the
+ *          database was locked and the table was exhausted, merged into the
+ *          table on the last unlock (the table is never rebuilt while locked)
+ * @param overflow_count Number of overflow slots in use
  * @param type Type of the database
  * @param options Options of the database
  * @param item_count Number of items in the database
@@ -221,6 +300,13 @@ struct DBMap_impl {
 	DBReleaser release;
 	struct DBNode *ht[HASH_SIZE];
 	struct DBNode *cache;
+	// Open-addressing table
+	struct DBHashSlot *slots;
+	uint32 capacity;
+	uint32 tombstones;
+	uint32 pending;
+	struct DBHashSlot **overflow;
+	uint32 overflow_count;
 	enum DBType type;
 	enum DBOptions options;
 	uint32 item_count;
@@ -232,7 +318,7 @@ struct DBMap_impl {
  * Complete iterator structure.
  * @param vtable Interface of the iterator
  * @param db Parent database
- * @param ht_index Current index of the hashtable
+ * @param ht_index Current index of the hashtable (or slot of open-addressing databases)
  * @param node Current node
  * @private
  * @see struct DBIterator
@@ -343,6 +429,15 @@ static struct db_stats {
 	uint32 db_data2ptr;
 	uint32 db_init;
 	uint32 db_final;
+	// Lookup cost comparison (tree depth vs. probe length)
+	uint32 db_tree_lookup;
+	uint32 db_tree_steps_max;
+	uint64 db_tree_steps;
+	uint32 db_hash_lookup;
+	uint32 db_hash_steps_max;
+	uint64 db_hash_steps;
+	uint32 db_hash_rebuild;
+	uint32 db_hash_overflow;
 } stats = {
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -350,11 +445,24 @@ static struct db_stats {
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 0
+	0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0
 };
 #define DB_COUNTSTAT(token) do { if ((stats.token) != UINT32_MAX) ++(stats.token); } while(0)
+/**
+ * Records the number of nodes (tree) or slots (open-addressing) visited by a lookup.
+ * @param kind tree or hash
+ * @param steps Number of visited nodes/slots
+ */
+#define DB_COUNTLOOKUP(kind, steps) do { \
+	DB_COUNTSTAT(db_##kind##_lookup); \
+	stats.db_##kind##_steps += (steps); \
+	if ((uint32)(steps) > stats.db_##kind##_steps_max) \
+		stats.db_##kind##_steps_max = (uint32)(steps); \
+} while(0)
 #else /* !defined(DB_ENABLE_STATS) */
 #define DB_COUNTSTAT(token) (void)0
+#define DB_COUNTLOOKUP(kind, steps) (void)(steps)
 #endif /* !defined(DB_ENABLE_STATS) */
 
 /* [Ind/Hercules] */
@@ -373,6 +481,16 @@ static struct eri *db_alloc_ers;
  *  db_free_add        - Add a node to the free_list of a database.          *
  *  db_free_remove     - Remove a node from the free_list of a database.     *
  *  db_free_lock       - Increment the free_lock of a database.              *
+ *  dbh_hash           - Hash a key of an open-addressing database.          *
+ *  dbh_slot           - Get an open-addressing slot by index.               *
+ *  dbh_free_overflow  - Free the overflow slots of an open-addressing db.   *
+ *  dbh_rebuild        - Rebuild the table of an open-addressing database.   *
+ *  dbh_resize         - Rebuild the table with room for the entries.        *
+ *  dbh_reserve        - Make room for one more open-addressing entry.       *
+ *  dbh_find           - Find the slot of an open-addressing entry.          *
+ *  dbh_find_or_claim  - Find or claim the slot of an open-addressing entry. *
+ *  dbh_remove_slot    - Turn an open-addressing slot into a tombstone.      *
+ *  dbh_free_unlock    - Release what was kept while the table was locked.   *
  *  db_free_unlock     - Decrement the free_lock of a database.              *
  *         If it was the last lock, frees the nodes in free_list.            *
  *         NOTE: Keeps the database trees balanced.                          *
@@ -817,6 +935,299 @@ static void db_free_remove(struct DBMap_impl *db, struct DBNode *node)
 	db->item_count++;
 }
 
+/**
+ * Hashes a key for an open-addressing database.
+ * The default hashers of numeric keys return the key itself, so the result
+ * is mixed (MurmurHash3 finalizer) to spread sequential ids over the table.
+ * @param db Target database
+ * @param key Key to be hashed
+ * @return Mixed hash of the key
+ * @private
+ */
+static uint32 dbh_hash(struct DBMap_impl *db, union DBKey key)
+{
+	uint64 hash = db->hash(key, db->maxlen);
+
+	hash ^= hash >> 33;
+	hash *= UINT64_C(0xff51afd7ed558ccd);
+	hash ^= hash >> 33;
+	hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+	hash ^= hash >> 33;
+	return (uint32)hash;
+}
+
+/**
+ * Returns a slot of an open-addressing database by index.
+ * Indexes past the end of the table refer to the overflow slots.
+ * @param db Target database
+ * @param index Index of the slot, below capacity + overflow_count
+ * @return The slot
+ * @private
+ */
+static inline struct DBHashSlot *dbh_slot(struct DBMap_impl *db, uint32 index)
+{
+	if (index < db->capacity)
+		return &db->slots[index];
+	index -= db->capacity;
+	return &db->overflow[index / DBH_OVERFLOW_CHUNK][index % DBH_OVERFLOW_CHUNK];
+}
+
+/**
+ * Frees the overflow slots of an open-addressing database.
+ * Their entries must have been moved to the table or released.
+ * @param db Target database
+ * @private
+ */
+static void dbh_free_overflow(struct DBMap_impl *db)
+{
+	uint32 i;
+
+	if (db->overflow == NULL)
+		return;
+	for (i = 0; i * DBH_OVERFLOW_CHUNK < db->overflow_count; i++)
+		aFree(db->overflow[i]);
+	aFree(db->overflow);
+	db->overflow = NULL;
+	db->overflow_count = 0;
+}
+
+/**
+ * Rebuilds the table of an open-addressing database with the specified
+ * capacity, dropping the tombstones and merging the overflow slots.
+ * Tombstones that still own a key (DBH_SLOT_PENDING) are carried over.
+ * Only called while the database is unlocked, or while it is still empty,
+ * so that iterators never see the entries move.
+ * @param db Target database
+ * @param capacity New number of slots (power of two)
+ * @private
+ * @see #dbh_resize()
+ */
+static void dbh_rebuild(struct DBMap_impl *db, uint32 capacity)
+{
+	struct DBHashSlot *old_slots = db->slots;
+	uint32 old_capacity = db->capacity;
+	uint32 old_count = old_capacity + db->overflow_count;
+	uint32 mask = capacity - 1;
+	uint32 i;
+
+	DB_COUNTSTAT(db_hash_rebuild);
+	db->slots = aCalloc(capacity, sizeof(struct DBHashSlot));
+	db->capacity = capacity;
+	db->tombstones = db->pending;
+	for (i = 0; i < old_count; i++) {
+		const struct DBHashSlot *slot;
+		uint32 j;
+
+		if (i < old_capacity) {
+			slot = &old_slots[i];
+		} else {
+			uint32 k = i - old_capacity;
+			slot = &db->overflow[k / DBH_OVERFLOW_CHUNK][k % DBH_OVERFLOW_CHUNK];
+		}
+		if (slot->state != DBH_SLOT_USED && slot->state != DBH_SLOT_PENDING)
+			continue;
+		for (j = slot->hash & mask; db->slots[j].state != DBH_SLOT_EMPTY; j = (j + 1) & mask)
+			;
+		memcpy(&db->slots[j], slot, sizeof(struct DBHashSlot));
+	}
+	aFree(old_slots);
+	dbh_free_overflow(db);
+}
+
+/**
+ * Rebuilds the table of an open-addressing database with enough capacity to
+ * keep its load at or below 1/2 after one more insertion.
+ * @param db Target database
+ * @private
+ * @see #dbh_rebuild()
+ */
+static void dbh_resize(struct DBMap_impl *db)
+{
+	uint32 capacity = max(db->capacity, DBH_MIN_CAPACITY);
+
+	while ((uint64)(db->item_count + db->pending + 1) * 2 > capacity) {
+		if (capacity >= UINT32_C(0x80000000)) {
+			ShowFatalError("dbh_resize: capacity overflow\n"
+					"Database allocated at %s:%d\n",
+					db->alloc_file, db->alloc_line);
+			exit(EXIT_FAILURE);
+		}
+		capacity <<= 1;
+	}
+	dbh_rebuild(db, capacity);
+}
+
+/**
+ * Makes sure an open-addressing database has room for one more entry.
+ * While the database is locked the table is never rebuilt (except for the
+ * first allocation), since rebuilding moves the entries; once the table is
+ * exhausted, #dbh_find_or_claim() puts new entries in the overflow slots.
+ * @param db Target database
+ * @private
+ * @see #dbh_resize()
+ */
+static void dbh_reserve(struct DBMap_impl *db)
+{
+	if (db->capacity == 0) {
+		dbh_rebuild(db, DBH_MIN_CAPACITY);
+		return;
+	}
+	if (db->free_lock != 0)
+		return; // postponed until unlocked
+	if (DBH_OVERLOADED(db->item_count + db->tombstones + 1, db->capacity))
+		dbh_resize(db);
+}
+
+/**
+ * Finds the slot of a live entry in an open-addressing database.
+ * @param db Target database
+ * @param key Key of the entry
+ * @param hash Hash of the key, as returned by #dbh_hash()
+ * @return Slot of the entry or NULL if not found
+ * @private
+ */
+static struct DBHashSlot *dbh_find(struct DBMap_impl *db, union DBKey key, uint32 hash)
+{
+	struct DBHashSlot *slot = NULL;
+	uint32 mask, i;
+	int steps = 0;
+
+	if (db->capacity == 0)
+		return NULL;
+	mask = db->capacity - 1;
+	for (i = hash & mask; db->slots[i].state != DBH_SLOT_EMPTY; i = (i + 1) & mask) {
+		++steps;
+		if (db->slots[i].state == DBH_SLOT_USED && db->slots[i].hash == hash
+		 && db->cmp(key, db->slots[i].key, db->maxlen) == 0) {
+			slot = &db->slots[i];
+			break;
+		}
+	}
+	for (i = 0; slot == NULL && i < db->overflow_count; i++) {
+		struct DBHashSlot *oslot = dbh_slot(db, db->capacity + i);
+		++steps;
+		if (oslot->state == DBH_SLOT_USED && oslot->hash == hash
+		 && db->cmp(key, oslot->key, db->maxlen) == 0)
+			slot = oslot;
+	}
+	DB_COUNTLOOKUP(hash, steps);
+	return slot;
+}
+
+/**
+ * Finds the slot of an entry in an open-addressing database, claiming a free
+ * slot for it if it doesn't exist yet.
+ * A claimed slot is marked as used and counted, the caller fills key and data.
+ * @param db Target database
+ * @param key Key of the entry
+ * @param out_found Set to true if the entry already existed
+ * @return Slot of the entry
+ * @private
+ */
+static struct DBHashSlot *dbh_find_or_claim(struct DBMap_impl *db, union DBKey key, bool *out_found)
+{
+	struct DBHashSlot *tombstone = NULL;
+	uint32 hash = dbh_hash(db, key);
+	uint32 mask, i;
+
+	dbh_reserve(db);
+	mask = db->capacity - 1;
+	for (i = hash & mask; db->slots[i].state != DBH_SLOT_EMPTY; i = (i + 1) & mask) {
+		struct DBHashSlot *slot = &db->slots[i];
+		if (slot->state == DBH_SLOT_USED) {
+			if (slot->hash == hash && db->cmp(key, slot->key, db->maxlen) == 0) {
+				*out_found = true;
+				return slot;
+			}
+		} else if (slot->state == DBH_SLOT_DELETED && tombstone == NULL) {
+			tombstone = slot; // reusable, but the key might still be further away
+		}
+	}
+	if (db->overflow_count != 0) {
+		struct DBHashSlot *slot = dbh_find(db, key, hash);
+		if (slot != NULL) {
+			*out_found = true;
+			return slot;
+		}
+	}
+	if (tombstone != NULL) {
+		db->tombstones--;
+	} else if (db->free_lock != 0 && DBH_EXHAUSTED(db->item_count + db->tombstones - db->overflow_count + 1, db->capacity)) {
+		// locked and out of room, keep it aside until the last unlock
+		uint32 index = db->overflow_count;
+		if (index % DBH_OVERFLOW_CHUNK == 0) {
+			RECREATE(db->overflow, struct DBHashSlot *, index / DBH_OVERFLOW_CHUNK + 1);
+			db->overflow[index / DBH_OVERFLOW_CHUNK] = aCalloc(DBH_OVERFLOW_CHUNK, sizeof(struct DBHashSlot));
+		}
+		db->overflow_count++;
+		tombstone = dbh_slot(db, db->capacity + index);
+		DB_COUNTSTAT(db_hash_overflow);
+	} else {
+		tombstone = &db->slots[i];
+	}
+	tombstone->state = DBH_SLOT_USED;
+	tombstone->hash = hash;
+	db->item_count++;
+	*out_found = false;
+	return tombstone;
+}
+
+/**
+ * Turns the slot of a live entry into a tombstone.
+ * The data must have been released by the caller.
+ * While the database is locked, the key is kept in the tombstone and freed
+ * when the database is unlocked.
+ * @param db Target database
+ * @param slot Slot of the entry
+ * @private
+ * @see #db_free_unlock()
+ */
+static void dbh_remove_slot(struct DBMap_impl *db, struct DBHashSlot *slot)
+{
+	if (!(db->options&DB_OPT_DUP_KEY)) {
+		union DBKey old_key = slot->key;
+		if (db->free_lock != 0) // Make sure we have a key until the database is unlocked
+			slot->key = db_dup_key(db, slot->key);
+		db->release(old_key, slot->data, DB_RELEASE_KEY);
+	} else if (db->free_lock == 0) {
+		db_dup_key_free(db, slot->key);
+	}
+	if (db->free_lock != 0) {
+		slot->state = DBH_SLOT_PENDING;
+		db->pending++;
+	} else {
+		slot->state = DBH_SLOT_DELETED;
+	}
+	db->tombstones++;
+	db->item_count--;
+}
+
+/**
+ * Frees the keys of the tombstones created while an open-addressing database
+ * was locked, and rebuilds the table if it got overloaded or entries were
+ * put in the overflow slots.
+ * @param db Target database
+ * @private
+ * @see #db_free_unlock()
+ */
+static void dbh_free_unlock(struct DBMap_impl *db)
+{
+	if (db->pending != 0) {
+		uint32 i;
+		for (i = 0; i < db->capacity + db->overflow_count; i++) {
+			struct DBHashSlot *slot = dbh_slot(db, i);
+			if (slot->state != DBH_SLOT_PENDING)
+				continue;
+			db_dup_key_free(db, slot->key);
+			slot->state = DBH_SLOT_DELETED;
+		}
+		db->pending = 0;
+	}
+	if (db->overflow_count != 0
+	 || (db->capacity != 0 && DBH_OVERLOADED(db->item_count + db->tombstones, db->capacity)))
+		dbh_resize(db);
+}
+
 /**
  * Increment the free_lock of the database.
  * @param db Target database
@@ -862,6 +1273,10 @@ static void db_free_unlock(struct DBMap_impl *db)
 	if (db->free_lock)
 		return; // Not last lock
 
+	if (db->options&DB_OPT_OPEN_ADDRESSING) {
+		dbh_free_unlock(db);
+		return;
+	}
 	for (i = 0; i < db->free_count ; i++) {
 		db_rebalance_erase(db->free_list[i].node, db->free_list[i].root);
 		db_dup_key_free(db, db->free_list[i].node->key);
@@ -1250,6 +1665,7 @@ static void db_release_both(union DBKey key, struct DBData data, enum DBReleaseO
  *  db_obj_size     - Return the size of the database.                       *
  *  db_obj_type     - Return the type of the database.                       *
  *  db_obj_options  - Return the options of the database.                    *
+ *  dbhit_obj_*, dbh_obj_* - Same as above for open-addressing databases.    *
 \*****************************************************************************/
 
 /**
@@ -1563,6 +1979,7 @@ static bool db_obj_exists(struct DBMap *self, union DBKey key)
 	struct DBMap_impl *db = (struct DBMap_impl *)self;
 	struct DBNode *node;
 	bool found = false;
+	int steps = 0;
 
 	DB_COUNTSTAT(db_exists);
 	if (db == NULL) return false; // nullpo candidate
@@ -1577,6 +1994,7 @@ static bool db_obj_exists(struct DBMap *self, union DBKey key)
 			return false;
 		}
 #endif
+		DB_COUNTLOOKUP(tree, 1);
 		return true; // cache hit
 	}
 
@@ -1584,6 +2002,7 @@ static bool db_obj_exists(struct DBMap *self, union DBKey key)
 	node = db->ht[db->hash(key, db->maxlen)%HASH_SIZE];
 	while (node) {
 		int c = db->cmp(key, node->key, db->maxlen);
+		++steps;
 		if (c == 0) {
 			if (!(node->deleted)) {
 				db->cache = node;
@@ -1596,6 +2015,7 @@ static bool db_obj_exists(struct DBMap *self, union DBKey key)
 		else
 			node = node->right;
 	}
+	DB_COUNTLOOKUP(tree, steps);
 	db_free_unlock(db);
 	return found;
 }
@@ -1613,6 +2033,7 @@ static struct DBData *db_obj_get(struct DBMap *self, union DBKey key)
 	struct DBMap_impl *db = (struct DBMap_impl *)self;
 	struct DBNode *node;
 	struct DBData *data = NULL;
+	int steps = 0;
 
 	DB_COUNTSTAT(db_get);
 	if (db == NULL) return NULL; // nullpo candidate
@@ -1628,6 +2049,7 @@ static struct DBData *db_obj_get(struct DBMap *self, union DBKey key)
 			return NULL;
 		}
 #endif
+		DB_COUNTLOOKUP(tree, 1);
 		return &db->cache->data; // cache hit
 	}
 
@@ -1635,6 +2057,7 @@ static struct DBData *db_obj_get(struct DBMap *self, union DBKey key)
 	node = db->ht[db->hash(key, db->maxlen)%HASH_SIZE];
 	while (node) {
 		int c = db->cmp(key, node->key, db->maxlen);
+		++steps;
 		if (c == 0) {
 			if (!(node->deleted)) {
 				data = &node->data;
@@ -1647,6 +2070,7 @@ static struct DBData *db_obj_get(struct DBMap *self, union DBKey key)
 		else
 			node = node->right;
 	}
+	DB_COUNTLOOKUP(tree, steps);
 	db_free_unlock(db);
 	return data;
 }
@@ -2385,6 +2809,493 @@ static enum DBOptions db_obj_options(struct DBMap *self)
 	return options;
 }
 
+/**
+ * Fetches the first entry in an open-addressing database.
+ * @see #dbit_obj_first()
+ * @protected
+ */
+static struct DBData *dbhit_obj_first(struct DBIterator *self, union DBKey *out_key)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+
+	DB_COUNTSTAT(dbit_first);
+	it->ht_index = -1;
+	return self->next(self, out_key);
+}
+
+/**
+ * Fetches the last entry in an open-addressing database.
+ * @see #dbit_obj_last()
+ * @protected
+ */
+static struct DBData *dbhit_obj_last(struct DBIterator *self, union DBKey *out_key)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+
+	DB_COUNTSTAT(dbit_last);
+	it->ht_index = INT_MAX;
+	return self->prev(self, out_key);
+}
+
+/**
+ * Fetches the next entry in an open-addressing database.
+ * Entries are returned in table order, followed by the overflow slots.
+ * The table is not rebuilt while the iterator exists, so slot indexes stay valid.
+ * @see #dbit_obj_next()
+ * @protected
+ */
+static struct DBData *dbhit_obj_next(struct DBIterator *self, union DBKey *out_key)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+	struct DBMap_impl *db = it->db;
+	int64 i;
+
+	DB_COUNTSTAT(dbit_next);
+	if (it->ht_index == INT_MAX)
+		return NULL; // already after the last entry
+	for (i = it->ht_index + 1; i < (int64)db->capacity + db->overflow_count; ++i) {
+		struct DBHashSlot *slot = dbh_slot(db, (uint32)i);
+		if (slot->state != DBH_SLOT_USED)
+			continue;
+		it->ht_index = (int)i;
+		if (out_key)
+			memcpy(out_key, &slot->key, sizeof(union DBKey));
+		return &slot->data;
+	}
+	it->ht_index = INT_MAX;
+	return NULL; // not found
+}
+
+/**
+ * Fetches the previous entry in an open-addressing database.
+ * @see #dbit_obj_prev()
+ * @protected
+ */
+static struct DBData *dbhit_obj_prev(struct DBIterator *self, union DBKey *out_key)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+	struct DBMap_impl *db = it->db;
+	int64 i;
+
+	DB_COUNTSTAT(dbit_prev);
+	i = (it->ht_index == INT_MAX) ? (int64)db->capacity + db->overflow_count : min(it->ht_index, (int64)db->capacity + db->overflow_count);
+	for (--i; i >= 0; --i) {
+		struct DBHashSlot *slot = dbh_slot(db, (uint32)i);
+		if (slot->state != DBH_SLOT_USED)
+			continue;
+		it->ht_index = (int)i;
+		if (out_key)
+			memcpy(out_key, &slot->key, sizeof(union DBKey));
+		return &slot->data;
+	}
+	it->ht_index = -1;
+	return NULL; // not found
+}
+
+/**
+ * Returns true if the fetched entry of an open-addressing database exists.
+ * @see #dbit_obj_exists()
+ * @protected
+ */
+static bool dbhit_obj_exists(struct DBIterator *self)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+
+	DB_COUNTSTAT(dbit_exists);
+	if (it->ht_index < 0 || (int64)it->ht_index >= (int64)it->db->capacity + it->db->overflow_count)
+		return false; // before the first or after the last entry, or cleared
+	return (dbh_slot(it->db, (uint32)it->ht_index)->state == DBH_SLOT_USED);
+}
+
+/**
+ * Removes the current entry from an open-addressing database.
+ * @see #dbit_obj_remove()
+ * @protected
+ */
+static int dbhit_obj_remove(struct DBIterator *self, struct DBData *out_data)
+{
+	struct DBIterator_impl *it = (struct DBIterator_impl *)self;
+	struct DBMap_impl *db = it->db;
+	struct DBHashSlot *slot;
+
+	DB_COUNTSTAT(dbit_remove);
+	if (!self->exists(self))
+		return 0;
+	slot = dbh_slot(db, (uint32)it->ht_index);
+	db->release(slot->key, slot->data, DB_RELEASE_DATA);
+	if (out_data)
+		memcpy(out_data, &slot->data, sizeof(struct DBData));
+	dbh_remove_slot(db, slot);
+	return 1;
+}
+
+/**
+ * Returns a new iterator for an open-addressing database.
+ * @see #db_obj_iterator()
+ * @protected
+ */
+static struct DBIterator *dbh_obj_iterator(struct DBMap *self)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBIterator_impl *it;
+
+	DB_COUNTSTAT(db_iterator);
+	it = ers_alloc(db_iterator_ers, struct DBIterator_impl);
+	/* Interface of the iterator **/
+	it->vtable.first   = dbhit_obj_first;
+	it->vtable.last    = dbhit_obj_last;
+	it->vtable.next    = dbhit_obj_next;
+	it->vtable.prev    = dbhit_obj_prev;
+	it->vtable.exists  = dbhit_obj_exists;
+	it->vtable.remove  = dbhit_obj_remove;
+	it->vtable.destroy = dbit_obj_destroy;
+	/* Initial state (before the first entry) */
+	it->db = db;
+	it->ht_index = -1;
+	it->node = NULL;
+	/* Lock the database */
+	db_free_lock(db);
+	return &it->vtable;
+}
+
+/**
+ * Returns true if the entry exists in an open-addressing database.
+ * @see #db_obj_exists()
+ * @protected
+ */
+static bool dbh_obj_exists(struct DBMap *self, union DBKey key)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+
+	DB_COUNTSTAT(db_exists);
+	if (db == NULL) return false; // nullpo candidate
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		return false; // nullpo candidate
+	}
+
+	return (dbh_find(db, key, dbh_hash(db, key)) != NULL);
+}
+
+/**
+ * Get the data of the entry identified by the key in an open-addressing
+ * database.
+ * NOTE: the returned pointer is only valid until the next insertion.
+ * @see #db_obj_get()
+ * @protected
+ */
+static struct DBData *dbh_obj_get(struct DBMap *self, union DBKey key)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBHashSlot *slot;
+
+	DB_COUNTSTAT(db_get);
+	if (db == NULL) return NULL; // nullpo candidate
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		ShowError("db_get: Attempted to retrieve non-allowed NULL key for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return NULL; // nullpo candidate
+	}
+
+	slot = dbh_find(db, key, dbh_hash(db, key));
+	if (slot == NULL)
+		return NULL;
+	return &slot->data;
+}
+
+/**
+ * Get the data of the entries matched by <code>match</code> in an
+ * open-addressing database.
+ * @see #db_obj_vgetall()
+ * @protected
+ */
+static unsigned int dbh_obj_vgetall(struct DBMap *self, struct DBData **buf, unsigned int max, DBMatcher match, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	unsigned int ret = 0;
+	uint32 i;
+
+	DB_COUNTSTAT(db_vgetall);
+	if (db == NULL) return 0; // nullpo candidate
+	if (match == NULL) return 0; // nullpo candidate
+
+	db_free_lock(db);
+	for (i = 0; i < db->capacity + db->overflow_count; i++) {
+		struct DBHashSlot *slot = dbh_slot(db, i);
+		va_list argscopy;
+
+		if (slot->state != DBH_SLOT_USED)
+			continue;
+		va_copy(argscopy, args);
+		if (match(slot->key, slot->data, argscopy) == 0) {
+			if (buf && ret < max)
+				buf[ret] = &slot->data;
+			ret++;
+		}
+		va_end(argscopy);
+	}
+	db_free_unlock(db);
+	return ret;
+}
+
+/**
+ * Get the data of the entry identified by the key in an open-addressing
+ * database, creating it if it doesn't exist.
+ * NOTE: the returned pointer is only valid until the next insertion.
+ * @see #db_obj_vensure()
+ * @protected
+ */
+static struct DBData *dbh_obj_vensure(struct DBMap *self, union DBKey key, DBCreateData create, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBHashSlot *slot;
+	struct DBData data;
+	va_list argscopy;
+	bool found;
+
+	DB_COUNTSTAT(db_vensure);
+	if (db == NULL) return NULL; // nullpo candidate
+	if (create == NULL) {
+		ShowError("db_ensure: Create function is NULL for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return NULL; // nullpo candidate
+	}
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		ShowError("db_ensure: Attempted to use non-allowed NULL key for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return NULL; // nullpo candidate
+	}
+
+	slot = dbh_find(db, key, dbh_hash(db, key));
+	if (slot != NULL)
+		return &slot->data;
+
+	if (db->item_count == UINT32_MAX) {
+		ShowError("db_vensure: item_count overflow, aborting item insertion.\n"
+				"Database allocated at %s:%d",
+				db->alloc_file, db->alloc_line);
+		return NULL;
+	}
+	// create() may use the database and move the slots, so it runs first
+	va_copy(argscopy, args);
+	data = create(key, argscopy);
+	va_end(argscopy);
+	slot = dbh_find_or_claim(db, key, &found);
+	if (!found) {
+		if (db->options&DB_OPT_DUP_KEY) {
+			slot->key = db_dup_key(db, key);
+			if (db->options&DB_OPT_RELEASE_KEY)
+				db->release(key, data, DB_RELEASE_KEY);
+		} else {
+			slot->key = key;
+		}
+	}
+	slot->data = data;
+	return &slot->data;
+}
+
+/**
+ * Put the data identified by the key in an open-addressing database.
+ * @see #db_obj_put()
+ * @protected
+ */
+static int dbh_obj_put(struct DBMap *self, union DBKey key, struct DBData data, struct DBData *out_data)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBHashSlot *slot;
+	bool found;
+	int retval = 0;
+
+	DB_COUNTSTAT(db_put);
+	if (db == NULL) return 0; // nullpo candidate
+	if (db->global_lock) {
+		ShowError("db_put: Database is being destroyed, aborting entry insertion.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		ShowError("db_put: Attempted to use non-allowed NULL key for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+	if (!(db->options&DB_OPT_ALLOW_NULL_DATA) && (data.type == DB_DATA_PTR && data.u.ptr == NULL)) {
+		ShowError("db_put: Attempted to use non-allowed NULL data for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+
+	if (db->item_count == UINT32_MAX) {
+		ShowError("db_put: item_count overflow, aborting item insertion.\n"
+				"Database allocated at %s:%d",
+				db->alloc_file, db->alloc_line);
+		return 0;
+	}
+	slot = dbh_find_or_claim(db, key, &found);
+	if (found) { // equal entry, replace
+		db->release(slot->key, slot->data, DB_RELEASE_BOTH);
+		if (out_data)
+			memcpy(out_data, &slot->data, sizeof(*out_data));
+		retval = 1;
+	}
+	// put key and data in the slot
+	if (db->options&DB_OPT_DUP_KEY) {
+		slot->key = db_dup_key(db, key);
+		if (db->options&DB_OPT_RELEASE_KEY)
+			db->release(key, data, DB_RELEASE_KEY);
+	} else {
+		slot->key = key;
+	}
+	slot->data = data;
+	return retval;
+}
+
+/**
+ * Remove an entry from an open-addressing database.
+ * @see #db_obj_remove()
+ * @protected
+ */
+static int dbh_obj_remove(struct DBMap *self, union DBKey key, struct DBData *out_data)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	struct DBHashSlot *slot;
+
+	DB_COUNTSTAT(db_remove);
+	if (db == NULL) return 0; // nullpo candidate
+	if (db->global_lock) {
+		ShowError("db_remove: Database is being destroyed. Aborting entry deletion.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+	if (!(db->options&DB_OPT_ALLOW_NULL_KEY) && db_is_key_null(db->type, key)) {
+		ShowError("db_remove: Attempted to use non-allowed NULL key for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+
+	slot = dbh_find(db, key, dbh_hash(db, key));
+	if (slot == NULL)
+		return 0;
+	db->release(slot->key, slot->data, DB_RELEASE_DATA);
+	if (out_data)
+		memcpy(out_data, &slot->data, sizeof(*out_data));
+	dbh_remove_slot(db, slot);
+	return 1;
+}
+
+/**
+ * Apply <code>func</code> to every entry in an open-addressing database.
+ * @see #db_obj_vforeach()
+ * @protected
+ */
+static int dbh_obj_vforeach(struct DBMap *self, DBApply func, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	int sum = 0;
+	uint32 i;
+
+	DB_COUNTSTAT(db_vforeach);
+	if (db == NULL) return 0; // nullpo candidate
+	if (func == NULL) {
+		ShowError("db_foreach: Passed function is NULL for db allocated at %s:%d\n",db->alloc_file, db->alloc_line);
+		return 0; // nullpo candidate
+	}
+
+	// the table is not rebuilt while locked, entries inserted by func go to
+	// free slots or to the overflow slots and may or may not be visited
+	db_free_lock(db);
+	for (i = 0; i < db->capacity + db->overflow_count; i++) {
+		struct DBHashSlot *slot = dbh_slot(db, i);
+		va_list argscopy;
+
+		if (slot->state != DBH_SLOT_USED)
+			continue;
+		va_copy(argscopy, args);
+		sum += func(slot->key, &slot->data, argscopy);
+		va_end(argscopy);
+	}
+	db_free_unlock(db);
+	return sum;
+}
+
+/**
+ * Removes all entries from an open-addressing database.
+ * The table keeps its capacity.
+ * @see #db_obj_vclear()
+ * @protected
+ */
+static int dbh_obj_vclear(struct DBMap *self, DBApply func, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	int sum = 0;
+	uint32 i;
+
+	DB_COUNTSTAT(db_vclear);
+	if (db == NULL) return 0; // nullpo candidate
+
+	db_free_lock(db);
+	for (i = 0; i < db->capacity + db->overflow_count; i++) {
+		struct DBHashSlot *slot = dbh_slot(db, i);
+
+		if (slot->state == DBH_SLOT_PENDING) {
+			db_dup_key_free(db, slot->key);
+		} else if (slot->state == DBH_SLOT_USED) {
+			if (func) {
+				va_list argscopy;
+				va_copy(argscopy, args);
+				sum += func(slot->key, &slot->data, argscopy);
+				va_end(argscopy);
+			}
+			db->release(slot->key, slot->data, DB_RELEASE_BOTH);
+		}
+		slot->state = DBH_SLOT_EMPTY;
+	}
+	db->item_count = 0;
+	db->tombstones = 0;
+	db->pending = 0;
+	dbh_free_overflow(db);
+	db_free_unlock(db);
+	return sum;
+}
+
+/**
+ * Finalize an open-addressing database, feeing all the memory it uses.
+ * @see #db_obj_vdestroy()
+ * @protected
+ */
+static int dbh_obj_vdestroy(struct DBMap *self, DBApply func, va_list args)
+{
+	struct DBMap_impl *db = (struct DBMap_impl *)self;
+	int sum;
+
+	DB_COUNTSTAT(db_vdestroy);
+	if (db == NULL) return 0; // nullpo candidate
+	if (db->global_lock) {
+		ShowError("db_vdestroy: Database is already locked for destruction. Aborting second database destruction.\n"
+				"Database allocated at %s:%d\n",
+				db->alloc_file, db->alloc_line);
+		return 0;
+	}
+	if (db->free_lock)
+		ShowWarning("db_vdestroy: Database is still in use, %u lock(s) left. Continuing database destruction.\n"
+				"Database allocated at %s:%d\n",
+				db->free_lock, db->alloc_file, db->alloc_line);
+
+#ifdef DB_ENABLE_STATS
+	switch (db->type) {
+		case DB_INT: DB_COUNTSTAT(db_int_destroy); break;
+		case DB_UINT: DB_COUNTSTAT(db_uint_destroy); break;
+		case DB_STRING: DB_COUNTSTAT(db_string_destroy); break;
+		case DB_ISTRING: DB_COUNTSTAT(db_istring_destroy); break;
+		case DB_INT64: DB_COUNTSTAT(db_int64_destroy); break;
+		case DB_UINT64: DB_COUNTSTAT(db_uint64_destroy); break;
+	}
+#endif /* DB_ENABLE_STATS */
+	db_free_lock(db);
+	db->global_lock = 1;
+	sum = self->vclear(self, func, args);
+	aFree(db->slots);
+	db->slots = NULL;
+	db->capacity = 0;
+	db_free_unlock(db);
+	ers_free(db_alloc_ers, db);
+	return sum;
+}
+
 /*****************************************************************************\
  *  (5) Section with public functions.
  *  db_fix_options     - Apply database type restrictions to the options.
@@ -2606,6 +3517,18 @@ static struct DBMap *db_alloc(const char *file, const char *func, int line, enum
 	db->vtable.size     = db_obj_size;
 	db->vtable.type     = db_obj_type;
 	db->vtable.options  = db_obj_options;
+	if (options&DB_OPT_OPEN_ADDRESSING) {
+		db->vtable.iterator = dbh_obj_iterator;
+		db->vtable.exists   = dbh_obj_exists;
+		db->vtable.get      = dbh_obj_get;
+		db->vtable.vgetall  = dbh_obj_vgetall;
+		db->vtable.vensure  = dbh_obj_vensure;
+		db->vtable.put      = dbh_obj_put;
+		db->vtable.remove   = dbh_obj_remove;
+		db->vtable.vforeach = dbh_obj_vforeach;
+		db->vtable.vclear   = dbh_obj_vclear;
+		db->vtable.vdestroy = dbh_obj_vdestroy;
+	}
 	/* File and line of allocation */
 	db->alloc_file = file;
 	db->alloc_line = line;
@@ -2615,14 +3538,24 @@ static struct DBMap *db_alloc(const char *file, const char *func, int line, enum
 	db->free_max = 0;
 	db->free_lock = 0;
 	/* Other */
-	snprintf(ers_name, 50, "db_alloc:nodes:%s:%s:%d",func,file,line);
-	db->nodes = ers_new(sizeof(struct DBNode),ers_name,ERS_OPT_WAIT|ERS_OPT_FREE_NAME|ERS_OPT_CLEAN);
+	if (options&DB_OPT_OPEN_ADDRESSING) {
+		db->nodes = NULL; // no tree nodes
+	} else {
+		snprintf(ers_name, 50, "db_alloc:nodes:%s:%s:%d",func,file,line);
+		db->nodes = ers_new(sizeof(struct DBNode),ers_name,ERS_OPT_WAIT|ERS_OPT_FREE_NAME|ERS_OPT_CLEAN);
+	}
 	db->cmp = DB->default_cmp(type);
 	db->hash = DB->default_hash(type);
 	db->release = DB->default_release(type, options);
 	for (i = 0; i < HASH_SIZE; i++)
 		db->ht[i] = NULL;
 	db->cache = NULL;
+	db->slots = NULL;
+	db->capacity = 0;
+	db->tombstones = 0;
+	db->pending = 0;
+	db->overflow = NULL;
+	db->overflow_count = 0;
 	db->type = type;
 	db->options = options;
 	db->item_count = 0;
@@ -2915,6 +3848,13 @@ static void db_final(void)
 			stats.db_ptr2data,        stats.db_data2i,
 			stats.db_data2ui,         stats.db_data2ptr,
 			stats.db_init,            stats.db_final);
+	ShowInfo(CL_WHITE"Database lookup cost"CL_RESET":\n"
+			"RED-BLACK trees  : %10u lookups, %6.2f nodes per lookup (max %u)\n"
+			"Open addressing  : %10u lookups, %6.2f slots per lookup (max %u)\n"
+			"                   %10u table rebuilds, %u entries deferred while locked\n",
+			stats.db_tree_lookup, stats.db_tree_lookup ? (double)stats.db_tree_steps / stats.db_tree_lookup : 0., stats.db_tree_steps_max,
+			stats.db_hash_lookup, stats.db_hash_lookup ? (double)stats.db_hash_steps / stats.db_hash_lookup : 0., stats.db_hash_steps_max,
+			stats.db_hash_rebuild, stats.db_hash_overflow);
 #endif /* DB_ENABLE_STATS */
 	ers_destroy(db_iterator_ers);
 	ers_destroy(db_alloc_ers);
@@ -140,6 +140,13 @@ enum DBType {
  * @param DB_OPT_RELEASE_BOTH Releases both key and data.
  * @param DB_OPT_ALLOW_NULL_KEY Allow NULL keys in the database.
  * @param DB_OPT_ALLOW_NULL_DATA Allow NULL data in the database.
+ * @param DB_OPT_OPEN_ADDRESSING Store the entries in a resizable open-addressing
+ *          hashtable instead of the fixed hashtable of RED-BLACK trees.
+ *          Lookups touch a single contiguous array, which is faster for big
+ *          databases with frequent lookups (id_db, pc_db, ...).
+ *          WARNING: the struct DBData pointers returned by get/ensure are only
+ *          valid until the next insertion in the database, since the table
+ *          may be resized.
  * @public
  * @see #db_fix_options()
  * @see #db_default_release()
@@ -153,6 +160,7 @@ enum DBOptions {
 	DB_OPT_RELEASE_BOTH    = DB_OPT_RELEASE_KEY|DB_OPT_RELEASE_DATA,
 	DB_OPT_ALLOW_NULL_KEY  = 0x08,
 	DB_OPT_ALLOW_NULL_DATA = 0x10,
+	DB_OPT_OPEN_ADDRESSING = 0x20,
 };
 
 /**
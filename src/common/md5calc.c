@@ -37,9 +37,6 @@
 static struct md5_interface md5_s;
 struct md5_interface *md5;
 
-/// Global variable
-static unsigned int *pX;
-
 /// String Table
 static const unsigned int T[] = {
 	0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, //0
@@ -84,31 +81,31 @@ static unsigned int md5_I(unsigned int X, unsigned int Y, unsigned int Z)
 	return Y ^ (X | ~Z);
 }
 
-static unsigned int md5_Round(unsigned int a, unsigned int b, unsigned int FGHI,
+static unsigned int md5_Round(const unsigned int *X, unsigned int a, unsigned int b, unsigned int FGHI,
 		unsigned int k, unsigned int s, unsigned int i)
 {
-	return b + ROTATE_LEFT(a + FGHI + pX[k] + T[i], s);
+	return b + ROTATE_LEFT(a + FGHI + X[k] + T[i], s);
 }
 
-static void md5_Round1(unsigned int *a, unsigned int b, unsigned int c,
+static void md5_Round1(const unsigned int *X, unsigned int *a, unsigned int b, unsigned int c,
 		unsigned int d,unsigned int k, unsigned int s, unsigned int i)
 {
-	*a = md5_Round(*a, b, md5_F(b,c,d), k, s, i);
+	*a = md5_Round(X, *a, b, md5_F(b,c,d), k, s, i);
 }
-static void md5_Round2(unsigned int *a, unsigned int b, unsigned int c,
+static void md5_Round2(const unsigned int *X, unsigned int *a, unsigned int b, unsigned int c,
 		unsigned int d,unsigned int k, unsigned int s, unsigned int i)
 {
-	*a = md5_Round(*a, b, md5_G(b,c,d), k, s, i);
+	*a = md5_Round(X, *a, b, md5_G(b,c,d), k, s, i);
 }
-static void md5_Round3(unsigned int *a, unsigned int b, unsigned int c,
+static void md5_Round3(const unsigned int *X, unsigned int *a, unsigned int b, unsigned int c,
 		unsigned int d,unsigned int k, unsigned int s, unsigned int i)
 {
-	*a = md5_Round(*a, b, md5_H(b,c,d), k, s, i);
+	*a = md5_Round(X, *a, b, md5_H(b,c,d), k, s, i);
 }
-static void md5_Round4(unsigned int *a, unsigned int b, unsigned int c,
+static void md5_Round4(const unsigned int *X, unsigned int *a, unsigned int b, unsigned int c,
 		unsigned int d,unsigned int k, unsigned int s, unsigned int i)
 {
-	*a = md5_Round(*a, b, md5_I(b,c,d), k, s, i);
+	*a = md5_Round(X, *a, b, md5_I(b,c,d), k, s, i);
 }
 
 static void md5_Round_Calculate(const unsigned char *block,
@@ -122,9 +119,6 @@ static void md5_Round_Calculate(const unsigned char *block,
 	unsigned int A = *A2, B = *B2, C = *C2, D = *D2;
 	unsigned int AA = A, BB = B, CC = C, DD = D;
 
-	//It is a large region variable reluctantly because of calculation of a round. . . for Round1...4
-	pX = X;
-
 	//Copy block(padding_message) i into X
 	for (j = 0, k = 0; j < 64; j += 4, k++) {
 		X[k] = ((unsigned int)block[j])         // 8byte*4 -> 32byte conversion
@@ -134,28 +128,28 @@ static void md5_Round_Calculate(const unsigned char *block,
 	}
 
 	//Round 1
-	md5_Round1(&A,B,C,D,  0, 7,  0); md5_Round1(&D,A,B,C,  1, 12,  1); md5_Round1(&C,D,A,B,  2, 17,  2); md5_Round1(&B,C,D,A,  3, 22,  3);
-	md5_Round1(&A,B,C,D,  4, 7,  4); md5_Round1(&D,A,B,C,  5, 12,  5); md5_Round1(&C,D,A,B,  6, 17,  6); md5_Round1(&B,C,D,A,  7, 22,  7);
-	md5_Round1(&A,B,C,D,  8, 7,  8); md5_Round1(&D,A,B,C,  9, 12,  9); md5_Round1(&C,D,A,B, 10, 17, 10); md5_Round1(&B,C,D,A, 11, 22, 11);
-	md5_Round1(&A,B,C,D, 12, 7, 12); md5_Round1(&D,A,B,C, 13, 12, 13); md5_Round1(&C,D,A,B, 14, 17, 14); md5_Round1(&B,C,D,A, 15, 22, 15);
+	md5_Round1(X, &A,B,C,D,  0, 7,  0); md5_Round1(X, &D,A,B,C,  1, 12,  1); md5_Round1(X, &C,D,A,B,  2, 17,  2); md5_Round1(X, &B,C,D,A,  3, 22,  3);
+	md5_Round1(X, &A,B,C,D,  4, 7,  4); md5_Round1(X, &D,A,B,C,  5, 12,  5); md5_Round1(X, &C,D,A,B,  6, 17,  6); md5_Round1(X, &B,C,D,A,  7, 22,  7);
+	md5_Round1(X, &A,B,C,D,  8, 7,  8); md5_Round1(X, &D,A,B,C,  9, 12,  9); md5_Round1(X, &C,D,A,B, 10, 17, 10); md5_Round1(X, &B,C,D,A, 11, 22, 11);
+	md5_Round1(X, &A,B,C,D, 12, 7, 12); md5_Round1(X, &D,A,B,C, 13, 12, 13); md5_Round1(X, &C,D,A,B, 14, 17, 14); md5_Round1(X, &B,C,D,A, 15, 22, 15);
 
 	//Round 2
-	md5_Round2(&A,B,C,D,  1, 5, 16); md5_Round2(&D,A,B,C,  6, 9, 17); md5_Round2(&C,D,A,B, 11, 14, 18); md5_Round2(&B,C,D,A,  0, 20, 19);
-	md5_Round2(&A,B,C,D,  5, 5, 20); md5_Round2(&D,A,B,C, 10, 9, 21); md5_Round2(&C,D,A,B, 15, 14, 22); md5_Round2(&B,C,D,A,  4, 20, 23);
-	md5_Round2(&A,B,C,D,  9, 5, 24); md5_Round2(&D,A,B,C, 14, 9, 25); md5_Round2(&C,D,A,B,  3, 14, 26); md5_Round2(&B,C,D,A,  8, 20, 27);
-	md5_Round2(&A,B,C,D, 13, 5, 28); md5_Round2(&D,A,B,C,  2, 9, 29); md5_Round2(&C,D,A,B,  7, 14, 30); md5_Round2(&B,C,D,A, 12, 20, 31);
+	md5_Round2(X, &A,B,C,D,  1, 5, 16); md5_Round2(X, &D,A,B,C,  6, 9, 17); md5_Round2(X, &C,D,A,B, 11, 14, 18); md5_Round2(X, &B,C,D,A,  0, 20, 19);
+	md5_Round2(X, &A,B,C,D,  5, 5, 20); md5_Round2(X, &D,A,B,C, 10, 9, 21); md5_Round2(X, &C,D,A,B, 15, 14, 22); md5_Round2(X, &B,C,D,A,  4, 20, 23);
+	md5_Round2(X, &A,B,C,D,  9, 5, 24); md5_Round2(X, &D,A,B,C, 14, 9, 25); md5_Round2(X, &C,D,A,B,  3, 14, 26); md5_Round2(X, &B,C,D,A,  8, 20, 27);
+	md5_Round2(X, &A,B,C,D, 13, 5, 28); md5_Round2(X, &D,A,B,C,  2, 9, 29); md5_Round2(X, &C,D,A,B,  7, 14, 30); md5_Round2(X, &B,C,D,A, 12, 20, 31);
 
 	//Round 3
-	md5_Round3(&A,B,C,D,  5, 4, 32); md5_Round3(&D,A,B,C,  8, 11, 33); md5_Round3(&C,D,A,B, 11, 16, 34); md5_Round3(&B,C,D,A, 14, 23, 35);
-	md5_Round3(&A,B,C,D,  1, 4, 36); md5_Round3(&D,A,B,C,  4, 11, 37); md5_Round3(&C,D,A,B,  7, 16, 38); md5_Round3(&B,C,D,A, 10, 23, 39);
-	md5_Round3(&A,B,C,D, 13, 4, 40); md5_Round3(&D,A,B,C,  0, 11, 41); md5_Round3(&C,D,A,B,  3, 16, 42); md5_Round3(&B,C,D,A,  6, 23, 43);
-	md5_Round3(&A,B,C,D,  9, 4, 44); md5_Round3(&D,A,B,C, 12, 11, 45); md5_Round3(&C,D,A,B, 15, 16, 46); md5_Round3(&B,C,D,A,  2, 23, 47);
+	md5_Round3(X, &A,B,C,D,  5, 4, 32); md5_Round3(X, &D,A,B,C,  8, 11, 33); md5_Round3(X, &C,D,A,B, 11, 16, 34); md5_Round3(X, &B,C,D,A, 14, 23, 35);
+	md5_Round3(X, &A,B,C,D,  1, 4, 36); md5_Round3(X, &D,A,B,C,  4, 11, 37); md5_Round3(X, &C,D,A,B,  7, 16, 38); md5_Round3(X, &B,C,D,A, 10, 23, 39);
+	md5_Round3(X, &A,B,C,D, 13, 4, 40); md5_Round3(X, &D,A,B,C,  0, 11, 41); md5_Round3(X, &C,D,A,B,  3, 16, 42); md5_Round3(X, &B,C,D,A,  6, 23, 43);
+	md5_Round3(X, &A,B,C,D,  9, 4, 44); md5_Round3(X, &D,A,B,C, 12, 11, 45); md5_Round3(X, &C,D,A,B, 15, 16, 46); md5_Round3(X, &B,C,D,A,  2, 23, 47);
 
 	//Round 4
-	md5_Round4(&A,B,C,D,  0, 6, 48); md5_Round4(&D,A,B,C,  7, 10, 49); md5_Round4(&C,D,A,B, 14, 15, 50); md5_Round4(&B,C,D,A,  5, 21, 51);
-	md5_Round4(&A,B,C,D, 12, 6, 52); md5_Round4(&D,A,B,C,  3, 10, 53); md5_Round4(&C,D,A,B, 10, 15, 54); md5_Round4(&B,C,D,A,  1, 21, 55);
-	md5_Round4(&A,B,C,D,  8, 6, 56); md5_Round4(&D,A,B,C, 15, 10, 57); md5_Round4(&C,D,A,B,  6, 15, 58); md5_Round4(&B,C,D,A, 13, 21, 59);
-	md5_Round4(&A,B,C,D,  4, 6, 60); md5_Round4(&D,A,B,C, 11, 10, 61); md5_Round4(&C,D,A,B,  2, 15, 62); md5_Round4(&B,C,D,A,  9, 21, 63);
+	md5_Round4(X, &A,B,C,D,  0, 6, 48); md5_Round4(X, &D,A,B,C,  7, 10, 49); md5_Round4(X, &C,D,A,B, 14, 15, 50); md5_Round4(X, &B,C,D,A,  5, 21, 51);
+	md5_Round4(X, &A,B,C,D, 12, 6, 52); md5_Round4(X, &D,A,B,C,  3, 10, 53); md5_Round4(X, &C,D,A,B, 10, 15, 54); md5_Round4(X, &B,C,D,A,  1, 21, 55);
+	md5_Round4(X, &A,B,C,D,  8, 6, 56); md5_Round4(X, &D,A,B,C, 15, 10, 57); md5_Round4(X, &C,D,A,B,  6, 15, 58); md5_Round4(X, &B,C,D,A, 13, 21, 59);
+	md5_Round4(X, &A,B,C,D,  4, 6, 60); md5_Round4(X, &D,A,B,C, 11, 10, 61); md5_Round4(X, &C,D,A,B,  2, 15, 62); md5_Round4(X, &B,C,D,A,  9, 21, 63);
 
 	// Then perform the following additions. (let's add)
 	*A2 = A + AA;
@@ -164,7 +158,7 @@ static void md5_Round_Calculate(const unsigned char *block,
 	*D2 = D + DD;
 
 	//The clearance of confidential information
-	memset(pX, 0, sizeof(X));
+	memset(X, 0, sizeof(X));
 }
 
 /// @copydoc md5_interface::binary()
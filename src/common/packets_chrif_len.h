@@ -32,8 +32,8 @@ packetLen(0x2b00, 6)   /* H->M, map_setusers -> 'set the actual usercount? PACKE
 packetLen(0x2b01, -1)  /* M->H, chrif_save -> 'charsave of char XY account XY (complete struct)' */
 packetLen(0x2b02, 18)  /* M->H, chrif_charselectreq -> 'player returns from ingame to charserver to select another char.., this packets includes sessid etc' ? (not 100% sure) */
 packetLen(0x2b03, 7)   /* H->M, clif_charselectok -> '' (i think its the packet after enterworld?) (not sure) */
-packetLen(0x2b04, 0)   /* FREE */
-packetLen(0x2b05, 0)   /* FREE */
+packetLen(0x2b04, -1)  /* M->H, chrif_save -> 'charsave of char XY account XY (changed blocks only)' */
+packetLen(0x2b05, 10)  /* H->M, chrif_save_full_req -> 'delta save rejected, resend the complete struct' */
 packetLen(0x2b06, 0)   /* FREE */
 packetLen(0x2b07, 10)  /* M->H, chrif_removefriend -> 'Tell charserver to remove friend_id from char_id friend list' */
 packetLen(0x2b08, 6)   /* M->H, chrif_searchcharid -> '...' */
@@ -39,18 +39,32 @@
 #include <stdlib.h>
 #include <sys/types.h>
 
+#if defined(SOCKET_EPOLL) && defined(SOCKET_IO_URING)
+#error "SOCKET_EPOLL and SOCKET_IO_URING can't be enabled at the same time"
+#endif  // defined(SOCKET_EPOLL) && defined(SOCKET_IO_URING)
+
 #ifndef MAXCONN
-#ifdef SOCKET_EPOLL
+#if defined(SOCKET_EPOLL) || defined(SOCKET_IO_URING)
 #define MAXCONN 3072
-#else  // SOCKET_EPOLL
+#else  // defined(SOCKET_EPOLL) || defined(SOCKET_IO_URING)
 #define MAXCONN FD_SETSIZE
-#endif  // SOCKET_EPOLL
+#endif  // defined(SOCKET_EPOLL) || defined(SOCKET_IO_URING)
 #endif  // MAXCONN
 
 #ifdef SOCKET_EPOLL
 #include <sys/epoll.h>
 #endif  // SOCKET_EPOLL
 
+#ifdef SOCKET_IO_URING
+#include <endian.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#endif  // SOCKET_IO_URING
+
 #ifdef WIN32
 #	include "common/winapi.h"
 #else  // WIN32
@@ -67,6 +81,7 @@
 #	include <sys/ioctl.h>
 #	include <sys/socket.h>
 #	include <sys/time.h>
+#	include <sys/uio.h>
 #	include <unistd.h>
 
 #ifndef SIOCGIFCONF
@@ -95,6 +110,15 @@ static void send_shortlist_add_fd(int fd);
 static void send_shortlist_do_sends(void);
 #endif  // SEND_SHORTLIST
 
+// Add a fd to the parse list so that its parse function is called in the next cycle.
+static void parse_list_add_fd(int fd);
+// Call the parse function of the sessions in the parse list.
+static void parse_list_do_parse(void);
+// Add a fd to the stall heap so that its rdata_tick is checked against stall_time.
+static void stall_heap_add_fd(int fd);
+// Handle the sessions that haven't received any data in stall_time seconds.
+static void stall_heap_do_checks(void);
+
 /////////////////////////////////////////////////////////////////////
 #if defined(WIN32)
 /////////////////////////////////////////////////////////////////////
@@ -262,7 +286,139 @@ static char *sErr(int code)
 	#define MSG_NOSIGNAL 0
 #endif  // MSG_NOSIGNAL
 
-#ifndef SOCKET_EPOLL
+#ifndef WIN32
+// Shared buffers are sent with scatter/gather I/O, without being copied into
+// each WFIFO. Where that's unavailable, they're copied like regular packets.
+#define SOCKET_SHARED_WFIFO
+// Maximum number of buffers sent in a single call
+#define SOCKET_IOV_MAX 64
+#endif  // WIN32
+
+#if defined(SOCKET_IO_URING)
+// io_uring based Event Dispatcher:
+
+// Size of the submission queue
+#ifndef SOCKET_URING_ENTRIES
+#define SOCKET_URING_ENTRIES 256
+#endif  // SOCKET_URING_ENTRIES
+// Number of receive buffers provided to the kernel (power of 2)
+#ifndef SOCKET_URING_BUFFERS
+#define SOCKET_URING_BUFFERS 2048
+#endif  // SOCKET_URING_BUFFERS
+// Size of each receive buffer
+#ifndef SOCKET_URING_BUFFER_SIZE
+#define SOCKET_URING_BUFFER_SIZE 2048
+#endif  // SOCKET_URING_BUFFER_SIZE
+// Receive buffers a connection may hold before its receive is stopped,
+// so that a client that sends faster than it's parsed is slowed down by TCP
+#ifndef SOCKET_URING_FD_BUFFERS
+#define SOCKET_URING_FD_BUFFERS 32
+#endif  // SOCKET_URING_FD_BUFFERS
+// Buffer group id of the receive buffers
+#define SOCKET_URING_BGID 0
+// Oldest kernel with everything the dispatcher uses (multishot receives)
+#define SOCKET_URING_KERNEL_MAJOR 6
+#define SOCKET_URING_KERNEL_MINOR 0
+
+/// Kind of request, stored in its user_data.
+enum socket_uring_op {
+	SOCKET_URING_RECV = 1, ///< multishot receive of a connection
+	SOCKET_URING_POLL,     ///< readiness poll of a listener
+	SOCKET_URING_SEND,     ///< send of a batch slot
+	SOCKET_URING_CANCEL,   ///< cancellation of a multishot receive
+};
+
+/// user_data of a request: generation of the fd, kind of request and fd (or batch slot)
+#define SOCKET_URING_DATA(gen, op, idx) (((uint64)(gen) << 32) | ((uint64)(op) << 24) | (uint64)(idx))
+
+/// Received data of a connection, in a provided buffer.
+struct socket_uring_chunk {
+	uint16 bid; ///< buffer id
+	uint16 pos; ///< first unread byte
+	uint16 len; ///< unread bytes
+};
+
+/// io_uring state of a fd.
+struct socket_uring_fd {
+	VECTOR_DECL(struct socket_uring_chunk) chunks; ///< received data not read by func_recv yet
+	int head;      ///< first chunk with unread data
+	uint32 gen;    ///< bumped on close, so that late completions are dropped
+	int error;     ///< errno of a failed receive, 0 for a connection closed by the peer
+	unsigned int active : 1;   ///< registered with the ring
+	unsigned int listener : 1; ///< polled for readiness, func_recv accepts the connections
+	unsigned int armed : 1;    ///< a receive or poll request is pending
+	unsigned int closed : 1;   ///< receiving is over, see error
+	unsigned int ready : 1;    ///< listed in ready
+	unsigned int rearm : 1;    ///< listed in rearm
+	unsigned int starved : 1;  ///< listed in starved
+	unsigned int throttled : 1; ///< holds SOCKET_URING_FD_BUFFERS buffers, not receiving until func_recv reads them
+	unsigned int queued : 1;   ///< listed in the send batch
+};
+
+/// Send of a batch, the message must stay valid until the send completes.
+struct socket_uring_send {
+	int fd;
+	int res;
+	struct msghdr msg;
+	struct iovec iov[SOCKET_IOV_MAX];
+};
+
+static struct {
+	int fd; ///< ring fd
+	// submission queue
+	void *sq_ptr;
+	size_t sq_len;
+	uint32 *sq_head, *sq_tail, *sq_array;
+	uint32 sq_mask, sq_entries;
+	uint32 sq_local_tail; ///< tail including the requests not published yet
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+	// completion queue
+	void *cq_ptr;
+	size_t cq_len;
+	uint32 *cq_head, *cq_tail;
+	uint32 cq_mask;
+	struct io_uring_cqe *cqes;
+	// provided receive buffers
+	struct io_uring_buf_ring *br;
+	size_t br_len;
+	uint16 br_tail;
+	unsigned char *buffers;
+	int buffers_free; ///< receive buffers owned by the kernel
+	// fds with received data, eof or a ready listener for func_recv
+	int ready[MAXCONN];
+	int ready_count;
+	// fds whose receive or poll request must be submitted again
+	int rearm[MAXCONN];
+	int rearm_count;
+	// fds that ran out of receive buffers, submitted again once some are given back
+	int starved[MAXCONN];
+	int starved_count;
+	// send batch
+	bool batching;
+	int queued[MAXCONN];
+	int queued_count;
+	struct socket_uring_send *sends;
+	int sends_pending;
+} uring;
+static struct socket_uring_fd uring_fds[MAXCONN];
+
+static void socket_uring_init(void);
+static void socket_uring_final(void);
+static void socket_uring_add(int fd, bool listener);
+static void socket_uring_remove(int fd);
+static ssize_t socket_uring_recv(int fd, char *buf, size_t len);
+static int socket_uring_wait(int next);
+static void socket_uring_dispatch(void);
+static bool socket_uring_send_queue(int fd);
+static void socket_uring_send_begin(void);
+static void socket_uring_send_end(void);
+
+// Reads the data received by the ring instead of calling recv
+#undef sRecv
+#define sRecv(fd,buf,len,flags) socket_uring_recv((fd),(buf),(len))
+
+#elif !defined(SOCKET_EPOLL)
 // Select based Event Dispatcher:
 static fd_set readfds;
 
@@ -306,6 +462,27 @@ static int send_shortlist_count = 0;// how many fd's are in the shortlist
 static uint32 send_shortlist_set[(MAXCONN + 31) / 32]; // to know if specific fd's are already in the shortlist
 #endif  // SEND_SHORTLIST
 
+static int parse_list_array[MAXCONN]; // sessions with unparsed data, a pending eof or a pending ping
+static int parse_list_count = 0; // how many fd's are in the parse list
+static uint32 parse_list_set[(MAXCONN + 31) / 32]; // to know if specific fd's are already in the parse list
+
+/// Entry of the stall heap.
+/// The tick is the rdata_tick of the session when it was pushed, the actual
+/// rdata_tick is only compared once the entry reaches the top of the heap.
+struct stall_heap_entry {
+	time_t tick;
+	int fd;
+};
+static BHEAP_VAR(struct stall_heap_entry, stall_heap); // sessions ordered by rdata_tick
+static uint32 stall_heap_set[(MAXCONN + 31) / 32]; // to know if specific fd's are already in the stall heap
+
+#define STALL_HEAP_MINTOPCMP(e1,e2) BHEAP_MINTOPCMP((e1).tick, (e2).tick)
+#define STALL_HEAP_SWAP(a,b) do { \
+	struct stall_heap_entry _tmp_ = (a); \
+	(a) = (b); \
+	(b) = _tmp_; \
+} while (0)
+
 static int ip_rules = 1;
 static int connect_check(uint32 ip);
 
@@ -451,6 +628,8 @@ static void set_eof(int fd)
 		send_shortlist_add_fd(fd);
 #endif  // SEND_SHORTLIST
 		sockt->session[fd]->flag.eof = 1;
+		// The parse function closes the session.
+		parse_list_add_fd(fd);
 	}
 }
 
@@ -480,6 +659,8 @@ static int recv_to_fifo(int fd)
 
 	sockt->session[fd]->rdata_size += len;
 	sockt->session[fd]->rdata_tick = sockt->last_tick;
+	parse_list_add_fd(fd);
+	stall_heap_add_fd(fd);
 #ifdef SHOW_SERVER_STATS
 	socket_data_i += len;
 	socket_data_qi += len;
@@ -491,40 +672,149 @@ static int recv_to_fifo(int fd)
 	return (int)len;
 }
 
-static int send_from_fifo(int fd)
+/// Drops all the shared buffers queued in the send queue of a session.
+static void wfifo_clear_refs(struct socket_data *s)
 {
-	ssize_t len;
+	int i;
 
-	if (!sockt->session_is_valid(fd))
-		return -1;
+	for (i = 0; i < VECTOR_LENGTH(s->wrefs); i++)
+		sockt->shared_buffer_release(VECTOR_INDEX(s->wrefs, i).buf);
+	VECTOR_CLEAR(s->wrefs);
+	s->wrefs_size = 0;
+}
 
-	if( sockt->session[fd]->wdata_size == 0 )
-		return 0; // nothing to send
+#ifdef SOCKET_SHARED_WFIFO
+/// Fills 'msg' with the WFIFO of a session and the shared buffers queued in it, in order.
+/// 'iov' must hold SOCKET_IOV_MAX entries.
+static void send_wfifo_msg(int fd, struct msghdr *msg, struct iovec *iov)
+{
+	struct socket_data *s = sockt->session[fd];
+	size_t pos = s->wdata_pos;
+	int i, n = 0;
+
+	for (i = 0; i < VECTOR_LENGTH(s->wrefs) && n + 2 <= SOCKET_IOV_MAX; i++) {
+		struct socket_wfifo_ref *ref = &VECTOR_INDEX(s->wrefs, i);
+		if (ref->wdata_pos > pos) {
+			iov[n].iov_base = s->wdata + pos;
+			iov[n].iov_len = ref->wdata_pos - pos;
+			n++;
+			pos = ref->wdata_pos;
+		}
+		iov[n].iov_base = ref->buf->data + ref->sent;
+		iov[n].iov_len = ref->buf->len - ref->sent;
+		n++;
+	}
+	if (i == VECTOR_LENGTH(s->wrefs) && s->wdata_size > pos && n < SOCKET_IOV_MAX) {
+		iov[n].iov_base = s->wdata + pos;
+		iov[n].iov_len = s->wdata_size - pos;
+		n++;
+	}
 
-	len = sSend(fd, (const char *) sockt->session[fd]->wdata, (int)sockt->session[fd]->wdata_size, MSG_NOSIGNAL);
+	memset(msg, 0, sizeof(*msg));
+	msg->msg_iov = iov;
+	msg->msg_iovlen = n;
+}
 
+/// Sends the WFIFO of a session along with the shared buffers queued in it, in order.
+/// Returns the number of bytes sent, or SOCKET_ERROR.
+static ssize_t send_wfifo_iov(int fd)
+{
+	struct iovec iov[SOCKET_IOV_MAX];
+	struct msghdr msg;
+
+	send_wfifo_msg(fd, &msg, iov);
+	return sendmsg(fd, &msg, MSG_NOSIGNAL);
+}
+#endif  // SOCKET_SHARED_WFIFO
+
+/// Moves the unsent data of the WFIFO of a session to the front of the buffer.
+static void wfifo_compact(struct socket_data *s)
+{
+	int i;
+
+	if (s->wdata_pos == 0)
+		return;
+	if (s->wdata_pos < s->wdata_size)
+		memmove(s->wdata, s->wdata + s->wdata_pos, s->wdata_size - s->wdata_pos);
+	s->wdata_size -= s->wdata_pos;
+	for (i = 0; i < VECTOR_LENGTH(s->wrefs); i++)
+		VECTOR_INDEX(s->wrefs, i).wdata_pos -= s->wdata_pos;
+	s->wdata_pos = 0;
+}
+
+/// Removes 'len' sent bytes from the front of the send queue of a session.
+/// The sent WFIFO data is only skipped, its space is reclaimed by realloc_writefifo.
+static void wfifo_consume(int fd, size_t len)
+{
+	struct socket_data *s = sockt->session[fd];
+	size_t pos = s->wdata_pos; // sent bytes of wdata
+	int i = 0;
+
+	while (len > 0) {
+		struct socket_wfifo_ref *ref;
+		size_t chunk = (i < VECTOR_LENGTH(s->wrefs) ? VECTOR_INDEX(s->wrefs, i).wdata_pos : s->wdata_size) - pos;
+
+		chunk = min(chunk, len);
+		pos += chunk;
+		len -= chunk;
+		if (len == 0 || i == VECTOR_LENGTH(s->wrefs))
+			break;
+
+		ref = &VECTOR_INDEX(s->wrefs, i);
+		chunk = min(ref->buf->len - ref->sent, len);
+		ref->sent += chunk;
+		s->wrefs_size -= chunk;
+		len -= chunk;
+		if (ref->sent < ref->buf->len)
+			break;
+		sockt->shared_buffer_release(ref->buf);
+		i++;
+	}
+
+	if (i > 0)
+		VECTOR_ERASEN(s->wrefs, 0, i);
+
+	s->wdata_pos = pos;
+	if (s->wdata_pos == s->wdata_size)
+		wfifo_compact(s); // nothing to move, rewind to the beginning of the buffer
+}
+
+/// Closes a client session whose send queue went over WFIFO_MAX, the client isn't reading its data.
+static void wfifo_check_limit(int fd)
+{
+	struct socket_data *s = sockt->session[fd];
+
+	if (s->flag.server || s->flag.eof || WFIFOPENDING(fd) <= WFIFO_MAX)
+		return;
+
+	ShowWarning("Connection #%d (%u.%u.%u.%u) has %"PRIuS" bytes pending to send (max %d), closing it.\n", fd, CONVIP(s->client_addr), WFIFOPENDING(fd), WFIFO_MAX);
+	sockt->eof(fd);
+}
+
+/// Updates the send queue of a session with the result of a send.
+/// 'len' is the number of bytes sent, or SOCKET_ERROR.
+static void send_from_fifo_result(int fd, ssize_t len)
+{
 	if( len == SOCKET_ERROR )
 	{ //An exception has occurred
 		if( sErrno != S_EWOULDBLOCK ) {
 			//ShowDebug("send_from_fifo: %s, ending connection #%d\n", error_msg(), fd);
 #ifdef SHOW_SERVER_STATS
-			socket_data_qo -= sockt->session[fd]->wdata_size;
+			socket_data_qo -= WFIFOPENDING(fd);
 #endif  // SHOW_SERVER_STATS
 			sockt->session[fd]->wdata_size = 0; //Clear the send queue as we can't send anymore. [Skotlex]
+			sockt->session[fd]->wdata_pos = 0;
+			wfifo_clear_refs(sockt->session[fd]);
 			sockt->eof(fd);
 		}
-		return 0;
+		return;
 	}
 
 	if (len > 0)
 	{
 		sockt->session[fd]->wdata_tick = sockt->last_tick;
 		// some data could not be transferred?
-		// shift unsent data to the beginning of the queue
-		if ((size_t)len < sockt->session[fd]->wdata_size)
-			memmove(sockt->session[fd]->wdata, sockt->session[fd]->wdata + len, sockt->session[fd]->wdata_size - len);
-
-		sockt->session[fd]->wdata_size -= len;
+		wfifo_consume(fd, (size_t)len);
 #ifdef SHOW_SERVER_STATS
 		socket_data_o += len;
 		socket_data_qo -= len;
@@ -534,7 +824,31 @@ static int send_from_fifo(int fd)
 		}
 #endif  // SHOW_SERVER_STATS
 	}
+}
+
+static int send_from_fifo(int fd)
+{
+	ssize_t len;
 
+	if (!sockt->session_is_valid(fd))
+		return -1;
+
+	if (sockt->session[fd]->wdata_size == 0 && VECTOR_LENGTH(sockt->session[fd]->wrefs) == 0)
+		return 0; // nothing to send
+
+#ifdef SOCKET_IO_URING
+	if (socket_uring_send_queue(fd))
+		return 0; // sent along with the rest of the batch
+#endif  // SOCKET_IO_URING
+
+#ifdef SOCKET_SHARED_WFIFO
+	if (VECTOR_LENGTH(sockt->session[fd]->wrefs) > 0)
+		len = send_wfifo_iov(fd);
+	else
+#endif  // SOCKET_SHARED_WFIFO
+		len = sSend(fd, (const char *) sockt->session[fd]->wdata + sockt->session[fd]->wdata_pos, (int)(sockt->session[fd]->wdata_size - sockt->session[fd]->wdata_pos), MSG_NOSIGNAL);
+
+	send_from_fifo_result(fd, len);
 	return 0;
 }
 
@@ -587,7 +901,11 @@ static int connect_client(int listen_fd)
 		return -1;
 	}
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher
+	socket_uring_add(fd, false);
+
+#elif !defined(SOCKET_EPOLL)
 	// Select Based Event Dispatcher
 	sFD_SET(fd,&readfds);
 
@@ -655,7 +973,11 @@ static int make_listen_bind(uint32 ip, uint16 port)
 	}
 
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher
+	socket_uring_add(fd, true);
+
+#elif !defined(SOCKET_EPOLL)
 	// Select Based Event Dispatcher
 	sFD_SET(fd,&readfds);
 
@@ -725,7 +1047,11 @@ static int make_connection(uint32 ip, uint16 port, struct hSockOpt *opt)
 	sockt->set_nonblocking(fd, 1);
 
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher
+	socket_uring_add(fd, false);
+
+#elif !defined(SOCKET_EPOLL)
 	// Select Based Event Dispatcher
 	sFD_SET(fd,&readfds);
 
@@ -766,6 +1092,7 @@ static int create_session(int fd, RecvFunc func_recv, SendFunc func_send, ParseF
 	sockt->session[fd]->wdata_tick = sockt->last_tick;
 	sockt->session[fd]->session_data = NULL;
 	sockt->session[fd]->hdata = NULL;
+	stall_heap_add_fd(fd);
 	return 0;
 }
 
@@ -774,11 +1101,12 @@ static void delete_session(int fd)
 	if (sockt->session_is_valid(fd)) {
 #ifdef SHOW_SERVER_STATS
 		socket_data_qi -= sockt->session[fd]->rdata_size - sockt->session[fd]->rdata_pos;
-		socket_data_qo -= sockt->session[fd]->wdata_size;
+		socket_data_qo -= WFIFOPENDING(fd);
 #endif  // SHOW_SERVER_STATS
 		sockt->session[fd]->func_delete(fd);
 		aFree(sockt->session[fd]->rdata);
 		aFree(sockt->session[fd]->wdata);
+		wfifo_clear_refs(sockt->session[fd]);
 		if( sockt->session[fd]->session_data )
 			aFree(sockt->session[fd]->session_data);
 		HPM->data_store_destroy(&sockt->session[fd]->hdata);
@@ -797,6 +1125,8 @@ static int realloc_fifo(int fd, unsigned int rfifo_size, unsigned int wfifo_size
 		sockt->session[fd]->max_rdata  = rfifo_size;
 	}
 
+	if (sockt->session[fd]->max_wdata != wfifo_size)
+		wfifo_compact(sockt->session[fd]);
 	if( sockt->session[fd]->max_wdata != wfifo_size && sockt->session[fd]->wdata_size < wfifo_size) {
 		RECREATE(sockt->session[fd]->wdata, unsigned char, wfifo_size);
 		sockt->session[fd]->max_wdata  = wfifo_size;
@@ -811,6 +1141,12 @@ static int realloc_writefifo(int fd, size_t addition)
 	if (!sockt->session_is_valid(fd)) // might not happen
 		return 0;
 
+	// Reclaim the space of the sent data before growing the buffer, once there's
+	// at least as much sent data as unsent data (so each byte is moved at most once on average).
+	if (sockt->session[fd]->wdata_size + addition > sockt->session[fd]->max_wdata
+	 && sockt->session[fd]->wdata_pos >= sockt->session[fd]->wdata_size - sockt->session[fd]->wdata_pos)
+		wfifo_compact(sockt->session[fd]);
+
 	if (sockt->session[fd]->wdata_size + addition  > sockt->session[fd]->max_wdata) {
 		// grow rule; grow in multiples of WFIFO_SIZE
 		newsize = WFIFO_SIZE;
@@ -936,8 +1272,9 @@ static int wfifoset(int fd, size_t len, bool validate)
 	socket_data_qo += len;
 #endif  // SHOW_SERVER_STATS
 	//If the interserver has 200% of its normal size full, flush the data.
-	if( s->flag.server && s->wdata_size >= 2*FIFOSIZE_SERVERLINK )
+	if( s->flag.server && s->wdata_size - s->wdata_pos >= 2*FIFOSIZE_SERVERLINK )
 		sockt->flush(fd);
+	wfifo_check_limit(fd);
 
 	// always keep a WFIFO_SIZE reserve in the buffer
 	// For inter-server connections, let the reserve be 1/4th of the link size.
@@ -962,13 +1299,667 @@ static void wfifohead(int fd, size_t len)
 		sockt->realloc_writefifo(fd, len);
 }
 
+/// Queues a shared buffer for sending, after the data already in the WFIFO.
+/// The send queue takes its own reference to the buffer.
+static int wfifoshare(int fd, struct socket_shared_buffer *buf)
+{
+	nullpo_ret(buf);
+
+	if (!sockt->session_is_valid(fd))
+		return 0;
+
+	struct socket_data *s = sockt->session[fd];
+	if (buf->len == 0 || buf->len > 0xFFFF) {
+		ShowError("wfifoshare: Invalid shared packet length %"PRIuS" (connection %d).\n", buf->len, fd);
+		return 0;
+	}
+	if (!s->flag.server && buf->len > socket_max_client_packet) {
+		ShowError("wfifoshare: Dropped too large client packet 0x%04x (length=%"PRIuS", max=%"PRIuS").\n",
+		          RBUFW(buf->data, 0), buf->len, socket_max_client_packet);
+		return 0;
+	}
+
+#ifdef SOCKET_SHARED_WFIFO
+	if (s->flag.validate == 0) {
+		struct socket_wfifo_ref ref = { buf, s->wdata_size, 0 };
+
+		buf->refcount++;
+		VECTOR_ENSURE(s->wrefs, 1, 8);
+		VECTOR_PUSH(s->wrefs, ref);
+		s->wrefs_size += buf->len;
+#ifdef SHOW_SERVER_STATS
+		socket_data_qo += buf->len;
+#endif  // SHOW_SERVER_STATS
+#ifdef SEND_SHORTLIST
+		send_shortlist_add_fd(fd);
+#endif  // SEND_SHORTLIST
+		wfifo_check_limit(fd);
+		return 0;
+	}
+#endif  // SOCKET_SHARED_WFIFO
+
+	// copy it like any other packet
+	WFIFOHEAD(fd, buf->len);
+	memcpy(WFIFOP(fd, 0), buf->data, buf->len);
+	return WFIFOSET(fd, buf->len);
+}
+
+/// Allocates a shared buffer holding a copy of 'data'.
+/// The caller owns the first reference and must release it once done queueing the buffer.
+static struct socket_shared_buffer *socket_shared_buffer_create(const void *data, size_t len)
+{
+	struct socket_shared_buffer *buf;
+
+	nullpo_retr(NULL, data);
+
+	buf = aMalloc(sizeof(*buf) + len);
+	buf->refcount = 1;
+	buf->len = len;
+	memcpy(buf->data, data, len);
+	return buf;
+}
+
+/// Drops a reference to a shared buffer, freeing it along with the last one.
+static void socket_shared_buffer_release(struct socket_shared_buffer *buf)
+{
+	nullpo_retv(buf);
+	Assert_retv(buf->refcount > 0);
+
+	if (--buf->refcount == 0)
+		aFree(buf);
+}
+
+#ifdef SOCKET_IO_URING
+/*======================================
+ * io_uring based Event Dispatcher
+ *--------------------------------------
+ * Connections are received with one multishot receive each, into buffers
+ * provided to the kernel through a buffer ring. The received data waits in
+ * those buffers until func_recv reads it through sRecv. Listeners are polled
+ * for readiness, so func_recv still accepts the connections.
+ * Sends queued from the send shortlist are submitted with a single call.
+ *--------------------------------------*/
+
+#if __BYTE_ORDER == __BIG_ENDIAN
+// poll32_events is split in two 16 bits halves
+#define SOCKET_URING_POLL_EVENTS(events) ((((uint32)(events) & 0xFFFF) << 16) | ((uint32)(events) >> 16))
+#else  // __BYTE_ORDER == __BIG_ENDIAN
+#define SOCKET_URING_POLL_EVENTS(events) ((uint32)(events))
+#endif  // __BYTE_ORDER == __BIG_ENDIAN
+
+STATIC_ASSERT(SOCKET_URING_BUFFER_SIZE <= UINT16_MAX, "Receive buffers must fit in socket_uring_chunk");
+STATIC_ASSERT((SOCKET_URING_BUFFERS & (SOCKET_URING_BUFFERS - 1)) == 0 && SOCKET_URING_BUFFERS <= 32768, "SOCKET_URING_BUFFERS must be a power of 2, up to 32768");
+
+static int socket_uring_enter(unsigned int to_submit, unsigned int min_complete, unsigned int flags, void *arg, size_t argsz)
+{
+	return (int)syscall(__NR_io_uring_enter, uring.fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+/// Number of requests queued but not consumed by the kernel yet.
+static unsigned int socket_uring_unsubmitted(void)
+{
+	return uring.sq_local_tail - __atomic_load_n(uring.sq_head, __ATOMIC_ACQUIRE);
+}
+
+/// Submits the queued requests and waits for min_complete completions.
+/// Returns SOCKET_ERROR on failure, with errno set.
+static int socket_uring_submit(unsigned int min_complete)
+{
+	int ret;
+
+	do {
+		ret = socket_uring_enter(socket_uring_unsubmitted(), min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while (ret == SOCKET_ERROR && (errno == EINTR || errno == EAGAIN));
+	return ret < 0 ? SOCKET_ERROR : 0;
+}
+
+/// Returns a cleared submission queue entry, submitting the queue first if it's full.
+/// The entry is handed to the kernel with socket_uring_push.
+static struct io_uring_sqe *socket_uring_sqe(void)
+{
+	struct io_uring_sqe *sqe;
+
+	if (socket_uring_unsubmitted() >= uring.sq_entries && socket_uring_submit(0) == SOCKET_ERROR) {
+		ShowFatalError("socket_uring_sqe: io_uring_enter() failed, %s!\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+
+	sqe = &uring.sqes[uring.sq_local_tail & uring.sq_mask];
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+static void socket_uring_push(void)
+{
+	uring.sq_local_tail++;
+	__atomic_store_n(uring.sq_tail, uring.sq_local_tail, __ATOMIC_RELEASE);
+}
+
+/// Gives a receive buffer back to the kernel.
+static void socket_uring_recycle(uint16 bid)
+{
+	struct io_uring_buf *buf = &uring.br->bufs[uring.br_tail & (SOCKET_URING_BUFFERS - 1)];
+
+	buf->addr = (uint64)(uintptr_t)(uring.buffers + (size_t)bid * SOCKET_URING_BUFFER_SIZE);
+	buf->len = SOCKET_URING_BUFFER_SIZE;
+	buf->bid = bid;
+	uring.br_tail++;
+	__atomic_store_n(&uring.br->tail, uring.br_tail, __ATOMIC_RELEASE);
+	uring.buffers_free++;
+}
+
+/// Submits the receive request of a connection, or the poll request of a listener.
+static void socket_uring_arm(int fd)
+{
+	struct socket_uring_fd *u = &uring_fds[fd];
+	struct io_uring_sqe *sqe = socket_uring_sqe();
+
+	sqe->fd = fd;
+	if (u->listener) {
+		sqe->opcode = IORING_OP_POLL_ADD;
+		sqe->poll32_events = SOCKET_URING_POLL_EVENTS(POLLIN);
+		sqe->user_data = SOCKET_URING_DATA(u->gen, SOCKET_URING_POLL, fd);
+	} else {
+		sqe->opcode = IORING_OP_RECV;
+		sqe->ioprio = IORING_RECV_MULTISHOT;
+		sqe->flags = IOSQE_BUFFER_SELECT;
+		sqe->buf_group = SOCKET_URING_BGID;
+		sqe->user_data = SOCKET_URING_DATA(u->gen, SOCKET_URING_RECV, fd);
+	}
+	socket_uring_push();
+	u->armed = 1;
+}
+
+static void socket_uring_ready(int fd)
+{
+	if (uring_fds[fd].ready)
+		return;
+	uring_fds[fd].ready = 1;
+	uring.ready[uring.ready_count++] = fd;
+}
+
+static void socket_uring_rearm(int fd)
+{
+	if (uring_fds[fd].rearm)
+		return;
+	uring_fds[fd].rearm = 1;
+	uring.rearm[uring.rearm_count++] = fd;
+}
+
+static void socket_uring_starve(int fd)
+{
+	if (uring_fds[fd].starved)
+		return;
+	uring_fds[fd].starved = 1;
+	uring.starved[uring.starved_count++] = fd;
+}
+
+/// Stops the multishot receive of a connection that holds too many buffers.
+/// It's submitted again by socket_uring_recv once func_recv has read them.
+static void socket_uring_throttle(int fd)
+{
+	struct socket_uring_fd *u = &uring_fds[fd];
+	struct io_uring_sqe *sqe;
+
+	u->throttled = 1;
+	if (!u->armed)
+		return;
+
+	sqe = socket_uring_sqe();
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = SOCKET_URING_DATA(u->gen, SOCKET_URING_RECV, fd);
+	sqe->user_data = SOCKET_URING_DATA(u->gen, SOCKET_URING_CANCEL, fd);
+	socket_uring_push();
+}
+
+/// Handles a completion.
+static void socket_uring_complete(const struct io_uring_cqe *cqe)
+{
+	int idx = (int)(cqe->user_data & 0xFFFFFF);
+	enum socket_uring_op op = (enum socket_uring_op)((cqe->user_data >> 24) & 0xFF);
+	uint32 gen = (uint32)(cqe->user_data >> 32);
+	bool has_buffer = (cqe->flags & IORING_CQE_F_BUFFER) != 0;
+	uint16 bid = (uint16)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+	struct socket_uring_fd *u;
+
+	if (op == SOCKET_URING_SEND) {
+		uring.sends[idx].res = cqe->res;
+		uring.sends_pending--;
+		return;
+	}
+	if (op == SOCKET_URING_CANCEL)
+		return; // the receive itself completes with -ECANCELED
+
+	if (has_buffer)
+		uring.buffers_free--;
+
+	u = &uring_fds[idx];
+	if (!u->active || u->gen != gen) {
+		// late completion of a closed fd
+		if (has_buffer)
+			socket_uring_recycle(bid);
+		return;
+	}
+
+	if (op == SOCKET_URING_POLL) {
+		u->armed = 0;
+		socket_uring_ready(idx);
+		return;
+	}
+
+	if (!(cqe->flags & IORING_CQE_F_MORE))
+		u->armed = 0;
+
+	if (cqe->res > 0) {
+		struct socket_uring_chunk chunk = { bid, 0, (uint16)cqe->res };
+
+		VECTOR_ENSURE(u->chunks, 1, 4);
+		VECTOR_PUSH(u->chunks, chunk);
+		socket_uring_ready(idx);
+		if (!u->throttled && VECTOR_LENGTH(u->chunks) - u->head >= SOCKET_URING_FD_BUFFERS)
+			socket_uring_throttle(idx);
+	} else if (cqe->res == -ENOBUFS) {
+		// ran out of receive buffers, wait until some are given back
+		if (!u->throttled)
+			socket_uring_starve(idx);
+		return;
+	} else if (cqe->res != -ECANCELED) {
+		// connection closed by the peer, or receive error
+		if (has_buffer)
+			socket_uring_recycle(bid);
+		u->closed = 1;
+		u->error = -cqe->res;
+		socket_uring_ready(idx);
+	}
+
+	// the kernel ended the multishot receive
+	if (!u->armed && !u->closed && !u->throttled)
+		socket_uring_rearm(idx);
+}
+
+/// Handles all the available completions.
+static void socket_uring_reap(void)
+{
+	uint32 head = *uring.cq_head;
+	uint32 tail;
+
+	while (head != (tail = __atomic_load_n(uring.cq_tail, __ATOMIC_ACQUIRE))) {
+		do {
+			socket_uring_complete(&uring.cqes[head & uring.cq_mask]);
+			head++;
+		} while (head != tail);
+		__atomic_store_n(uring.cq_head, head, __ATOMIC_RELEASE);
+	}
+}
+
+/// Submits the queued requests and waits up to 'next' ms for completions.
+/// Doesn't wait if func_recv still has data to read.
+/// Returns SOCKET_ERROR on failure, with errno set.
+static int socket_uring_wait(int next)
+{
+	int ret;
+
+	if (uring.ready_count > 0 || next <= 0) {
+		ret = socket_uring_enter(socket_uring_unsubmitted(), 0, IORING_ENTER_GETEVENTS, NULL, 0);
+	} else {
+		struct __kernel_timespec ts;
+		struct io_uring_getevents_arg arg;
+
+		ts.tv_sec = next / 1000;
+		ts.tv_nsec = (long long)(next % 1000) * 1000000;
+		memset(&arg, 0, sizeof(arg));
+		arg.sigmask_sz = _NSIG / 8;
+		arg.ts = (uint64)(uintptr_t)&ts;
+		ret = socket_uring_enter(socket_uring_unsubmitted(), 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+		if (ret == SOCKET_ERROR && errno == ETIME)
+			ret = 0; // timed out
+	}
+	if (ret == SOCKET_ERROR && (errno == EAGAIN || errno == EBUSY))
+		ret = 0; // the completion queue is full, it's emptied below
+
+	socket_uring_reap();
+	return ret < 0 ? SOCKET_ERROR : 0;
+}
+
+/// Calls func_recv on the fds that received data, got closed or have a connection to accept.
+static void socket_uring_dispatch(void)
+{
+	int i, count = uring.ready_count;
+
+	// fds that still have data are listed again in place, behind the current one
+	uring.ready_count = 0;
+	for (i = 0; i < count; i++) {
+		int fd = uring.ready[i];
+		struct socket_uring_fd *u = &uring_fds[fd];
+
+		u->ready = 0;
+		if (!u->active || sockt->session[fd] == NULL)
+			continue;
+
+		sockt->session[fd]->func_recv(fd);
+
+		if (!u->active)
+			continue; // closed by func_recv
+		if (u->listener && !u->armed)
+			socket_uring_arm(fd);
+		else if (u->head < VECTOR_LENGTH(u->chunks) && sockt->session_is_active(fd))
+			socket_uring_ready(fd); // RFIFO is full, read the rest after it's parsed
+	}
+
+	count = uring.rearm_count;
+	uring.rearm_count = 0;
+	for (i = 0; i < count; i++) {
+		int fd = uring.rearm[i];
+		struct socket_uring_fd *u = &uring_fds[fd];
+
+		u->rearm = 0;
+		if (u->active && !u->armed && !u->closed && !u->throttled)
+			socket_uring_arm(fd);
+	}
+
+	// sessions that were out of receive buffers get them back as func_recv reads the data
+	if (uring.buffers_free == 0)
+		return;
+	count = uring.starved_count;
+	uring.starved_count = 0;
+	for (i = 0; i < count; i++) {
+		int fd = uring.starved[i];
+		struct socket_uring_fd *u = &uring_fds[fd];
+
+		u->starved = 0;
+		if (u->active && !u->armed && !u->closed && !u->throttled)
+			socket_uring_arm(fd);
+	}
+}
+
+/// Reads the data received for a connection, in place of recv.
+static ssize_t socket_uring_recv(int fd, char *buf, size_t len)
+{
+	struct socket_uring_fd *u = &uring_fds[fd];
+	size_t copied = 0;
+
+	while (copied < len && u->head < VECTOR_LENGTH(u->chunks)) {
+		struct socket_uring_chunk *chunk = &VECTOR_INDEX(u->chunks, u->head);
+		size_t n = min(len - copied, (size_t)chunk->len);
+
+		memcpy(buf + copied, uring.buffers + (size_t)chunk->bid * SOCKET_URING_BUFFER_SIZE + chunk->pos, n);
+		copied += n;
+		chunk->pos += (uint16)n;
+		chunk->len -= (uint16)n;
+		if (chunk->len == 0) {
+			socket_uring_recycle(chunk->bid);
+			u->head++;
+		}
+	}
+	if (u->head == VECTOR_LENGTH(u->chunks)) {
+		VECTOR_TRUNCATE(u->chunks);
+		u->head = 0;
+	}
+	if (u->throttled && VECTOR_LENGTH(u->chunks) - u->head <= SOCKET_URING_FD_BUFFERS / 2) {
+		u->throttled = 0;
+		if (!u->armed && !u->closed)
+			socket_uring_rearm(fd);
+	}
+
+	if (copied > 0)
+		return (ssize_t)copied;
+	if (len == 0 || (u->closed && u->error == 0))
+		return 0;
+	errno = u->closed ? u->error : EAGAIN;
+	return SOCKET_ERROR;
+}
+
+/// Registers a new socket with the ring.
+static void socket_uring_add(int fd, bool listener)
+{
+	struct socket_uring_fd *u = &uring_fds[fd];
+
+	u->active = 1;
+	u->listener = listener ? 1 : 0;
+	u->armed = 0;
+	u->closed = 0;
+	u->throttled = 0;
+	u->error = 0;
+	socket_uring_arm(fd);
+}
+
+/// Unregisters a socket that's being closed.
+/// Its pending request ends once the socket is shut down, and its completion is dropped.
+static void socket_uring_remove(int fd)
+{
+	struct socket_uring_fd *u = &uring_fds[fd];
+	int i;
+
+	if (!u->active)
+		return;
+
+	for (i = u->head; i < VECTOR_LENGTH(u->chunks); i++)
+		socket_uring_recycle(VECTOR_INDEX(u->chunks, i).bid);
+	VECTOR_TRUNCATE(u->chunks);
+	u->head = 0;
+	u->gen++;
+	u->active = 0;
+}
+
+/// Starts collecting the sends of send_from_fifo into a batch.
+static void socket_uring_send_begin(void)
+{
+	uring.batching = true;
+}
+
+/// Adds a session to the send batch.
+/// Returns false if no batch is being collected, and the data must be sent right away.
+static bool socket_uring_send_queue(int fd)
+{
+	if (!uring.batching)
+		return false;
+
+	if (!uring_fds[fd].queued) {
+		uring_fds[fd].queued = 1;
+		uring.queued[uring.queued_count++] = fd;
+	}
+	return true;
+}
+
+/// Submits the send batch and waits for it to complete.
+/// The messages are built here, so that WFIFOs can still move until then.
+static void socket_uring_send_end(void)
+{
+	int i = 0;
+
+	uring.batching = false;
+
+	while (i < uring.queued_count) {
+		int n = 0, j;
+
+		for (; i < uring.queued_count && n < SOCKET_URING_ENTRIES; i++) {
+			int fd = uring.queued[i];
+			struct socket_uring_send *send = &uring.sends[n];
+			struct io_uring_sqe *sqe;
+
+			uring_fds[fd].queued = 0;
+			if (!sockt->session_is_valid(fd) || (sockt->session[fd]->wdata_size == 0 && VECTOR_LENGTH(sockt->session[fd]->wrefs) == 0))
+				continue;
+
+			send->fd = fd;
+			send_wfifo_msg(fd, &send->msg, send->iov);
+			sqe = socket_uring_sqe();
+			sqe->opcode = IORING_OP_SENDMSG;
+			sqe->fd = fd;
+			sqe->addr = (uint64)(uintptr_t)&send->msg;
+			sqe->len = 1;
+			sqe->msg_flags = MSG_NOSIGNAL | MSG_DONTWAIT; // complete with EAGAIN instead of waiting for room
+			sqe->user_data = SOCKET_URING_DATA(0, SOCKET_URING_SEND, n);
+			socket_uring_push();
+			n++;
+		}
+
+		uring.sends_pending = n;
+		while (uring.sends_pending > 0) {
+			if (socket_uring_submit(1) == SOCKET_ERROR && errno != EBUSY) {
+				ShowFatalError("socket_uring_send_end: io_uring_enter() failed, %s!\n", error_msg());
+				exit(EXIT_FAILURE);
+			}
+			socket_uring_reap();
+		}
+
+		for (j = 0; j < n; j++) {
+			struct socket_uring_send *send = &uring.sends[j];
+
+			if (!sockt->session_is_valid(send->fd))
+				continue;
+			if (send->res < 0) {
+				errno = -send->res;
+				send_from_fifo_result(send->fd, SOCKET_ERROR);
+			} else {
+				send_from_fifo_result(send->fd, send->res);
+			}
+		}
+	}
+	uring.queued_count = 0;
+}
+
+/// Checks that the running kernel is at least SOCKET_URING_KERNEL_MAJOR.SOCKET_URING_KERNEL_MINOR.
+static bool socket_uring_kernel_supported(void)
+{
+	struct utsname name;
+	int major, minor;
+
+	if (uname(&name) != 0 || sscanf(name.release, "%d.%d", &major, &minor) != 2)
+		return true; // unknown release, rely on the feature checks
+	if (major != SOCKET_URING_KERNEL_MAJOR)
+		return major > SOCKET_URING_KERNEL_MAJOR;
+	return minor >= SOCKET_URING_KERNEL_MINOR;
+}
+
+/// Sets up the ring and its receive buffers.
+static void socket_uring_init(void)
+{
+	struct io_uring_params p;
+	struct io_uring_buf_reg reg;
+	uint32 i;
+
+	if (!socket_uring_kernel_supported()) {
+		ShowFatalError("socket_uring_init: the kernel is too old for the io_uring event dispatcher (%d.%d or newer is required).\n", SOCKET_URING_KERNEL_MAJOR, SOCKET_URING_KERNEL_MINOR);
+		exit(EXIT_FAILURE);
+	}
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = 4 * MAXCONN; // room for the receives of every connection between two waits
+	uring.fd = (int)syscall(__NR_io_uring_setup, SOCKET_URING_ENTRIES, &p);
+	if (uring.fd < 0) {
+		ShowFatalError("socket_uring_init: io_uring_setup() failed, %s!\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+	if (!(p.features & IORING_FEAT_EXT_ARG) || !(p.features & IORING_FEAT_NODROP)) {
+		ShowFatalError("socket_uring_init: the kernel is too old for the io_uring event dispatcher (%d.%d or newer is required).\n", SOCKET_URING_KERNEL_MAJOR, SOCKET_URING_KERNEL_MINOR);
+		exit(EXIT_FAILURE);
+	}
+
+	uring.sq_len = p.sq_off.array + p.sq_entries * sizeof(uint32);
+	uring.cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP)
+		uring.sq_len = uring.cq_len = max(uring.sq_len, uring.cq_len);
+
+	uring.sq_ptr = mmap(NULL, uring.sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQ_RING);
+	if (uring.sq_ptr == MAP_FAILED) {
+		ShowFatalError("socket_uring_init: failed to map the submission queue, %s!\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		uring.cq_ptr = uring.sq_ptr;
+	} else {
+		uring.cq_ptr = mmap(NULL, uring.cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_CQ_RING);
+		if (uring.cq_ptr == MAP_FAILED) {
+			ShowFatalError("socket_uring_init: failed to map the completion queue, %s!\n", error_msg());
+			exit(EXIT_FAILURE);
+		}
+	}
+	uring.sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	uring.sqes = mmap(NULL, uring.sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, uring.fd, IORING_OFF_SQES);
+	if (uring.sqes == MAP_FAILED) {
+		ShowFatalError("socket_uring_init: failed to map the submission queue entries, %s!\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+
+	uring.sq_head = (uint32 *)((char *)uring.sq_ptr + p.sq_off.head);
+	uring.sq_tail = (uint32 *)((char *)uring.sq_ptr + p.sq_off.tail);
+	uring.sq_array = (uint32 *)((char *)uring.sq_ptr + p.sq_off.array);
+	uring.sq_mask = *(uint32 *)((char *)uring.sq_ptr + p.sq_off.ring_mask);
+	uring.sq_entries = p.sq_entries;
+	uring.sq_local_tail = *uring.sq_tail;
+	for (i = 0; i < p.sq_entries; i++)
+		uring.sq_array[i] = i; // entries are used in order
+	uring.cq_head = (uint32 *)((char *)uring.cq_ptr + p.cq_off.head);
+	uring.cq_tail = (uint32 *)((char *)uring.cq_ptr + p.cq_off.tail);
+	uring.cq_mask = *(uint32 *)((char *)uring.cq_ptr + p.cq_off.ring_mask);
+	uring.cqes = (struct io_uring_cqe *)((char *)uring.cq_ptr + p.cq_off.cqes);
+
+	// the buffer ring is shared with the kernel and must be page aligned
+	uring.br_len = SOCKET_URING_BUFFERS * sizeof(struct io_uring_buf);
+	uring.br = mmap(NULL, uring.br_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (uring.br == MAP_FAILED) {
+		ShowFatalError("socket_uring_init: failed to allocate the receive buffer ring, %s!\n", error_msg());
+		exit(EXIT_FAILURE);
+	}
+	memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = (uint64)(uintptr_t)uring.br;
+	reg.ring_entries = SOCKET_URING_BUFFERS;
+	reg.bgid = SOCKET_URING_BGID;
+	if (syscall(__NR_io_uring_register, uring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+		ShowFatalError("socket_uring_init: failed to register the receive buffers, %s! (kernel %d.%d or newer is required)\n", error_msg(), SOCKET_URING_KERNEL_MAJOR, SOCKET_URING_KERNEL_MINOR);
+		exit(EXIT_FAILURE);
+	}
+	uring.buffers = aMalloc((size_t)SOCKET_URING_BUFFERS * SOCKET_URING_BUFFER_SIZE);
+	uring.br_tail = 0;
+	uring.buffers_free = 0;
+	for (i = 0; i < SOCKET_URING_BUFFERS; i++)
+		socket_uring_recycle((uint16)i);
+
+	uring.ready_count = 0;
+	uring.rearm_count = 0;
+	uring.starved_count = 0;
+	uring.batching = false;
+	uring.queued_count = 0;
+	CREATE(uring.sends, struct socket_uring_send, SOCKET_URING_ENTRIES);
+	uring.sends_pending = 0;
+	memset(uring_fds, 0, sizeof(uring_fds));
+}
+
+/// Releases the ring, after every socket has been closed.
+static void socket_uring_final(void)
+{
+	int i;
+
+	if (uring.buffers == NULL)
+		return;
+
+	close(uring.fd); // cancels the pending requests
+	munmap(uring.sqes, uring.sqes_len);
+	if (uring.cq_ptr != uring.sq_ptr)
+		munmap(uring.cq_ptr, uring.cq_len);
+	munmap(uring.sq_ptr, uring.sq_len);
+	munmap(uring.br, uring.br_len);
+	aFree(uring.buffers);
+	uring.buffers = NULL;
+	aFree(uring.sends);
+	for (i = 0; i < MAXCONN; i++)
+		VECTOR_CLEAR(uring_fds[i].chunks);
+}
+#endif  // SOCKET_IO_URING
+
 static int do_sockets(int next)
 {
-#ifndef SOCKET_EPOLL
+#if !defined(SOCKET_EPOLL) && !defined(SOCKET_IO_URING)
 	fd_set rfd;
 	struct timeval timeout;
-#endif  // SOCKET_EPOLL
-	int ret,i;
+#endif  // !defined(SOCKET_EPOLL) && !defined(SOCKET_IO_URING)
+	int ret;
+#if !defined(SOCKET_IO_URING) || !defined(SEND_SHORTLIST)
+	int i;
+#endif  // !defined(SOCKET_IO_URING) || !defined(SEND_SHORTLIST)
 
 	// PRESEND Timers are executed before do_sendrecv and can send packets and/or set sessions to eof.
 	// Send remaining data and process client-side disconnects here.
@@ -979,12 +1970,25 @@ static int do_sockets(int next)
 		if (sockt->session[i] == NULL)
 			continue;
 
-		if (sockt->session[i]->wdata_size > 0)
+		if (sockt->session[i]->wdata_size > 0 || VECTOR_LENGTH(sockt->session[i]->wrefs) > 0)
 			sockt->session[i]->func_send(i);
 	}
 #endif  // SEND_SHORTLIST
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher:
+
+	ret = socket_uring_wait(next);
+	if (ret == SOCKET_ERROR)
+	{
+		if( sErrno != S_EINTR )
+		{
+			ShowFatalError("do_sockets: io_uring_enter() failed, %s!\n", error_msg());
+			exit(EXIT_FAILURE);
+		}
+		return 0; // interrupted by a signal, just loop and try again
+	}
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher:
 
 	// can timeout until the next tick
@@ -1028,6 +2032,10 @@ static int do_sockets(int next)
 		if( sockt->session[fd] )
 			sockt->session[fd]->func_recv(fd);
 	}
+#elif defined(SOCKET_IO_URING)
+	// io_uring based selection
+	socket_uring_dispatch();
+
 #elif defined(SOCKET_EPOLL)
 	// epoll based selection
 
@@ -1075,7 +2083,7 @@ static int do_sockets(int next)
 		if(!sockt->session[i])
 			continue;
 
-		if(sockt->session[i]->wdata_size)
+		if (sockt->session[i]->wdata_size || VECTOR_LENGTH(sockt->session[i]->wrefs))
 			sockt->session[i]->func_send(i);
 
 		if (sockt->session[i]->flag.eof) { //func_send can't free a session, this is safe.
@@ -1085,34 +2093,11 @@ static int do_sockets(int next)
 	}
 #endif  // SEND_SHORTLIST
 
-	// parse input data on each socket
-	for(i = 1; i < sockt->fd_max; i++)
-	{
-		if(!sockt->session[i])
-			continue;
-
-		if (sockt->session[i]->rdata_tick && DIFF_TICK(sockt->last_tick, sockt->session[i]->rdata_tick) > sockt->stall_time) {
-			if( sockt->session[i]->flag.server ) {/* server is special */
-				if( sockt->session[i]->flag.ping != 2 )/* only update if necessary otherwise it'd resend the ping unnecessarily */
-					sockt->session[i]->flag.ping = 1;
-			} else {
-				ShowInfo("Session #%d timed out\n", i);
-				sockt->eof(i);
-			}
-		}
-
-		sockt->session[i]->func_parse(i);
+	// check the sessions that reached stall time
+	stall_heap_do_checks();
 
-		if(!sockt->session[i])
-			continue;
-
-		RFIFOFLUSH(i);
-		// after parse, check client's RFIFO size to know if there is an invalid packet (too big and not parsed)
-		if (sockt->session[i]->rdata_size == sockt->session[i]->max_rdata) {
-			sockt->eof(i);
-			continue;
-		}
-	}
+	// parse input data on the sessions that received some or are eof
+	parse_list_do_parse();
 
 #ifdef SHOW_SERVER_STATS
 	if (sockt->last_tick != socket_data_last_tick)
@@ -1571,6 +2556,7 @@ static void socket_final(void)
 	VECTOR_CLEAR(sockt->lan_subnets);
 	VECTOR_CLEAR(sockt->allowed_ips);
 	VECTOR_CLEAR(sockt->trusted_ips);
+	BHEAP_CLEAR(stall_heap);
 
 #ifdef SOCKET_EPOLL
 	if(epfd != SOCKET_ERROR){
@@ -1582,6 +2568,9 @@ static void socket_final(void)
 		epevents = NULL;
 	}
 #endif  // SOCKET_EPOLL
+#ifdef SOCKET_IO_URING
+	socket_uring_final();
+#endif  // SOCKET_IO_URING
 
 }
 
@@ -1593,7 +2582,10 @@ static void socket_close(int fd)
 
 	sockt->flush(fd); // Try to send what's left (although it might not succeed since it's a nonblocking socket)
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher
+	socket_uring_remove(fd); // the pending receive ends with the shutdown below
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher
 	sFD_CLR(fd, &readfds);// this needs to be done before closing the socket
 #else  // SOCKET_EPOLL
@@ -1749,7 +2741,12 @@ static void socket_init(void)
 
 	socket_config_read(sockt->SOCKET_CONF_FILENAME, false);
 
-#ifndef SOCKET_EPOLL
+#if defined(SOCKET_IO_URING)
+	// io_uring based Event Dispatcher:
+	socket_uring_init();
+	ShowInfo("Server uses '" CL_WHITE "io_uring" CL_RESET "' with " CL_WHITE "%d" CL_RESET " receive buffers of " CL_WHITE "%d" CL_RESET " bytes as event dispatcher\n", SOCKET_URING_BUFFERS, SOCKET_URING_BUFFER_SIZE);
+
+#elif !defined(SOCKET_EPOLL)
 	// Select based Event Dispatcher:
 	sFD_ZERO(&readfds);
 	ShowInfo("Server uses '" CL_WHITE "select" CL_RESET "' as event dispatcher\n");
@@ -1772,6 +2769,10 @@ static void socket_init(void)
 #if defined(SEND_SHORTLIST)
 	memset(send_shortlist_set, 0, sizeof(send_shortlist_set));
 #endif  // defined(SEND_SHORTLIST)
+	memset(parse_list_set, 0, sizeof(parse_list_set));
+	parse_list_count = 0;
+	memset(stall_heap_set, 0, sizeof(stall_heap_set));
+	BHEAP_INIT(stall_heap);
 
 	CREATE(sockt->session, struct socket_data *, MAXCONN);
 
@@ -1941,6 +2942,18 @@ static void send_shortlist_do_sends(void)
 {
 	int i;
 
+#ifdef SOCKET_IO_URING
+	// Queue the sends of all the listed sessions and submit them with a single call
+	socket_uring_send_begin();
+	for (i = 0; i < send_shortlist_count; i++) {
+		int fd = send_shortlist_array[i];
+
+		if (sockt->session_is_valid(fd) && (sockt->session[fd]->wdata_size || VECTOR_LENGTH(sockt->session[fd]->wrefs)))
+			sockt->session[fd]->func_send(fd);
+	}
+	socket_uring_send_end();
+#endif  // SOCKET_IO_URING
+
 	for( i = send_shortlist_count-1; i >= 0; --i )
 	{
 		int fd = send_shortlist_array[i];
@@ -1967,9 +2980,11 @@ static void send_shortlist_do_sends(void)
 		// check for the eof state.
 		if( sockt->session[fd] )
 		{
+#ifndef SOCKET_IO_URING
 			// Send data
-			if( sockt->session[fd]->wdata_size )
+			if (sockt->session[fd]->wdata_size || VECTOR_LENGTH(sockt->session[fd]->wrefs))
 				sockt->session[fd]->func_send(fd);
+#endif  // SOCKET_IO_URING
 
 			// If it's been marked as eof, call the parse func on it so that
 			// the socket will be immediately closed.
@@ -1978,13 +2993,128 @@ static void send_shortlist_do_sends(void)
 
 			// If the session still exists, is not eof and has things left to
 			// be sent from it we'll re-add it to the shortlist.
-			if( sockt->session[fd] && !sockt->session[fd]->flag.eof && sockt->session[fd]->wdata_size )
+			if (sockt->session[fd] && !sockt->session[fd]->flag.eof && (sockt->session[fd]->wdata_size || VECTOR_LENGTH(sockt->session[fd]->wrefs)))
 				send_shortlist_add_fd(fd);
 		}
 	}
 }
 #endif  // SEND_SHORTLIST
 
+// Add a fd to the parse list so that its parse function is called in the
+// next cycle, or in the current one if the list is being processed.
+static void parse_list_add_fd(int fd)
+{
+	int i;
+	int bit;
+
+	if (!sockt->session_is_valid(fd))
+		return;// out of range
+
+	i = fd/32;
+	bit = fd%32;
+
+	if( (parse_list_set[i]>>bit)&1 )
+		return;// already in the list
+
+	// set the bit
+	parse_list_set[i] |= 1U << bit;
+	// Add to the end of the parse list array.
+	parse_list_array[parse_list_count++] = fd;
+}
+
+// Call the parse function of the sessions in the parse list.
+// Sessions are kept in the list while they have unparsed data left, are eof or
+// are waiting for a ping reply (the parse function checks the ping timeout).
+static void parse_list_do_parse(void)
+{
+	int i;
+	int count = 0;
+
+	// parse_list_count is re-read on each iteration, sessions added while
+	// parsing are handled in this same cycle.
+	for (i = 0; i < parse_list_count; i++) {
+		int fd = parse_list_array[i];
+		struct socket_data *s = sockt->session[fd];
+
+		if (s != NULL) {
+			s->func_parse(fd);
+
+			if ((s = sockt->session[fd]) != NULL) {
+				RFIFOFLUSH(fd);
+				// after parse, check client's RFIFO size to know if there is an invalid packet (too big and not parsed)
+				if (s->rdata_size == s->max_rdata)
+					sockt->eof(fd);
+
+				if (s->rdata_size > 0 || s->flag.eof || s->flag.ping) {
+					// keep it in the list, entries before i were already moved
+					parse_list_array[count++] = fd;
+					continue;
+				}
+			}
+		}
+
+		parse_list_set[fd/32] &= ~(1U << (fd%32));// unset fd
+	}
+	parse_list_count = count;
+}
+
+// Add a fd to the stall heap, keyed by its current rdata_tick.
+// Sessions already in the heap are left as they are, their entry is updated
+// when it reaches the top.
+static void stall_heap_add_fd(int fd)
+{
+	struct stall_heap_entry entry;
+	int i;
+	int bit;
+
+	if (!sockt->session_is_valid(fd))
+		return;// out of range
+
+	i = fd/32;
+	bit = fd%32;
+
+	if( (stall_heap_set[i]>>bit)&1 )
+		return;// already in the heap
+
+	stall_heap_set[i] |= 1U << bit;
+	entry.tick = sockt->session[fd]->rdata_tick;
+	entry.fd = fd;
+	BHEAP_ENSURE(stall_heap, 1, 256);
+	BHEAP_PUSH(stall_heap, entry, STALL_HEAP_MINTOPCMP, STALL_HEAP_SWAP);
+}
+
+// Handle the sessions that haven't received any data in stall_time seconds.
+// Only the entries that reached stall time are looked at; entries of sessions
+// that received data since they were pushed are pushed again with the new tick.
+static void stall_heap_do_checks(void)
+{
+	while (BHEAP_LENGTH(stall_heap) > 0 && DIFF_TICK(sockt->last_tick, BHEAP_PEEK(stall_heap).tick) > sockt->stall_time) {
+		int fd = BHEAP_PEEK(stall_heap).fd;
+		struct socket_data *s = sockt->session[fd];
+
+		BHEAP_POP(stall_heap, STALL_HEAP_MINTOPCMP, STALL_HEAP_SWAP);
+		stall_heap_set[fd/32] &= ~(1U << (fd%32));// unset fd
+
+		if (s == NULL || s->rdata_tick == 0)
+			continue;// session is gone or timeouts are disabled on it
+
+		if (DIFF_TICK(sockt->last_tick, s->rdata_tick) <= sockt->stall_time) {
+			stall_heap_add_fd(fd);// received data since it was pushed
+			continue;
+		}
+
+		// The session is re-added by recv_to_fifo when it receives data again.
+		if( s->flag.server ) {/* server is special */
+			if( s->flag.ping != 2 )/* only update if necessary otherwise it'd resend the ping unnecessarily */
+				s->flag.ping = 1;
+			parse_list_add_fd(fd);
+		} else {
+			ShowInfo("Session #%d timed out\n", fd);
+			sockt->eof(fd);
+		}
+	}
+}
+
 /**
  * Checks whether the given IP comes from LAN or WAN.
  *
@@ -2204,6 +3334,9 @@ void socket_defaults(void)
 	sockt->realloc_writefifo = realloc_writefifo;
 	sockt->wfifoset = wfifoset;
 	sockt->wfifohead = wfifohead;
+	sockt->wfifoshare = wfifoshare;
+	sockt->shared_buffer_create = socket_shared_buffer_create;
+	sockt->shared_buffer_release = socket_shared_buffer_release;
 	sockt->rfifoskip = rfifoskip;
 	sockt->close = socket_close;
 	/* */
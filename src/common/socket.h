@@ -39,6 +39,12 @@ struct config_setting_t;
 
 #define FIFOSIZE_SERVERLINK 256*1024
 
+// packets smaller than this are cheaper to copy into every WFIFO than to share (see sockt->wfifoshare)
+#define WFIFO_SHARED_MIN_LEN 64
+
+// pending send data above which a client session is considered congested (see WFIFOCONGESTED)
+#define WFIFO_CONGESTED_SIZE (256*1024)
+
 // socket I/O macros
 #define RFIFOHEAD(fd)
 #define WFIFOHEAD(fd, size) sockt->wfifohead(fd, size)
@@ -58,17 +64,26 @@ struct config_setting_t;
 #define WFIFOSPACE(fd) (sockt->session[fd]->max_wdata - sockt->session[fd]->wdata_size)
 
 #define RFIFOREST(fd)  (sockt->session[fd]->flag.eof ? 0 : sockt->session[fd]->rdata_size - sockt->session[fd]->rdata_pos)
+// Compacts the RFIFO, moving the unparsed data to the front once it's no bigger
+// than the parsed data (or the buffer is full), so each byte is moved at most once on average.
 #define RFIFOFLUSH(fd) \
 	do { \
 		if(sockt->session[fd]->rdata_size == sockt->session[fd]->rdata_pos){ \
 			sockt->session[fd]->rdata_size = sockt->session[fd]->rdata_pos = 0; \
-		} else { \
+		} else if (sockt->session[fd]->rdata_pos > 0 \
+		        && (sockt->session[fd]->rdata_pos >= sockt->session[fd]->rdata_size - sockt->session[fd]->rdata_pos \
+		         || sockt->session[fd]->rdata_size == sockt->session[fd]->max_rdata)) { \
 			sockt->session[fd]->rdata_size -= sockt->session[fd]->rdata_pos; \
 			memmove(sockt->session[fd]->rdata, sockt->session[fd]->rdata+sockt->session[fd]->rdata_pos, sockt->session[fd]->rdata_size); \
 			sockt->session[fd]->rdata_pos = 0; \
 		} \
 	} while(0)
 
+// number of bytes queued for sending (WFIFO data and shared buffers)
+#define WFIFOPENDING(fd) (sockt->session[fd]->wdata_size - sockt->session[fd]->wdata_pos + sockt->session[fd]->wrefs_size)
+// whether a client session is not reading its data fast enough, senders of non-essential data should hold back
+#define WFIFOCONGESTED(fd) (!sockt->session[fd]->flag.server && WFIFOPENDING(fd) >= WFIFO_CONGESTED_SIZE)
+
 #define WFIFOSET(fd, len)  (sockt->wfifoset(fd, len, true))
 #define WFIFOSET2(fd, len)  (sockt->wfifoset(fd, len, false))
 #define RFIFOSKIP(fd, len) (sockt->rfifoskip(fd, len))
@@ -116,6 +131,20 @@ typedef int (*ParseFunc)(int fd);
 typedef int (*ConnectedFunc)(int fd);
 typedef int (*DeleteFunc)(int fd);
 
+/// Packet data shared by the send queues of several sessions.
+struct socket_shared_buffer {
+	int refcount; ///< Number of owners (the creator and each send queue holding it).
+	size_t len;   ///< Length of data.
+	uint8 data[];
+};
+
+/// Shared buffer queued in the send queue of a session.
+struct socket_wfifo_ref {
+	struct socket_shared_buffer *buf;
+	size_t wdata_pos; ///< Position in wdata where the buffer is inserted.
+	size_t sent;      ///< Number of bytes of the buffer already sent.
+};
+
 struct socket_data {
 	struct {
 		unsigned char eof : 1;
@@ -130,9 +159,12 @@ struct socket_data {
 	size_t max_rdata, max_wdata;
 	size_t rdata_size, wdata_size;
 	size_t rdata_pos;
+	size_t wdata_pos; // start of the unsent data in wdata, the space before it is reclaimed lazily
 	uint32 last_head_size;
 	time_t rdata_tick; // time of last recv (for detecting timeouts); zero when timeout is disabled
 	time_t wdata_tick; // time of last send (for detecting timeouts);
+	VECTOR_DECL(struct socket_wfifo_ref) wrefs; // shared buffers queued between the wdata bytes
+	size_t wrefs_size; // unsent bytes of the shared buffers
 
 	RecvFunc func_recv;
 	SendFunc func_send;
@@ -209,6 +241,9 @@ struct socket_interface {
 	int (*realloc_writefifo) (int fd, size_t addition);
 	int (*wfifoset) (int fd, size_t len, bool validate);
 	void (*wfifohead) (int fd, size_t len);
+	int (*wfifoshare) (int fd, struct socket_shared_buffer *buf);
+	struct socket_shared_buffer *(*shared_buffer_create) (const void *data, size_t len);
+	void (*shared_buffer_release) (struct socket_shared_buffer *buf);
 	int (*rfifoskip) (int fd, size_t len);
 	void (*close) (int fd);
 	void (*validateWfifo) (int fd, size_t len);
@@ -433,6 +433,38 @@ static void Sql_Free(struct Sql *self)
 	}
 }
 
+/// Hands a connected handle over to a worker thread.
+static void Sql_Detach(struct Sql *self, size_t query_size)
+{
+	nullpo_retv(self);
+
+	if (self->keepalive != INVALID_TIMER) {
+		timer->delete(self->keepalive, Sql_P_KeepaliveTimer);
+		self->keepalive = INVALID_TIMER;
+	}
+
+	// queries are appended to a cleared buffer, so one that fits never grows it
+	if (query_size > self->buf.max_) {
+		StrBuf->Destroy(&self->buf);
+		self->buf.max_ = (unsigned int)query_size;
+		self->buf.ptr_ = self->buf.buf_ = (char *)aMalloc(self->buf.max_ + 1);
+	}
+}
+
+/// Sets up the client library for the calling thread.
+static int Sql_ThreadInit(void)
+{
+	if (mysql_thread_init() != 0)
+		return SQL_ERROR;
+	return SQL_SUCCESS;
+}
+
+/// Releases what Sql_ThreadInit set up.
+static void Sql_ThreadEnd(void)
+{
+	mysql_thread_end();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Prepared Statements
 ///////////////////////////////////////////////////////////////////////////////
@@ -1157,6 +1189,9 @@ void sql_defaults(void)
 	SQL->ShowDebug_ = Sql_ShowDebug_;
 	SQL->Free = Sql_Free;
 	SQL->Malloc = Sql_Malloc;
+	SQL->Detach = Sql_Detach;
+	SQL->ThreadInit = Sql_ThreadInit;
+	SQL->ThreadEnd = Sql_ThreadEnd;
 
 	/* SqlStmt defaults [Susu] */
 	SQL->StmtBindColumn = SqlStmt_BindColumn;
@@ -161,6 +161,19 @@ struct sql_interface {
 	void (*Free) (struct Sql *self);
 	/// Allocates and initializes a new Sql handle.
 	struct Sql *(*Malloc) (void);
+	/// Hands a connected handle over to a worker thread.
+	/// Stops the keepalive timer and reserves query_size bytes for the query
+	/// buffer, so that queries up to that size neither race with the main
+	/// thread nor go through the memory manager.
+	/// The handle must not be used by the main thread afterwards, except to free it.
+	void (*Detach) (struct Sql *self, size_t query_size);
+	/// Sets up the client library for the calling thread.
+	/// A thread other than the main one must call it before using a handle.
+	///
+	/// @return SQL_SUCCESS or SQL_ERROR
+	int (*ThreadInit) (void);
+	/// Releases what ThreadInit set up, before the calling thread exits.
+	void (*ThreadEnd) (void);
 
 	///////////////////////////////////////////////////////////////////////////////
 	// Prepared Statements
@@ -418,6 +418,130 @@ static bool strlib_bin2hex(char *output, const unsigned char *input, size_t coun
 	return true;
 }
 
+/// Packs the case-folded trigram starting at str.
+static inline uint32 strlib_trigram_key(const char *str)
+{
+	return ((uint32)(unsigned char)TOLOWER(str[0]) << 16)
+	     | ((uint32)(unsigned char)TOLOWER(str[1]) << 8)
+	     | (uint32)(unsigned char)TOLOWER(str[2]);
+}
+
+/// Adds every trigram of str to the index under the given id.
+/// The index must be rebuilt with trigram_build before it is searched.
+static void strlib_trigram_add(struct trigram_index *index, int id, const char *str)
+{
+	size_t i, len;
+
+	nullpo_retv(index);
+	nullpo_retv(str);
+
+	len = strlen(str);
+	if (len < 3)
+		return;
+
+	if (index->count + (int)(len - 2) > index->max) {
+		index->max = max(index->max * 2, index->count + (int)(len - 2));
+		RECREATE(index->entries, struct trigram_entry, index->max);
+	}
+	for (i = 0; i + 2 < len; ++i) {
+		index->entries[index->count].trigram = strlib_trigram_key(str + i);
+		index->entries[index->count].id = id;
+		index->count++;
+	}
+}
+
+static int strlib_trigram_cmp(const void *a, const void *b)
+{
+	const struct trigram_entry *ea = a, *eb = b;
+
+	if (ea->trigram != eb->trigram)
+		return ea->trigram < eb->trigram ? -1 : 1;
+	if (ea->id != eb->id)
+		return ea->id < eb->id ? -1 : 1;
+	return 0;
+}
+
+/// Sorts the index by (trigram, id) and drops duplicate entries.
+static void strlib_trigram_build(struct trigram_index *index)
+{
+	int i, n = 0;
+
+	nullpo_retv(index);
+
+	if (index->count == 0)
+		return;
+
+	qsort(index->entries, index->count, sizeof(index->entries[0]), strlib_trigram_cmp);
+	for (i = 1; i < index->count; ++i) {
+		if (strlib_trigram_cmp(&index->entries[n], &index->entries[i]) != 0)
+			index->entries[++n] = index->entries[i];
+	}
+	index->count = n + 1;
+}
+
+/// Looks up the rarest trigram of str.
+///
+/// @param index Built trigram index
+/// @param str Substring being searched for
+/// @param out Set to the first entry of the trigram, entries are sorted by id
+/// @return Number of entries, or -1 if str is shorter than a trigram
+static int strlib_trigram_find(const struct trigram_index *index, const char *str, const struct trigram_entry **out)
+{
+	size_t i, len;
+	int best = -1;
+
+	nullpo_retr(-1, index);
+	nullpo_retr(-1, str);
+	nullpo_retr(-1, out);
+
+	len = strlen(str);
+	if (len < 3)
+		return -1;
+
+	*out = NULL;
+	for (i = 0; i + 2 < len; ++i) {
+		uint32 key = strlib_trigram_key(str + i);
+		int lo = 0, hi = index->count, first, count;
+
+		// lower bound of key
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (index->entries[mid].trigram < key)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		first = lo;
+		hi = index->count;
+		// upper bound of key
+		while (lo < hi) {
+			int mid = (lo + hi) / 2;
+			if (index->entries[mid].trigram <= key)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		count = lo - first;
+		if (best == -1 || count < best) {
+			best = count;
+			*out = index->entries + first;
+			if (count == 0)
+				break; // no name contains this trigram
+		}
+	}
+	return best;
+}
+
+/// Frees the trigram index.
+static void strlib_trigram_clear(struct trigram_index *index)
+{
+	nullpo_retv(index);
+
+	aFree(index->entries);
+	index->entries = NULL;
+	index->count = index->max = 0;
+}
+
 /////////////////////////////////////////////////////////////////////
 /// Parses a single field in a delim-separated string.
 /// The delimiter after the field is skipped.
@@ -1127,6 +1251,10 @@ void strlib_defaults(void)
 	strlib->safestrnlen_ = strlib_safestrnlen;
 	strlib->strline_ = strlib_strline;
 	strlib->bin2hex_ = strlib_bin2hex;
+	strlib->trigram_add_ = strlib_trigram_add;
+	strlib->trigram_build_ = strlib_trigram_build;
+	strlib->trigram_find_ = strlib_trigram_find;
+	strlib->trigram_clear_ = strlib_trigram_clear;
 
 	StrBuf->Malloc = StringBuf_Malloc;
 	StrBuf->Init = StringBuf_Init;
@@ -48,6 +48,10 @@
 #define safestrnlen(string,maxlen)   (strlib->safestrnlen_((string),(maxlen)))
 #define strline(str,pos)             (strlib->strline_((str),(pos)))
 #define bin2hex(output,input,count)  (strlib->bin2hex_((output),(input),(count)))
+#define trigram_add(index,id,str)    (strlib->trigram_add_((index),(id),(str)))
+#define trigram_build(index)         (strlib->trigram_build_(index))
+#define trigram_find(index,str,out)  (strlib->trigram_find_((index),(str),(out)))
+#define trigram_clear(index)         (strlib->trigram_clear_(index))
 #if (defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L)
 #if defined(__GNUC__) && !defined(__clang__) && GCC_VERSION < 40900
 // _Generic is only supported starting with GCC 4.9
@@ -101,6 +105,20 @@ struct s_svstate {
 };
 
 
+/// Trigram index entry: the name with this id contains this trigram.
+struct trigram_entry {
+	uint32 trigram;
+	int id;
+};
+
+/// Case-insensitive trigram index for substring searches over names.
+/// Filled with trigram_add, then sorted with trigram_build before use.
+struct trigram_index {
+	struct trigram_entry *entries; //< sorted by (trigram, id) once built
+	int count;
+	int max;
+};
+
 /// StringBuf - dynamic string
 struct StringBuf {
 	char *buf_;
@@ -141,6 +159,20 @@ struct strlib_interface {
 	/// The output buffer must be at least count*2+1 in size.
 	/// Returns true on success, false on failure.
 	bool (*bin2hex_) (char *output, const unsigned char *input, size_t count) GCC10ATTR ((access (write_only, 1), access (read_only, 2, 3)));
+
+	/// Adds every trigram of str to the index under the given id.
+	void (*trigram_add_) (struct trigram_index *index, int id, const char *str) GCC10ATTR ((access (read_write, 1), access (read_only, 3)));
+
+	/// Sorts the index and drops duplicate entries.
+	void (*trigram_build_) (struct trigram_index *index) GCC10ATTR ((access (read_write, 1)));
+
+	/// Looks up the rarest trigram of str.
+	/// Sets *out to its entries, sorted by id: a superset of the ids whose names contain str.
+	/// Returns the number of entries, or -1 if str is too short to use the index.
+	int (*trigram_find_) (const struct trigram_index *index, const char *str, const struct trigram_entry **out) GCC10ATTR ((access (read_only, 1), access (read_only, 2)));
+
+	/// Frees the index.
+	void (*trigram_clear_) (struct trigram_index *index) GCC10ATTR ((access (read_write, 1)));
 };
 
 struct stringbuf_interface {
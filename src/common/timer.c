@@ -58,6 +58,19 @@ static int *free_timer_list = NULL;
 static int free_timer_list_max = 0;
 static int free_timer_list_pos = 0;
 
+/// Bookkeeping kept next to timer_data (same index), private to the timer module.
+struct timer_link {
+	int pos;        ///< position in timer_heap or slot in timer_wheel, -1 if not scheduled
+	int wheel_next; ///< next timer in the same wheel slot, 0 if none
+	int wheel_prev; ///< previous timer in the same wheel slot, 0 if head
+	int id_next;    ///< next timer with the same id, 0 if none
+	int id_prev;    ///< previous timer with the same id, 0 if head
+};
+static struct timer_link *timer_links = NULL;
+
+// timers by id (id -> first tid)
+static struct DBMap *timer_id_db = NULL;
+
 
 /// Comparator for the timer heap. (minimum tick at top)
 /// Returns negative if tid1's tick is smaller, positive if tid2's tick is smaller, 0 if equal.
@@ -70,6 +83,44 @@ static int free_timer_list_pos = 0;
 // timer heap (binary heap of tid's)
 static BHEAP_VAR(int, timer_heap);
 
+/// Swapper for the timer heap, keeps the heap positions of both timers up to date.
+#define TIMER_HEAP_SWAP(a,b) do { \
+	swap(a,b); \
+	timer_links[a].pos = (int)(&(a) - BHEAP_DATA(timer_heap)); \
+	timer_links[b].pos = (int)(&(b) - BHEAP_DATA(timer_heap)); \
+} while(0)
+
+// Hierarchical timing wheel (alternative to the timer heap).
+// The first level has one slot per millisecond, each further level covers
+// the whole range of the previous one per slot. Timers further away than the
+// last level are parked in its furthest slot and cascaded again from there.
+#define TIMER_WHEEL_ROOT_BITS 8
+#define TIMER_WHEEL_LEVEL_BITS 6
+#define TIMER_WHEEL_LEVELS 3 // levels after the first
+#define TIMER_WHEEL_ROOT_SIZE (1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_SIZE (1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_SIZE (TIMER_WHEEL_ROOT_SIZE + TIMER_WHEEL_LEVELS * TIMER_WHEEL_LEVEL_SIZE)
+#define TIMER_WHEEL_SPAN(level) ((int64)1 << (TIMER_WHEEL_ROOT_BITS + (level) * TIMER_WHEEL_LEVEL_BITS))
+#define TIMER_WHEEL_INDEX(tick, level) ((int)(((tick) >> (TIMER_WHEEL_ROOT_BITS + (level) * TIMER_WHEEL_LEVEL_BITS)) & (TIMER_WHEEL_LEVEL_SIZE - 1)))
+#define TIMER_WHEEL_SLOT(level, index) (TIMER_WHEEL_ROOT_SIZE + (level) * TIMER_WHEEL_LEVEL_SIZE + (index))
+
+// timer wheel (first tid of each slot, 0 if empty)
+static int timer_wheel[TIMER_WHEEL_SIZE];
+static int64 timer_wheel_tick = 0; ///< next tick to be processed by the wheel
+static int timer_wheel_count = 0;  ///< number of timers in the wheel
+
+// scheduler used for the timers, can't change once timers are started
+#ifdef TIMER_WHEEL
+static bool timer_use_wheel = true;
+#else
+static bool timer_use_wheel = false;
+#endif
+
+// fire latency histogram (how late timers run, in milliseconds)
+static const int timer_latency_bounds[] = { 0, 1, 5, 10, 25, 50, 100, 250, 500, 1000 };
+static uint64 timer_latency_hist[ARRAYLENGTH(timer_latency_bounds) + 1];
+static int64 timer_latency_max = 0;
+
 
 // server startup time
 static time_t start_time;
@@ -267,7 +318,149 @@ static int64 timer_gettick(void)
 static void push_timer_heap(int tid)
 {
 	BHEAP_ENSURE(timer_heap, 1, 256);
-	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP, swap);
+	timer_links[tid].pos = BHEAP_LENGTH(timer_heap);
+	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP, TIMER_HEAP_SWAP);
+}
+
+/// Removes a timer from the timer_heap
+static void pop_timer_heap(int tid)
+{
+	int pos = timer_links[tid].pos;
+
+	timer_links[BHEAP_DATA(timer_heap)[BHEAP_LENGTH(timer_heap) - 1]].pos = pos;
+	timer_links[tid].pos = -1;
+	BHEAP_POPINDEX(timer_heap, pos, DIFFTICK_MINTOPCMP, TIMER_HEAP_SWAP);
+}
+
+/*======================================
+ * CORE : Timer Wheel
+ *--------------------------------------*/
+
+/// Adds a timer to the slot of the timer_wheel matching its tick
+static void push_timer_wheel(int tid)
+{
+	int64 tick = timer_data[tid].tick;
+	int64 delta = DIFF_TICK(tick, timer_wheel_tick);
+	int slot, level;
+
+	if (delta < 0) {
+		// already expired, run it with the next processed tick
+		slot = (int)(timer_wheel_tick & (TIMER_WHEEL_ROOT_SIZE - 1));
+	} else if (delta < TIMER_WHEEL_ROOT_SIZE) {
+		slot = (int)(tick & (TIMER_WHEEL_ROOT_SIZE - 1));
+	} else {
+		for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+			if (delta < TIMER_WHEEL_SPAN(level + 1))
+				break;
+		}
+		if (delta >= TIMER_WHEEL_SPAN(level + 1)) // beyond the last level
+			tick = timer_wheel_tick + TIMER_WHEEL_SPAN(level + 1) - 1;
+		slot = TIMER_WHEEL_SLOT(level, TIMER_WHEEL_INDEX(tick, level));
+	}
+
+	timer_links[tid].pos = slot;
+	timer_links[tid].wheel_prev = 0;
+	timer_links[tid].wheel_next = timer_wheel[slot];
+	if (timer_wheel[slot] != 0)
+		timer_links[timer_wheel[slot]].wheel_prev = tid;
+	timer_wheel[slot] = tid;
+	timer_wheel_count++;
+}
+
+/// Removes a timer from its slot of the timer_wheel
+static void pop_timer_wheel(int tid)
+{
+	int next = timer_links[tid].wheel_next;
+	int prev = timer_links[tid].wheel_prev;
+
+	if (next != 0)
+		timer_links[next].wheel_prev = prev;
+	if (prev != 0)
+		timer_links[prev].wheel_next = next;
+	else
+		timer_wheel[timer_links[tid].pos] = next;
+	timer_links[tid].pos = -1;
+	timer_links[tid].wheel_next = timer_links[tid].wheel_prev = 0;
+	timer_wheel_count--;
+}
+
+/// Moves all timers of a slot of the given level to the lower levels.
+/// Returns the index of the slot.
+static int cascade_timer_wheel(int level)
+{
+	int index = TIMER_WHEEL_INDEX(timer_wheel_tick, level);
+	int slot = TIMER_WHEEL_SLOT(level, index);
+	int tid = timer_wheel[slot];
+
+	// detach the slot first, parked timers may land in it again
+	timer_wheel[slot] = 0;
+	while (tid != 0) {
+		int next = timer_links[tid].wheel_next;
+		timer_wheel_count--;
+		push_timer_wheel(tid);
+		tid = next;
+	}
+
+	return index;
+}
+
+/*======================================
+ * CORE : Scheduler
+ *--------------------------------------*/
+
+/// Schedules a timer to run at its tick
+static void schedule_timer(int tid)
+{
+	if (timer_use_wheel)
+		push_timer_wheel(tid);
+	else
+		push_timer_heap(tid);
+}
+
+/// Removes a timer from the scheduler
+static void unschedule_timer(int tid)
+{
+	if (timer_use_wheel)
+		pop_timer_wheel(tid);
+	else
+		pop_timer_heap(tid);
+}
+
+/*==========================
+ * Timers by id
+ *--------------------------*/
+
+/// Links a timer to the list of timers sharing its id
+static void link_timer_id(int tid)
+{
+	int head;
+
+	if (timer_id_db == NULL)
+		timer_id_db = idb_alloc(DB_OPT_OPEN_ADDRESSING);
+
+	head = idb_iget(timer_id_db, timer_data[tid].id);
+	timer_links[tid].id_prev = 0;
+	timer_links[tid].id_next = head;
+	if (head != 0)
+		timer_links[head].id_prev = tid;
+	idb_iput(timer_id_db, timer_data[tid].id, tid);
+}
+
+/// Unlinks a timer from the list of timers sharing its id
+static void unlink_timer_id(int tid)
+{
+	int next = timer_links[tid].id_next;
+	int prev = timer_links[tid].id_prev;
+
+	if (next != 0)
+		timer_links[next].id_prev = prev;
+	if (prev != 0)
+		timer_links[prev].id_next = next;
+	else if (next != 0)
+		idb_iput(timer_id_db, timer_data[tid].id, next);
+	else
+		idb_remove(timer_id_db, timer_data[tid].id);
+	timer_links[tid].id_next = timer_links[tid].id_prev = 0;
 }
 
 /*==========================
@@ -293,12 +486,17 @@ static int acquire_timer(void)
 		for (tid = timer_data_num; tid < timer_data_max && timer_data[tid].type; tid++);
 	if (tid >= timer_data_num && tid >= timer_data_max)
 	{// expand timer array
+		int i;
 		timer_data_max += 256;
 		if( timer_data )
 			RECREATE(timer_data, struct TimerData, timer_data_max);
 		else
 			CREATE(timer_data, struct TimerData, timer_data_max);
 		memset(timer_data + (timer_data_max - 256), 0, sizeof(struct TimerData)*256);
+		RECREATE(timer_links, struct timer_link, timer_data_max);
+		memset(timer_links + (timer_data_max - 256), 0, sizeof(struct timer_link)*256);
+		for (i = timer_data_max - 256; i < timer_data_max; i++)
+			timer_links[i].pos = -1;
 	}
 
 	if( tid >= timer_data_num )
@@ -307,6 +505,20 @@ static int acquire_timer(void)
 	return tid;
 }
 
+/// Releases a timer id, making it available for reuse.
+static void release_timer(int tid)
+{
+	unlink_timer_id(tid);
+	timer_data[tid].type = 0;
+	timer_data[tid].func = NULL;
+	if (free_timer_list_pos >= free_timer_list_max) {
+		free_timer_list_max += 256;
+		RECREATE(free_timer_list,int,free_timer_list_max);
+		memset(free_timer_list + (free_timer_list_max - 256), 0, 256 * sizeof(int));
+	}
+	free_timer_list[free_timer_list_pos++] = tid;
+}
+
 /// Starts a new timer that is deleted once it expires (single-use).
 /// Returns the timer's id.
 static int timer_add(int64 tick, TimerFunc func, int id, intptr_t data)
@@ -332,7 +544,8 @@ static int timer_add(int64 tick, TimerFunc func, int id, intptr_t data)
 	timer_data[tid].data     = data;
 	timer_data[tid].type     = TIMER_ONCE_AUTODEL;
 	timer_data[tid].interval = 1000;
-	push_timer_heap(tid);
+	schedule_timer(tid);
+	link_timer_id(tid);
 
 	return tid;
 }
@@ -369,7 +582,8 @@ static int timer_add_interval(int64 tick, TimerFunc func, int id, intptr_t data,
 	timer_data[tid].data     = data;
 	timer_data[tid].type     = TIMER_INTERVAL;
 	timer_data[tid].interval = interval;
-	push_timer_heap(tid);
+	schedule_timer(tid);
+	link_timer_id(tid);
 
 	return tid;
 }
@@ -381,7 +595,21 @@ static const struct TimerData *timer_get(int tid)
 	return ( tid >= 0 && tid < timer_data_num ) ? &timer_data[tid] : NULL;
 }
 
-/// Marks a timer specified by 'id' for immediate deletion once it expires.
+/// Removes a live timer.
+/// Timers in the heap are released right away; a timer that is currently
+/// executing is only disarmed and gets released by do_timer once its function returns.
+static void timer_remove(int tid)
+{
+	timer_data[tid].func = NULL;
+	if (timer_data[tid].type & TIMER_REMOVE_HEAP) {
+		timer_data[tid].type = TIMER_ONCE_AUTODEL|TIMER_REMOVE_HEAP;
+		return;
+	}
+	unschedule_timer(tid);
+	release_timer(tid);
+}
+
+/// Deletes a timer specified by 'tid'.
 /// Param 'func' is used for debug/verification purposes.
 /// Returns 0 on success, < 0 on failure.
 static int timer_do_delete(int tid, TimerFunc func)
@@ -406,12 +634,33 @@ static int timer_do_delete(int tid, TimerFunc func)
 		return -3;
 	}
 
-	timer_data[tid].func = NULL;
-	timer_data[tid].type = TIMER_ONCE_AUTODEL;
+	timer_remove(tid);
 
 	return 0;
 }
 
+/// Deletes all timers started with the given 'id'.
+/// If 'func' is not NULL, only the timers running that function are deleted.
+/// Returns the number of deleted timers.
+static int timer_delete_by_id(int id, TimerFunc func)
+{
+	int tid, count = 0;
+
+	if (timer_id_db == NULL)
+		return 0;
+
+	for (tid = idb_iget(timer_id_db, id); tid != 0; ) {
+		int next = timer_links[tid].id_next;
+		if (timer_data[tid].func != NULL && (func == NULL || timer_data[tid].func == func)) {
+			timer_remove(tid);
+			count++;
+		}
+		tid = next;
+	}
+
+	return count;
+}
+
 /// Adjusts a timer's expiration time.
 /// Returns the new tick value, or -1 if it fails.
 static int64 timer_addtick(int tid, int64 tick)
@@ -434,11 +683,12 @@ static int64 timer_addtick(int tid, int64 tick)
  */
 static int64 timer_settick(int tid, int64 tick)
 {
-	int i;
-
-	// search timer position
-	ARR_FIND(0, BHEAP_LENGTH(timer_heap), i, BHEAP_DATA(timer_heap)[i] == tid);
-	if (i == BHEAP_LENGTH(timer_heap)) {
+	if (tid < 1 || tid >= timer_data_num) {
+		ShowError("timer_settick error : no such timer [%d]\n", tid);
+		Assert_retr(-1, 0);
+		return -1;
+	}
+	if (timer_links[tid].pos < 0) {
 		ShowError("timer_settick: no such timer [%d](%p(%s))\n", tid, timer_data[tid].func, search_timer_func_list(timer_data[tid].func));
 		Assert_retr(-1, 0);
 		return -1;
@@ -462,19 +712,64 @@ static int64 timer_settick(int tid, int64 tick)
 		return tick; // nothing to do, already in proper position
 
 	// pop and push adjusted timer
-	BHEAP_POPINDEX(timer_heap, i, DIFFTICK_MINTOPCMP, swap);
+	unschedule_timer(tid);
 	timer_data[tid].tick = tick;
-	BHEAP_PUSH(timer_heap, tid, DIFFTICK_MINTOPCMP, swap);
+	schedule_timer(tid);
 	return tick;
 }
 
-/**
- * Executes all expired timers.
- *
- * @param tick The current tick.
- * @return The value of the smallest non-expired timer (or 1 second if there aren't any).
- */
-static int do_timer(int64 tick)
+/// Records how late a timer ran in the fire latency histogram.
+static void timer_record_latency(int64 latency)
+{
+	int i;
+
+	if (latency < 0)
+		latency = 0;
+	if (latency > timer_latency_max)
+		timer_latency_max = latency;
+	ARR_FIND(0, ARRAYLENGTH(timer_latency_bounds), i, latency <= timer_latency_bounds[i]);
+	timer_latency_hist[i]++;
+}
+
+/// Runs an expired timer that was already removed from the scheduler,
+/// then either releases or reschedules it.
+static void run_timer(int tid, int64 tick)
+{
+	int64 diff = DIFF_TICK(timer_data[tid].tick, tick);
+
+	timer_data[tid].type |= TIMER_REMOVE_HEAP;
+
+	if( timer_data[tid].func ) {
+		timer_record_latency(-diff);
+		if( diff < -1000 )
+			// timer was delayed for more than 1 second, use current tick instead
+			timer_data[tid].func(tid, tick, timer_data[tid].id, timer_data[tid].data);
+		else
+			timer_data[tid].func(tid, timer_data[tid].tick, timer_data[tid].id, timer_data[tid].data);
+	}
+
+	// in the case the function didn't change anything...
+	if( timer_data[tid].type & TIMER_REMOVE_HEAP ) {
+		timer_data[tid].type &= ~TIMER_REMOVE_HEAP;
+
+		switch( timer_data[tid].type ) {
+			default:
+			case TIMER_ONCE_AUTODEL:
+				release_timer(tid);
+			break;
+			case TIMER_INTERVAL:
+				if( DIFF_TICK(timer_data[tid].tick, tick) < -1000 )
+					timer_data[tid].tick = tick + timer_data[tid].interval;
+				else
+					timer_data[tid].tick += timer_data[tid].interval;
+				schedule_timer(tid);
+			break;
+		}
+	}
+}
+
+/// Executes all expired timers of the timer_heap.
+static int64 do_timer_heap(int64 tick)
 {
 	int64 diff = TIMER_MAX_INTERVAL; // return value
 
@@ -486,48 +781,83 @@ static int do_timer(int64 tick)
 		if( diff > 0 )
 			break; // no more expired timers to process
 
-		// remove timer
-		BHEAP_POP(timer_heap, DIFFTICK_MINTOPCMP, swap);
-		timer_data[tid].type |= TIMER_REMOVE_HEAP;
+		pop_timer_heap(tid);
+		run_timer(tid, tick);
+	}
 
-		if( timer_data[tid].func ) {
-			if( diff < -1000 )
-				// timer was delayed for more than 1 second, use current tick instead
-				timer_data[tid].func(tid, tick, timer_data[tid].id, timer_data[tid].data);
-			else
-				timer_data[tid].func(tid, timer_data[tid].tick, timer_data[tid].id, timer_data[tid].data);
-		}
+	return diff;
+}
 
-		// in the case the function didn't change anything...
-		if( timer_data[tid].type & TIMER_REMOVE_HEAP ) {
-			timer_data[tid].type &= ~TIMER_REMOVE_HEAP;
-
-			switch( timer_data[tid].type ) {
-				default:
-				case TIMER_ONCE_AUTODEL:
-					timer_data[tid].type = 0;
-					timer_data[tid].func = NULL;
-					if (free_timer_list_pos >= free_timer_list_max) {
-						free_timer_list_max += 256;
-						RECREATE(free_timer_list,int,free_timer_list_max);
-						memset(free_timer_list + (free_timer_list_max - 256), 0, 256 * sizeof(int));
-					}
-					free_timer_list[free_timer_list_pos++] = tid;
-				break;
-				case TIMER_INTERVAL:
-					if( DIFF_TICK(timer_data[tid].tick, tick) < -1000 )
-						timer_data[tid].tick = tick + timer_data[tid].interval;
-					else
-						timer_data[tid].tick += timer_data[tid].interval;
-					push_timer_heap(tid);
+/// Executes all expired timers of the timer_wheel, one tick at a time.
+static int64 do_timer_wheel(int64 tick)
+{
+	int i;
+
+	while (timer_wheel_count > 0 && DIFF_TICK(timer_wheel_tick, tick) <= 0) {
+		int slot = (int)(timer_wheel_tick & (TIMER_WHEEL_ROOT_SIZE - 1));
+
+		// refill the first level from the upper ones when it wraps around
+		for (i = 0; slot == 0 && i < TIMER_WHEEL_LEVELS; i++) {
+			if (cascade_timer_wheel(i) != 0)
 				break;
-			}
 		}
+
+		while (timer_wheel[slot] != 0) {
+			int tid = timer_wheel[slot];
+			pop_timer_wheel(tid);
+			run_timer(tid, tick);
+		}
+		timer_wheel_tick++;
 	}
 
+	if (timer_wheel_count == 0) {
+		timer_wheel_tick = tick + 1; // nothing to process, skip ahead
+		return TIMER_MAX_INTERVAL;
+	}
+
+	// look for the next timer in the first level
+	for (i = 0; i < TIMER_WHEEL_ROOT_SIZE; i++) {
+		if (timer_wheel[(timer_wheel_tick + i) & (TIMER_WHEEL_ROOT_SIZE - 1)] != 0)
+			break;
+	}
+	return DIFF_TICK(timer_wheel_tick + i, tick);
+}
+
+/**
+ * Executes all expired timers.
+ *
+ * @param tick The current tick.
+ * @return The value of the smallest non-expired timer (or 1 second if there aren't any).
+ */
+static int do_timer(int64 tick)
+{
+	int64 diff = timer_use_wheel ? do_timer_wheel(tick) : do_timer_heap(tick);
+
 	return (int)cap_value(diff, TIMER_MIN_INTERVAL, TIMER_MAX_INTERVAL);
 }
 
+/// Shows the fire latency histogram of the timers run so far.
+static void timer_report_latency(void)
+{
+	uint64 total = 0;
+	int i;
+
+	for (i = 0; i < ARRAYLENGTH(timer_latency_hist); i++)
+		total += timer_latency_hist[i];
+	if (total == 0)
+		return;
+
+	ShowInfo("Timer fire latency (%s, %"PRIu64" timers, max %"PRId64"ms):\n", timer_use_wheel ? "wheel" : "heap", total, timer_latency_max);
+	for (i = 0; i < ARRAYLENGTH(timer_latency_hist); i++) {
+		if (timer_latency_hist[i] == 0)
+			continue;
+		if (i == ARRAYLENGTH(timer_latency_bounds))
+			ShowMessage("\t  > %4dms: %10"PRIu64" (%5.2f%%)\n", timer_latency_bounds[i - 1], timer_latency_hist[i], timer_latency_hist[i] * 100. / total);
+		else
+			ShowMessage("\t <= %4dms: %10"PRIu64" (%5.2f%%)\n", timer_latency_bounds[i], timer_latency_hist[i], timer_latency_hist[i] * 100. / total);
+	}
+}
+
 static unsigned long timer_get_uptime(void)
 {
 	return (unsigned long)difftime(time(NULL), start_time);
@@ -540,6 +870,7 @@ static void timer_init(void)
 #endif
 
 	time(&start_time);
+	timer_wheel_tick = timer->gettick_nocache();
 }
 
 static void timer_final(void)
@@ -553,7 +884,11 @@ static void timer_final(void)
 		aFree(tfl);
 	}
 
+	timer->report_latency();
+
 	if (timer_data) aFree(timer_data);
+	if (timer_links) aFree(timer_links);
+	if (timer_id_db) db_destroy(timer_id_db);
 	BHEAP_CLEAR(timer_heap);
 	if (free_timer_list) aFree(free_timer_list);
 }
@@ -655,10 +990,12 @@ void timer_defaults(void)
 	timer->add_func_list = timer_add_func_list;
 	timer->get = timer_get;
 	timer->delete = timer_do_delete;
+	timer->delete_by_id = timer_delete_by_id;
 	timer->addtick = timer_addtick;
 	timer->settick = timer_settick;
 	timer->get_uptime = timer_get_uptime;
 	timer->perform = do_timer;
+	timer->report_latency = timer_report_latency;
 	timer->init = timer_init;
 	timer->final = timer_final;
 	timer->check_timers = timer_check_timers;
@@ -66,6 +66,7 @@ struct timer_interface {
 	int (*add_interval) (int64 tick, TimerFunc func, int id, intptr_t data, int interval);
 	const struct TimerData *(*get) (int tid);
 	int (*delete) (int tid, TimerFunc func);
+	int (*delete_by_id) (int id, TimerFunc func);
 
 	int64 (*addtick) (int tid, int64 tick);
 	int64 (*settick) (int tid, int64 tick);
@@ -75,6 +76,7 @@ struct timer_interface {
 	unsigned long (*get_uptime) (void);
 
 	int (*perform) (int64 tick);
+	void (*report_latency) (void);
 	void (*init) (void);
 	void (*final) (void);
 	void (*check_timers) (void);
@@ -26,6 +26,7 @@
 #include "login/loginlog.h"
 #include "common/cbasetypes.h"
 #include "common/conf.h"
+#include "common/db.h"
 #include "common/nullpo.h"
 #include "common/showmsg.h"
 #include "common/sql.h"
@@ -33,6 +34,7 @@
 #include "common/timer.h"
 
 #include <stdlib.h>
+#include <time.h>
 
 static struct ipban_interface ipban_s;
 struct ipban_interface *ipban;
@@ -41,11 +43,16 @@ static struct s_ipban_dbs ipbandbs;
 // initialize
 static void ipban_init(void)
 {
+	int i;
+
 	ipban->inited = true;
 
 	if (!login->config->ipban)
 		return;// ipban disabled
 
+	for (i = 0; i < IPBAN_LEVELS; i++)
+		ipban->bans[i] = uidb_alloc(DB_OPT_BASE);
+
 	// establish connections
 	ipban->sql_handle = SQL->Malloc();
 	if (SQL_ERROR == SQL->Connect(ipban->sql_handle, ipban->dbs->db_username, ipban->dbs->db_password,
@@ -57,6 +64,9 @@ static void ipban_init(void)
 	if (ipban->dbs->codepage[0] != '\0' && SQL_ERROR == SQL->SetEncoding(ipban->sql_handle, ipban->dbs->codepage))
 		Sql_ShowDebug(ipban->sql_handle);
 
+	if (!ipban->load())
+		ShowError("ipban_init: Failed to load the IP ban list, only new bans will be enforced until the next cleanup.\n");
+
 	if (login->config->ipban_cleanup_interval > 0) {
 		// set up periodic cleanup of connection history and active bans
 		timer->add_func_list(ipban->cleanup, "ipban_cleanup");
@@ -70,6 +80,8 @@ static void ipban_init(void)
 // finalize
 static void ipban_final(void)
 {
+	int i;
+
 	if (!login->config->ipban)
 		return;// ipban disabled
 
@@ -82,6 +94,11 @@ static void ipban_final(void)
 	// close connections
 	SQL->Free(ipban->sql_handle);
 	ipban->sql_handle = NULL;
+
+	for (i = 0; i < IPBAN_LEVELS; i++) {
+		db_destroy(ipban->bans[i]);
+		ipban->bans[i] = NULL;
+	}
 }
 
 /**
@@ -233,32 +250,125 @@ static bool ipban_config_read(const char *filename, struct config_t *config, boo
 	return retval;
 }
 
+/**
+ * Parses a ban pattern of the ban list table.
+ *
+ * Only the patterns matched by the login-server are accepted: one to four
+ * leading numbers followed by wildcards, e.g. "192.168.*.*".
+ *
+ * @param[in]  list  Pattern to parse.
+ * @param[out] ip    Address with the wildcard parts set to 0.
+ * @param[out] level Number of numeric parts minus one (index in ipban->bans).
+ *
+ * @retval false if the pattern is not one of the accepted forms.
+ */
+static bool ipban_parse_list(const char *list, uint32 *ip, int *level)
+{
+	const char *p = list;
+	uint32 addr = 0;
+	int i, parts = 0;
+
+	nullpo_retr(false, list);
+	nullpo_retr(false, ip);
+	nullpo_retr(false, level);
+
+	for (i = 0; i < 4; i++) {
+		char *end;
+		unsigned long value;
+
+		if (i > 0 && *p++ != '.')
+			return false;
+		if (*p == '*') {
+			p++;
+			continue;
+		}
+		if (parts != i || !ISDIGIT(*p))
+			return false; // number after a wildcard
+		value = strtoul(p, &end, 10);
+		if (value > 255)
+			return false;
+		p = end;
+		addr |= (uint32)value << (24 - 8 * i);
+		parts++;
+	}
+
+	if (*p != '\0' || parts == 0)
+		return false;
+
+	*ip = addr;
+	*level = parts - 1;
+	return true;
+}
+
+/**
+ * Adds a ban to the in-memory ban list.
+ *
+ * @param ip     Banned address, parts below the level are ignored.
+ * @param level  0 to 3 for x.*.*.*, x.x.*.*, x.x.x.* and x.x.x.x bans.
+ * @param expire Time the ban ends at (unix time).
+ */
+static void ipban_add(uint32 ip, int level, unsigned int expire)
+{
+	uint32 key;
+
+	Assert_retv(level >= 0 && level < IPBAN_LEVELS);
+
+	key = ip & IPBAN_MASK(level);
+	if (uidb_uiget(ipban->bans[level], key) < expire)
+		uidb_uiput(ipban->bans[level], key, expire);
+}
+
+/**
+ * Replaces the in-memory ban list with the active bans of the ban table.
+ *
+ * @retval false if the table could not be read; the list is kept as is.
+ */
+static bool ipban_load(void)
+{
+	int i;
+
+	if (SQL_ERROR == SQL->Query(ipban->sql_handle, "SELECT `list`, UNIX_TIMESTAMP(`rtime`) FROM `%s` WHERE `rtime` > NOW()", ipban->dbs->table)) {
+		Sql_ShowDebug(ipban->sql_handle);
+		return false;
+	}
+
+	for (i = 0; i < IPBAN_LEVELS; i++)
+		db_clear(ipban->bans[i]);
+
+	while (SQL_SUCCESS == SQL->NextRow(ipban->sql_handle)) {
+		char *data = NULL;
+		uint32 ip;
+		int level;
+
+		SQL->GetData(ipban->sql_handle, 0, &data, NULL);
+		if (data == NULL || !ipban->parse_list(data, &ip, &level))
+			continue;
+		SQL->GetData(ipban->sql_handle, 1, &data, NULL);
+		if (data == NULL)
+			continue;
+		ipban->add(ip, level, (unsigned int)strtoul(data, NULL, 10));
+	}
+	SQL->FreeResult(ipban->sql_handle);
+
+	return true;
+}
+
 // check ip against active bans list
 static bool ipban_check(uint32 ip)
 {
-	uint8* p = (uint8*)&ip;
-	char* data = NULL;
-	int matches;
+	unsigned int now;
+	int i;
 
 	if (!login->config->ipban)
 		return false;// ipban disabled
 
-	if( SQL_ERROR == SQL->Query(ipban->sql_handle, "SELECT count(*) FROM `%s` WHERE `rtime` > NOW() AND (`list` = '%u.*.*.*' OR `list` = '%u.%u.*.*' OR `list` = '%u.%u.%u.*' OR `list` = '%u.%u.%u.%u')",
-		ipban->dbs->table, p[3], p[3], p[2], p[3], p[2], p[1], p[3], p[2], p[1], p[0]) )
-	{
-		Sql_ShowDebug(ipban->sql_handle);
-		// close connection because we can't verify their connectivity.
-		return true;
+	now = (unsigned int)time(NULL);
+	for (i = 0; i < IPBAN_LEVELS; i++) {
+		if (uidb_uiget(ipban->bans[i], ip & IPBAN_MASK(i)) > now)
+			return true;
 	}
 
-	if( SQL_SUCCESS != SQL->NextRow(ipban->sql_handle) )
-		return false;
-
-	SQL->GetData(ipban->sql_handle, 0, &data, NULL);
-	matches = atoi(data);
-	SQL->FreeResult(ipban->sql_handle);
-
-	return( matches > 0 );
+	return false;
 }
 
 // log failed attempt
@@ -275,6 +385,10 @@ static void ipban_log(uint32 ip)
 	if (failures >= login->config->dynamic_pass_failure_ban_limit)
 	{
 		uint8* p = (uint8*)&ip;
+
+		// The ban applies right away, the table keeps it across restarts.
+		ipban->add(ip, 2, (unsigned int)time(NULL) + login->config->dynamic_pass_failure_ban_duration * 60);
+
 		if (SQL_ERROR == SQL->Query(ipban->sql_handle, "INSERT INTO `%s`(`list`,`btime`,`rtime`,`reason`) VALUES ('%u.%u.%u.*', NOW() , NOW() +  INTERVAL %u MINUTE ,'Password error ban')",
 			ipban->dbs->table, p[3], p[2], p[1], login->config->dynamic_pass_failure_ban_duration))
 		{
@@ -292,6 +406,9 @@ static int ipban_cleanup(int tid, int64 tick, int id, intptr_t data)
 	if( SQL_ERROR == SQL->Query(ipban->sql_handle, "DELETE FROM `%s` WHERE `rtime` <= NOW()", ipban->dbs->table) )
 		Sql_ShowDebug(ipban->sql_handle);
 
+	// Drops the expired bans and picks up bans added to the table by others.
+	ipban->load();
+
 	return 0;
 }
 
@@ -302,6 +419,7 @@ void ipban_defaults(void)
 	ipban->dbs = &ipbandbs;
 
 	ipban->sql_handle = NULL;
+	memset(ipban->bans, 0, sizeof(ipban->bans));
 	ipban->cleanup_timer_id = INVALID_TIMER;
 	ipban->inited = false;
 
@@ -321,6 +439,9 @@ void ipban_defaults(void)
 	ipban->config_read_connection = ipban_config_read_connection;
 	ipban->config_read_dynamic = ipban_config_read_dynamic;
 	ipban->config_read = ipban_config_read;
+	ipban->parse_list = ipban_parse_list;
+	ipban->add = ipban_add;
+	ipban->load = ipban_load;
 	ipban->check = ipban_check;
 	ipban->log = ipban_log;
 }
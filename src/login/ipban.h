@@ -26,6 +26,12 @@
 
 /* Forward Declarations */
 struct config_t; // common/conf.h
+struct DBMap; // common/db.h
+
+/// Ban levels: x.*.*.*, x.x.*.*, x.x.x.* and x.x.x.x.
+#define IPBAN_LEVELS 4
+/// Mask of the address parts compared at a ban level.
+#define IPBAN_MASK(level) (0xFFFFFFFFU << (24 - 8 * (level)))
 
 struct s_ipban_dbs {
 	char   db_hostname[32];
@@ -43,6 +49,7 @@ struct s_ipban_dbs {
 struct ipban_interface {
 	struct s_ipban_dbs *dbs;
 	struct Sql *sql_handle;
+	struct DBMap *bans[IPBAN_LEVELS]; ///< Active bans per level: masked address -> end time (unix time).
 	int cleanup_timer_id;
 	bool inited;
 	void (*init) (void);
@@ -52,6 +59,9 @@ struct ipban_interface {
 	bool (*config_read_connection) (const char *filename, struct config_t *config, bool imported);
 	bool (*config_read_dynamic) (const char *filename, struct config_t *config, bool imported);
 	bool (*config_read) (const char *filename, struct config_t *config, bool imported);
+	bool (*parse_list) (const char *list, uint32 *ip, int *level);
+	void (*add) (uint32 ip, int level, unsigned int expire);
+	bool (*load) (void);
 	bool (*check) (uint32 ip);
 	void (*log) (uint32 ip);
 };
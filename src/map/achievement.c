@@ -287,8 +287,161 @@ static bool achievement_check_criteria(const struct achievement_objective *objec
 	return true;
 }
 
+/**
+ * Gets the value objectives of an achievement type are indexed by.
+ *
+ * Each type is indexed by the most selective criteria field it uses:
+ * mob id, item id, job id, status type, weapon level or achievement id.
+ * Types with none of these are not indexed.
+ *
+ * @param[in]  type        type of the achievement.
+ * @param[in]  objective   objective, or the criteria being validated.
+ * @param[in]  is_criteria whether objective is the criteria being validated.
+ * @param[out] key         indexed value.
+ * @return false if an objective matches any value of the field, or if all
+ *         objectives must be checked for this criteria.
+ */
+static bool achievement_index_key(enum achievement_types type, const struct achievement_objective *objective, bool is_criteria, int *key)
+{
+	nullpo_retr(false, objective);
+	nullpo_retr(false, key);
+
+	if (achievement_criteria_mobid(type)) {
+		*key = objective->mobid;
+		return is_criteria || objective->mobid > 0;
+	} else if (achievement_criteria_itemid(type)) {
+		*key = objective->unique.itemid;
+		return is_criteria || objective->unique_type == CRITERIA_UNIQUE_ITEM_ID;
+	} else if (achievement_criteria_jobid(type)) {
+		// Objectives with jobs only match criteria whose jobs all equal theirs,
+		// and criteria without jobs match every objective.
+		if (VECTOR_LENGTH(objective->jobid) == 0)
+			return false;
+		*key = VECTOR_INDEX(objective->jobid, 0);
+		return true;
+	} else if (achievement_criteria_stattype(type)) {
+		*key = (int)objective->unique.status_type;
+		return is_criteria || objective->unique_type == CRITERIA_UNIQUE_STATUS_TYPE;
+	} else if (achievement_criteria_weaponlv(type)) {
+		*key = objective->unique.weapon_lv;
+		return is_criteria || objective->unique_type == CRITERIA_UNIQUE_WEAPON_LV;
+	} else if (type == ACH_ACHIEVE) {
+		*key = objective->unique.achieve_id;
+		return is_criteria || objective->unique_type == CRITERIA_UNIQUE_ACHIEVE_ID;
+	}
+
+	return false;
+}
+
+/**
+ * Builds the per-type objective index from the loaded achievements.
+ */
+static void achievement_index_build(void)
+{
+	int type, i, j;
+
+	for (type = 0; type < ACH_TYPE_MAX; type++) {
+		struct achievement_type_index *index = &achievement->index[type];
+
+		index->keyed = idb_alloc(DB_OPT_RELEASE_DATA);
+		VECTOR_INIT(index->any);
+
+		for (i = 0; i < VECTOR_LENGTH(achievement->category[type]); i++) {
+			const struct achievement_data *ad = achievement->get(VECTOR_INDEX(achievement->category[type], i));
+
+			if (ad == NULL)
+				continue;
+
+			for (j = 0; j < VECTOR_LENGTH(ad->objective); j++) {
+				struct achievement_objective_ref ref = { i, j };
+				struct achievement_objective_refs *refs = &index->any;
+				int key;
+
+				if (achievement->index_key(type, &VECTOR_INDEX(ad->objective, j), false, &key)) {
+					if ((refs = idb_get(index->keyed, key)) == NULL) {
+						CREATE(refs, struct achievement_objective_refs, 1);
+						VECTOR_INIT(*refs);
+						idb_put(index->keyed, key, refs);
+					}
+				}
+
+				VECTOR_ENSURE(*refs, 1, 1);
+				VECTOR_PUSH(*refs, ref);
+			}
+		}
+	}
+}
+
+/**
+ * Cleaning function called through achievement->index[type].keyed->destroy()
+ */
+static int achievement_index_finalize(union DBKey key, struct DBData *data, va_list args)
+{
+	struct achievement_objective_refs *refs = DB->data2ptr(data);
+
+	VECTOR_CLEAR(*refs);
+	return 0;
+}
+
+/**
+ * Frees the per-type objective index.
+ */
+static void achievement_index_clear(void)
+{
+	int type;
+
+	for (type = 0; type < ACH_TYPE_MAX; type++) {
+		struct achievement_type_index *index = &achievement->index[type];
+
+		if (index->keyed != NULL) {
+			index->keyed->destroy(index->keyed, achievement->index_finalize);
+			index->keyed = NULL;
+		}
+		VECTOR_CLEAR(index->any);
+	}
+}
+
+/**
+ * Validates a single objective of an achievement against the criteria.
+ * @param[in] sd         as a pointer to the map session data.
+ * @param[in] ad         as the achievement.
+ * @param[in] obj_idx    as the index of the objective.
+ * @param[in] criteria   as the criteria being validated.
+ * @param[in] additive   whether the criteria's goal is added to the progress.
+ * @return 1 if the progress was updated, 0 if not, -1 on failure.
+ */
+static int achievement_validate_objective(struct map_session_data *sd, const struct achievement_data *ad, int obj_idx, const struct achievement_objective *criteria, bool additive)
+{
+	struct achievement *ach = NULL;
+
+	nullpo_retr(-1, sd);
+	nullpo_retr(-1, ad);
+	nullpo_retr(-1, criteria);
+
+	// Check if objective criteria matches.
+	if (achievement->check_criteria(&VECTOR_INDEX(ad->objective, obj_idx), criteria) == false)
+		return 0;
+	// Ensure availability of the achievement.
+	if ((ach = achievement->ensure(sd, ad)) == NULL)
+		return -1;
+	// Criteria passed, check if not completed and update progress.
+	if ((ach->completed_at == 0 && ach->objective[obj_idx] < VECTOR_INDEX(ad->objective, obj_idx).goal)) {
+		if (additive == true)
+			achievement->progress_add(sd, ad, obj_idx, criteria->goal);
+		else
+			achievement->progress_set(sd, ad, obj_idx, criteria->goal);
+		return 1;
+	}
+
+	return 0;
+}
+
 /**
  * Validates an Achievement Objective of similar types.
+ *
+ * Only the objectives the type index lists for the criteria are checked,
+ * in the order of the achievement database.
+ *
  * @param[in] sd         as a pointer to the map session data.
  * @param[in] type       as the type of the achievement.
  * @param[in] criteria   as the criteria of the objective (mob id, job id etc.. 0 for no criteria).
@@ -297,8 +450,11 @@ static bool achievement_check_criteria(const struct achievement_objective *objec
  */
 static int achievement_validate_type(struct map_session_data *sd, enum achievement_types type, const struct achievement_objective *criteria, bool additive)
 {
-	int i = 0, total = 0;
-	struct achievement *ach = NULL;
+	const struct achievement_type_index *index = NULL;
+	const struct achievement_objective_refs *keyed = NULL;
+	int i = 0, total = 0, key = 0;
+	int a = 0, b = 0, last_pos = -1;
+	bool updated = false;
 
 	nullpo_ret(sd);
 	nullpo_ret(criteria);
@@ -316,36 +472,73 @@ static int achievement_validate_type(struct map_session_data *sd, enum achieveme
 		return 0;
 	}
 
-	/* Loop through all achievements of the type, checking for possible matches. */
-	for (i = 0; i < VECTOR_LENGTH(achievement->category[type]); i++) {
-		int j = 0;
-		bool updated = false;
-		const struct achievement_data *ad = NULL;
-
-		if ((ad = achievement->get(VECTOR_INDEX(achievement->category[type], i))) == NULL)
-			continue;
+	index = &achievement->index[type];
+	if (index->keyed == NULL || !achievement->index_key(type, criteria, true, &key)) {
+		/* Loop through all achievements of the type, checking for possible matches. */
+		for (i = 0; i < VECTOR_LENGTH(achievement->category[type]); i++) {
+			int j = 0;
+			const struct achievement_data *ad = NULL;
 
-		for (j = 0; j < VECTOR_LENGTH(ad->objective); j++) {
-			// Check if objective criteria matches.
-			if (achievement->check_criteria(&VECTOR_INDEX(ad->objective, j), criteria) == false)
+			if ((ad = achievement->get(VECTOR_INDEX(achievement->category[type], i))) == NULL)
 				continue;
-			// Ensure availability of the achievement.
-			if ((ach = achievement->ensure(sd, ad)) == NULL)
-				return false;
-			// Criteria passed, check if not completed and update progress.
-			if ((ach->completed_at == 0 && ach->objective[j] < VECTOR_INDEX(ad->objective, j).goal)) {
-				if (additive == true)
-					achievement->progress_add(sd, ad, j, criteria->goal);
-				else
-					achievement->progress_set(sd, ad, j, criteria->goal);
-				updated = true;
+
+			updated = false;
+			for (j = 0; j < VECTOR_LENGTH(ad->objective); j++) {
+				int result = achievement->validate_objective(sd, ad, j, criteria, additive);
+
+				if (result < 0)
+					return false;
+				if (result > 0)
+					updated = true;
 			}
+
+			if (updated == true)
+				total++;
+		}
+
+		return total;
+	}
+
+	/* Merge the objectives matching any key with those of the criteria's key. */
+	keyed = idb_get(index->keyed, key);
+	while (a < VECTOR_LENGTH(index->any) || (keyed != NULL && b < VECTOR_LENGTH(*keyed))) {
+		const struct achievement_objective_ref *ref = NULL;
+		const struct achievement_data *ad = NULL;
+		int result;
+
+		if (keyed == NULL || b >= VECTOR_LENGTH(*keyed)) {
+			ref = &VECTOR_INDEX(index->any, a++);
+		} else if (a >= VECTOR_LENGTH(index->any)) {
+			ref = &VECTOR_INDEX(*keyed, b++);
+		} else {
+			const struct achievement_objective_ref *ref_a = &VECTOR_INDEX(index->any, a);
+			const struct achievement_objective_ref *ref_b = &VECTOR_INDEX(*keyed, b);
+
+			if (ref_a->pos < ref_b->pos || (ref_a->pos == ref_b->pos && ref_a->objective < ref_b->objective))
+				ref = &VECTOR_INDEX(index->any, a++);
+			else
+				ref = &VECTOR_INDEX(*keyed, b++);
 		}
 
-		if (updated == true)
-			total++;
+		if (ref->pos != last_pos) {
+			if (updated == true)
+				total++;
+			updated = false;
+			last_pos = ref->pos;
+		}
+
+		if ((ad = achievement->get(VECTOR_INDEX(achievement->category[type], ref->pos))) == NULL)
+			continue;
+
+		if ((result = achievement->validate_objective(sd, ad, ref->objective, criteria, additive)) < 0)
+			return false;
+		if (result > 0)
+			updated = true;
 	}
 
+	if (updated == true)
+		total++;
+
 	return total;
 }
 
@@ -1897,6 +2090,7 @@ static void do_init_achievement(bool minimal)
 	/* Read LibConfig Files */
 	achievement->readdb();
 	achievement->readdb_ranks();
+	achievement->index_build();
 }
 
 /**
@@ -1929,6 +2123,7 @@ static void do_final_achievement(void)
 {
 	int i = 0;
 
+	achievement->index_clear();
 	achievement->db->destroy(achievement->db, achievement->db_finalize);
 
 	for (i = 0; i < ACH_TYPE_MAX; i++)
@@ -1948,6 +2143,7 @@ void achievement_defaults(void)
 	achievement->final = do_final_achievement;
 	/* */
 	achievement->db_finalize = achievement_db_finalize;
+	achievement->index_finalize = achievement_index_finalize;
 	/* */
 	achievement->readdb = achievement_readb;
 	/* */
@@ -1982,6 +2178,10 @@ void achievement_defaults(void)
 	achievement->check_criteria = achievement_check_criteria;
 	/* */
 	achievement->validate = achievement_validate;
+	achievement->index_key = achievement_index_key;
+	achievement->index_build = achievement_index_build;
+	achievement->index_clear = achievement_index_clear;
+	achievement->validate_objective = achievement_validate_objective;
 	achievement->validate_type = achievement_validate_type;
 	/* */
 	achievement->validate_mob_kill = achievement_validate_mob_kill;
@@ -207,16 +207,32 @@ struct achievement_data {
 		|| (s) ==  SP_LUK \
 		|| (s) ==  SP_BASELEVEL || (s) ==  SP_JOBLEVEL )
 
+/** Objective of an achievement, as listed in an achievement_type_index. */
+struct achievement_objective_ref {
+	int pos;       ///< Index of the achievement in achievement->category[type].
+	int objective; ///< Index of the objective in the achievement.
+};
+
+VECTOR_STRUCT_DECL(achievement_objective_refs, struct achievement_objective_ref);
+
+/** Objectives of one achievement type, indexed by their criteria (@see achievement_index_key). */
+struct achievement_type_index {
+	struct DBMap *keyed; ///< int key -> struct achievement_objective_refs *
+	struct achievement_objective_refs any; ///< Objectives matching any key, in database order.
+};
+
 struct achievement_interface {
 	struct DBMap *db; // int id -> struct achievement_data *
 	/* */
 	VECTOR_DECL(int) rank_exp; // Achievement Rank Exp Requirements
 	VECTOR_DECL(int) category[ACH_TYPE_MAX]; /* A collection of Ids per type for faster processing. */
+	struct achievement_type_index index[ACH_TYPE_MAX]; /* Objectives per type, by criteria value. */
 	/* */
 	void (*init) (bool minimal);
 	void (*final) (void);
 	/* */
 	int (*db_finalize) (union DBKey key, struct DBData *data, va_list args);
+	int (*index_finalize) (union DBKey key, struct DBData *data, va_list args);
 	/* */
 	void (*readdb)(void);
 	/* */
@@ -251,6 +267,10 @@ struct achievement_interface {
 	bool (*check_criteria) (const struct achievement_objective *objective, const struct achievement_objective *criteria);
 	/* */
 	bool (*validate) (struct map_session_data *sd, int aid, unsigned int obj_idx, int progress, bool additive);
+	bool (*index_key) (enum achievement_types type, const struct achievement_objective *objective, bool is_criteria, int *key);
+	void (*index_build) (void);
+	void (*index_clear) (void);
+	int (*validate_objective) (struct map_session_data *sd, const struct achievement_data *ad, int obj_idx, const struct achievement_objective *criteria, bool additive);
 	int (*validate_type) (struct map_session_data *sd, enum achievement_types type, const struct achievement_objective *criteria, bool additive);
 	/* */
 	void (*validate_mob_kill) (struct map_session_data *sd, int mob_id);
@@ -7911,6 +7911,7 @@ static const struct config_data_old battle_data[] = {
 	{ "features/goldpc/enable",             &battle_config.feature_goldpc_enable,           0,      0,      1,              },
 	{ "features/goldpc/default_mode",       &battle_config.feature_goldpc_default_mode,     1,      0,      INT_MAX,        },
 	{ "venom_dust_exp",                     &battle_config.venom_dust_exp,                  0,      0,      1,              },
+	{ "path_region_cache",                  &battle_config.path_region_cache,               1,      0,      1,              },
 };
 
 static bool battle_set_value_sub(int index, int value)
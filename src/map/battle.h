@@ -652,6 +652,8 @@ struct Battle_Config {
 	int feature_goldpc_default_mode;
 
 	int venom_dust_exp; // Enable exp given by venom dust
+
+	int path_region_cache;
 };
 
 /* criteria for battle_config.idletime_criteria */
@@ -42,6 +42,7 @@
 #include "common/HPM.h"
 #include "common/cbasetypes.h"
 #include "common/ers.h"
+#include "common/grfio.h"
 #include "common/mapcharpackets.h"
 #include "common/memmgr.h"
 #include "common/msgtable.h"
@@ -113,6 +114,9 @@ static bool chrif_auth_delete(int account_id, int char_id, enum sd_state state)
 			if( node->sd->regs.arrays )
 				node->sd->regs.arrays->destroy(node->sd->regs.arrays, script->array_free_db);
 
+			if (node->sd->status_base != NULL)
+				aFree(node->sd->status_base);
+
 			aFree(node->sd);
 		}
 
@@ -271,14 +275,7 @@ static bool chrif_save(struct map_session_data *sd, int flag)
 	if (sd->vars_dirty)
 		intif->saveregistry(sd);
 
-	WFIFOHEAD(chrif->fd, sizeof(sd->status) + 13);
-	WFIFOW(chrif->fd,0) = 0x2b01;
-	WFIFOW(chrif->fd,2) = sizeof(sd->status) + 13;
-	WFIFOL(chrif->fd,4) = sd->status.account_id;
-	WFIFOL(chrif->fd,8) = sd->status.char_id;
-	WFIFOB(chrif->fd,12) = (flag==1)?1:0; //Flag to tell char-server this character is quitting.
-	memcpy(WFIFOP(chrif->fd,13), &sd->status, sizeof(sd->status));
-	WFIFOSET(chrif->fd, WFIFOW(chrif->fd,2));
+	chrif->save_status(sd, flag, false);
 
 	if( sd->status.pet_id > 0 && sd->pd )
 		intif->save_petdata(sd->status.account_id,&sd->pd->pet);
@@ -299,6 +296,115 @@ static bool chrif_save(struct map_session_data *sd, int flag)
 	return true;
 }
 
+/**
+ * Sends a character's status to the char-server for saving.
+ *
+ * While the char-server holds the status last sent for this character,
+ * only the blocks of CHRIF_SAVE_DELTA_BLOCK bytes that changed since
+ * then are sent (0x2b04), along with a checksum of the whole status.
+ * The char-server applies them to its cached copy and answers with
+ * 0x2b05 if the result does not match, so a full save (0x2b01) is sent.
+ *
+ * @param sd   Character to save.
+ * @param flag 1 if the character is quitting.
+ * @param full Whether to send the whole status.
+ */
+static void chrif_save_status(struct map_session_data *sd, int flag, bool full)
+{
+	const int full_len = sizeof(sd->status) + 13;
+	const uint8 *cur, *base;
+	int fd = chrif->fd;
+	int pos = 19;
+	int offset, length;
+
+	nullpo_retv(sd);
+
+	if (!full && (sd->status_base == NULL || sd->status_base_epoch != chrif->save_epoch))
+		full = true;
+
+	if (!full) {
+		cur = (const uint8 *)&sd->status;
+		base = (const uint8 *)sd->status_base;
+
+		// worst case: every other block changed
+		WFIFOHEAD(fd, full_len + (sizeof(sd->status) / CHRIF_SAVE_DELTA_BLOCK / 2 + 1) * 4 + 6);
+		for (offset = 0; offset < (int)sizeof(sd->status) && pos < full_len; offset += length) {
+			int end;
+
+			length = min(CHRIF_SAVE_DELTA_BLOCK, (int)sizeof(sd->status) - offset);
+			if (memcmp(cur + offset, base + offset, length) == 0)
+				continue;
+
+			// merge the following changed blocks into this range
+			for (end = offset + length; end < (int)sizeof(sd->status); end += CHRIF_SAVE_DELTA_BLOCK) {
+				int block = min(CHRIF_SAVE_DELTA_BLOCK, (int)sizeof(sd->status) - end);
+				if (memcmp(cur + end, base + end, block) == 0)
+					break;
+			}
+			end = min(end, (int)sizeof(sd->status));
+			length = end - offset;
+
+			WFIFOW(fd,pos) = offset;
+			WFIFOW(fd,pos+2) = length;
+			memcpy(WFIFOP(fd,pos+4), cur + offset, length);
+			pos += 4 + length;
+		}
+		if (pos >= full_len)
+			full = true; // no smaller than a full save
+	}
+
+	if (full) {
+		WFIFOHEAD(fd, full_len);
+		WFIFOW(fd,0) = 0x2b01;
+		WFIFOW(fd,2) = full_len;
+		WFIFOL(fd,4) = sd->status.account_id;
+		WFIFOL(fd,8) = sd->status.char_id;
+		WFIFOB(fd,12) = (flag==1)?1:0; //Flag to tell char-server this character is quitting.
+		memcpy(WFIFOP(fd,13), &sd->status, sizeof(sd->status));
+		WFIFOSET(fd, full_len);
+	} else {
+		WFIFOW(fd,0) = 0x2b04;
+		WFIFOW(fd,2) = pos;
+		WFIFOL(fd,4) = sd->status.account_id;
+		WFIFOL(fd,8) = sd->status.char_id;
+		WFIFOB(fd,12) = (flag==1)?1:0; //Flag to tell char-server this character is quitting.
+		WFIFOL(fd,13) = (uint32)grfio->crc32((const unsigned char *)&sd->status, sizeof(sd->status));
+		WFIFOW(fd,17) = sizeof(sd->status);
+		WFIFOSET(fd, pos);
+	}
+
+	if (sd->status_base == NULL)
+		sd->status_base = aMalloc(sizeof(*sd->status_base));
+	memcpy(sd->status_base, &sd->status, sizeof(*sd->status_base));
+	sd->status_base_epoch = chrif->save_epoch;
+}
+
+/**
+ * The char-server could not apply a delta save (0x2b05), resend the
+ * character's whole status.
+ */
+static void chrif_save_full_req(int fd)
+{
+	int account_id = RFIFOL(fd,2);
+	int char_id = RFIFOL(fd,6);
+	struct map_session_data *sd = map->id2sd(account_id);
+	int flag = 0;
+
+	if (sd == NULL || sd->status.char_id != char_id) {
+		struct auth_node *node = chrif->search(account_id);
+
+		if (node == NULL || node->char_id != char_id || node->sd == NULL) {
+			ShowError("chrif_save_full_req: Character %d:%d is gone, its last changes were not saved.\n", account_id, char_id);
+			return;
+		}
+		sd = node->sd;
+		if (node->state == ST_LOGOUT)
+			flag = 1;
+	}
+
+	chrif->save_status(sd, flag, true);
+}
+
 // connects to char-server (plaintext)
 static void chrif_connect(int fd)
 {
@@ -404,6 +510,9 @@ static void chrif_on_ready(void)
 
 	chrif->state = 2;
 
+	// the char-server may have lost its cached status, start over with full saves
+	chrif->save_epoch++;
+
 	chrif->check_shutdown();
 
 	//If there are players online, send them to the char-server. [Skotlex]
@@ -540,6 +649,12 @@ static void chrif_authok(int fd)
 		node->char_id == char_id &&
 		node->login_id1 == login_id1 )
 	{ //Auth Ok
+		// what the char-server has cached, the base of the first delta save
+		if (sd->status_base == NULL)
+			sd->status_base = aMalloc(sizeof(*sd->status_base));
+		memcpy(sd->status_base, charstatus, sizeof(*sd->status_base));
+		sd->status_base_epoch = chrif->save_epoch;
+
 		if (pc->authok(sd, login_id2, expiration_time, group_id, charstatus, changing_mapservers))
 			return;
 	} else { //Auth Failed
@@ -1374,6 +1489,7 @@ static int chrif_parse(int fd)
 			case 0x2afd: chrif->authok(fd); break;
 			case 0x2b00: map->setusers(RFIFOL(fd,2)); chrif->keepalive(fd); break;
 			case 0x2b03: clif->charselectok(RFIFOL(fd,2), RFIFOB(fd,6)); break;
+			case 0x2b05: chrif->save_full_req(fd); break;
 			case 0x2b09: map->addnickdb(RFIFOL(fd,2), RFIFOP(fd,6)); break;
 			case 0x2b0a: sockt->datasync(fd, false); break;
 			case 0x2b0d: chrif->changedsex(fd); break;
@@ -1554,6 +1670,9 @@ static int auth_db_final(union DBKey key, struct DBData *data, va_list ap)
 		if( node->sd->regs.arrays )
 			node->sd->regs.arrays->destroy(node->sd->regs.arrays, script->array_free_db);
 
+		if (node->sd->status_base != NULL)
+			aFree(node->sd->status_base);
+
 		aFree(node->sd);
 	}
 	ers_free(chrif->auth_db_ers, node);
@@ -1621,6 +1740,7 @@ void chrif_defaults(void)
 	memset(chrif->userid,0,sizeof(chrif->userid));
 	memset(chrif->passwd,0,sizeof(chrif->passwd));
 	chrif->state = 0;
+	chrif->save_epoch = 0;
 
 	/* */
 	chrif->auth_db = NULL;
@@ -1648,6 +1768,8 @@ void chrif_defaults(void)
 	chrif->authok = chrif_authok;
 	chrif->scdata_request = chrif_scdata_request;
 	chrif->save = chrif_save;
+	chrif->save_status = chrif_save_status;
+	chrif->save_full_req = chrif_save_full_req;
 	chrif->charselectreq = chrif_charselectreq;
 
 	chrif->searchcharid = chrif_searchcharid;
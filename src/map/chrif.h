@@ -37,6 +37,9 @@ struct status_change_entry;
 //Interval at which map server sends number of connected users. [Skotlex]
 #define UPDATE_INTERVAL 10000
 
+/// Granularity (bytes) of the changes sent by delta character saves.
+#define CHRIF_SAVE_DELTA_BLOCK 32
+
 /**
  * Enumerations
  **/
@@ -78,6 +81,7 @@ struct chrif_interface {
 	uint16 port;
 	char userid[NAME_LENGTH], passwd[NAME_LENGTH];
 	int state;
+	unsigned int save_epoch; ///< Bumped on every char-server connection, invalidates the bases of delta saves.
 	/* */
 	void (*init) (bool minimal);
 	void (*final) (void);
@@ -100,6 +104,8 @@ struct chrif_interface {
 	void (*authok) (int fd);
 	bool (*scdata_request) (int account_id, int char_id);
 	bool (*save) (struct map_session_data* sd, int flag);
+	void (*save_status) (struct map_session_data *sd, int flag, bool full);
+	void (*save_full_req) (int fd);
 	bool (*charselectreq) (struct map_session_data* sd, uint32 s_ip);
 
 	bool (*searchcharid) (int char_id);
@@ -336,6 +336,27 @@ static unsigned char clif_bl_type(struct block_list *bl)
 	return CLUT_UNKNOWN;
 }
 
+/**
+ * Checks whether an area packet may be skipped for a congested client
+ * (WFIFOCONGESTED). Only cosmetic packets are, the client's view of the
+ * map doesn't depend on them.
+ *
+ * @param packet_type The packet id.
+ * @retval true if the packet can be dropped.
+ */
+static bool clif_send_droppable(int packet_type)
+{
+	switch (packet_type) {
+		case 0x8d: // ZC_NOTIFY_CHAT
+		case 0xc0: // ZC_EMOTION
+		case 0x19b: // ZC_NOTIFY_EFFECT
+		case 0x1f3: // ZC_NOTIFY_EFFECT2
+		case HEADER_ZC_NOTIFY_EFFECT3:
+			return true;
+	}
+	return false;
+}
+
 /*==========================================
  * sub process of clif_send
  * Called from a map_foreachinarea (grabs all players in specific area and subjects them to this function)
@@ -350,6 +371,7 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
 {
 	struct block_list *src_bl;
 	struct map_session_data *sd;
+	struct socket_shared_buffer **sbuf;
 	void *buf;
 	int len, type, fd;
 
@@ -365,6 +387,11 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
 	len = va_arg(ap,int);
 	nullpo_ret(src_bl = va_arg(ap,struct block_list*));
 	type = va_arg(ap,int);
+	sbuf = va_arg(ap, struct socket_shared_buffer **);
+
+	// Don't add to the backlog of a client that can't keep up
+	if (WFIFOCONGESTED(fd) && clif->send_droppable(WBUFW(buf, 0)))
+		return 0;
 
 	switch(type) {
 		case AREA_WOS:
@@ -407,14 +434,14 @@ static int clif_send_sub(struct block_list *bl, va_list ap)
 	if( clif->ally_only && !sd->sc.data[SC_CLAIRVOYANCE] && !sd->special_state.intravision && battle->check_target( src_bl, &sd->bl, BCT_ENEMY ) > 0 )
 		return 0;
 
-	return clif->send_actual(fd, buf, len);
+	return clif->send_shared(fd, buf, len, sbuf);
 }
 
 static int clif_send_actual(int fd, void *buf, int len)
 {
 	nullpo_retr(0, buf);
-	WFIFOHEAD(fd, len);
-	if (WFIFOP(fd,0) == buf) {
+	// checked before WFIFOHEAD, which may move the buffer and leave buf dangling
+	if (sockt->session_is_valid(fd) && WFIFOP(fd,0) == buf) {
 		ShowError("WARNING: Invalid use of clif->send function\n");
 		ShowError("         Packet x%4x use a WFIFO of a player instead of to use a buffer.\n", WBUFW(buf,0));
 		ShowError("         Please correct your code.\n");
@@ -424,12 +451,39 @@ static int clif_send_actual(int fd, void *buf, int len)
 		return 0;
 	}
 
+	WFIFOHEAD(fd, len);
 	memcpy(WFIFOP(fd,0), buf, len);
 	WFIFOSET(fd,len);
 
 	return 0;
 }
 
+/**
+ * Sends a packet to one of the recipients of a broadcast.
+ *
+ * Large packets are written once into a shared buffer (created on the first
+ * recipient), which is then queued by reference to every recipient instead
+ * of being copied into each WFIFO. Small packets are copied with
+ * clif->send_actual.
+ *
+ * @param fd   The recipient's session.
+ * @param buf  The packet.
+ * @param len  The packet length.
+ * @param sbuf The broadcast's shared buffer, NULL until created. Released by the caller.
+ */
+static int clif_send_shared(int fd, const void *buf, int len, struct socket_shared_buffer **sbuf)
+{
+	nullpo_ret(buf);
+	nullpo_ret(sbuf);
+
+	if (len < WFIFO_SHARED_MIN_LEN)
+		return clif->send_actual(fd, (void *)buf, len);
+
+	if (*sbuf == NULL)
+		*sbuf = sockt->shared_buffer_create(buf, len);
+	return sockt->wfifoshare(fd, *sbuf);
+}
+
 /*==========================================
  * Packet Delegation (called on all packets that require data to be sent to more than one client)
  * functions that are sent solely to one use whose ID it posses use WFIFOSET
@@ -448,6 +502,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 	struct battleground_data *bgd = NULL;
 	int x0 = 0, x1 = 0, y0 = 0, y1 = 0, fd;
 	struct s_mapiterator* iter;
+	struct socket_shared_buffer *sbuf = NULL; // shared copy of the packet, created on demand
 	int area_size;
 
 	if (sd != NULL && pc_isinvisible(sd)) {
@@ -461,9 +516,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 		case ALL_CLIENT: //All player clients.
 			iter = mapit_getallusers();
 			while ((tsd = BL_UCAST(BL_PC, mapit->next(iter))) != NULL) {
-				WFIFOHEAD(tsd->fd, len);
-				memcpy(WFIFOP(tsd->fd,0), buf, len);
-				WFIFOSET(tsd->fd,len);
+				clif->send_shared(tsd->fd, buf, len, &sbuf);
 			}
 			mapit->free(iter);
 			break;
@@ -472,9 +525,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 			iter = mapit_getallusers();
 			while ((tsd = BL_UCAST(BL_PC, mapit->next(iter))) != NULL) {
 				if (bl && bl->m == tsd->bl.m) {
-					WFIFOHEAD(tsd->fd, len);
-					memcpy(WFIFOP(tsd->fd,0), buf, len);
-					WFIFOSET(tsd->fd,len);
+					clif->send_shared(tsd->fd, buf, len, &sbuf);
 				}
 			}
 			mapit->free(iter);
@@ -494,12 +545,12 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 				area_size = AREA_SIZE;
 			nullpo_retr(true, bl);
 			map->foreachinarea(clif->send_sub, bl->m, bl->x - area_size, bl->y - area_size, bl->x + area_size, bl->y + area_size,
-				BL_PC, buf, len, bl, type);
+				BL_PC, buf, len, bl, type, &sbuf);
 			break;
 		case AREA_CHAT_WOC:
 			nullpo_retr(true, bl);
 			map->foreachinarea(clif->send_sub, bl->m, bl->x-CHAT_AREA_SIZE, bl->y-CHAT_AREA_SIZE,
-			                   bl->x+CHAT_AREA_SIZE, bl->y+CHAT_AREA_SIZE, BL_PC, buf, len, bl, AREA_WOC);
+			                   bl->x+CHAT_AREA_SIZE, bl->y+CHAT_AREA_SIZE, BL_PC, buf, len, bl, AREA_WOC, &sbuf);
 			break;
 
 		case CHAT:
@@ -518,9 +569,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 					if (type == CHAT_WOS && cd->usersd[i] == sd)
 						continue;
 					if ((fd=cd->usersd[i]->fd) >0 && sockt->session[fd]) { // Added check to see if session exists [PoW]
-						WFIFOHEAD(fd,len);
-						memcpy(WFIFOP(fd,0), buf, len);
-						WFIFOSET(fd,len);
+						clif->send_shared(fd, buf, len, &sbuf);
 					}
 				}
 			}
@@ -558,9 +607,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 					if( (type == PARTY_AREA || type == PARTY_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 						continue;
 
-					WFIFOHEAD(fd,len);
-					memcpy(WFIFOP(fd,0), buf, len);
-					WFIFOSET(fd,len);
+					clif->send_shared(fd, buf, len, &sbuf);
 				}
 				if (!map->enable_spy) //Skip unnecessary parsing. [Skotlex]
 					break;
@@ -568,9 +615,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 				iter = mapit_getallusers();
 				while ((tsd = BL_UCAST(BL_PC, mapit->next(iter))) != NULL) {
 					if( tsd->partyspy == p->party.party_id ) {
-						WFIFOHEAD(tsd->fd, len);
-						memcpy(WFIFOP(tsd->fd,0), buf, len);
-						WFIFOSET(tsd->fd,len);
+						clif->send_shared(tsd->fd, buf, len, &sbuf);
 					}
 				}
 				mapit->free(iter);
@@ -586,9 +631,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 				if( type == DUEL_WOS && bl->id == tsd->bl.id )
 					continue;
 				if( sd->duel_group == tsd->duel_group ) {
-					WFIFOHEAD(tsd->fd, len);
-					memcpy(WFIFOP(tsd->fd,0), buf, len);
-					WFIFOSET(tsd->fd,len);
+					clif->send_shared(tsd->fd, buf, len, &sbuf);
 				}
 			}
 			mapit->free(iter);
@@ -636,9 +679,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 
 						if( (type == GUILD_AREA || type == GUILD_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 							continue;
-						WFIFOHEAD(fd,len);
-						memcpy(WFIFOP(fd,0), buf, len);
-						WFIFOSET(fd,len);
+						clif->send_shared(fd, buf, len, &sbuf);
 					}
 				}
 				if (!map->enable_spy) //Skip unnecessary parsing. [Skotlex]
@@ -647,9 +688,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 				iter = mapit_getallusers();
 				while ((tsd = BL_UCAST(BL_PC, mapit->next(iter))) != NULL) {
 					if( tsd->guildspy == g->guild_id ) {
-						WFIFOHEAD(tsd->fd, len);
-						memcpy(WFIFOP(tsd->fd,0), buf, len);
-						WFIFOSET(tsd->fd,len);
+						clif->send_shared(tsd->fd, buf, len, &sbuf);
 					}
 				}
 				mapit->free(iter);
@@ -678,9 +717,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 						continue;
 					if( (type == BG_AREA || type == BG_AREA_WOS) && (sd->bl.x < x0 || sd->bl.y < y0 || sd->bl.x > x1 || sd->bl.y > y1) )
 						continue;
-					WFIFOHEAD(fd,len);
-					memcpy(WFIFOP(fd,0), buf, len);
-					WFIFOSET(fd,len);
+					clif->send_shared(fd, buf, len, &sbuf);
 				}
 			}
 			break;
@@ -693,9 +730,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 					struct map_session_data *qsd = map->id2sd(VECTOR_INDEX(queue->entries, i));
 
 					if (qsd != NULL) {
-						WFIFOHEAD(qsd->fd,len);
-						memcpy(WFIFOP(qsd->fd,0), buf, len);
-						WFIFOSET(qsd->fd,len);
+						clif->send_shared(qsd->fd, buf, len, &sbuf);
 					}
 				}
 			}
@@ -710,9 +745,7 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 				for (i = 0; i < VECTOR_LENGTH(c->members); i++) {
 					if (VECTOR_INDEX(c->members, i).online == 0 || (sd = VECTOR_INDEX(c->members, i).sd) == NULL || (fd = sd->fd) <= 0)
 						continue;
-					WFIFOHEAD(fd, len);
-					memcpy(WFIFOP(fd, 0), buf, len);
-					WFIFOSET(fd, len);
+					clif->send_shared(fd, buf, len, &sbuf);
 				}
 			}
 			break;
@@ -722,6 +755,9 @@ static bool clif_send(const void *buf, int len, struct block_list *bl, enum send
 			return false;
 	}
 
+	if (sbuf != NULL)
+		sockt->shared_buffer_release(sbuf);
+
 	return true;
 }
 
@@ -26574,8 +26610,10 @@ void clif_defaults(void)
 	clif->setport = clif_setport;
 	clif->refresh_ip = clif_refresh_ip;
 	clif->send = clif_send;
+	clif->send_droppable = clif_send_droppable;
 	clif->send_sub = clif_send_sub;
 	clif->send_actual = clif_send_actual;
+	clif->send_shared = clif_send_shared;
 	clif->parse = clif_parse;
 	clif->parse_cmd = clif_parse_cmd_optional;
 	clif->decrypt_cmd = clif_decrypt_cmd;
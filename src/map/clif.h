@@ -52,6 +52,7 @@ struct pet_data;
 struct quest;
 struct s_vending;
 struct skill_cd;
+struct socket_shared_buffer;
 struct skill_unit;
 struct unit_data;
 struct view_data;
@@ -957,8 +958,10 @@ struct clif_interface {
 	void (*setport) (uint16 port);
 	uint32 (*refresh_ip) (void);
 	bool (*send) (const void* buf, int len, struct block_list* bl, enum send_target type);
+	bool (*send_droppable) (int packet_type);
 	int (*send_sub) (struct block_list *bl, va_list ap);
 	int (*send_actual) (int fd, void *buf, int len);
+	int (*send_shared) (int fd, const void *buf, int len, struct socket_shared_buffer **sbuf);
 	int (*parse) (int fd);
 	const struct s_packet_db *(*packet) (int packet_id);
 	unsigned short (*parse_cmd) ( int fd, struct map_session_data *sd );
@@ -29,6 +29,7 @@
 #include "map/map.h"
 #include "map/npc.h"
 #include "map/party.h"
+#include "map/path.h"
 #include "map/pc.h"
 #include "map/quest.h"
 #include "common/HPM.h"
@@ -191,7 +192,6 @@ static int instance_add_map(const char *name, int instance_id, bool usebasename,
 {
 	int16 m = map->mapname2mapid(name);
 	int i, im = MAPID_NONE;
-	size_t num_cell, size, j;
 
 	nullpo_retr(-1, name);
 
@@ -235,6 +235,7 @@ static int instance_add_map(const char *name, int instance_id, bool usebasename,
 	map->list[im].index = mapindex->addmap(-1, map->list[im].name); // Add map index
 
 	map->list[im].channel = NULL;
+	map->list[im].path_region = NULL;
 
 	if( !map->list[im].index ) {
 		map->list[im].name[0] = '\0';
@@ -242,25 +243,10 @@ static int instance_add_map(const char *name, int instance_id, bool usebasename,
 		return -3; // No free map index
 	}
 
-	// Reallocate cells
-	num_cell = map->list[im].xs * map->list[im].ys;
-	CREATE( map->list[im].cell, struct mapcell, num_cell );
-	memcpy( map->list[im].cell, map->list[m].cell, num_cell * sizeof(struct mapcell) );
+	// Share the source map's cells, blocks are copied when they change
+	map->cell_share(&map->list[im], &map->list[m]);
 
-	// Appropriately clear cell data
-	for(j = 0; j < num_cell; j++) {
-#ifdef CELL_NOSTACK
-		map->list[im].cell[j].cell_bl = 0;
-#endif // CELL_NOSTACK
-		map->list[im].cell[j].basilica = 0;
-		map->list[im].cell[j].icewall = 0;
-		map->list[im].cell[j].npc = 0;
-		map->list[im].cell[j].landprotector = 0;
-	}
-
-	size = map->list[im].bxs * map->list[im].bys * sizeof(struct block_list*);
-	map->list[im].block = (struct block_list**)aCalloc(1, size);
-	map->list[im].block_mob = (struct block_list**)aCalloc(1, size);
+	map->alloc_blocks(&map->list[im]);
 
 	memset(map->list[im].npc, 0x00, sizeof(map->list[i].npc));
 	map->list[im].npc_num = 0;
@@ -497,9 +483,9 @@ static void instance_del_map(int16 m)
 	mapindex->removemap(map_id2index(m));
 
 	// Free memory
-	aFree(map->list[m].cell);
-	aFree(map->list[m].block);
-	aFree(map->list[m].block_mob);
+	map->cell_free(&map->list[m]);
+	map->free_blocks(&map->list[m]);
+	path->region_clear(&map->list[m]);
 
 	if (map->list[m].unit_count && map->list[m].units) {
 		for(i = 0; i < map->list[m].unit_count; i++) {
@@ -81,30 +81,20 @@ static int itemdb_searchname_sub(union DBKey key, struct DBData *data, va_list a
  *------------------------------------------*/
 static struct item_data *itemdb_searchname(const char *str)
 {
-	struct item_data* item;
-	struct item_data* item2=NULL;
-	int i;
+	struct item_data *item;
 
 	nullpo_retr(NULL, str);
-	for( i = 0; i < ARRAYLENGTH(itemdb->array); ++i ) {
-		item = itemdb->array[i];
-		if( item == NULL )
-			continue;
 
-		// Absolute priority to Aegis code name.
-		if ( battle_config.case_sensitive_aegisnames && strcmp(item->name,str) == 0 )
-			return item;
-		else if ( !battle_config.case_sensitive_aegisnames && strcasecmp(item->name,str) == 0 )
-			return item;
-
-		//Second priority to Client displayed name.
-		if (!item2 && strcasecmp(item->jname,str) == 0)
-			item2 = item;
-	}
+	// Absolute priority to Aegis code name.
+	if (battle_config.case_sensitive_aegisnames)
+		item = strdb_get(itemdb->name_index, str);
+	else
+		item = strdb_get(itemdb->name_index_ci, str);
+	if (item != NULL)
+		return item;
 
-	item = NULL;
-	itemdb->other->foreach(itemdb->other,itemdb->searchname_sub,str,&item,&item2);
-	return item?item:item2;
+	//Second priority to Client displayed name.
+	return strdb_get(itemdb->jname_index_ci, str);
 }
 /* name to item data */
 static struct item_data *itemdb_name2id(const char *str)
@@ -112,6 +102,28 @@ static struct item_data *itemdb_name2id(const char *str)
 	return strdb_get(itemdb->names,str);
 }
 
+/**
+ * Checks whether an item name matches a search string.
+ * @param itd item to check
+ * @param str string used in this search
+ * @param flag search mode refer to enum item_name_search_flag for possible values
+ * @return true if the AegisName or client name matches
+ **/
+static bool itemdb_searchname_match(const struct item_data *itd, const char *str, enum item_name_search_flag flag)
+{
+	nullpo_retr(false, itd);
+	nullpo_retr(false, str);
+
+	if (flag == IT_SEARCH_NAME_PARTIAL)
+		return (stristr(itd->jname, str) != NULL
+			|| (battle_config.case_sensitive_aegisnames && strstr(itd->name, str))
+			|| (!battle_config.case_sensitive_aegisnames && stristr(itd->name, str)));
+
+	return (strcmp(itd->jname, str) == 0
+		|| (battle_config.case_sensitive_aegisnames && strcmp(itd->name, str) == 0)
+		|| (!battle_config.case_sensitive_aegisnames && strcasecmp(itd->name, str) == 0));
+}
+
 /**
  * @see DBMatcher
  */
@@ -126,23 +138,7 @@ static int itemdb_searchname_array_sub(union DBKey key, struct DBData data, va_l
 	if (itd == &itemdb->dummy)
 		return 1; //Invalid item.
 
-	if (
-		(flag == IT_SEARCH_NAME_PARTIAL
-		 && (stristr(itd->jname, str) != NULL
-			 || (battle_config.case_sensitive_aegisnames && strstr(itd->name, str))
-			 || (!battle_config.case_sensitive_aegisnames && stristr(itd->name, str))
-			 ))
-		|| (flag == IT_SEARCH_NAME_EXACT
-			&& (strcmp(itd->jname, str) == 0
-				|| (battle_config.case_sensitive_aegisnames && strcmp(itd->name, str) == 0)
-				|| (!battle_config.case_sensitive_aegisnames && strcasecmp(itd->name, str) == 0)
-				))
-		) {
-
-		return 0;
-	} else {
-		return 1;
-	}
+	return itemdb->searchname_match(itd, str, flag) ? 0 : 1;
 }
 
 /**
@@ -164,25 +160,33 @@ static int itemdb_searchname_array(struct item_data **data, const int size, cons
 		results_count = 0,
 		length = 0;
 
-	// Search in array
+	// Only the items sharing the rarest trigram of str can match it.
+	const struct trigram_entry *entries = NULL;
+	int entry_count = trigram_find(&itemdb->name_trigrams, str, &entries);
+	if (entry_count >= 0) {
+		for (int i = 0; i < entry_count; ++i) {
+			struct item_data *itd = itemdb->exists(entries[i].id);
+
+			if (itd == NULL || !itemdb->searchname_match(itd, str, flag))
+				continue;
+
+			if (length < size) {
+				data[length] = itd;
+				++length;
+			}
+			++results_count;
+		}
+		return results_count;
+	}
+
+	// Search string is too short for the index, search in array
 	for (int i = 0; i < ARRAYLENGTH(itemdb->array); ++i) {
 		struct item_data *itd = itemdb->array[i];
 
 		if (itd == NULL)
 			continue;
 
-		if (
-			(flag == IT_SEARCH_NAME_PARTIAL
-			 && (stristr(itd->jname, str) != NULL
-				 || (battle_config.case_sensitive_aegisnames && strstr(itd->name, str))
-				 || (!battle_config.case_sensitive_aegisnames && stristr(itd->name, str))
-				 ))
-			|| (flag == IT_SEARCH_NAME_EXACT
-				&& (strcmp(itd->jname, str) == 0
-					|| (battle_config.case_sensitive_aegisnames && strcmp(itd->name, str) == 0)
-					|| (!battle_config.case_sensitive_aegisnames && strcasecmp(itd->name, str) == 0)
-					))
-			) {
+		if (itemdb->searchname_match(itd, str, flag)) {
 			if (length < size) {
 				data[length] = itd;
 				++length;
@@ -3015,6 +3019,8 @@ static void itemdb_read(bool minimal)
 
 	itemdb->other->foreach(itemdb->other, itemdb->addname_sub);
 
+	itemdb->index_build();
+
 	itemdb->read_options();
 
 	if (minimal)
@@ -3049,6 +3055,78 @@ static int itemdb_addname_sub(union DBKey key, struct DBData *data, va_list ap)
 	return 0;
 }
 
+/**
+ * Adds an item to the name lookup indexes.
+ * Items must be added in increasing nameid order so that the lowest nameid keeps a shared name.
+ * @param item the item to index
+ */
+static void itemdb_index_add(struct item_data *item)
+{
+	nullpo_retv(item);
+
+	if (strdb_get(itemdb->name_index, item->name) == NULL)
+		strdb_put(itemdb->name_index, item->name, item);
+	if (strdb_get(itemdb->name_index_ci, item->name) == NULL)
+		strdb_put(itemdb->name_index_ci, item->name, item);
+	if (strdb_get(itemdb->jname_index_ci, item->jname) == NULL)
+		strdb_put(itemdb->jname_index_ci, item->jname, item);
+
+	trigram_add(&itemdb->name_trigrams, item->nameid, item->name);
+	trigram_add(&itemdb->name_trigrams, item->nameid, item->jname);
+}
+
+static int itemdb_index_cmp(const void *a, const void *b)
+{
+	const struct item_data *ia = *(const struct item_data *const *)a;
+	const struct item_data *ib = *(const struct item_data *const *)b;
+
+	return ia->nameid - ib->nameid;
+}
+
+/**
+ * Builds the name lookup indexes from the loaded items.
+ */
+static void itemdb_index_build(void)
+{
+	struct DBIterator *iter;
+	struct item_data *item;
+	struct item_data **other;
+	int i, count = 0;
+
+	itemdb->index_clear();
+
+	for (i = 0; i < ARRAYLENGTH(itemdb->array); ++i) {
+		if (itemdb->array[i] != NULL)
+			itemdb->index_add(itemdb->array[i]);
+	}
+
+	// items with high ids are kept in a hash map, index them in nameid order too
+	CREATE(other, struct item_data *, max(db_size(itemdb->other), 1));
+	iter = db_iterator(itemdb->other);
+	for (item = dbi_first(iter); dbi_exists(iter); item = dbi_next(iter)) {
+		if (item != &itemdb->dummy)
+			other[count++] = item;
+	}
+	dbi_destroy(iter);
+	qsort(other, count, sizeof(other[0]), itemdb_index_cmp);
+	for (i = 0; i < count; ++i)
+		itemdb->index_add(other[i]);
+	aFree(other);
+
+	trigram_build(&itemdb->name_trigrams);
+}
+
+/**
+ * Empties the name lookup indexes.
+ */
+static void itemdb_index_clear(void)
+{
+	db_clear(itemdb->name_index);
+	db_clear(itemdb->name_index_ci);
+	db_clear(itemdb->jname_index_ci);
+	trigram_clear(&itemdb->name_trigrams);
+}
+
 /**
  * retrieves item_combo data by combo id
  **/
@@ -3148,6 +3226,10 @@ static int itemdb_reform_final_sub(union DBKey key, struct DBData *data, va_list
 static void itemdb_clear(bool total)
 {
 	int i;
+
+	// the indexes point into the item data that is about to be freed
+	itemdb->index_clear();
+
 	// clear the previous itemdb data
 	for( i = 0; i < ARRAYLENGTH(itemdb->array); ++i ) {
 		if( itemdb->array[i] )
@@ -3305,6 +3387,9 @@ static void do_final_itemdb(void)
 	itemdb->reform->destroy(itemdb->reform, itemdb->reform_final_sub);
 	itemdb->destroy_item_data(&itemdb->dummy, 0);
 	db_destroy(itemdb->names);
+	db_destroy(itemdb->name_index);
+	db_destroy(itemdb->name_index_ci);
+	db_destroy(itemdb->jname_index_ci);
 	VECTOR_CLEAR(clif->attendance_data);
 }
 
@@ -3315,6 +3400,9 @@ static void do_init_itemdb(bool minimal)
 	itemdb->options = idb_alloc(DB_OPT_RELEASE_DATA);
 	itemdb->reform = idb_alloc(DB_OPT_RELEASE_DATA);
 	itemdb->names = strdb_alloc(DB_OPT_BASE,ITEM_NAME_LENGTH);
+	itemdb->name_index = strdb_alloc(DB_OPT_BASE, ITEM_NAME_LENGTH);
+	itemdb->name_index_ci = stridb_alloc(DB_OPT_BASE, ITEM_NAME_LENGTH);
+	itemdb->jname_index_ci = stridb_alloc(DB_OPT_BASE, ITEM_NAME_LENGTH);
 	itemdb->create_dummy_data(); //Dummy data item.
 	itemdb->read(minimal);
 
@@ -3351,6 +3439,10 @@ void itemdb_defaults(void)
 	itemdb->combo_count = 0;
 	/* */
 	itemdb->names = NULL;
+	itemdb->name_index = NULL;
+	itemdb->name_index_ci = NULL;
+	itemdb->jname_index_ci = NULL;
+	memset(&itemdb->name_trigrams, 0, sizeof(itemdb->name_trigrams));
 	/* */
 	/* itemdb->array is cleared on itemdb->init() */
 	itemdb->other = NULL;
@@ -3379,6 +3471,10 @@ void itemdb_defaults(void)
 	itemdb->package_item = itemdb_package_item;
 	itemdb->searchname_sub = itemdb_searchname_sub;
 	itemdb->searchname_array_sub = itemdb_searchname_array_sub;
+	itemdb->searchname_match = itemdb_searchname_match;
+	itemdb->index_add = itemdb_index_add;
+	itemdb->index_build = itemdb_index_build;
+	itemdb->index_clear = itemdb_index_clear;
 	itemdb->searchrandomid = itemdb_searchrandomid;
 	itemdb->typename = itemdb_typename;
 	itemdb->jobmask2mapid = itemdb_jobmask2mapid;
@@ -25,6 +25,7 @@
 #include "common/hercules.h"
 #include "common/db.h"
 #include "common/mmo.h" // ITEM_NAME_LENGTH
+#include "common/strlib.h" // struct trigram_index
 
 struct config_setting_t;
 struct script_code;
@@ -684,6 +685,11 @@ struct itemdb_interface {
 	unsigned short combo_count;
 	/* */
 	struct DBMap *names;
+	/* name lookup indexes, rebuilt on every read; the lowest nameid wins a name */
+	struct DBMap *name_index; // const char* AegisName -> struct item_data*
+	struct DBMap *name_index_ci; // const char* AegisName (case-insensitive) -> struct item_data*
+	struct DBMap *jname_index_ci; // const char* client name (case-insensitive) -> struct item_data*
+	struct trigram_index name_trigrams; // trigrams of AegisName and client name -> nameid
 	/* */
 	struct item_data *array[MAX_ITEMDB];
 	struct DBMap *other;// int nameid -> struct item_data*
@@ -714,6 +720,10 @@ struct itemdb_interface {
 	void (*package_item) (struct map_session_data *sd, struct item_package *package);
 	int (*searchname_sub) (union DBKey key, struct DBData *data, va_list ap);
 	int (*searchname_array_sub) (union DBKey key, struct DBData data, va_list ap);
+	bool (*searchname_match) (const struct item_data *itd, const char *str, enum item_name_search_flag flag);
+	void (*index_add) (struct item_data *item);
+	void (*index_build) (void);
+	void (*index_clear) (void);
 	int (*searchrandomid) (struct item_group *group);
 	const char* (*typename) (enum item_types type);
 	void (*jobmask2mapid) (uint64 *bclass, uint64 jobmask);
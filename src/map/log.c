@@ -29,11 +29,16 @@
 #include "map/pc.h"
 #include "common/cbasetypes.h"
 #include "common/conf.h"
+#include "common/db.h"
+#include "common/memmgr.h"
 #include "common/nullpo.h"
 #include "common/showmsg.h"
 #include "common/sql.h" // SQL_INNODB
 #include "common/strlib.h"
 #include "common/HPM.h"
+#include "common/mutex.h"
+#include "common/thread.h"
+#include "common/timer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,6 +47,45 @@
 static struct log_interface log_s;
 struct log_interface *logs;
 
+/// Column lists of the SQL log tables, indexed by enum log_sql_table.
+static const char *log_sql_columns[LOG_SQL_TABLE_MAX] = {
+	"`time`, `char_id`, `type`, `nameid`, `amount`, `refine`, `grade`, `card0`, `card1`, `card2`, `card3`, "
+		"`opt_idx0`, `opt_val0`, `opt_idx1`, `opt_val1`, `opt_idx2`, `opt_val2`, `opt_idx3`, `opt_val3`, `opt_idx4`, `opt_val4`, `map`, `unique_id`", // LOG_SQL_PICK
+	"`time`, `char_id`, `src_id`, `type`, `amount`, `map`", // LOG_SQL_ZENY
+	"`mvp_date`, `kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`", // LOG_SQL_MVPDROP
+	"`atcommand_date`, `account_id`, `char_id`, `char_name`, `map`, `command`", // LOG_SQL_ATCOMMAND
+	"`npc_date`, `account_id`, `char_id`, `char_name`, `map`, `mes`", // LOG_SQL_NPC
+	"`time`, `type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`", // LOG_SQL_CHAT
+	"`branch_date`, `account_id`, `char_id`, `char_name`, `map`", // LOG_SQL_BRANCH
+};
+
+/// State of the asynchronous SQL writer (map_log/database/async).
+static struct {
+	struct thread_handle *thread;
+	struct mutex_data *lock;
+	struct cond_data *wake; ///< Signalled when a batch is handed over or on shutdown.
+	struct cond_data *idle; ///< Signalled when the writer finishes a batch.
+	VECTOR_DECL(struct log_sql_row) rows[2]; ///< Queue being filled and batch being written.
+	int pending;            ///< Index in rows of the queue being filled.
+	bool busy;              ///< The writer owns rows[pending^1].
+	bool shutdown;
+	int timer;
+	char header[LOG_SQL_TABLE_MAX][LOG_SQL_HEADER_MAX];
+	char *query;            ///< LOG_SQL_QUERY_MAX bytes, used only by the writer.
+	int errors;             ///< Queries that failed since the last handoff.
+	char error[LOG_SQL_ERROR_MAX]; ///< Start of the last failed query.
+} log_sql;
+
+/// formats the current time as a DATETIME literal for queued rows
+static void log_sql_timestamp(char *out, size_t size)
+{
+	time_t curtime;
+
+	nullpo_retv(out);
+	time(&curtime);
+	strftime(out, size, "%Y-%m-%d %H:%M:%S", localtime(&curtime));
+}
+
 /// obtain log type character for item/zeny logs
 static char log_picktype2char(e_log_pick_type type)
 {
@@ -139,19 +183,18 @@ static bool should_log_item(int nameid, int amount, int refine_level, struct ite
 }
 static void log_branch_sub_sql(struct map_session_data *sd)
 {
-	struct SqlStmt *stmt;
+	StringBuf buf;
+	char timestamp[LOG_SQL_TIMESTAMP_LEN];
+	char esc_name[NAME_LENGTH*2+1];
 
 	nullpo_retv(sd);
-	stmt = SQL->StmtMalloc(logs->mysql_handle);
-	if( SQL_SUCCESS != SQL->StmtPrepare(stmt, LOG_QUERY " INTO `%s` (`branch_date`, `account_id`, `char_id`, `char_name`, `map`) VALUES (NOW(), '%d', '%d', ?, '%s')", logs->config.log_branch, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-	   ||  SQL_SUCCESS != SQL->StmtBindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-	   ||  SQL_SUCCESS != SQL->StmtExecute(stmt) )
-	{
-		SqlStmt_ShowDebug(stmt);
-		SQL->StmtFree(stmt);
-		return;
-	}
-	SQL->StmtFree(stmt);
+	log_sql_timestamp(timestamp, sizeof(timestamp));
+	SQL->EscapeStringLen(logs->mysql_handle, esc_name, sd->status.name, strnlen(sd->status.name, NAME_LENGTH));
+
+	StrBuf->Init(&buf);
+	StrBuf->Printf(&buf, "('%s', '%d', '%d', '%s', '%s')", timestamp, sd->status.account_id, sd->status.char_id, esc_name, mapindex_id2name(sd->mapindex));
+	logs->sql_insert(LOG_SQL_BRANCH, StrBuf->Value(&buf));
+	StrBuf->Destroy(&buf);
 }
 static void log_branch_sub_txt(struct map_session_data *sd)
 {
@@ -180,19 +223,20 @@ static void log_branch(struct map_session_data *sd)
 }
 static void log_pick_sub_sql(int id, int16 m, e_log_pick_type type, int amount, struct item *itm, struct item_data *data)
 {
+	StringBuf buf;
+	char timestamp[LOG_SQL_TIMESTAMP_LEN];
+
 	nullpo_retv(itm);
-	if (SQL_ERROR == SQL->Query(logs->mysql_handle,
-	    LOG_QUERY " INTO `%s` (`time`, `char_id`, `type`, `nameid`, `amount`, `refine`, `grade`, `card0`, `card1`, `card2`, `card3`, "
-		"`opt_idx0`, `opt_val0`, `opt_idx1`, `opt_val1`, `opt_idx2`, `opt_val2`, `opt_idx3`, `opt_val3`, `opt_idx4`, `opt_val4`, `map`, `unique_id`) "
-	    "VALUES (NOW(), '%d', '%c', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%s', '%"PRIu64"')",
-	    logs->config.log_pick, id, logs->picktype2char(type), itm->nameid, amount, itm->refine, itm->grade, itm->card[0], itm->card[1], itm->card[2], itm->card[3],
+	log_sql_timestamp(timestamp, sizeof(timestamp));
+
+	StrBuf->Init(&buf);
+	StrBuf->Printf(&buf, "('%s', '%d', '%c', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%d', '%s', '%"PRIu64"')",
+	    timestamp, id, logs->picktype2char(type), itm->nameid, amount, itm->refine, itm->grade, itm->card[0], itm->card[1], itm->card[2], itm->card[3],
 		itm->option[0].index, itm->option[0].value, itm->option[1].index, itm->option[1].value, itm->option[2].index, itm->option[2].value,
 		itm->option[3].index, itm->option[3].value, itm->option[4].index, itm->option[4].value,
-	    map->list[m].name, itm->unique_id))
-	{
-		Sql_ShowDebug(logs->mysql_handle);
-		return;
-	}
+	    map->list[m].name, itm->unique_id);
+	logs->sql_insert(LOG_SQL_PICK, StrBuf->Value(&buf));
+	StrBuf->Destroy(&buf);
 }
 static void log_pick_sub_txt(int id, int16 m, e_log_pick_type type, int amount, struct item *itm, struct item_data *data)
 {
@@ -241,14 +285,18 @@ static void log_pick_mob(struct mob_data *md, e_log_pick_type type, int amount,
 }
 static void log_zeny_sub_sql(struct map_session_data *sd, e_log_pick_type type, struct map_session_data *src_sd, int amount)
 {
+	StringBuf buf;
+	char timestamp[LOG_SQL_TIMESTAMP_LEN];
+
 	nullpo_retv(sd);
 	nullpo_retv(src_sd);
-	if( SQL_ERROR == SQL->Query(logs->mysql_handle, LOG_QUERY " INTO `%s` (`time`, `char_id`, `src_id`, `type`, `amount`, `map`) VALUES (NOW(), '%d', '%d', '%c', '%d', '%s')",
-							   logs->config.log_zeny, sd->status.char_id, src_sd->status.char_id, logs->picktype2char(type), amount, mapindex_id2name(sd->mapindex)) )
-	{
-		Sql_ShowDebug(logs->mysql_handle);
-		return;
-	}
+	log_sql_timestamp(timestamp, sizeof(timestamp));
+
+	StrBuf->Init(&buf);
+	StrBuf->Printf(&buf, "('%s', '%d', '%d', '%c', '%d', '%s')",
+	    timestamp, sd->status.char_id, src_sd->status.char_id, logs->picktype2char(type), amount, mapindex_id2name(sd->mapindex));
+	logs->sql_insert(LOG_SQL_ZENY, StrBuf->Value(&buf));
+	StrBuf->Destroy(&buf);
 }
 static void log_zeny_sub_txt(struct map_session_data *sd, e_log_pick_type type, struct map_session_data *src_sd, int amount)
 {
@@ -277,14 +325,18 @@ static void log_zeny(struct map_session_data *sd, e_log_pick_type type, struct m
 }
 static void log_mvpdrop_sub_sql(struct map_session_data *sd, int monster_id, int *log_mvp)
 {
+	StringBuf buf;
+	char timestamp[LOG_SQL_TIMESTAMP_LEN];
+
 	nullpo_retv(sd);
 	nullpo_retv(log_mvp);
-	if( SQL_ERROR == SQL->Query(logs->mysql_handle, LOG_QUERY " INTO `%s` (`mvp_date`, `kill_char_id`, `monster_id`, `prize`, `mvpexp`, `map`) VALUES (NOW(), '%d', '%d', '%d', '%d', '%s') ",
-							   logs->config.log_mvpdrop, sd->status.char_id, monster_id, log_mvp[0], log_mvp[1], mapindex_id2name(sd->mapindex)) )
-	{
-		Sql_ShowDebug(logs->mysql_handle);
-		return;
-	}
+	log_sql_timestamp(timestamp, sizeof(timestamp));
+
+	StrBuf->Init(&buf);
+	StrBuf->Printf(&buf, "('%s', '%d', '%d', '%d', '%d', '%s')",
+	    timestamp, sd->status.char_id, monster_id, log_mvp[0], log_mvp[1], mapindex_id2name(sd->mapindex));
+	logs->sql_insert(LOG_SQL_MVPDROP, StrBuf->Value(&buf));
+	StrBuf->Destroy(&buf);
 }
 static void log_mvpdrop_sub_txt(struct map_session_data *sd, int monster_id, int *log_mvp)
 {
@@ -314,21 +366,21 @@ static void log_mvpdrop(struct map_session_data *sd, int monster_id, int *log_mv
 
 static void log_atcommand_sub_sql(struct map_session_data *sd, const char *message)
 {
-	struct SqlStmt *stmt;
+	StringBuf buf;
+	char timestamp[LOG_SQL_TIMESTAMP_LEN];
+	char esc_name[NAME_LENGTH*2+1];
+	char esc_message[255*2+1];
 
 	nullpo_retv(sd);
 	nullpo_retv(message);
-	stmt = SQL->StmtMalloc(logs->mysql_handle);
-	if( SQL_SUCCESS != SQL->StmtPrepare(stmt, LOG_QUERY " INTO `%s` (`atcommand_date`, `account_id`, `char_id`, `char_name`, `map`, `command`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", logs->config.log_gm, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-	   ||  SQL_SUCCESS != SQL->StmtBindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-	   ||  SQL_SUCCESS != SQL->StmtBindParam(stmt, 1, SQLDT_STRING, message, safestrnlen(message, 255))
-	   ||  SQL_SUCCESS != SQL->StmtExecute(stmt) )
-	{
-		SqlStmt_ShowDebug(stmt);
-		SQL->StmtFree(stmt);
-		return;
-	}
-	SQL->StmtFree(stmt);
+	log_sql_timestamp(timestamp, sizeof(timestamp));
+	SQL->EscapeStringLen(logs->mysql_handle, esc_name, sd->status.name, strnlen(sd->status.name, NAME_LENGTH));
+	SQL->EscapeStringLen(logs->mysql_handle, esc_message, message, safestrnlen(message, 255));
+
+	StrBuf->Init(&buf);
+	StrBuf->Printf(&buf, "('%s', '%d', '%d', '%s', '%s', '%s')", timestamp, sd->status.account_id, sd->status.char_id, esc_name, mapindex_id2name(sd->mapindex), esc_message);
+	logs->sql_insert(LOG_SQL_ATCOMMAND, StrBuf->Value(&buf));
+	StrBuf->Destroy(&buf);
 }
 static void log_atcommand_sub_txt(struct map_session_data *sd, const char *message)
 {
@@ -359,21 +411,21 @@ static void log_atcommand(struct map_session_data *sd, const char *message)
 
 static void log_npc_sub_sql(struct map_session_data *sd, const char *message)
 {
-	struct SqlStmt *stmt;
+	StringBuf buf;
+	char timestamp[LOG_SQL_TIMESTAMP_LEN];
+	char esc_name[NAME_LENGTH*2+1];
+	char esc_message[255*2+1];
 
 	nullpo_retv(sd);
 	nullpo_retv(message);
-	stmt = SQL->StmtMalloc(logs->mysql_handle);
-	if (SQL_SUCCESS != SQL->StmtPrepare(stmt, LOG_QUERY " INTO `%s` (`npc_date`, `account_id`, `char_id`, `char_name`, `map`, `mes`) VALUES (NOW(), '%d', '%d', ?, '%s', ?)", logs->config.log_npc, sd->status.account_id, sd->status.char_id, mapindex_id2name(sd->mapindex) )
-	 || SQL_SUCCESS != SQL->StmtBindParam(stmt, 0, SQLDT_STRING, sd->status.name, strnlen(sd->status.name, NAME_LENGTH))
-	 || SQL_SUCCESS != SQL->StmtBindParam(stmt, 1, SQLDT_STRING, message, safestrnlen(message, 255))
-	 || SQL_SUCCESS != SQL->StmtExecute(stmt)
-	) {
-		SqlStmt_ShowDebug(stmt);
-		SQL->StmtFree(stmt);
-		return;
-	}
-	SQL->StmtFree(stmt);
+	log_sql_timestamp(timestamp, sizeof(timestamp));
+	SQL->EscapeStringLen(logs->mysql_handle, esc_name, sd->status.name, strnlen(sd->status.name, NAME_LENGTH));
+	SQL->EscapeStringLen(logs->mysql_handle, esc_message, message, safestrnlen(message, 255));
+
+	StrBuf->Init(&buf);
+	StrBuf->Printf(&buf, "('%s', '%d', '%d', '%s', '%s', '%s')", timestamp, sd->status.account_id, sd->status.char_id, esc_name, mapindex_id2name(sd->mapindex), esc_message);
+	logs->sql_insert(LOG_SQL_NPC, StrBuf->Value(&buf));
+	StrBuf->Destroy(&buf);
 }
 static void log_npc_sub_txt(struct map_session_data *sd, const char *message)
 {
@@ -416,21 +468,23 @@ static void log_npc(struct map_session_data *sd, const char *message)
  */
 static void log_chat_sub_sql(e_log_chat_type type, int type_id, int src_charid, int src_accid, const char *mapname, int x, int y, const char *dst_charname, const char *message)
 {
-	struct SqlStmt* stmt;
+	StringBuf buf;
+	char timestamp[LOG_SQL_TIMESTAMP_LEN];
+	char esc_charname[NAME_LENGTH*2+1];
+	char esc_message[CHAT_SIZE_MAX*2+1];
 
+	nullpo_retv(mapname);
 	nullpo_retv(dst_charname);
 	nullpo_retv(message);
-	stmt = SQL->StmtMalloc(logs->mysql_handle);
-	if( SQL_SUCCESS != SQL->StmtPrepare(stmt, LOG_QUERY " INTO `%s` (`time`, `type`, `type_id`, `src_charid`, `src_accountid`, `src_map`, `src_map_x`, `src_map_y`, `dst_charname`, `message`) VALUES (NOW(), '%c', '%d', '%d', '%d', '%s', '%d', '%d', ?, ?)", logs->config.log_chat, logs->chattype2char(type), type_id, src_charid, src_accid, mapname, x, y)
-	 || SQL_SUCCESS != SQL->StmtBindParam(stmt, 0, SQLDT_STRING, dst_charname, safestrnlen(dst_charname, NAME_LENGTH))
-	 || SQL_SUCCESS != SQL->StmtBindParam(stmt, 1, SQLDT_STRING, message, safestrnlen(message, CHAT_SIZE_MAX))
-	 || SQL_SUCCESS != SQL->StmtExecute(stmt)
-	) {
-		SqlStmt_ShowDebug(stmt);
-		SQL->StmtFree(stmt);
-		return;
-	}
-	SQL->StmtFree(stmt);
+	log_sql_timestamp(timestamp, sizeof(timestamp));
+	SQL->EscapeStringLen(logs->mysql_handle, esc_charname, dst_charname, safestrnlen(dst_charname, NAME_LENGTH));
+	SQL->EscapeStringLen(logs->mysql_handle, esc_message, message, safestrnlen(message, CHAT_SIZE_MAX));
+
+	StrBuf->Init(&buf);
+	StrBuf->Printf(&buf, "('%s', '%c', '%d', '%d', '%d', '%s', '%d', '%d', '%s', '%s')",
+	    timestamp, logs->chattype2char(type), type_id, src_charid, src_accid, mapname, x, y, esc_charname, esc_message);
+	logs->sql_insert(LOG_SQL_CHAT, StrBuf->Value(&buf));
+	StrBuf->Destroy(&buf);
 }
 
 /**
@@ -494,6 +548,372 @@ static void log_chat(e_log_chat_type type, int type_id, int src_charid, int src_
 	logs->chat_sub(type,type_id,src_charid,src_accid,mapname,x,y,dst_charname,message);
 }
 
+/// obtains the configured name of a SQL log table
+static const char *log_sql_table_name(enum log_sql_table table)
+{
+	switch (table) {
+	case LOG_SQL_PICK:      return logs->config.log_pick;
+	case LOG_SQL_ZENY:      return logs->config.log_zeny;
+	case LOG_SQL_MVPDROP:   return logs->config.log_mvpdrop;
+	case LOG_SQL_ATCOMMAND: return logs->config.log_gm;
+	case LOG_SQL_NPC:       return logs->config.log_npc;
+	case LOG_SQL_CHAT:      return logs->config.log_chat;
+	case LOG_SQL_BRANCH:    return logs->config.log_branch;
+	case LOG_SQL_TABLE_MAX: break;
+	}
+
+	// should not get here
+	ShowDebug("log_sql_table_name: Unknown table %d.\n", (int)table);
+	return logs->config.log_pick;
+}
+
+/**
+ * Writes a batch of rows with multi-row INSERTs.
+ * Runs on the writer thread: it only touches the batch, the prebuilt
+ * headers and its own connection, none of which allocate.
+ * A failed query is not shown from here, as a long message would go
+ * through the memory manager; the start of it is kept for the main thread.
+ *
+ * @param batch Rows to write.
+ * @param count Number of rows in batch.
+ * @param[out] failed Number of rows lost to failed queries.
+ * @param[out] errors Number of failed queries.
+ * @return The number of rows written.
+ */
+static int log_sql_write_batch(const struct log_sql_row *batch, int count, int *failed, int *errors)
+{
+	int table, i, written = 0;
+
+	for (table = 0; table < LOG_SQL_TABLE_MAX; table++) {
+		size_t header_len = strlen(log_sql.header[table]);
+		size_t len = header_len;
+		int rows = 0;
+
+		for (i = 0; i <= count; i++) {
+			size_t row_len = 0;
+
+			if (i < count) {
+				if (batch[i].table != table)
+					continue;
+				row_len = strlen(batch[i].values);
+				if (rows == 0 || len + 1 + row_len < LOG_SQL_QUERY_MAX) {
+					if (rows == 0)
+						memcpy(log_sql.query, log_sql.header[table], header_len);
+					else
+						log_sql.query[len++] = ',';
+					memcpy(log_sql.query + len, batch[i].values, row_len);
+					len += row_len;
+					rows++;
+					continue;
+				}
+			}
+			if (rows == 0)
+				break;
+
+			// end of the batch, or the query is full
+			log_sql.query[len] = '\0';
+			if (SQL_ERROR == SQL->QueryStr(logs->async_handle, log_sql.query)) {
+				safestrncpy(log_sql.error, log_sql.query, sizeof(log_sql.error));
+				*errors += 1;
+				*failed += rows;
+			} else {
+				written += rows;
+			}
+			rows = 0;
+			len = header_len;
+			if (i < count)
+				i--; // start the next query with the row that did not fit
+		}
+	}
+
+	return written;
+}
+
+/// main loop of the asynchronous SQL writer
+static void *log_sql_writer_main(void *param)
+{
+	// the writer owns a connection, set up the client library for this thread
+	if (SQL_ERROR == SQL->ThreadInit())
+		ShowWarning("log_sql_writer_main: Failed to set up the SQL client for the log writer thread.\n");
+
+	mutex->lock(log_sql.lock);
+	while (true) {
+		const struct log_sql_row *batch;
+		int count, written, failed = 0, errors = 0;
+		int64 start, elapsed;
+
+		while (!log_sql.busy && !log_sql.shutdown)
+			mutex->cond_wait(log_sql.wake, log_sql.lock, -1);
+		if (!log_sql.busy)
+			break;
+		batch = VECTOR_DATA(log_sql.rows[log_sql.pending^1]);
+		count = VECTOR_LENGTH(log_sql.rows[log_sql.pending^1]);
+		mutex->unlock(log_sql.lock);
+
+		start = timer->gettick_nocache();
+		written = log_sql_write_batch(batch, count, &failed, &errors);
+		elapsed = timer->gettick_nocache() - start;
+
+		mutex->lock(log_sql.lock);
+		logs->sql_stats.queue_depth -= count;
+		logs->sql_stats.rows_written += written;
+		logs->sql_stats.rows_failed += failed;
+		log_sql.errors += errors;
+		logs->sql_stats.flushes++;
+		logs->sql_stats.flush_last = elapsed;
+		logs->sql_stats.flush_total += elapsed;
+		if (elapsed > logs->sql_stats.flush_max)
+			logs->sql_stats.flush_max = elapsed;
+		log_sql.busy = false;
+		mutex->cond_signal(log_sql.idle);
+	}
+	mutex->unlock(log_sql.lock);
+
+	SQL->ThreadEnd();
+	return NULL;
+}
+
+/**
+ * Shows the queries the writer failed to run since the last call.
+ * Must be called from the main thread, with the writer idle.
+ */
+static void log_sql_show_errors(void)
+{
+	if (log_sql.errors == 0)
+		return;
+
+	ShowError("log_sql_show_errors: The log writer failed to run %d queries, the last one started with:\n", log_sql.errors);
+	ShowDebug("%s\n", log_sql.error);
+	log_sql.errors = 0;
+}
+
+/**
+ * Hands the queued rows over to the writer.
+ * Must be called with log_sql.lock held and the writer idle.
+ */
+static void log_sql_handoff(void)
+{
+	int i;
+	int done = log_sql.pending^1;
+
+	log_sql_show_errors();
+
+	// the previous batch has been written, release it from the main thread
+	for (i = 0; i < VECTOR_LENGTH(log_sql.rows[done]); i++)
+		aFree(VECTOR_INDEX(log_sql.rows[done], i).values);
+	VECTOR_TRUNCATE(log_sql.rows[done]);
+
+	log_sql.pending = done;
+	log_sql.busy = true;
+	mutex->cond_signal(log_sql.wake);
+}
+
+/**
+ * Queues a row for the writer.
+ *
+ * @return false if the row must be written by the caller instead.
+ */
+static bool log_sql_push(enum log_sql_table table, const char *values)
+{
+	struct log_sql_row row;
+	int length;
+
+	if (strlen(values) >= LOG_SQL_QUERY_MAX - LOG_SQL_HEADER_MAX)
+		return false; // would not fit in a query of the writer
+
+	mutex->lock(log_sql.lock);
+	length = VECTOR_LENGTH(log_sql.rows[log_sql.pending]);
+	if (length >= logs->config.sql_queue_max) {
+		bool drop = (logs->config.sql_overflow == 1);
+
+		if (logs->sql_stats.rows_dropped + logs->sql_stats.rows_sync == 0)
+			ShowWarning("log_sql_push: Log queue is full (%d rows), %s rows until the writer catches up.\n", length, drop ? "dropping" : "synchronously writing");
+		if (drop)
+			logs->sql_stats.rows_dropped++;
+		else
+			logs->sql_stats.rows_sync++;
+		mutex->unlock(log_sql.lock);
+		return drop;
+	}
+
+	row.table = table;
+	row.values = aStrdup(values);
+	VECTOR_ENSURE(log_sql.rows[log_sql.pending], 1, 256);
+	VECTOR_PUSH(log_sql.rows[log_sql.pending], row);
+	logs->sql_stats.rows_queued++;
+	if (++logs->sql_stats.queue_depth > logs->sql_stats.queue_peak)
+		logs->sql_stats.queue_peak = logs->sql_stats.queue_depth;
+
+	if (length + 1 >= logs->config.sql_batch_rows && !log_sql.busy)
+		log_sql_handoff();
+	mutex->unlock(log_sql.lock);
+
+	return true;
+}
+
+/**
+ * Inserts a row into a SQL log table.
+ * With map_log/database/async enabled the row is queued for the writer,
+ * otherwise (or when the writer cannot take it) it is written right away.
+ *
+ * @param table  Target table.
+ * @param values Escaped value tuple, "(...)".
+ */
+static void log_sql_insert(enum log_sql_table table, const char *values)
+{
+	nullpo_retv(values);
+	Assert_retv(table >= LOG_SQL_PICK && table < LOG_SQL_TABLE_MAX);
+
+	if (log_sql.thread != NULL && log_sql_push(table, values))
+		return;
+
+	if (SQL_ERROR == SQL->Query(logs->mysql_handle, LOG_QUERY " INTO `%s` (%s) VALUES %s", logs->sql_table_name(table), log_sql_columns[table], values))
+		Sql_ShowDebug(logs->mysql_handle);
+}
+
+/// hands the queued rows to the writer, if it is idle
+static void log_sql_flush(void)
+{
+	if (log_sql.thread == NULL)
+		return;
+
+	mutex->lock(log_sql.lock);
+	if (!log_sql.busy && VECTOR_LENGTH(log_sql.rows[log_sql.pending]) > 0)
+		log_sql_handoff();
+	mutex->unlock(log_sql.lock);
+}
+
+/// timer that flushes the queue every map_log/database/async/flush_interval ms
+static int log_sql_flush_timer(int tid, int64 tick, int id, intptr_t data)
+{
+	logs->sql_flush();
+	return 0;
+}
+
+/// shows the counters of the asynchronous SQL writer
+static void log_sql_report(void)
+{
+	struct log_sql_stats stats;
+
+	if (log_sql.thread == NULL)
+		return;
+
+	mutex->lock(log_sql.lock);
+	stats = logs->sql_stats;
+	mutex->unlock(log_sql.lock);
+
+	ShowInfo("Log writer: %"PRIu64" rows queued, %"PRIu64" written, %"PRIu64" failed, %"PRIu64" dropped, %"PRIu64" written synchronously.\n",
+	         stats.rows_queued, stats.rows_written, stats.rows_failed, stats.rows_dropped, stats.rows_sync);
+	ShowInfo("Log writer: queue depth %d (peak %d), %"PRIu64" batches, last %"PRId64"ms, max %"PRId64"ms, average %"PRId64"ms.\n",
+	         stats.queue_depth, stats.queue_peak, stats.flushes, stats.flush_last, stats.flush_max,
+	         stats.flushes > 0 ? stats.flush_total / (int64)stats.flushes : 0);
+}
+
+/**
+ * Starts the asynchronous SQL writer (map_log/database/async).
+ * Falls back to synchronous writes if it cannot be started.
+ */
+static void log_sql_async_init(void)
+{
+	int i;
+
+	memset(&log_sql, 0, sizeof(log_sql));
+	memset(&logs->sql_stats, 0, sizeof(logs->sql_stats));
+	log_sql.timer = INVALID_TIMER;
+
+	if (!logs->config.sql_async)
+		return;
+
+	logs->async_handle = SQL->Malloc();
+	if (SQL_ERROR == SQL->Connect(logs->async_handle, logs->db_id, logs->db_pw, logs->db_ip, logs->db_port, logs->db_name)) {
+		ShowError("log_sql_async_init: Failed to connect the log writer, logs will be written synchronously.\n");
+		SQL->Free(logs->async_handle);
+		logs->async_handle = NULL;
+		return;
+	}
+	if (map->default_codepage[0] != '\0')
+		if (SQL_ERROR == SQL->SetEncoding(logs->async_handle, map->default_codepage))
+			Sql_ShowDebug(logs->async_handle);
+	SQL->Detach(logs->async_handle, LOG_SQL_QUERY_MAX);
+
+	for (i = 0; i < LOG_SQL_TABLE_MAX; i++) {
+		if (snprintf(log_sql.header[i], LOG_SQL_HEADER_MAX, LOG_QUERY " INTO `%s` (%s) VALUES ", logs->sql_table_name(i), log_sql_columns[i]) >= LOG_SQL_HEADER_MAX) {
+			ShowError("log_sql_async_init: Table name '%s' is too long, logs will be written synchronously.\n", logs->sql_table_name(i));
+			SQL->Free(logs->async_handle);
+			logs->async_handle = NULL;
+			return;
+		}
+	}
+
+	log_sql.query = aMalloc(LOG_SQL_QUERY_MAX);
+	VECTOR_INIT(log_sql.rows[0]);
+	VECTOR_INIT(log_sql.rows[1]);
+	log_sql.lock = mutex->create();
+	log_sql.wake = mutex->cond_create();
+	log_sql.idle = mutex->cond_create();
+
+	if ((log_sql.thread = thread->create(log_sql_writer_main, NULL)) == NULL) {
+		ShowError("log_sql_async_init: Failed to start the log writer thread, logs will be written synchronously.\n");
+		mutex->cond_destroy(log_sql.idle);
+		mutex->cond_destroy(log_sql.wake);
+		mutex->destroy(log_sql.lock);
+		aFree(log_sql.query);
+		log_sql.query = NULL;
+		SQL->Free(logs->async_handle);
+		logs->async_handle = NULL;
+		return;
+	}
+
+	timer->add_func_list(logs->sql_flush_timer, "log_sql_flush_timer");
+	log_sql.timer = timer->add_interval(timer->gettick() + logs->config.sql_flush_interval, logs->sql_flush_timer, 0, 0, logs->config.sql_flush_interval);
+	ShowStatus("Log writer started (queue: %d rows, batch: %d rows, flush: %dms).\n", logs->config.sql_queue_max, logs->config.sql_batch_rows, logs->config.sql_flush_interval);
+}
+
+/// writes every queued row and stops the asynchronous SQL writer
+static void log_sql_async_final(void)
+{
+	int i, j;
+
+	if (log_sql.thread == NULL)
+		return;
+
+	if (log_sql.timer != INVALID_TIMER) {
+		timer->delete(log_sql.timer, logs->sql_flush_timer);
+		log_sql.timer = INVALID_TIMER;
+	}
+
+	mutex->lock(log_sql.lock);
+	while (log_sql.busy)
+		mutex->cond_wait(log_sql.idle, log_sql.lock, -1);
+	if (VECTOR_LENGTH(log_sql.rows[log_sql.pending]) > 0) {
+		log_sql_handoff();
+		while (log_sql.busy)
+			mutex->cond_wait(log_sql.idle, log_sql.lock, -1);
+	}
+	log_sql.shutdown = true;
+	mutex->cond_signal(log_sql.wake);
+	mutex->unlock(log_sql.lock);
+
+	thread->wait(log_sql.thread, NULL);
+	log_sql_show_errors();
+	logs->sql_report();
+	log_sql.thread = NULL;
+
+	for (i = 0; i < 2; i++) {
+		for (j = 0; j < VECTOR_LENGTH(log_sql.rows[i]); j++)
+			aFree(VECTOR_INDEX(log_sql.rows[i], j).values);
+		VECTOR_CLEAR(log_sql.rows[i]);
+	}
+	mutex->cond_destroy(log_sql.idle);
+	mutex->cond_destroy(log_sql.wake);
+	mutex->destroy(log_sql.lock);
+	aFree(log_sql.query);
+	log_sql.query = NULL;
+
+	SQL->Free(logs->async_handle);
+	logs->async_handle = NULL;
+}
+
 static void log_sql_init(void)
 {
 	// log db connection
@@ -507,9 +927,13 @@ static void log_sql_init(void)
 	if (map->default_codepage[0] != '\0')
 		if ( SQL_ERROR == SQL->SetEncoding(logs->mysql_handle, map->default_codepage) )
 			Sql_ShowDebug(logs->mysql_handle);
+
+	log_sql_async_init();
 }
 static void log_sql_final(void)
 {
+	log_sql_async_final();
+
 	ShowStatus("Close Log DB Connection....\n");
 	SQL->Free(logs->mysql_handle);
 	logs->mysql_handle = NULL;
@@ -536,6 +960,13 @@ static void log_set_defaults(void)
 	logs->config.rare_items_log   = 100;  // log rare items. drop chance <= 1%
 	logs->config.price_items_log  = 1000; // 1000z
 	logs->config.amount_items_log = 100;
+
+	//map_log/database/async default values
+	logs->config.sql_async = false;
+	logs->config.sql_queue_max = 20000;
+	logs->config.sql_batch_rows = 500;
+	logs->config.sql_flush_interval = 1000;
+	logs->config.sql_overflow = 0;
 }
 
 /**
@@ -591,6 +1022,23 @@ static bool log_config_read_database(const char *filename, struct config_t *conf
 				logs->config.log_chat, sizeof(logs->config.log_chat)) == CONFIG_FALSE)
 		safestrncpy(logs->config.log_chat, "chatlog", sizeof(logs->config.log_chat));
 
+	if ((setting = libconfig->setting_get_member(setting, "async")) != NULL) {
+		libconfig->setting_lookup_bool_real(setting, "enable", &logs->config.sql_async);
+		if (libconfig->setting_lookup_int(setting, "queue_max", &logs->config.sql_queue_max) == CONFIG_TRUE && logs->config.sql_queue_max < 1) {
+			ShowWarning("log_config_read: map_log/database/async/queue_max must be at least 1, defaulting to 20000.\n");
+			logs->config.sql_queue_max = 20000;
+		}
+		if (libconfig->setting_lookup_int(setting, "batch_rows", &logs->config.sql_batch_rows) == CONFIG_TRUE && logs->config.sql_batch_rows < 1) {
+			ShowWarning("log_config_read: map_log/database/async/batch_rows must be at least 1, defaulting to 500.\n");
+			logs->config.sql_batch_rows = 500;
+		}
+		if (libconfig->setting_lookup_int(setting, "flush_interval", &logs->config.sql_flush_interval) == CONFIG_TRUE && logs->config.sql_flush_interval < 100) {
+			ShowWarning("log_config_read: map_log/database/async/flush_interval must be at least 100, defaulting to 1000.\n");
+			logs->config.sql_flush_interval = 1000;
+		}
+		libconfig->setting_lookup_int(setting, "overflow", &logs->config.sql_overflow);
+	}
+
 	return true;
 }
 
@@ -789,6 +1237,8 @@ void log_defaults(void)
 
 	logs->db_port = 3306;
 	logs->mysql_handle = NULL;
+	logs->async_handle = NULL;
+	memset(&logs->sql_stats, 0, sizeof(logs->sql_stats));
 	/* */
 
 	logs->pick_pc = log_pick_pc;
@@ -813,6 +1263,11 @@ void log_defaults(void)
 	logs->config_done = log_config_complete;
 	logs->sql_init = log_sql_init;
 	logs->sql_final = log_sql_final;
+	logs->sql_insert = log_sql_insert;
+	logs->sql_flush = log_sql_flush;
+	logs->sql_flush_timer = log_sql_flush_timer;
+	logs->sql_report = log_sql_report;
+	logs->sql_table_name = log_sql_table_name;
 
 	logs->picktype2char = log_picktype2char;
 	logs->chattype2char = log_chattype2char;
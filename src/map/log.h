@@ -43,6 +43,15 @@ struct mob_data;
 	#define LOG_QUERY "INSERT DELAYED"
 #endif
 
+/// Size of the query buffer of the asynchronous SQL writer.
+#define LOG_SQL_QUERY_MAX 65536
+/// Room reserved for the INSERT header (table and column names) of a query.
+#define LOG_SQL_HEADER_MAX 1024
+/// Length of the start of a failed query kept by the asynchronous SQL writer.
+#define LOG_SQL_ERROR_MAX 512
+/// Length of the DATETIME literal stored in queued rows.
+#define LOG_SQL_TIMESTAMP_LEN 20
+
 /**
  * Enumerations
  **/
@@ -96,6 +105,18 @@ typedef enum e_log_pick_type {
 	LOG_TYPE_ALL              = 0xFFFFFFFF,
 } e_log_pick_type;
 
+/// tables written by the SQL backend
+enum log_sql_table {
+	LOG_SQL_PICK,
+	LOG_SQL_ZENY,
+	LOG_SQL_MVPDROP,
+	LOG_SQL_ATCOMMAND,
+	LOG_SQL_NPC,
+	LOG_SQL_CHAT,
+	LOG_SQL_BRANCH,
+	LOG_SQL_TABLE_MAX
+};
+
 /// filters for item logging
 typedef enum e_log_filter {
 	LOG_FILTER_NONE     = 0x000,
@@ -114,6 +135,27 @@ typedef enum e_log_filter {
 	LOG_FILTER_CHANCE   = 0x800,  // Log rare items and Emperium ( drop chance <= rare_log )
 } e_log_filter;
 
+/// A row waiting for the asynchronous SQL writer.
+struct log_sql_row {
+	enum log_sql_table table;
+	char *values; ///< Escaped value tuple, "(...)".
+};
+
+/// Counters of the asynchronous SQL writer.
+struct log_sql_stats {
+	int queue_depth;        ///< Rows queued or being written.
+	int queue_peak;         ///< Highest queue_depth seen.
+	uint64 rows_queued;     ///< Rows accepted by the queue.
+	uint64 rows_written;    ///< Rows stored by the writer.
+	uint64 rows_failed;     ///< Rows lost to failed queries.
+	uint64 rows_dropped;    ///< Rows discarded because the queue was full.
+	uint64 rows_sync;       ///< Rows written by the main thread because the queue was full.
+	uint64 flushes;         ///< Batches completed by the writer.
+	int64 flush_last;       ///< Duration of the last batch (ms).
+	int64 flush_max;        ///< Longest batch (ms).
+	int64 flush_total;      ///< Sum of all batch durations (ms).
+};
+
 struct log_interface {
 	struct {
 		e_log_pick_type enable_logs;
@@ -124,6 +166,8 @@ struct log_interface {
 		int zeny, chat;
 		bool branch, mvpdrop, commands, npc;
 		char log_branch[64], log_pick[64], log_zeny[64], log_mvpdrop[64], log_gm[64], log_npc[64], log_chat[64];
+		bool sql_async;
+		int sql_queue_max, sql_batch_rows, sql_flush_interval, sql_overflow;
 	} config;
 	/* */
 	char db_ip[32];
@@ -132,6 +176,8 @@ struct log_interface {
 	char db_pw[100];
 	char db_name[32];
 	struct Sql *mysql_handle;
+	struct Sql *async_handle; ///< Connection owned by the asynchronous writer.
+	struct log_sql_stats sql_stats;
 	/* */
 	void (*pick_pc) (struct map_session_data* sd, e_log_pick_type type, int amount, struct item* itm, struct item_data *data);
 	void (*pick_mob) (struct mob_data* md, e_log_pick_type type, int amount, struct item* itm, struct item_data *data);
@@ -154,6 +200,11 @@ struct log_interface {
 	void (*config_done) (void);
 	void (*sql_init) (void);
 	void (*sql_final) (void);
+	void (*sql_insert) (enum log_sql_table table, const char *values);
+	void (*sql_flush) (void);
+	int (*sql_flush_timer) (int tid, int64 tick, int id, intptr_t data);
+	void (*sql_report) (void);
+	const char *(*sql_table_name) (enum log_sql_table table);
 
 	char (*picktype2char) (e_log_pick_type type);
 	char (*chattype2char) (e_log_chat_type type);
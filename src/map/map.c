@@ -76,12 +76,14 @@
 #include "common/grfio.h"
 #include "common/md5calc.h"
 #include "common/memmgr.h"
+#include "common/mutex.h"
 #include "common/nullpo.h"
 #include "common/random.h"
 #include "common/showmsg.h"
 #include "common/socket.h" // WFIFO*()
 #include "common/sql.h"
 #include "common/strlib.h"
+#include "common/thread.h"
 #include "common/timer.h"
 #include "common/utils.h"
 
@@ -92,6 +94,8 @@
 #include <string.h>
 #include <sys/stat.h>
 #ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #endif
 
@@ -227,7 +231,7 @@ static int map_freeblock_timer(int tid, int64 tick, int id, intptr_t data)
 static void map_update_cell_bl(struct block_list *bl, bool increase)
 {
 #ifdef CELL_NOSTACK
-	int pos;
+	struct mapcell *cell;
 
 	nullpo_retv(bl);
 	if( bl->m < 0 || bl->x < 0 || bl->x >= map->list[bl->m].xs
@@ -241,15 +245,172 @@ static void map_update_cell_bl(struct block_list *bl, bool increase)
 	if( map->list[bl->m].cell == (struct mapcell *)0xdeadbeaf )
 		map->cellfromcache(&map->list[bl->m]);
 
-	pos = bl->x + bl->y*map->list[bl->m].xs;
+	cell = map->cell_ref(&map->list[bl->m], bl->x, bl->y);
 	if( increase )
-		map->list[bl->m].cell[pos].cell_bl++;
+		cell->cell_bl++;
 	else
-		map->list[bl->m].cell[pos].cell_bl--;
+		cell->cell_bl--;
 #endif
 	return;
 }
 
+/**
+ * Returns the block index slot of an object type (see struct map_block).
+ *
+ * @param type A single enum bl_type value.
+ * @return The slot, or -1 if type is not a single known type.
+ */
+static int map_bl_type_index(enum bl_type type)
+{
+	int i;
+
+	for (i = 0; i < MAP_BLOCK_TYPES; i++) {
+		if (type == (1 << i))
+			return i;
+	}
+	return -1;
+}
+
+/**
+ * Allocates the (empty) block grid of a map.
+ *
+ * @param mapdata The map, with bxs and bys already set.
+ */
+static void map_alloc_blocks(struct map_data *mapdata)
+{
+	nullpo_retv(mapdata);
+
+	CREATE(mapdata->block, struct map_block *, mapdata->bxs * mapdata->bys);
+	memset(mapdata->type_count, 0, sizeof(mapdata->type_count));
+	mapdata->npc_touch = NULL; // allocated with the first NPC touch area (see npc->touch_index_add)
+}
+
+/**
+ * Frees the block grid of a map, along with its NPC touch grid.
+ *
+ * @param mapdata The map.
+ */
+static void map_free_blocks(struct map_data *mapdata)
+{
+	int i;
+
+	nullpo_retv(mapdata);
+
+	if (mapdata->npc_touch != NULL) {
+		for (i = 0; i < mapdata->bxs * mapdata->bys; i++)
+			VECTOR_CLEAR(mapdata->npc_touch[i]);
+		aFree(mapdata->npc_touch);
+		mapdata->npc_touch = NULL;
+	}
+
+	if (mapdata->block == NULL)
+		return;
+
+	for (i = 0; i < mapdata->bxs * mapdata->bys; i++) {
+		if (mapdata->block[i] != NULL)
+			aFree(mapdata->block[i]);
+	}
+	aFree(mapdata->block);
+	mapdata->block = NULL;
+	memset(mapdata->type_count, 0, sizeof(mapdata->type_count));
+}
+
+/**
+ * Appends an object to the segment of its type in a map block.
+ *
+ * The first object of every following segment is moved to the end of that
+ * segment to make room, so this costs at most MAP_BLOCK_TYPES moves.
+ *
+ * @param mapdata The map.
+ * @param pos     Block position (bx + by * bxs).
+ * @param bl      The object.
+ * @retval false if the object couldn't be stored.
+ */
+static bool map_block_insert(struct map_data *mapdata, int pos, struct block_list *bl)
+{
+	struct map_block *block;
+	int t, s, hole;
+
+	nullpo_retr(false, mapdata);
+	nullpo_retr(false, bl);
+	Assert_retr(false, mapdata->block != NULL);
+	t = map->bl_type_index(bl->type);
+	Assert_retr(false, t >= 0);
+
+	block = mapdata->block[pos];
+	if (block == NULL || block->offset[MAP_BLOCK_TYPES] == block->capacity) {
+		int capacity = 4;
+
+		if (block != NULL) {
+			if (block->capacity == UINT16_MAX) {
+				ShowError("map_block_insert: block %d of map '%s' is full.\n", pos, mapdata->name);
+				return false;
+			}
+			capacity = min(block->capacity * 2, UINT16_MAX);
+			block = aRealloc(block, sizeof(*block) + capacity * sizeof(block->data[0]));
+		} else {
+			block = aCalloc(1, sizeof(*block) + capacity * sizeof(block->data[0]));
+		}
+		block->capacity = capacity;
+		mapdata->block[pos] = block;
+	}
+
+	hole = block->offset[MAP_BLOCK_TYPES]++;
+	for (s = MAP_BLOCK_TYPES - 1; s > t; s--) {
+		block->data[hole] = block->data[block->offset[s]];
+		hole = block->offset[s]++;
+	}
+	block->data[hole] = bl;
+	mapdata->type_count[t]++;
+	mapdata->block_changes++;
+
+	return true;
+}
+
+/**
+ * Removes an object from a map block, keeping the type segments packed.
+ *
+ * @param mapdata The map.
+ * @param pos     Block position (bx + by * bxs).
+ * @param bl      The object.
+ * @retval false if the object wasn't found in the block.
+ */
+static bool map_block_remove(struct map_data *mapdata, int pos, struct block_list *bl)
+{
+	struct map_block *block;
+	int t, s, i, hole;
+
+	nullpo_retr(false, mapdata);
+	nullpo_retr(false, bl);
+	Assert_retr(false, mapdata->block != NULL);
+	t = map->bl_type_index(bl->type);
+	Assert_retr(false, t >= 0);
+
+	block = mapdata->block[pos];
+	Assert_retr(false, block != NULL);
+
+	ARR_FIND(block->offset[t], block->offset[t + 1], i, block->data[i] == bl);
+	Assert_retr(false, i < block->offset[t + 1]);
+
+	hole = block->offset[t + 1] - 1;
+	block->data[i] = block->data[hole];
+	for (s = t + 1; s < MAP_BLOCK_TYPES; s++) {
+		const int last = block->offset[s + 1] - 1;
+		block->data[hole] = block->data[last];
+		hole = last;
+		block->offset[s]--;
+	}
+	block->offset[MAP_BLOCK_TYPES]--;
+	mapdata->type_count[t]--;
+	mapdata->block_changes++;
+
+	return true;
+}
+
+/// Object inside map_moveblock; its delblock/addblock calls leave the mob AI
+/// range counters to map_moveblock.
+static struct block_list *map_moving_bl = NULL;
+
 /*==========================================
  * Adds a block to the map.
  * Returns 0 on success, 1 on failure (illegal coordinates).
@@ -280,24 +441,18 @@ static int map_addblock(struct block_list *bl)
 
 	pos = x/BLOCK_SIZE+(y/BLOCK_SIZE)*map->list[m].bxs;
 
-	if (bl->type == BL_MOB) {
-		Assert_ret(map->list[m].block_mob != NULL);
-		bl->next = map->list[m].block_mob[pos];
-		bl->prev = &map->bl_head;
-		if (bl->next) bl->next->prev = bl;
-		map->list[m].block_mob[pos] = bl;
-	} else {
-		Assert_ret(map->list[m].block != NULL);
-		bl->next = map->list[m].block[pos];
-		bl->prev = &map->bl_head;
-		if (bl->next) bl->next->prev = bl;
-		map->list[m].block[pos] = bl;
-	}
+	if (!map_block_insert(&map->list[m], pos, bl))
+		return 1;
+	bl->next = NULL;
+	bl->prev = &map->bl_head; // marks the object as being on a map
 
 #ifdef CELL_NOSTACK
 	map->update_cell_bl(bl, true);
 #endif
 
+	if (bl != map_moving_bl)
+		mob->ai_area_update(bl, x, y, 1);
+
 	return 0;
 }
 
@@ -322,22 +477,12 @@ static int map_delblock(struct block_list *bl)
 	map->update_cell_bl(bl, false);
 #endif
 
+	if (bl != map_moving_bl)
+		mob->ai_area_update(bl, bl->x, bl->y, -1);
+
 	pos = bl->x/BLOCK_SIZE+(bl->y/BLOCK_SIZE)*map->list[bl->m].bxs;
 
-	if (bl->next)
-		bl->next->prev = bl->prev;
-	if (bl->prev == &map->bl_head) {
-		//Since the head of the list, update the block_list map of []
-		if (bl->type == BL_MOB) {
-			Assert_ret(map->list[bl->m].block_mob != NULL);
-			map->list[bl->m].block_mob[pos] = bl->next;
-		} else {
-			Assert_ret(map->list[bl->m].block != NULL);
-			map->list[bl->m].block[pos] = bl->next;
-		}
-	} else {
-		bl->prev->next = bl->next;
-	}
+	map_block_remove(&map->list[bl->m], pos, bl);
 	bl->next = NULL;
 	bl->prev = NULL;
 
@@ -385,16 +530,24 @@ static int map_moveblock(struct block_list *bl, int x1, int y1, int64 tick)
 		npc->unsetcells(BL_UCAST(BL_NPC, bl));
 	}
 
+	map_moving_bl = bl;
 	if (moveblock) map->delblock(bl);
 #ifdef CELL_NOSTACK
 	else map->update_cell_bl(bl, false);
 #endif
 	bl->x = x1;
 	bl->y = y1;
+	map->list[bl->m].block_changes++;
 	if (moveblock) map->addblock(bl);
 #ifdef CELL_NOSTACK
 	else map->update_cell_bl(bl, true);
 #endif
+	map_moving_bl = NULL;
+
+	if (bl->prev != NULL)
+		mob->ai_area_move(bl, x0, y0);
+	else // addblock failed, the object left the map
+		mob->ai_area_update(bl, x0, y0, -1);
 
 	if (bl->type&BL_CHAR) {
 		struct map_session_data *sd = BL_CAST(BL_PC, bl);
@@ -470,8 +623,8 @@ static int map_moveblock(struct block_list *bl, int x1, int y1, int64 tick)
  *------------------------------------------*/
 static int map_count_oncell(int16 m, int16 x, int16 y, int type, int flag)
 {
-	int bx,by;
-	struct block_list *bl;
+	const struct map_block *block;
+	int t;
 	int count = 0;
 
 	Assert_ret(m >= -1);
@@ -483,47 +636,37 @@ static int map_count_oncell(int16 m, int16 x, int16 y, int type, int flag)
 	if (x < 0 || y < 0 || (x >= map->list[m].xs) || (y >= map->list[m].ys))
 		return 0;
 
-	bx = x/BLOCK_SIZE;
-	by = y/BLOCK_SIZE;
+	block = map->list[m].block[x/BLOCK_SIZE + (y/BLOCK_SIZE)*map->list[m].bxs];
+	if (block == NULL)
+		return 0;
 
-	if (type&~BL_MOB) {
-		for (bl = map->list[m].block[bx+by*map->list[m].bxs]; bl != NULL; bl = bl->next) {
-			if (bl->x == x && bl->y == y && bl->type&type) {
-				if (flag&0x2) {
-					struct status_change *sc = status->get_sc(bl);
-					if (sc && (sc->option&OPTION_INVISIBLE))
-						continue;
-					if (bl->type == BL_NPC) {
-						const struct npc_data *nd = BL_UCCAST(BL_NPC, bl);
-						if (nd->class_ == FAKE_NPC || nd->class_ == HIDDEN_WARP_CLASS || nd->dyn.isdynamic)
-							continue;
-					}
-				}
-				if (flag&0x1) {
-					struct unit_data *ud = unit->bl2ud(bl);
-					if (ud && ud->walktimer != INVALID_TIMER)
-						continue;
-				}
-				count++;
-			}
-		}
-	}
+	for (t = 0; t < MAP_BLOCK_TYPES; t++) {
+		int i;
 
-	if (type&BL_MOB) {
-		for (bl = map->list[m].block_mob[bx+by*map->list[m].bxs]; bl != NULL; bl = bl->next) {
-			if (bl->x == x && bl->y == y) {
-				if (flag&0x2) {
-					struct status_change *sc = status->get_sc(bl);
-					if (sc && (sc->option&OPTION_INVISIBLE))
-						continue;
-				}
-				if (flag&0x1) {
-					struct unit_data *ud = unit->bl2ud(bl);
-					if (ud && ud->walktimer != INVALID_TIMER)
+		if ((type & (1 << t)) == 0)
+			continue;
+
+		for (i = block->offset[t]; i < block->offset[t + 1]; i++) {
+			struct block_list *bl = block->data[i];
+
+			if (bl->x != x || bl->y != y)
+				continue;
+			if (flag&0x2) {
+				struct status_change *sc = status->get_sc(bl);
+				if (sc && (sc->option&OPTION_INVISIBLE))
+					continue;
+				if (bl->type == BL_NPC) {
+					const struct npc_data *nd = BL_UCCAST(BL_NPC, bl);
+					if (nd->class_ == FAKE_NPC || nd->class_ == HIDDEN_WARP_CLASS || nd->dyn.isdynamic)
 						continue;
 				}
-				count++;
 			}
+			if (flag&0x1) {
+				struct unit_data *ud = unit->bl2ud(bl);
+				if (ud && ud->walktimer != INVALID_TIMER)
+					continue;
+			}
+			count++;
 		}
 	}
 
@@ -535,8 +678,9 @@ static int map_count_oncell(int16 m, int16 x, int16 y, int type, int flag)
  */
 static struct skill_unit *map_find_skill_unit_oncell(struct block_list *target, int16 x, int16 y, uint16 skill_id, struct skill_unit *out_unit, int flag)
 {
-	int16 m,bx,by;
-	struct block_list *bl;
+	int16 m;
+	int i, t;
+	const struct map_block *block;
 	struct skill_unit *su;
 
 	nullpo_retr(NULL, target);
@@ -551,11 +695,15 @@ static struct skill_unit *map_find_skill_unit_oncell(struct block_list *target,
 	if (x < 0 || y < 0 || (x >= map->list[m].xs) || (y >= map->list[m].ys))
 		return NULL;
 
-	bx = x/BLOCK_SIZE;
-	by = y/BLOCK_SIZE;
+	block = map->list[m].block[x/BLOCK_SIZE + (y/BLOCK_SIZE)*map->list[m].bxs];
+	if (block == NULL)
+		return NULL;
 
-	for( bl = map->list[m].block[bx+by*map->list[m].bxs] ; bl != NULL ; bl = bl->next ) {
-		if (bl->x != x || bl->y != y || bl->type != BL_SKILL)
+	t = map->bl_type_index(BL_SKILL);
+	for (i = block->offset[t]; i < block->offset[t + 1]; i++) {
+		struct block_list *bl = block->data[i];
+
+		if (bl->x != x || bl->y != y)
 			continue;
 
 		su = BL_UCAST(BL_SKILL, bl);
@@ -573,6 +721,91 @@ static struct skill_unit *map_find_skill_unit_oncell(struct block_list *target,
  * @{
  */
 
+/**
+ * Retrieves all map objects in area that are matched by the type
+ * and func. Appends them at the end of global bl_list array.
+ * Only the type segments of each block that were asked for are visited,
+ * and types absent from the whole map are skipped at once.
+ * @param type Matching enum bl_type
+ * @param m Map
+ * @param func Matching function (NULL to match everything)
+ * @param ... Extra arguments for func
+ * @return Number of found objects
+ */
+static int bl_getall_area(int type, int m, int x0, int y0, int x1, int y1, int (*func)(struct block_list*, va_list), ...)
+{
+	va_list args;
+	int bx, by, t;
+	int types[MAP_BLOCK_TYPES];
+	int type_num = 0;
+	int found = 0;
+
+	Assert_ret(m >= -1);
+	if (m < 0)
+		return 0;
+	Assert_ret(m < map->count);
+	const struct map_data *const listm = &map->list[m];
+	Assert_ret(listm->xs > 0 && listm->ys > 0);
+	Assert_ret(listm->block != NULL);
+
+	for (t = 0; t < MAP_BLOCK_TYPES; t++) {
+		if ((type & (1 << t)) != 0 && listm->type_count[t] > 0)
+			types[type_num++] = t;
+	}
+	if (type_num == 0)
+		return 0;
+
+	// Limit search area to map size
+	x0 = min(max(x0, 0), map->list[m].xs - 1);
+	y0 = min(max(y0, 0), map->list[m].ys - 1);
+	x1 = min(max(x1, 0), map->list[m].xs - 1);
+	y1 = min(max(y1, 0), map->list[m].ys - 1);
+
+	if (x1 < x0) swap(x0, x1);
+	if (y1 < y0) swap(y0, y1);
+
+	for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+		const bool inside_y = by * BLOCK_SIZE >= y0 && (by + 1) * BLOCK_SIZE - 1 <= y1;
+
+		for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+			const struct map_block *block = listm->block[bx + by * listm->bxs];
+			// Blocks fully covered by the area need no per-object coordinate check
+			const bool inside = inside_y && bx * BLOCK_SIZE >= x0 && (bx + 1) * BLOCK_SIZE - 1 <= x1;
+			int i;
+
+			if (block == NULL || block->offset[MAP_BLOCK_TYPES] == 0)
+				continue;
+
+			for (i = 0; i < type_num; i++) {
+				int j;
+
+				for (j = block->offset[types[i]]; j < block->offset[types[i] + 1]; j++) {
+					struct block_list *bl = block->data[j];
+
+					if (!inside && (bl->x < x0 || bl->x > x1 || bl->y < y0 || bl->y > y1))
+						continue;
+
+					if (func != NULL) {
+						int matched;
+
+						va_start(args, func);
+						matched = func(bl, args);
+						va_end(args);
+						if (!matched)
+							continue;
+					}
+
+					if (map->bl_list_count >= map->bl_list_size)
+						map_bl_list_expand();
+					map->bl_list[map->bl_list_count++] = bl;
+					found++;
+				}
+			}
+		}
+	}
+	return found;
+}
+
 /**
  * Applies func to every block_list in bl_list starting with bl_list[blockcount].
  * Sets bl_list_count back to blockcount.
@@ -617,38 +850,16 @@ static int bl_vforeach(int (*func)(struct block_list*, va_list), int blockcount,
  */
 static int map_vforeachinmap(int (*func)(struct block_list*, va_list), int16 m, int type, va_list args)
 {
-	int i;
 	int returnCount = 0;
-	int bsize;
 	va_list argscopy;
-	struct block_list *bl;
 	int blockcount = map->bl_list_count;
 
 	Assert_ret(m >= -1);
 	if (m < 0)
 		return 0;
 	Assert_ret(m < map->count);
-	Assert_ret(map->list[m].block != NULL);
 
-	bsize = map->list[m].bxs * map->list[m].bys;
-	for (i = 0; i < bsize; i++) {
-		if (type&~BL_MOB) {
-			for (bl = map->list[m].block[i]; bl != NULL; bl = bl->next) {
-				if (bl->type&type) {
-					if( map->bl_list_count >= map->bl_list_size )
-						map_bl_list_expand();
-					map->bl_list[map->bl_list_count++] = bl;
-				}
-			}
-		}
-		if (type&BL_MOB) {
-			for (bl = map->list[m].block_mob[i]; bl != NULL; bl = bl->next) {
-				if( map->bl_list_count >= map->bl_list_size )
-					map_bl_list_expand();
-				map->bl_list[map->bl_list_count++] = bl;
-			}
-		}
-	}
+	bl_getall_area(type, m, 0, 0, map->list[m].xs - 1, map->list[m].ys - 1, NULL);
 
 	va_copy(argscopy, args);
 	returnCount = bl_vforeach(func, blockcount, INT_MAX, argscopy);
@@ -744,146 +955,22 @@ static int map_foreachininstance(int (*func)(struct block_list*, va_list), int16
 	return returnCount;
 }
 
-/**
- * Retrieves all map objects in area that are matched by the type
- * and func. Appends them at the end of global bl_list array.
- * @param type Matching enum bl_type
- * @param m Map
- * @param func Matching function
- * @param ... Extra arguments for func
- * @return Number of found objects
- */
-static int bl_getall_area(int type, int m, int x0, int y0, int x1, int y1, int (*func)(struct block_list*, va_list), ...)
-{
-	va_list args;
-	int bx, by;
-	struct block_list *bl;
-	int found = 0;
-
-	Assert_ret(m >= -1);
-	if (m < 0)
-		return 0;
-	Assert_ret(m < map->count);
-	const struct map_data *const listm = &map->list[m];
-	Assert_ret(listm->xs > 0 && listm->ys > 0);
-	Assert_ret(listm->block != NULL);
-
-	// Limit search area to map size
-	x0 = min(max(x0, 0), map->list[m].xs - 1);
-	y0 = min(max(y0, 0), map->list[m].ys - 1);
-	x1 = min(max(x1, 0), map->list[m].xs - 1);
-	y1 = min(max(y1, 0), map->list[m].ys - 1);
-
-	if (x1 < x0) swap(x0, x1);
-	if (y1 < y0) swap(y0, y1);
-
-	{
-		const int x0b = x0 / BLOCK_SIZE;
-		const int x1b = x1 / BLOCK_SIZE;
-		const int y0b = y0 / BLOCK_SIZE;
-		const int y1b = y1 / BLOCK_SIZE;
-		const int bxs0 = listm->bxs;
-
-		// duplication for better performance
-		if (func != NULL) {
-			if (type & ~BL_MOB) {
-				for (by = y0b; by <= y1b; by++) {
-					const int bxs = by * bxs0;
-					for (bx = x0b; bx <= x1b; bx++) {
-						for (bl = listm->block[bx + bxs]; bl != NULL; bl = bl->next) {
-							const int x = bl->x;
-							const int y = bl->y;
-							if (bl->type & type && x >= x0 && x <= x1 && y >= y0 && y <= y1) {
-								va_start(args, func);
-								if (func(bl, args)) {
-									if (map->bl_list_count >= map->bl_list_size)
-										map_bl_list_expand();
-									map->bl_list[map->bl_list_count++] = bl;
-									found++;
-								}
-								va_end(args);
-							}
-						}
-					}
-				}
-			}
-			if (type & BL_MOB) {
-				for (by = y0b; by <= y1b; by++) {
-					const int bxs = by * bxs0;
-					for (bx = x0b; bx <= x1b; bx++) {
-						for (bl = listm->block_mob[bx + bxs]; bl != NULL; bl = bl->next) {
-							const int x = bl->x;
-							const int y = bl->y;
-							if (x >= x0 && x <= x1 && y >= y0 && y <= y1) {
-								va_start(args, func);
-								if (func(bl, args)) {
-									if (map->bl_list_count >= map->bl_list_size)
-										map_bl_list_expand();
-									map->bl_list[map->bl_list_count++] = bl;
-									found++;
-								}
-								va_end(args);
-							}
-						}
-					}
-				}
-			}
-		} else {  // func != NULL
-			if (type & ~BL_MOB) {
-				for (by = y0b; by <= y1b; by++) {
-					const int bxs = by * bxs0;
-					for (bx = x0b; bx <= x1b; bx++) {
-						for (bl = listm->block[bx + bxs]; bl != NULL; bl = bl->next) {
-							const int x = bl->x;
-							const int y = bl->y;
-							if (bl->type & type && x >= x0 && x <= x1 && y >= y0 && y <= y1) {
-								if (map->bl_list_count >= map->bl_list_size)
-									map_bl_list_expand();
-								map->bl_list[map->bl_list_count++] = bl;
-								found++;
-							}
-						}
-					}
-				}
-			}
-			if (type & BL_MOB) {
-				for (by = y0b; by <= y1b; by++) {
-					const int bxs = by * bxs0;
-					for (bx = x0b; bx <= x1b; bx++) {
-						for (bl = listm->block_mob[bx + bxs]; bl != NULL; bl = bl->next) {
-							const int x = bl->x;
-							const int y = bl->y;
-							if (x >= x0 && x <= x1 && y >= y0 && y <= y1) {
-								if (map->bl_list_count >= map->bl_list_size)
-									map_bl_list_expand();
-								map->bl_list[map->bl_list_count++] = bl;
-								found++;
-							}
-						}
-					}
-				}
-			}
-		}
-	}
-	return found;
-}
-
+#ifdef CIRCULAR_AREA
 /**
  * Checks if bl is within range cells from center.
- * If CIRCULAR AREA is not used always returns 1, since
- * preliminary range selection is already done in bl_getall_area.
+ * Only needed with CIRCULAR_AREA, since the rectangular
+ * selection is already done in bl_getall_area.
  * @return 1 if matches, 0 otherwise
  */
 static int bl_vgetall_inrange(struct block_list *bl, va_list args)
 {
-#ifdef CIRCULAR_AREA
 	struct block_list *center = va_arg(args, struct block_list*);
 	int range = va_arg(args, int);
 	if (!check_distance_bl(center, bl, range))
 		return 0;
-#endif
 	return 1;
 }
+#endif
 
 /**
  * Applies func to every block_list object of bl_type type within range cells from center.
@@ -904,7 +991,11 @@ static int map_vforeachinrange(int (*func)(struct block_list*, va_list), struct
 
 	if (range < 0) range *= -1;
 
+#ifdef CIRCULAR_AREA
 	bl_getall_area(type, center->m, center->x - range, center->y - range, center->x + range, center->y + range, bl_vgetall_inrange, center, range);
+#else
+	bl_getall_area(type, center->m, center->x - range, center->y - range, center->x + range, center->y + range, NULL);
+#endif
 
 	va_copy(apcopy, ap);
 	returnCount = bl_vforeach(func, blockcount, INT_MAX, apcopy);
@@ -914,24 +1005,128 @@ static int map_vforeachinrange(int (*func)(struct block_list*, va_list), struct
 }
 
 /**
- * Applies func to every block_list object of bl_type type within range cells from center.
- * Area is rectangular, unless CIRCULAR_AREA is defined.
+ * Applies func to every block_list object of bl_type type within range cells from center.
+ * Area is rectangular, unless CIRCULAR_AREA is defined.
+ * Returns the sum of values returned by func.
+ * @see map_vforeachinrange
+ * @param func Function to be applied
+ * @param center Center of the selection area
+ * @param range Range in cells from center
+ * @param type enum bl_type
+ * @param ... Extra arguments for func
+ * @return Sum of the values returned by func
+ */
+static int map_foreachinrange(int (*func)(struct block_list*, va_list), struct block_list *center, int16 range, int type, ...)
+{
+	int returnCount;
+	va_list ap;
+
+	va_start(ap, type);
+	returnCount = map->vforeachinrange(func, center, range, type, ap);
+	va_end(ap);
+
+	return returnCount;
+}
+
+/**
+ * Stores the block_list objects of bl_type type within range cells from
+ * (x,y) on map m in out, in the order map->foreachinrange visits them.
+ * Only reads the map, so the map worker pool may run it while the main
+ * thread waits.
+ * @param m Map id
+ * @param x X-coordinate of the center of the selection area
+ * @param y Y-coordinate of the center of the selection area
+ * @param range Range in cells from the center
+ * @param type enum bl_type
+ * @param out Destination array
+ * @param size Capacity of out, objects past it are only counted
+ * @return Number of found objects, which may exceed size
+ */
+static int map_getall_inrange(int16 m, int16 x, int16 y, int16 range, int type, struct block_list **out, int size)
+{
+	int bx, by, t;
+	int x0, y0, x1, y1;
+	int types[MAP_BLOCK_TYPES];
+	int type_num = 0;
+	int found = 0;
+
+	Assert_ret(m >= 0 && m < map->count);
+	const struct map_data *const listm = &map->list[m];
+	Assert_ret(listm->xs > 0 && listm->ys > 0);
+	Assert_ret(listm->block != NULL);
+
+	for (t = 0; t < MAP_BLOCK_TYPES; t++) {
+		if ((type & (1 << t)) != 0 && listm->type_count[t] > 0)
+			types[type_num++] = t;
+	}
+	if (type_num == 0)
+		return 0;
+
+	if (range < 0) range *= -1;
+
+	// Same area and order as bl_getall_area
+	x0 = min(max(x - range, 0), listm->xs - 1);
+	y0 = min(max(y - range, 0), listm->ys - 1);
+	x1 = min(max(x + range, 0), listm->xs - 1);
+	y1 = min(max(y + range, 0), listm->ys - 1);
+
+	for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+		for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+			const struct map_block *block = listm->block[bx + by * listm->bxs];
+			int i;
+
+			if (block == NULL || block->offset[MAP_BLOCK_TYPES] == 0)
+				continue;
+
+			for (i = 0; i < type_num; i++) {
+				int j;
+
+				for (j = block->offset[types[i]]; j < block->offset[types[i] + 1]; j++) {
+					struct block_list *bl = block->data[j];
+
+					if (bl->x < x0 || bl->x > x1 || bl->y < y0 || bl->y > y1)
+						continue;
+#ifdef CIRCULAR_AREA
+					if (!check_distance_blxy(bl, x, y, range))
+						continue;
+#endif
+					if (found < size)
+						out[found] = bl;
+					found++;
+				}
+			}
+		}
+	}
+	return found;
+}
+
+/**
+ * Applies func to every block_list object of list that is still on a map.
+ * Objects are visited the same way map->foreachinrange visits the ones
+ * it finds, e.g. for a list filled by map->getall_inrange.
  * Returns the sum of values returned by func.
- * @see map_vforeachinrange
  * @param func Function to be applied
- * @param center Center of the selection area
- * @param range Range in cells from center
- * @param type enum bl_type
+ * @param list Objects to visit
+ * @param count Number of objects in list
  * @param ... Extra arguments for func
  * @return Sum of the values returned by func
  */
-static int map_foreachinrange(int (*func)(struct block_list*, va_list), struct block_list *center, int16 range, int type, ...)
+static int map_foreachinlist(int (*func)(struct block_list*, va_list), struct block_list **list, int count, ...)
 {
 	int returnCount;
+	int blockcount = map->bl_list_count;
 	va_list ap;
 
-	va_start(ap, type);
-	returnCount = map->vforeachinrange(func, center, range, type, ap);
+	nullpo_ret(list);
+
+	while (map->bl_list_count + count > map->bl_list_size)
+		map_bl_list_expand();
+	if (count > 0)
+		memcpy(map->bl_list + map->bl_list_count, list, count * sizeof(*list));
+	map->bl_list_count += count;
+
+	va_start(ap, count);
+	returnCount = bl_vforeach(func, blockcount, INT_MAX, ap);
 	va_end(ap);
 
 	return returnCount;
@@ -958,7 +1153,11 @@ static int map_vforcountinrange(int (*func)(struct block_list*, va_list), struct
 
 	if (range < 0) range *= -1;
 
+#ifdef CIRCULAR_AREA
 	bl_getall_area(type, center->m, center->x - range, center->y - range, center->x + range, center->y + range, bl_vgetall_inrange, center, range);
+#else
+	bl_getall_area(type, center->m, center->x - range, center->y - range, center->x + range, center->y + range, NULL);
+#endif
 
 	va_copy(apcopy, ap);
 	returnCount = bl_vforeach(func, blockcount, count, apcopy);
@@ -3206,7 +3405,10 @@ static int map_getcellp(struct map_data *m, const struct block_list *bl, int16 x
 	if(x<0 || x>=m->xs-1 || y<0 || y>=m->ys-1)
 		return( cellchk == CELL_CHKNOPASS );
 
-	cell = m->cell[x + y*m->xs];
+	if (m->cell_blocks == NULL)
+		cell = m->cell[x + y*m->xs];
+	else
+		cell = map->cell_shared(m, x, y);
 
 	switch(cellchk) {
 		// gat type retrieval
@@ -3280,6 +3482,122 @@ static int map_sub_getcellp(struct map_data *m, const struct block_list *bl, int
 	return m->getcellp(m, bl, x, y, cellchk);
 }
 
+/**
+ * Makes an instance map share the cells of its source map (see
+ * map_data::cell_blocks).
+ *
+ * @param[in,out] m   The instance map, a copy of src.
+ * @param[in]     src The source map, with its cells loaded.
+ */
+static void map_cell_share(struct map_data *m, const struct map_data *src)
+{
+	nullpo_retv(m);
+	nullpo_retv(src);
+
+	m->cell = src->cell;
+	CREATE(m->cell_blocks, struct mapcell *, m->bxs * m->bys);
+}
+
+/**
+ * Frees the cells of a map, or only its private blocks if it shares the
+ * cells of another map.
+ *
+ * @param[in,out] m The map.
+ */
+static void map_cell_free(struct map_data *m)
+{
+	nullpo_retv(m);
+
+	if (m->cell_blocks != NULL) {
+		int i;
+
+		for (i = 0; i < m->bxs * m->bys; i++) {
+			if (m->cell_blocks[i] != NULL)
+				aFree(m->cell_blocks[i]);
+		}
+		aFree(m->cell_blocks);
+		m->cell_blocks = NULL;
+	} else if (m->cell != NULL && m->cell != (struct mapcell *)0xdeadbeaf) {
+		aFree(m->cell);
+	}
+	m->cell = NULL;
+}
+
+/**
+ * Reads a cell of a map sharing the cells of its source map.
+ * Cells of unchanged blocks come from the source map, without the flags
+ * tied to the objects placed on it.
+ *
+ * @param m The instance map.
+ * @return The cell at (x, y).
+ */
+static struct mapcell map_cell_shared(const struct map_data *m, int16 x, int16 y)
+{
+	const struct mapcell *block = m->cell_blocks[x / BLOCK_SIZE + (y / BLOCK_SIZE) * m->bxs];
+	struct mapcell cell;
+
+	if (block != NULL)
+		return block[x % BLOCK_SIZE + (y % BLOCK_SIZE) * BLOCK_SIZE];
+
+	cell = m->cell[x + y * m->xs];
+#ifdef CELL_NOSTACK
+	cell.cell_bl = 0;
+#endif // CELL_NOSTACK
+	cell.basilica = 0;
+	cell.icewall = 0;
+	cell.npc = 0;
+	cell.landprotector = 0;
+	return cell;
+}
+
+/**
+ * Returns a cell of a map for modification, copying its block first if the
+ * map shares the cells of its source map.
+ *
+ * @param m The map (x and y must be within its bounds).
+ * @return The cell at (x, y).
+ */
+static struct mapcell *map_cell_ref(struct map_data *m, int16 x, int16 y)
+{
+	struct mapcell **block;
+
+	if (m->cell_blocks == NULL)
+		return &m->cell[x + y * m->xs];
+
+	block = &m->cell_blocks[x / BLOCK_SIZE + (y / BLOCK_SIZE) * m->bxs];
+	if (*block == NULL) {
+		int16 x0 = x - x % BLOCK_SIZE, y0 = y - y % BLOCK_SIZE;
+		int16 bx, by;
+
+		CREATE(*block, struct mapcell, BLOCK_SIZE * BLOCK_SIZE);
+		for (by = 0; by < BLOCK_SIZE && y0 + by < m->ys; by++) {
+			for (bx = 0; bx < BLOCK_SIZE && x0 + bx < m->xs; bx++)
+				(*block)[bx + by * BLOCK_SIZE] = map->cell_shared(m, x0 + bx, y0 + by);
+		}
+	}
+
+	return &(*block)[x % BLOCK_SIZE + (y % BLOCK_SIZE) * BLOCK_SIZE];
+}
+
+/**
+ * Gives the instance maps still sharing a cell of a source map their own
+ * copy of it, before the source map's cell changes.
+ *
+ * @param m The source map.
+ */
+static void map_cell_unshare(int16 m, int16 x, int16 y)
+{
+	int i;
+
+	if (!map->list[m].flag.src4instance)
+		return;
+
+	for (i = instance->start_id; i < map->count; i++) {
+		if (map->list[i].cell_blocks != NULL && map->list[i].instance_src_map == m)
+			map->cell_ref(&map->list[i], x, y);
+	}
+}
+
 /*==========================================
  * Change the type/flags of a map cell
  * 'cell' - which flag to modify
@@ -3287,26 +3605,31 @@ static int map_sub_getcellp(struct map_data *m, const struct block_list *bl, int
  *------------------------------------------*/
 static void map_setcell(int16 m, int16 x, int16 y, cell_t cell, bool flag)
 {
-	int j;
+	struct mapcell *c;
 
 	if( m < 0 || m >= map->count || x < 0 || x >= map->list[m].xs || y < 0 || y >= map->list[m].ys )
 		return;
 
-	j = x + y*map->list[m].xs;
+	map->cell_unshare(m, x, y);
+	c = map->cell_ref(&map->list[m], x, y);
 
 	switch( cell ) {
-	case CELL_WALKABLE:      map->list[m].cell[j].walkable = flag;      break;
-	case CELL_SHOOTABLE:     map->list[m].cell[j].shootable = flag;     break;
-	case CELL_WATER:         map->list[m].cell[j].water = flag;         break;
-
-	case CELL_NPC:           map->list[m].cell[j].npc = flag;           break;
-	case CELL_BASILICA:      map->list[m].cell[j].basilica = flag;      break;
-	case CELL_LANDPROTECTOR: map->list[m].cell[j].landprotector = flag; break;
-	case CELL_NOVENDING:     map->list[m].cell[j].novending = flag;     break;
-	case CELL_NOCHAT:        map->list[m].cell[j].nochat = flag;        break;
-	case CELL_ICEWALL:       map->list[m].cell[j].icewall = flag;       break;
-	case CELL_NOICEWALL:     map->list[m].cell[j].noicewall = flag;     break;
-	case CELL_NOSKILL:       map->list[m].cell[j].noskill = flag;       break;
+	case CELL_WALKABLE:
+		c->walkable = flag;
+		if (flag)
+			path->region_clear(&map->list[m]);
+		break;
+	case CELL_SHOOTABLE:     c->shootable = flag;     break;
+	case CELL_WATER:         c->water = flag;         break;
+
+	case CELL_NPC:           c->npc = flag;           break;
+	case CELL_BASILICA:      c->basilica = flag;      break;
+	case CELL_LANDPROTECTOR: c->landprotector = flag; break;
+	case CELL_NOVENDING:     c->novending = flag;     break;
+	case CELL_NOCHAT:        c->nochat = flag;        break;
+	case CELL_ICEWALL:       c->icewall = flag;       break;
+	case CELL_NOICEWALL:     c->noicewall = flag;     break;
+	case CELL_NOSKILL:       c->noskill = flag;       break;
 
 	default:
 		ShowWarning("map_setcell: invalid cell type '%d'\n", (int)cell);
@@ -3325,18 +3648,20 @@ static void map_sub_setcell(int16 m, int16 x, int16 y, cell_t cell, bool flag)
 }
 static void map_setgatcell(int16 m, int16 x, int16 y, int gat)
 {
-	int j;
-	struct mapcell cell;
+	struct mapcell cell, *c;
 
 	if( m < 0 || m >= map->count || x < 0 || x >= map->list[m].xs || y < 0 || y >= map->list[m].ys )
 		return;
 
-	j = x + y*map->list[m].xs;
+	map->cell_unshare(m, x, y);
+	c = map->cell_ref(&map->list[m], x, y);
 
 	cell = map->gat2cell(gat);
-	map->list[m].cell[j].walkable = cell.walkable;
-	map->list[m].cell[j].shootable = cell.shootable;
-	map->list[m].cell[j].water = cell.water;
+	if (cell.walkable && !c->walkable)
+		path->region_clear(&map->list[m]);
+	c->walkable = cell.walkable;
+	c->shootable = cell.shootable;
+	c->water = cell.water;
 }
 
 /*==========================================
@@ -3574,6 +3899,254 @@ static bool map_readfromcache_v1(FILE *fp, struct map_data *m, unsigned int file
 	return true;
 }
 
+/// The packed map cache archive while maps are being loaded.
+static struct {
+	uint8 *data;    ///< Contents of the whole archive.
+	size_t size;
+	bool mapped;    ///< Whether data is a memory mapping (or an aMalloc'd copy).
+	const struct map_cache_archive_entry *entries;
+	int count;
+} map_archive;
+
+/**
+ * Opens the packed map cache archive, memory-mapping it where supported.
+ *
+ * @param archive_path Path to the archive.
+ * @return The loading success state.
+ * @retval false if the archive doesn't exist or is invalid.
+ */
+static bool map_archive_open(const char *archive_path)
+{
+	const struct map_cache_archive_header *header;
+	int i;
+
+	nullpo_retr(false, archive_path);
+
+	map->archive_close();
+
+#ifndef _WIN32
+	{
+		struct stat st;
+		int fd = open(archive_path, O_RDONLY);
+
+		if (fd < 0)
+			return false;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED) {
+				map_archive.data = data;
+				map_archive.size = (size_t)st.st_size;
+				map_archive.mapped = true;
+			}
+		}
+		close(fd);
+	}
+#endif // _WIN32
+
+	if (map_archive.data == NULL) {
+		FILE *fp = fopen(archive_path, "rb");
+		long file_size;
+
+		if (fp == NULL)
+			return false;
+
+		fseek(fp, 0, SEEK_END);
+		file_size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+
+		if (file_size <= 0) {
+			fclose(fp);
+			ShowError("map_archive_open: Map cache archive '%s' is empty.\n", archive_path);
+			return false;
+		}
+
+		map_archive.size = (size_t)file_size;
+		map_archive.data = aMalloc(map_archive.size);
+		if (fread(map_archive.data, map_archive.size, 1, fp) < 1) {
+			fclose(fp);
+			ShowError("map_archive_open: Could not read the map cache archive '%s'.\n", archive_path);
+			map->archive_close();
+			return false;
+		}
+		fclose(fp);
+	}
+
+	header = (const struct map_cache_archive_header *)map_archive.data;
+	if (map_archive.size < sizeof(*header) || memcmp(header->magic, MAPCACHE_ARCHIVE_MAGIC, sizeof(header->magic)) != 0) {
+		ShowError("map_archive_open: '%s' is not a map cache archive.\n", archive_path);
+		map->archive_close();
+		return false;
+	}
+
+	if (header->version != MAPCACHE_ARCHIVE_VERSION) {
+		ShowError("map_archive_open: Map cache archive '%s' has unknown version '%d'.\n", archive_path, header->version);
+		map->archive_close();
+		return false;
+	}
+
+	if (header->map_count < 0 || (map_archive.size - sizeof(*header)) / sizeof(struct map_cache_archive_entry) < (size_t)header->map_count) {
+		ShowError("map_archive_open: Map cache archive '%s' is truncated.\n", archive_path);
+		map->archive_close();
+		return false;
+	}
+
+	map_archive.entries = (const struct map_cache_archive_entry *)(map_archive.data + sizeof(*header));
+	map_archive.count = header->map_count;
+
+	// map->archive_find relies on the entries being sorted by name
+	for (i = 1; i < map_archive.count; i++) {
+		if (strncmp(map_archive.entries[i - 1].name, map_archive.entries[i].name, MAP_NAME_LENGTH) >= 0) {
+			ShowError("map_archive_open: Map cache archive '%s' isn't sorted by map name.\n", archive_path);
+			map->archive_close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Releases the packed map cache archive.
+ */
+static void map_archive_close(void)
+{
+	if (map_archive.data != NULL) {
+#ifndef _WIN32
+		if (map_archive.mapped)
+			munmap(map_archive.data, map_archive.size);
+		else
+#endif // _WIN32
+			aFree(map_archive.data);
+	}
+	memset(&map_archive, 0, sizeof(map_archive));
+}
+
+static int map_archive_entry_cmp(const void *key, const void *entry)
+{
+	return strncmp(key, ((const struct map_cache_archive_entry *)entry)->name, MAP_NAME_LENGTH);
+}
+
+/**
+ * Looks up a map in the packed map cache archive.
+ *
+ * @param mapname The map name.
+ * @return The archive entry, or NULL if the map isn't in the archive.
+ */
+static const struct map_cache_archive_entry *map_archive_find(const char *mapname)
+{
+	nullpo_retr(NULL, mapname);
+
+	if (map_archive.count == 0)
+		return NULL;
+
+	return bsearch(mapname, map_archive.entries, map_archive.count, sizeof(map_archive.entries[0]), map_archive_entry_cmp);
+}
+
+/**
+ * Worker callback of map->readfromarchive: checks and decodes the cells of
+ * one map into its pre-allocated cell array.
+ *
+ * @param m    Index of the map.
+ * @param data Array of map->count flags, set for the maps that failed.
+ */
+static void map_readfromarchive_sub(int16 m, void *data)
+{
+	struct map_data *md = &map->list[m];
+	const struct map_cache_archive_entry *entry = map->archive_find(md->name);
+	bool *failed = data;
+	char decode_buffer[MAX_MAP_SIZE];
+	unsigned long size = (unsigned long)md->xs * (unsigned long)md->ys;
+	unsigned long xy;
+	uint8 md5buf[16];
+
+	if (entry == NULL) {
+		failed[m] = true;
+		return;
+	}
+
+	md5->binary(map_archive.data + entry->offset, entry->len, md5buf);
+	if (memcmp(md5buf, entry->md5_checksum, sizeof(md5buf)) != 0) {
+		failed[m] = true;
+		return;
+	}
+
+	if (grfio->decode_zip(decode_buffer, &size, map_archive.data + entry->offset, entry->len) != 0
+	 || size != (unsigned long)md->xs * (unsigned long)md->ys) {
+		failed[m] = true;
+		return;
+	}
+
+	for (xy = 0; xy < size; ++xy)
+		md->cell[xy] = map->gat2cell(decode_buffer[xy]);
+}
+
+/**
+ * Loads the cells of every listed map found in the packed map cache archive,
+ * decoding them in parallel on the map worker pool.
+ *
+ * Maps that aren't in the archive, or whose entry is damaged, are left with
+ * a NULL cell array so map->readallmaps falls back to their own mapcache file.
+ *
+ * @return The number of maps loaded from the archive.
+ */
+static int map_readfromarchive(void)
+{
+	int16 *maps;
+	bool *failed;
+	int i, count = 0, loaded = 0;
+
+	for (i = 0; i < map->count; i++) {
+		map->list[i].cell = NULL;
+		map->list[i].cell_buf.data = NULL;
+		map->list[i].cell_buf.len = 0;
+	}
+
+	if (!map->archive_open(MAPCACHE_ARCHIVE_PATH))
+		return 0;
+
+	CREATE(maps, int16, map->count);
+	CREATE(failed, bool, map->count);
+
+	for (i = 0; i < map->count; i++) {
+		struct map_data *m = &map->list[i];
+		const struct map_cache_archive_entry *entry = map->archive_find(m->name);
+
+		if (entry == NULL)
+			continue;
+
+		if (entry->xs <= 0 || entry->ys <= 0 || (int)entry->xs * (int)entry->ys > MAX_MAP_SIZE
+		 || entry->len <= 0 || entry->offset > map_archive.size || (size_t)entry->len > map_archive.size - entry->offset) {
+			ShowError("map_readfromarchive: Invalid archive entry for map '%s', using its mapcache file.\n", m->name);
+			continue;
+		}
+
+		m->xs = entry->xs;
+		m->ys = entry->ys;
+		CREATE(m->cell, struct mapcell, (int)m->xs * (int)m->ys);
+		maps[count++] = (int16)i;
+	}
+
+	map->workers_run(map->readfromarchive_sub, maps, count, failed);
+
+	for (i = 0; i < count; i++) {
+		struct map_data *m = &map->list[maps[i]];
+
+		if (failed[maps[i]]) {
+			ShowError("map_readfromarchive: Corrupted cell data for map '%s' in the archive, using its mapcache file.\n", m->name);
+			aFree(m->cell);
+			m->cell = NULL;
+			continue;
+		}
+		loaded++;
+	}
+
+	aFree(maps);
+	aFree(failed);
+	map->archive_close();
+
+	return loaded;
+}
+
 /**
  * Adds a new empty map to the map list.
  *
@@ -3585,6 +4158,7 @@ static bool map_readfromcache_v1(FILE *fp, struct map_data *m, unsigned int file
 static int map_addmap(const char *mapname)
 {
 	map->list[map->count].instance_id = -1;
+	map->list[map->count].cell_blocks = NULL;
 	mapindex->getmapname(mapname, map->list[map->count++].name);
 	return 0;
 }
@@ -3697,12 +4271,9 @@ static void map_clean(int i)
 {
 	Assert_retv(i >= 0 && i < map->count);
 
-	if (map->list[i].cell && map->list[i].cell != (struct mapcell *)0xdeadbeaf)
-		aFree(map->list[i].cell);
-	if (map->list[i].block)
-		aFree(map->list[i].block);
-	if (map->list[i].block_mob)
-		aFree(map->list[i].block_mob);
+	map->cell_free(&map->list[i]);
+	map->free_blocks(&map->list[i]);
+	path->region_clear(&map->list[i]);
 
 	if (battle_config.dynamic_mobs != 0) { //Dynamic mobs flag by [random]
 		if (map->list[i].mob_delete_timer != INVALID_TIMER)
@@ -3981,16 +4552,17 @@ static int map_readallmaps(void)
 {
 	int i;
 	int maps_removed = 0;
+	int archived = 0;
+	int64 start = timer->gettick_nocache();
 
 	if (map->enable_grf) {
 		ShowStatus("Loading maps (using GRF files)...\n");
 	} else {
 		ShowStatus("Loading maps using map cache files...\n");
+		archived = map->readfromarchive();
 	}
 
 	for(i = 0; i < map->count; i++) {
-		size_t size;
-
 		// show progress
 		if(map->enable_grf)
 			ShowStatus("Loading maps [%i/%i]: %s"CL_CLL"\r", i, map->count, map->list[i].name);
@@ -3999,7 +4571,7 @@ static int map_readallmaps(void)
 		if( !
 			(map->enable_grf?
 			map->readgat(&map->list[i])
-			:map->readfromcache(&map->list[i]))
+			:(map->list[i].cell != NULL || map->readfromcache(&map->list[i])))
 			) {
 				map->delmapid(i);
 				maps_removed++;
@@ -4030,9 +4602,7 @@ static int map_readallmaps(void)
 		map->list[i].bxs = (map->list[i].xs + BLOCK_SIZE - 1) / BLOCK_SIZE;
 		map->list[i].bys = (map->list[i].ys + BLOCK_SIZE - 1) / BLOCK_SIZE;
 
-		size = map->list[i].bxs * map->list[i].bys * sizeof(struct block_list*);
-		map->list[i].block = (struct block_list**)aCalloc(1, size);
-		map->list[i].block_mob = (struct block_list**)aCalloc(1, size);
+		map->alloc_blocks(&map->list[i]);
 
 		map->list[i].getcellp = map->sub_getcellp;
 		map->list[i].setcell  = map->sub_setcell;
@@ -4043,6 +4613,9 @@ static int map_readallmaps(void)
 
 	// finished map loading
 	ShowInfo("Successfully loaded '"CL_WHITE"%d"CL_RESET"' maps."CL_CLL"\n",map->count);
+	if (!map->enable_grf)
+		ShowInfo("Map cells loaded in '"CL_WHITE"%"PRId64""CL_RESET"' ms ('"CL_WHITE"%d"CL_RESET"' from the map cache archive, the rest from per-map mapcache files).\n",
+		         timer->gettick_nocache() - start, archived);
 	instance->start_id = map->count; // Next Map Index will be instances
 
 	if (maps_removed)
@@ -4317,6 +4890,12 @@ static bool map_config_read(const char *filename, bool imported)
 	libconfig->setting_lookup_mutable_string(setting, "charhelp_txt", map->charhelp_txt, sizeof(map->charhelp_txt));
 	libconfig->setting_lookup_bool(setting, "enable_spy", &map->enable_spy);
 	libconfig->setting_lookup_bool(setting, "use_grf", &map->enable_grf);
+	if (libconfig->setting_lookup_int(setting, "worker_threads", &map->worker_threads) == CONFIG_TRUE) {
+		if (map->worker_threads < 0)
+			map->worker_threads = 0;
+		else if (map->worker_threads > MAX_MAP_WORKER_THREADS)
+			map->worker_threads = MAX_MAP_WORKER_THREADS;
+	}
 	libconfig->setting_lookup_mutable_string(setting, "default_language", map->default_lang_str, sizeof(map->default_lang_str));
 
 	if (!map->config_read_console(filename, &config, imported))
@@ -6470,6 +7049,173 @@ static void map_lock_check(const char *file, const char *func, int line, int loc
 	}
 }
 
+/// Map worker pool state (see map_workers_run).
+static struct {
+	struct thread_handle **threads;
+	int thread_count;
+	struct mutex_data *lock;
+	struct cond_data *wake; ///< Signalled when a new batch is posted or on shutdown.
+	struct cond_data *done; ///< Signalled when the last map of a batch is finished.
+	unsigned int generation;
+	bool shutdown;
+	/* current batch */
+	MapWorkerFunc func;
+	void *data;
+	const int16 *maps;
+	int map_count;
+	int next;     ///< Next index into maps to be claimed.
+	int finished; ///< Number of maps already processed.
+} map_workers;
+
+/**
+ * Claims and processes maps of the current batch until none are left.
+ * Must be called with map_workers.lock held; the lock is released while
+ * the batch function runs.
+ */
+static void map_workers_drain(void)
+{
+	while (map_workers.next < map_workers.map_count) {
+		int16 m = map_workers.maps[map_workers.next++];
+		MapWorkerFunc func = map_workers.func;
+		void *data = map_workers.data;
+
+		mutex->unlock(map_workers.lock);
+		func(m, data);
+		mutex->lock(map_workers.lock);
+
+		if (++map_workers.finished == map_workers.map_count)
+			mutex->cond_broadcast(map_workers.done);
+	}
+}
+
+/**
+ * Entry point of the map worker threads.
+ */
+static void *map_worker_main(void *param)
+{
+	unsigned int seen = 0;
+
+	mutex->lock(map_workers.lock);
+	while (true) {
+		while (!map_workers.shutdown && map_workers.generation == seen)
+			mutex->cond_wait(map_workers.wake, map_workers.lock, -1);
+		if (map_workers.shutdown)
+			break;
+		seen = map_workers.generation;
+		map_workers_drain();
+	}
+	mutex->unlock(map_workers.lock);
+
+	return NULL;
+}
+
+/**
+ * Starts the map worker pool (map_configuration/worker_threads).
+ *
+ * With no workers configured, map->workers_run processes every map on the
+ * main thread.
+ */
+static void map_workers_init(void)
+{
+	int i;
+
+	memset(&map_workers, 0, sizeof(map_workers));
+
+	if (map->worker_threads <= 0)
+		return;
+
+	map_workers.lock = mutex->create();
+	map_workers.wake = mutex->cond_create();
+	map_workers.done = mutex->cond_create();
+	CREATE(map_workers.threads, struct thread_handle *, map->worker_threads);
+
+	for (i = 0; i < map->worker_threads; i++) {
+		if ((map_workers.threads[i] = thread->create(map_worker_main, NULL)) == NULL) {
+			ShowError("map_workers_init: failed to create worker thread %d, continuing with %d.\n", i + 1, i);
+			break;
+		}
+	}
+	map_workers.thread_count = i;
+	ShowInfo("Map worker pool started with '"CL_WHITE"%d"CL_RESET"' threads.\n", map_workers.thread_count);
+}
+
+/**
+ * Stops and joins the map worker pool.
+ */
+static void map_workers_final(void)
+{
+	int i;
+
+	if (map_workers.lock == NULL)
+		return;
+
+	mutex->lock(map_workers.lock);
+	map_workers.shutdown = true;
+	mutex->cond_broadcast(map_workers.wake);
+	mutex->unlock(map_workers.lock);
+
+	for (i = 0; i < map_workers.thread_count; i++)
+		thread->wait(map_workers.threads[i], NULL);
+
+	aFree(map_workers.threads);
+	mutex->cond_destroy(map_workers.wake);
+	mutex->cond_destroy(map_workers.done);
+	mutex->destroy(map_workers.lock);
+	memset(&map_workers, 0, sizeof(map_workers));
+}
+
+/**
+ * Runs func once for every map in maps, spreading the maps over the worker
+ * pool. The calling thread takes part in the work and the call returns once
+ * every map has been processed.
+ *
+ * func runs concurrently with itself and must only read shared map-server
+ * state (no allocations, packets, timers or console output); whatever it
+ * computes is stored per map and applied by the caller afterwards.
+ *
+ * @param func  Function to run for each map.
+ * @param maps  Map indexes to process.
+ * @param count Number of entries in maps.
+ * @param data  Extra argument for func.
+ */
+static void map_workers_run(MapWorkerFunc func, const int16 *maps, int count, void *data)
+{
+	int i;
+
+	nullpo_retv(func);
+
+	if (count <= 0)
+		return;
+
+	nullpo_retv(maps);
+
+	if (map_workers.thread_count == 0 || count == 1) {
+		for (i = 0; i < count; i++)
+			func(maps[i], data);
+		return;
+	}
+
+	mutex->lock(map_workers.lock);
+	map_workers.func = func;
+	map_workers.data = data;
+	map_workers.maps = maps;
+	map_workers.map_count = count;
+	map_workers.next = 0;
+	map_workers.finished = 0;
+	map_workers.generation++;
+	mutex->cond_broadcast(map_workers.wake);
+
+	map_workers_drain();
+	while (map_workers.finished < map_workers.map_count)
+		mutex->cond_wait(map_workers.done, map_workers.lock, -1);
+
+	map_workers.func = NULL;
+	map_workers.data = NULL;
+	map_workers.maps = NULL;
+	map_workers.map_count = 0;
+	mutex->unlock(map_workers.lock);
+}
+
 /*==========================================
  * map destructor
  *------------------------------------------*/
@@ -6533,6 +7279,7 @@ int do_final(void)
 	pc->final();
 	pet->final();
 	mob->final();
+	map->workers_final();
 	homun->final();
 	atcommand->final_msg();
 	skill->final();
@@ -7017,12 +7764,12 @@ int do_init(int argc, char *argv[])
 	}
 	script->config_read(map->SCRIPT_CONF_NAME, false);
 
-	map->id_db     = idb_alloc(DB_OPT_BASE);
-	map->pc_db     = idb_alloc(DB_OPT_BASE); //Added for reliable map->id2sd() use. [Skotlex]
-	map->mobid_db  = idb_alloc(DB_OPT_BASE); //Added to lower the load of the lazy mob AI. [Skotlex]
+	map->id_db     = idb_alloc(DB_OPT_OPEN_ADDRESSING);
+	map->pc_db     = idb_alloc(DB_OPT_OPEN_ADDRESSING); //Added for reliable map->id2sd() use. [Skotlex]
+	map->mobid_db  = idb_alloc(DB_OPT_OPEN_ADDRESSING); //Added to lower the load of the lazy mob AI. [Skotlex]
 	map->bossid_db = idb_alloc(DB_OPT_BASE); // Used for Convex Mirror quick MVP search
 	map->nick_db   = idb_alloc(DB_OPT_BASE);
-	map->charid_db = idb_alloc(DB_OPT_BASE);
+	map->charid_db = idb_alloc(DB_OPT_OPEN_ADDRESSING);
 	map->regen_db  = idb_alloc(DB_OPT_BASE); // efficient status_natural_heal processing
 	map->iwall_db  = strdb_alloc(DB_OPT_DUP_KEY|DB_OPT_RELEASE_DATA, 2*NAME_LENGTH+2+1); // [Zephyrus] Invisible Walls
 	map->zone_db   = strdb_alloc(DB_OPT_DUP_KEY|DB_OPT_RELEASE_DATA, MAP_ZONE_NAME_LENGTH);
@@ -7055,6 +7802,10 @@ int do_init(int argc, char *argv[])
 	if (map->enable_grf)
 		grfio->init(map->GRF_PATH_FILENAME);
 
+	// Started before the maps are loaded so that they are decoded in parallel.
+	if (!minimal)
+		map->workers_init();
+
 	map->readallmaps();
 
 	if (!minimal) {
@@ -7062,7 +7813,6 @@ int do_init(int argc, char *argv[])
 		timer->add_func_list(map->clearflooritem_timer, "map_clearflooritem_timer");
 		timer->add_func_list(map->removemobs_timer, "map_removemobs_timer");
 		timer->add_interval(timer->gettick()+1000, map->freeblock_timer, 0, 0, 60*1000);
-
 	}
 	HPM->event(HPET_INIT);
 
@@ -7187,6 +7937,7 @@ void map_defaults(void)
 	map->agit2_flag = 0;
 	map->night_flag = 0; // 0=day, 1=night [Yor]
 	map->enable_spy = 0; //To enable/disable @spy commands, which consume too much cpu time when sending packets. [Skotlex]
+	map->worker_threads = 0;
 
 	map->INTER_CONF_NAME="conf/common/inter-server.conf";
 	map->LOG_CONF_NAME="conf/map/logs.conf";
@@ -7264,6 +8015,11 @@ PRAGMA_GCC9(GCC diagnostic pop)
 	map->setgatcell = map_setgatcell;
 
 	map->cellfromcache = map_cellfromcache;
+	map->cell_share = map_cell_share;
+	map->cell_free = map_cell_free;
+	map->cell_shared = map_cell_shared;
+	map->cell_ref = map_cell_ref;
+	map->cell_unshare = map_cell_unshare;
 	// users
 	map->setusers = map_setusers;
 	map->getusers = map_getusers;
@@ -7312,6 +8068,8 @@ PRAGMA_GCC9(GCC diagnostic pop)
 
 	map->vforeachinrange = map_vforeachinrange;
 	map->foreachinrange = map_foreachinrange;
+	map->getall_inrange = map_getall_inrange;
+	map->foreachinlist = map_foreachinlist;
 	map->vforeachinshootrange = map_vforeachinshootrange;
 	map->foreachinshootrange = map_foreachinshootrange;
 	map->vforeachinarea = map_vforeachinarea;
@@ -7394,6 +8152,11 @@ PRAGMA_GCC9(GCC diagnostic pop)
 	map->iwall_nextxy = map_iwall_nextxy;
 	map->readfromcache = map_readfromcache;
 	map->readfromcache_v1 = map_readfromcache_v1;
+	map->archive_open = map_archive_open;
+	map->archive_close = map_archive_close;
+	map->archive_find = map_archive_find;
+	map->readfromarchive = map_readfromarchive;
+	map->readfromarchive_sub = map_readfromarchive_sub;
 	map->addmap = map_addmap;
 	map->delmapid = map_delmapid;
 	map->zone_db_clear = map_zone_db_clear;
@@ -7436,6 +8199,14 @@ PRAGMA_GCC9(GCC diagnostic pop)
 	map->zone_clear_single = map_zone_clear_single;
 
 	map->lock_check = map_lock_check;
+
+	map->bl_type_index = map_bl_type_index;
+	map->alloc_blocks = map_alloc_blocks;
+	map->free_blocks = map_free_blocks;
+
+	map->workers_init = map_workers_init;
+	map->workers_final = map_workers_final;
+	map->workers_run = map_workers_run;
 }
 
 void mapit_defaults(void)
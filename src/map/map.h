@@ -341,6 +341,26 @@ enum bl_type {
 	BL_ALL   = 0xFFF,
 };
 
+/// Number of single bl_type values kept apart in map blocks.
+#define MAP_BLOCK_TYPES 10
+STATIC_ASSERT((1 << (MAP_BLOCK_TYPES - 1)) == BL_ELEM, "MAP_BLOCK_TYPES must cover every single bl_type.");
+
+/**
+ * Objects standing in one map block, grouped by type.
+ *
+ * Objects of type slot t (see map->bl_type_index) are stored in
+ * data[offset[t]] .. data[offset[t + 1] - 1], so area queries only visit
+ * the types they ask for.
+ */
+struct map_block {
+	uint16 capacity;
+	uint16 offset[MAP_BLOCK_TYPES + 1]; ///< offset[MAP_BLOCK_TYPES] is the number of objects.
+	struct block_list *data[];
+};
+
+/// NPCs whose touch area overlaps a block of a map (see npc->touch_index_add).
+VECTOR_STRUCT_DECL(npc_touch_list, struct npc_data *);
+
 enum npc_subtype { WARP, SHOP, SCRIPT, CASHSHOP, TOMB };
 
 /** optional flags for script labels, used by the label db */
@@ -957,18 +977,27 @@ struct map_data {
 	char name[MAP_NAME_LENGTH];
 	uint16 index; // The map index used by the mapindex* functions.
 	struct mapcell* cell; // Holds the information of each map cell (NULL if the map is not on this map-server).
+	/**
+	 * Instance maps share the cells of their source map and keep a private
+	 * copy of each BLOCK_SIZE x BLOCK_SIZE block of cells they change, indexed
+	 * by block (bx + by * bxs). NULL for maps owning their cells.
+	 */
+	struct mapcell **cell_blocks;
+	uint16 *path_region; // Connectivity region of each cell, built on demand (see path->region_build)
 
 	/* 2D Orthogonal Range Search: Grid Implementation
 	   "Algorithms in Java, Parts 1-4" 3.18, Robert Sedgewick
 	   Map is divided into squares, called blocks (side length = BLOCK_SIZE).
-	   For each block there is a linked list of objects in that block (block_list).
+	   For each block there is an array of the objects in that block, grouped
+	   by type (see struct map_block), allocated when the first object is
+	   placed in the block.
 	   Array provides capability to access immediately the set of objects close
 	   to a given object.
-	   The linked lists provide the flexibility to store the objects without
-	   knowing ahead how many objects fall into each block.
 	*/
-	struct block_list **block; // Grid array of block_lists containing only non-BL_MOB objects
-	struct block_list **block_mob; // Grid array of block_lists containing only BL_MOB objects
+	struct map_block **block; // Grid array of blocks (NULL while a block never held an object)
+	int type_count[MAP_BLOCK_TYPES]; // Objects on the map per type, lets queries skip absent types at once
+	unsigned int block_changes; // Bumped whenever an object is added to, removed from or moved on the map
+	struct npc_touch_list *npc_touch; // Touch area NPCs of each block (bx + by * bxs), NULL while the map has none
 
 	int16 m;
 	int16 xs,ys; // map dimensions (in cells)
@@ -1228,6 +1257,17 @@ static inline const struct block_list *BL_UCCAST_(const struct block_list *bl)
 #define BL_UCCAST(type_, bl) \
 	((const T ## type_ *)BL_UCCAST_(bl))
 
+/// Upper bound for map_configuration/worker_threads.
+#define MAX_MAP_WORKER_THREADS 32
+
+/**
+ * Per-map callback run by the map worker pool (see map->workers_run).
+ *
+ * @param m    Index of the map to process.
+ * @param data Extra argument given to map->workers_run.
+ */
+typedef void (*MapWorkerFunc)(int16 m, void *data);
+
 struct charid_request {
 	struct charid_request* next;
 	int charid;// who want to be notified of the nick
@@ -1248,6 +1288,28 @@ struct map_cache_header {
 	int16 ys;
 	int32 len;
 } __attribute__((packed));
+
+#define MAPCACHE_ARCHIVE_PATH "maps/" DBPATH "mapcache.pack"
+#define MAPCACHE_ARCHIVE_MAGIC "HMCA"
+#define MAPCACHE_ARCHIVE_VERSION 2
+
+/// Header of the packed map cache archive, followed by map_count entries sorted by name.
+struct map_cache_archive_header {
+	char magic[4]; ///< MAPCACHE_ARCHIVE_MAGIC
+	int16 version; ///< MAPCACHE_ARCHIVE_VERSION
+	int16 reserved;
+	int32 map_count;
+} __attribute__((packed));
+
+/// Index entry of a map in the packed map cache archive.
+struct map_cache_archive_entry {
+	char name[MAP_NAME_LENGTH];
+	uint8 md5_checksum[16]; ///< Checksum of the compressed cells.
+	int16 xs;
+	int16 ys;
+	int32 len;              ///< Length of the compressed cells.
+	uint32 offset;          ///< Position of the compressed cells from the start of the archive.
+} __attribute__((packed));
 #if !defined(sun) && (!defined(__NETBSD__) || __NetBSD_Version__ >= 600000000) // NetBSD 5 and Solaris don't like pragma pack but accept the packed attribute
 #pragma pack(pop)
 #endif // not NetBSD < 6 / Solaris
@@ -1277,6 +1339,7 @@ struct map_interface {
 	int agit2_flag;
 	int night_flag; // 0=day, 1=night [Yor]
 	int enable_spy; //Determines if @spy commands are active.
+	int worker_threads; ///< Number of map worker threads (0 = disabled).
 	char db_path[256];
 
 	char help_txt[256];
@@ -1363,6 +1426,11 @@ END_ZEROED_BLOCK;
 	void (*setgatcell) (int16 m, int16 x, int16 y, int gat);
 
 	void (*cellfromcache) (struct map_data *m);
+	void (*cell_share) (struct map_data *m, const struct map_data *src);
+	void (*cell_free) (struct map_data *m);
+	struct mapcell (*cell_shared) (const struct map_data *m, int16 x, int16 y);
+	struct mapcell *(*cell_ref) (struct map_data *m, int16 x, int16 y);
+	void (*cell_unshare) (int16 m, int16 x, int16 y);
 	// users
 	void (*setusers) (int);
 	int (*getusers) (void);
@@ -1411,6 +1479,8 @@ END_ZEROED_BLOCK;
 
 	int (*vforeachinrange) (int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, va_list ap);
 	int (*foreachinrange) (int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, ...);
+	int (*getall_inrange) (int16 m, int16 x, int16 y, int16 range, int type, struct block_list **out, int size);
+	int (*foreachinlist) (int (*func)(struct block_list*,va_list), struct block_list **list, int count, ...);
 	int (*vforeachinshootrange) (int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, va_list ap);
 	int (*foreachinshootrange) (int (*func)(struct block_list*,va_list), struct block_list* center, int16 range, int type, ...);
 	int (*vforeachinarea) (int (*func)(struct block_list*,va_list), int16 m, int16 x0, int16 y0, int16 x1, int16 y1, int type, va_list ap);
@@ -1494,6 +1564,11 @@ END_ZEROED_BLOCK;
 	void (*iwall_nextxy) (int16 x, int16 y, int8 dir, int pos, int16 *x1, int16 *y1);
 	bool (*readfromcache) (struct map_data *m);
 	bool (*readfromcache_v1) (FILE *fp, struct map_data *m, unsigned int file_size);
+	bool (*archive_open) (const char *path);
+	void (*archive_close) (void);
+	const struct map_cache_archive_entry *(*archive_find) (const char *mapname);
+	int (*readfromarchive) (void);
+	void (*readfromarchive_sub) (int16 m, void *data);
 	int (*addmap) (const char *mapname);
 	void (*delmapid) (int id);
 	void (*zone_db_clear) (void);
@@ -1531,6 +1606,14 @@ END_ZEROED_BLOCK;
 	struct map_zone_data *(*merge_zone) (struct map_zone_data *main, struct map_zone_data *other);
 	void (*zone_clear_single) (struct map_zone_data *zone);
 	void (*lock_check) (const char *file, const char *func, int line, int lock_count);
+
+	int (*bl_type_index) (enum bl_type type);
+	void (*alloc_blocks) (struct map_data *mapdata);
+	void (*free_blocks) (struct map_data *mapdata);
+
+	void (*workers_init) (void);
+	void (*workers_final) (void);
+	void (*workers_run) (MapWorkerFunc func, const int16 *maps, int count, void *data);
 };
 
 #ifdef HERCULES_CORE
@@ -24,6 +24,7 @@
 #include "map/script.h"
 #include "common/db.h"
 #include "common/hercules.h"
+#include "common/strlib.h"
 
 /** Forward Declarations **/
 struct config_setting_t;
@@ -33,6 +34,10 @@ struct eri;
 #define MAPREG_AUTOSAVE_INTERVAL (300 * 1000) //!< Interval for auto-saving permanent global variables to the database in milliseconds.
 #endif /** MAPREG_AUTOSAVE_INTERVAL **/
 
+#ifndef MAPREG_SAVE_BATCH_LENGTH
+#define MAPREG_SAVE_BATCH_LENGTH 65536 //!< Length in bytes after which a bulk save statement is sent to the database.
+#endif /** MAPREG_SAVE_BATCH_LENGTH **/
+
 /** Global variable structure. **/
 struct mapreg_save {
 	int64 uid;         //!< The variable's unique ID.
@@ -50,6 +55,7 @@ struct mapreg_interface {
 	struct eri *ers;    //!< Entry manager for global variables.
 	struct reg_db regs; //!< Generic database for global variables.
 	bool dirty;         //!< Whether there are modified global variables to be saved.
+	VECTOR_DECL(int64) dirty_uids; //!< Unique IDs of the modified global variables, in the order they changed.
 	bool skip_insert;   //!< Whether to skip inserting the variable into the SQL database in mapreg_set_*_db().
 	char num_db[32];    //!< Name of SQL table which holds permanent global integer variables.
 	char str_db[32];    //!< Name of SQL table which holds permanent global string variables.
@@ -66,8 +72,8 @@ struct mapreg_interface {
 	void (*load_num_db) (void);
 	void (*load_str_db) (void);
 	void (*load) (void);
-	void (*save_num_db) (const char *name, unsigned int index, int value);
-	void (*save_str_db) (const char *name, unsigned int index, const char *value);
+	void (*save_add) (StringBuf *buf, int *count, const char *table, const struct mapreg_save *var);
+	void (*save_flush) (StringBuf *buf, int *count);
 	void (*save) (void);
 	int (*save_timer) (int tid, int64 tick, int id, intptr_t data);
 	int (*destroyreg) (union DBKey key, struct DBData *data, va_list ap);
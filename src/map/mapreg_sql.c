@@ -92,8 +92,10 @@ static bool mapreg_set_num_db(int64 uid, const char *name, unsigned int index, i
 	if (var != NULL) {
 		var->u.i = value;
 
-		if (script->is_permanent_variable(name)) {
+		if (script->is_permanent_variable(name) && !var->save) {
 			var->save = true;
+			VECTOR_ENSURE(mapreg->dirty_uids, 1, 64);
+			VECTOR_PUSH(mapreg->dirty_uids, uid);
 			mapreg->dirty = true;
 		}
 
@@ -237,8 +239,10 @@ static bool mapreg_set_str_db(int64 uid, const char *name, unsigned int index, c
 
 		var->u.str = aStrdup(value);
 
-		if (script->is_permanent_variable(name)) {
+		if (script->is_permanent_variable(name) && !var->save) {
 			var->save = true;
+			VECTOR_ENSURE(mapreg->dirty_uids, 1, 64);
+			VECTOR_PUSH(mapreg->dirty_uids, uid);
 			mapreg->dirty = true;
 		}
 
@@ -469,103 +473,111 @@ static void mapreg_load(void)
 }
 
 /**
- * Saves a permanent global integer variable to the database.
+ * Adds a changed permanent global variable to a bulk save statement.
  *
- * @param name The variable's name.
- * @param index The variable's array index.
- * @param value The variable's value.
+ * @param buf The statement being built.
+ * @param count Number of variables already in the statement.
+ * @param table The table the variable is saved to.
+ * @param var The variable.
  *
  **/
-static void mapreg_save_num_db(const char *name, unsigned int index, int value)
+static void mapreg_save_add(StringBuf *buf, int *count, const char *table, const struct mapreg_save *var)
 {
-	nullpo_retv(name);
-	Assert_retv(*name != '\0');
-	Assert_retv(strlen(name) <= SCRIPT_VARNAME_LENGTH);
+	nullpo_retv(buf);
+	nullpo_retv(count);
+	nullpo_retv(table);
+	nullpo_retv(var);
 
-	struct SqlStmt *stmt = SQL->StmtMalloc(map->mysql_handle);
+	const char *name = script->get_str(script_getvarid(var->uid));
+	unsigned int index = script_getvaridx(var->uid);
+	char esc_name[SCRIPT_VARNAME_LENGTH * 2 + 1];
 
-	if (stmt == NULL) {
-		SqlStmt_ShowDebug(stmt);
-		return;
-	}
+	SQL->EscapeStringLen(map->mysql_handle, esc_name, name, strnlen(name, SCRIPT_VARNAME_LENGTH));
 
-	const char *query = "UPDATE `%s` SET `value`=? WHERE `key`=? AND `index`=? LIMIT 1";
+	if ((*count)++ == 0)
+		StrBuf->Printf(buf, "INSERT INTO `%s` (`key`, `index`, `value`) VALUES ", table);
+	else
+		StrBuf->AppendStr(buf, ",");
 
-	if (SQL_ERROR == SQL->StmtPrepare(stmt, query, mapreg->num_db)
-	    || SQL_ERROR == SQL->StmtBindParam(stmt, 0, SQLDT_INT32, &value, sizeof(value))
-	    || SQL_ERROR == SQL->StmtBindParam(stmt, 1, SQLDT_STRING, name, strlen(name))
-	    || SQL_ERROR == SQL->StmtBindParam(stmt, 2, SQLDT_UINT32, &index, sizeof(index))
-	    || SQL_ERROR == SQL->StmtExecute(stmt)) {
-		SqlStmt_ShowDebug(stmt);
-	}
+	if (var->is_string) {
+		char esc_value[SCRIPT_STRING_VAR_LENGTH * 2 + 1];
 
-	SQL->StmtFree(stmt);
+		SQL->EscapeStringLen(map->mysql_handle, esc_value, var->u.str, strnlen(var->u.str, SCRIPT_STRING_VAR_LENGTH));
+		StrBuf->Printf(buf, "('%s','%u','%s')", esc_name, index, esc_value);
+	} else {
+		StrBuf->Printf(buf, "('%s','%u','%d')", esc_name, index, var->u.i);
+	}
 }
 
 /**
- * Saves a permanent global string variable to the database.
+ * Runs a bulk save statement built by mapreg_save_add() and empties it.
  *
- * @param name The variable's name.
- * @param index The variable's array index.
- * @param value The variable's value.
+ * @param buf The statement.
+ * @param count Number of variables in the statement.
  *
  **/
-static void mapreg_save_str_db(const char *name, unsigned int index, const char *value)
+static void mapreg_save_flush(StringBuf *buf, int *count)
 {
-	nullpo_retv(name);
-	nullpo_retv(value);
-	Assert_retv(*name != '\0');
-	Assert_retv(strlen(name) <= SCRIPT_VARNAME_LENGTH);
-	Assert_retv(*value != '\0');
-	Assert_retv(strlen(value) <= SCRIPT_STRING_VAR_LENGTH);
-
-	struct SqlStmt *stmt = SQL->StmtMalloc(map->mysql_handle);
+	nullpo_retv(buf);
+	nullpo_retv(count);
 
-	if (stmt == NULL) {
-		SqlStmt_ShowDebug(stmt);
+	if (*count == 0)
 		return;
-	}
 
-	const char *query = "UPDATE `%s` SET `value`=? WHERE `key`=? AND `index`=? LIMIT 1";
+	StrBuf->AppendStr(buf, " ON DUPLICATE KEY UPDATE `value`=VALUES(`value`)");
 
-	if (SQL_ERROR == SQL->StmtPrepare(stmt, query, mapreg->str_db)
-	    || SQL_ERROR == SQL->StmtBindParam(stmt, 0, SQLDT_STRING, value, strlen(value))
-	    || SQL_ERROR == SQL->StmtBindParam(stmt, 1, SQLDT_STRING, name, strlen(name))
-	    || SQL_ERROR == SQL->StmtBindParam(stmt, 2, SQLDT_UINT32, &index, sizeof(index))
-	    || SQL_ERROR == SQL->StmtExecute(stmt)) {
-		SqlStmt_ShowDebug(stmt);
-	}
+	if (SQL_ERROR == SQL->QueryStr(map->mysql_handle, StrBuf->Value(buf)))
+		Sql_ShowDebug(map->mysql_handle);
 
-	SQL->StmtFree(stmt);
+	StrBuf->Clear(buf);
+	*count = 0;
 }
 
 /**
  * Saves permanent global variables to the database.
  *
+ * Only the variables queued in mapreg->dirty_uids are visited. They are
+ * written with one multi-row upsert per table, split every
+ * MAPREG_SAVE_BATCH_LENGTH bytes.
+ *
  **/
 static void mapreg_save(void)
 {
-	if (mapreg->dirty) {
-		struct DBIterator *iter = db_iterator(mapreg->regs.vars);
-		struct mapreg_save *var = NULL;
-
-		for (var = dbi_first(iter); dbi_exists(iter); var = dbi_next(iter)) {
-			if (var->save) {
-				int index = script_getvaridx(var->uid);
-				const char *name = script->get_str(script_getvarid(var->uid));
-
-				if (!var->is_string)
-					mapreg->save_num_db(name, index, var->u.i);
-				else
-					mapreg->save_str_db(name, index, var->u.str);
-
-				var->save = false;
-			}
+	if (!mapreg->dirty)
+		return;
+
+	StringBuf num_buf, str_buf;
+	int num_count = 0, str_count = 0;
+
+	StrBuf->Init(&num_buf);
+	StrBuf->Init(&str_buf);
+
+	for (int i = 0; i < VECTOR_LENGTH(mapreg->dirty_uids); i++) {
+		struct mapreg_save *var = i64db_get(mapreg->regs.vars, VECTOR_INDEX(mapreg->dirty_uids, i));
+
+		if (var == NULL || !var->save)
+			continue; // Deleted or recreated since it was queued.
+
+		if (!var->is_string) {
+			mapreg->save_add(&num_buf, &num_count, mapreg->num_db, var);
+			if (StrBuf->Length(&num_buf) >= MAPREG_SAVE_BATCH_LENGTH)
+				mapreg->save_flush(&num_buf, &num_count);
+		} else {
+			mapreg->save_add(&str_buf, &str_count, mapreg->str_db, var);
+			if (StrBuf->Length(&str_buf) >= MAPREG_SAVE_BATCH_LENGTH)
+				mapreg->save_flush(&str_buf, &str_count);
 		}
 
-		dbi_destroy(iter);
-		mapreg->dirty = false;
+		var->save = false;
 	}
+
+	mapreg->save_flush(&num_buf, &num_count);
+	mapreg->save_flush(&str_buf, &str_count);
+	StrBuf->Destroy(&num_buf);
+	StrBuf->Destroy(&str_buf);
+
+	VECTOR_TRUNCATE(mapreg->dirty_uids);
+	mapreg->dirty = false;
 }
 
 /**
@@ -680,6 +692,7 @@ static void mapreg_final(void)
 	mapreg->save();
 	mapreg->regs.vars->destroy(mapreg->regs.vars, mapreg->destroyreg);
 	ers_destroy(mapreg->ers);
+	VECTOR_CLEAR(mapreg->dirty_uids);
 
 	if (mapreg->regs.arrays != NULL)
 		mapreg->regs.arrays->destroy(mapreg->regs.arrays, script->array_free_db);
@@ -712,6 +725,7 @@ void mapreg_defaults(void)
 	mapreg->regs.vars = NULL;
 	mapreg->regs.arrays = NULL;
 	mapreg->dirty = false;
+	VECTOR_INIT(mapreg->dirty_uids);
 	mapreg->skip_insert = false;
 	safestrncpy(mapreg->num_db, "map_reg_num_db", sizeof(mapreg->num_db));
 	safestrncpy(mapreg->str_db, "map_reg_str_db", sizeof(mapreg->str_db));
@@ -728,8 +742,8 @@ void mapreg_defaults(void)
 	mapreg->load_num_db = mapreg_load_num_db;
 	mapreg->load_str_db = mapreg_load_str_db;
 	mapreg->load = mapreg_load;
-	mapreg->save_num_db = mapreg_save_num_db;
-	mapreg->save_str_db = mapreg_save_str_db;
+	mapreg->save_add = mapreg_save_add;
+	mapreg->save_flush = mapreg_save_flush;
 	mapreg->save = mapreg_save;
 	mapreg->save_timer = mapreg_save_timer;
 	mapreg->destroyreg = mapreg_destroy_reg;
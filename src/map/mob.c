@@ -114,10 +114,23 @@ static struct mob_chat *mob_chat(short id)
  *------------------------------------------*/
 static int mobdb_searchname(const char *str)
 {
-	int i;
+	int i, id, sprite_id;
 
 	nullpo_ret(str);
-	for(i=0;i<=MAX_MOB_DB;i++){
+
+	// The indexes hold the lowest id of each name, so the first match is the smaller of both
+	id = mob->db_index_get(mob->name_index_ci, str);
+	if (battle_config.case_sensitive_aegisnames)
+		sprite_id = mob->db_index_get(mob->sprite_index, str);
+	else
+		sprite_id = mob->db_index_get(mob->sprite_index_ci, str);
+	if (id == -1 || (sprite_id != -1 && sprite_id < id))
+		id = sprite_id;
+	if (id != -1)
+		return id;
+
+	// Clones are created at runtime and are not indexed
+	for (i = MOB_CLONE_START; i <= MAX_MOB_DB; i++) {
 		struct mob_db *monster = mob->db(i);
 		if(monster == mob->dummy) //Skip dummy mobs.
 			continue;
@@ -131,6 +144,69 @@ static int mobdb_searchname(const char *str)
 
 	return 0;
 }
+
+/**
+ * Looks up a name in one of the mob name indexes.
+ * @param index name index to search
+ * @param str name to look for
+ * @return mob id, or -1 if no mob has this name
+ */
+static int mobdb_index_get(struct DBMap *index, const char *str)
+{
+	struct DBData *data;
+
+	nullpo_retr(-1, index);
+	nullpo_retr(-1, str);
+
+	data = index->get(index, DB->str2key(str));
+	if (data == NULL)
+		return -1;
+	return DB->data2i(data);
+}
+
+/**
+ * Builds the mob name indexes from the loaded mob database.
+ * Clones are left out, as they come and go at runtime.
+ */
+static void mobdb_index_build(void)
+{
+	int i;
+
+	mob->db_index_clear();
+
+	for (i = 0; i < MOB_CLONE_START; i++) {
+		struct mob_db *monster = mob->db(i);
+		if (monster == mob->dummy)
+			continue;
+
+		if (!strdb_exists(mob->name_index_ci, monster->name))
+			strdb_iput(mob->name_index_ci, monster->name, i);
+		if (!strdb_exists(mob->name_index_ci, monster->jname))
+			strdb_iput(mob->name_index_ci, monster->jname, i);
+		if (!strdb_exists(mob->sprite_index, monster->sprite))
+			strdb_iput(mob->sprite_index, monster->sprite, i);
+		if (!strdb_exists(mob->sprite_index_ci, monster->sprite))
+			strdb_iput(mob->sprite_index_ci, monster->sprite, i);
+
+		trigram_add(&mob->name_trigrams, i, monster->name);
+		trigram_add(&mob->name_trigrams, i, monster->jname);
+		trigram_add(&mob->name_trigrams, i, monster->sprite);
+	}
+
+	trigram_build(&mob->name_trigrams);
+}
+
+/**
+ * Empties the mob name indexes.
+ */
+static void mobdb_index_clear(void)
+{
+	db_clear(mob->name_index_ci);
+	db_clear(mob->sprite_index);
+	db_clear(mob->sprite_index_ci);
+	trigram_clear(&mob->name_trigrams);
+}
+
 static int mobdb_searchname_array_sub(struct mob_db *monster, const char *str, int flag)
 {
 
@@ -272,7 +348,25 @@ static int mobdb_searchname_array(struct mob_db **data, int size, const char *st
 {
 	int count = 0, i;
 	struct mob_db* monster;
+	const struct trigram_entry *entries = NULL;
+	int entry_count;
 	nullpo_ret(data);
+	nullpo_ret(str);
+
+	// Only the mobs sharing the rarest trigram of str can match it, clones are not indexed.
+	entry_count = trigram_find(&mob->name_trigrams, str, &entries);
+	if (entry_count >= 0) {
+		for (i = 0; i < entry_count; i++) {
+			monster = mob->db(entries[i].id);
+			if (!mob->db_searchname_array_sub(monster, str, flag)) {
+				if (count < size)
+					data[count] = monster;
+				count++;
+			}
+		}
+		return count;
+	}
+
 	for(i=0;i<=MAX_MOB_DB;i++){
 		monster = mob->db(i);
 		if (monster == mob->dummy || mob->is_clone(i) ) //keep clones out (or you leak player stats)
@@ -1854,7 +1948,8 @@ static bool mob_ai_sub_hard(struct mob_data *md, int64 tick)
 	}
 
 	if ((!tbl && mode&MD_AGGRESSIVE) || md->state.skillstate == MSS_FOLLOW) {
-		map->foreachinrange(mob->ai_sub_hard_activesearch, &md->bl, view_range, DEFAULT_ENEMY_TYPE(md), md, &tbl, mode);
+		if (!mob->ai_search_targets(md, view_range, &tbl, mode))
+			map->foreachinrange(mob->ai_sub_hard_activesearch, &md->bl, view_range, DEFAULT_ENEMY_TYPE(md), md, &tbl, mode);
 	} else if ((mode&MD_CHANGECHASE && (md->state.skillstate == MSS_RUSH || md->state.skillstate == MSS_FOLLOW)) || (md->sc.count && md->sc.data[SC__CHAOS])) {
 		int search_size;
 		search_size = view_range<md->status.rhw.range ? view_range:md->status.rhw.range;
@@ -1990,14 +2085,9 @@ static bool mob_ai_sub_hard(struct mob_data *md, int64 tick)
 	return true;
 }
 
-static int mob_ai_sub_hard_timer(struct block_list *bl, va_list ap)
+static void mob_ai_hard_think(struct mob_data *md, int64 tick)
 {
-	struct mob_data *md = NULL;
-	int64 tick = va_arg(ap, int64);
-
-	nullpo_ret(bl);
-	Assert_ret(bl->type == BL_MOB);
-	md = BL_UCAST(BL_MOB, bl);
+	nullpo_retv(md);
 
 	if (mob->ai_sub_hard(md, tick)) {
 		//Hard AI triggered.
@@ -2005,22 +2095,348 @@ static int mob_ai_sub_hard_timer(struct block_list *bl, va_list ap)
 			md->state.spotted = 1;
 		md->last_pcneartime = tick;
 	}
-	return 0;
 }
 
-/*==========================================
- * Serious processing for mob in PC field of view (foreachclient)
- *------------------------------------------*/
-static int mob_ai_sub_foreachclient(struct map_session_data *sd, va_list ap)
+/**
+ * Changes the number of players near md and moves it in or out of the
+ * active mob set accordingly.
+ *
+ * @param md    Mob whose counter changes.
+ * @param delta Players entering (positive) or leaving (negative) its range.
+ */
+static void mob_ai_active_update(struct mob_data *md, int delta)
 {
-	int64 tick;
-	nullpo_ret(sd);
-	tick=va_arg(ap, int64);
-	map->foreachinrange(mob->ai_sub_hard_timer,&sd->bl, AREA_SIZE+ACTIVE_AI_RANGE, BL_MOB,tick);
+	nullpo_retv(md);
 
+	md->ai_nearby += delta;
+	if (md->ai_nearby < 0)
+		md->ai_nearby = 0;
+
+	if (md->ai_nearby > 0 && md->ai_active_pos == 0) {
+		VECTOR_ENSURE(mob->ai_active, 1, 256);
+		VECTOR_PUSH(mob->ai_active, md);
+		md->ai_active_pos = VECTOR_LENGTH(mob->ai_active);
+	} else if (md->ai_nearby == 0 && md->ai_active_pos != 0) {
+		// Swap-remove, the last mob takes the freed slot.
+		struct mob_data *last = VECTOR_POP(mob->ai_active);
+
+		if (last != md) {
+			VECTOR_INDEX(mob->ai_active, md->ai_active_pos - 1) = last;
+			last->ai_active_pos = md->ai_active_pos;
+		}
+		md->ai_active_pos = 0;
+	}
+}
+
+/**
+ * Applies delta to a mob near a player that entered or left the area
+ * (foreachinarea).
+ */
+static int mob_ai_area_sub(struct block_list *bl, va_list ap)
+{
+	int delta = va_arg(ap, int);
+
+	nullpo_ret(bl);
+	Assert_ret(bl->type == BL_MOB);
+
+	mob->ai_active_update(BL_UCAST(BL_MOB, bl), delta);
 	return 0;
 }
 
+/**
+ * Updates the counters for bl entering (delta 1) or leaving (delta -1) the
+ * rectangle (x0,y0)~(x1,y1) of the AI range around it.
+ *
+ * A player changes the counter of every mob in the rectangle, a mob
+ * changes its own counter by the number of players in it.
+ */
+static void mob_ai_area_rect(struct block_list *bl, int x0, int y0, int x1, int y1, int delta)
+{
+	const struct map_data *mapdata = &map->list[bl->m];
+
+	x0 = max(x0, 0);
+	y0 = max(y0, 0);
+	x1 = min(x1, mapdata->xs - 1);
+	y1 = min(y1, mapdata->ys - 1);
+	if (x0 > x1 || y0 > y1)
+		return;
+
+	if (bl->type == BL_PC) {
+		map->foreachinarea(mob->ai_area_sub, bl->m, x0, y0, x1, y1, BL_MOB, delta);
+	} else {
+		int count = map->foreachinarea(map->count_sub, bl->m, x0, y0, x1, y1, BL_PC);
+
+		if (count != 0)
+			mob->ai_active_update(BL_UCAST(BL_MOB, bl), delta * count);
+	}
+}
+
+/**
+ * Updates the active mob set for bl entering (delta 1) or leaving
+ * (delta -1) the map at (x,y).
+ *
+ * Called by map_addblock and map_delblock. The AI range is the square of
+ * side AREA_SIZE+ACTIVE_AI_RANGE around the object.
+ *
+ * @param bl    Object added or removed, only players and mobs are counted.
+ * @param x     X-coordinate of the object.
+ * @param y     Y-coordinate of the object.
+ * @param delta 1 when entering, -1 when leaving.
+ */
+static void mob_ai_area_update(struct block_list *bl, int x, int y, int delta)
+{
+	const int range = AREA_SIZE + ACTIVE_AI_RANGE;
+
+	nullpo_retv(bl);
+
+	if (bl->type == BL_MOB && delta < 0) {
+		// A mob leaving the map no longer has anyone near it.
+		struct mob_data *md = BL_UCAST(BL_MOB, bl);
+		mob->ai_active_update(md, -md->ai_nearby);
+		return;
+	}
+	if (bl->type != BL_PC && bl->type != BL_MOB)
+		return;
+
+	mob->ai_area_rect(bl, x - range, y - range, x + range, y + range, delta);
+}
+
+/**
+ * Applies delta to the part of the AI range around (ax,ay) that is not
+ * within the AI range around (bx,by).
+ */
+static void mob_ai_area_diff(struct block_list *bl, int ax, int ay, int bx, int by, int delta)
+{
+	const int range = AREA_SIZE + ACTIVE_AI_RANGE;
+	const int ax0 = ax - range, ay0 = ay - range, ax1 = ax + range, ay1 = ay + range;
+	const int bx0 = bx - range, by0 = by - range, bx1 = bx + range, by1 = by + range;
+	const int mx0 = max(ax0, bx0), mx1 = min(ax1, bx1);
+
+	// Columns of A left and right of B, then rows of A above and below B
+	// within the columns both share.
+	if (ax0 < bx0)
+		mob->ai_area_rect(bl, ax0, ay0, min(ax1, bx0 - 1), ay1, delta);
+	if (ax1 > bx1)
+		mob->ai_area_rect(bl, max(ax0, bx1 + 1), ay0, ax1, ay1, delta);
+	if (mx0 > mx1)
+		return;
+	if (ay0 < by0)
+		mob->ai_area_rect(bl, mx0, ay0, mx1, min(ay1, by0 - 1), delta);
+	if (ay1 > by1)
+		mob->ai_area_rect(bl, mx0, max(ay0, by1 + 1), mx1, ay1, delta);
+}
+
+/**
+ * Updates the active mob set for bl moving from (x0,y0) to its current
+ * position on the same map.
+ *
+ * Called by map_moveblock, only the strips the AI range gained and lost
+ * are visited.
+ *
+ * @param bl Object that moved, only players and mobs are counted.
+ * @param x0 Previous X-coordinate.
+ * @param y0 Previous Y-coordinate.
+ */
+static void mob_ai_area_move(struct block_list *bl, int x0, int y0)
+{
+	nullpo_retv(bl);
+
+	if (bl->type != BL_PC && bl->type != BL_MOB)
+		return;
+	if (bl->x == x0 && bl->y == y0)
+		return;
+
+	// Entering first, so a mob staying in range is not dropped and re-added.
+	mob->ai_area_diff(bl, bl->x, bl->y, x0, y0, 1);
+	mob->ai_area_diff(bl, x0, y0, bl->x, bl->y, -1);
+}
+
+/**
+ * Runs the target search of the hard AI over the candidates the map worker
+ * pool found for md, instead of a map->foreachinrange.
+ *
+ * The candidates are only used while nothing was added to, removed from or
+ * moved on the map since the scan, and the mob searches the same area; the
+ * search then visits the same objects in the same order.
+ *
+ * @param md         Mob being thought.
+ * @param view_range Range of the search.
+ * @param target     Target found so far, updated like by map->foreachinrange.
+ * @param mode       Mode of the mob.
+ * @retval false if there are no usable candidates and the area must be searched.
+ */
+static bool mob_ai_search_targets(struct mob_data *md, int view_range, struct block_list **target, uint32 mode)
+{
+	const struct mob_ai_search *search = mob->ai_search;
+	const struct mob_ai_plan *plan;
+
+	nullpo_retr(false, md);
+	nullpo_retr(false, target);
+
+	if (search == NULL || search->type == 0)
+		return false;
+	if (search->m != md->bl.m || search->x != md->bl.x || search->y != md->bl.y
+	 || search->range != view_range || search->type != DEFAULT_ENEMY_TYPE(md))
+		return false;
+	plan = &mob->ai_plan[search->m];
+	if (plan->block_changes != map->list[search->m].block_changes)
+		return false;
+
+	map->foreachinlist(mob->ai_sub_hard_activesearch, VECTOR_DATA(plan->targets) + search->start, search->count, md, target, mode);
+	return true;
+}
+
+/**
+ * Finds the candidates of the target searches of map m.
+ *
+ * Runs on the map worker pool, so it only reads the map and writes to the
+ * map's plan and its own entries of mob->ai_searches. When the candidates
+ * don't fit in plan->targets, they are only counted in plan->needed and
+ * the caller runs it again after growing it.
+ *
+ * @param m    Map to scan.
+ * @param data Unused.
+ */
+static void mob_ai_plan_map(int16 m, void *data)
+{
+	struct mob_ai_plan *plan = &mob->ai_plan[m];
+	const int capacity = VECTOR_CAPACITY(plan->targets);
+	int i, n = 0;
+
+	for (i = 0; i < VECTOR_LENGTH(plan->searches); i++) {
+		struct mob_ai_search *search = &VECTOR_INDEX(mob->ai_searches, VECTOR_INDEX(plan->searches, i));
+		struct block_list **out = n < capacity ? VECTOR_DATA(plan->targets) + n : NULL;
+
+		search->start = n;
+		search->count = map->getall_inrange(m, search->x, search->y, search->range, search->type, out, n < capacity ? capacity - n : 0);
+		n += search->count;
+	}
+
+	plan->needed = n;
+	VECTOR_LENGTH(plan->targets) = min(n, capacity);
+}
+
+/**
+ * Scans the areas the active mobs will search for targets this tick,
+ * split per map over the map worker pool.
+ *
+ * Only mobs that will think and look for a new target get a search; the
+ * rest search the map themselves if they end up needing it.
+ *
+ * @param tick Current tick.
+ */
+static void mob_ai_plan_searches(int64 tick)
+{
+	int i;
+
+	if (mob->ai_plan_count < map->count) {
+		RECREATE(mob->ai_plan, struct mob_ai_plan, map->count);
+		for (i = mob->ai_plan_count; i < map->count; i++) {
+			VECTOR_INIT(mob->ai_plan[i].searches);
+			VECTOR_INIT(mob->ai_plan[i].targets);
+			mob->ai_plan[i].needed = 0;
+			mob->ai_plan[i].block_changes = 0;
+		}
+		mob->ai_plan_count = map->count;
+	}
+
+	VECTOR_TRUNCATE(mob->ai_searches);
+	VECTOR_ENSURE(mob->ai_searches, VECTOR_LENGTH(mob->ai_active_ids), 256);
+	for (i = 0; i < VECTOR_LENGTH(mob->ai_active_ids); i++) {
+		struct mob_data *md = map->id2md(VECTOR_INDEX(mob->ai_active_ids, i));
+		struct mob_ai_search search = { 0 };
+
+		if (md != NULL && md->bl.prev != NULL && md->ai_active_pos != 0 && md->status.hp > 0
+		 && DIFF_TICK(tick, md->last_thinktime) >= MIN_MOBTHINKTIME && md->ud.skilltimer == INVALID_TIMER
+		 && ((md->target_id == 0 && (status_get_mode(&md->bl)&MD_AGGRESSIVE) != 0) || md->state.skillstate == MSS_FOLLOW)) {
+			struct mob_ai_plan *plan = &mob->ai_plan[md->bl.m];
+
+			search.m = md->bl.m;
+			search.x = md->bl.x;
+			search.y = md->bl.y;
+			search.range = (md->sc.count && md->sc.data[SC_BLIND]) ? 3 : md->db->range2;
+			search.type = DEFAULT_ENEMY_TYPE(md);
+			if (VECTOR_LENGTH(plan->searches) == 0) {
+				VECTOR_ENSURE(mob->ai_plan_maps, 1, 32);
+				VECTOR_PUSH(mob->ai_plan_maps, md->bl.m);
+			}
+			VECTOR_ENSURE(plan->searches, 1, 32);
+			VECTOR_PUSH(plan->searches, i);
+		}
+		VECTOR_PUSH(mob->ai_searches, search);
+	}
+
+	map->workers_run(mob->ai_plan_map, VECTOR_DATA(mob->ai_plan_maps), VECTOR_LENGTH(mob->ai_plan_maps), NULL);
+
+	for (i = 0; i < VECTOR_LENGTH(mob->ai_plan_maps); i++) {
+		int16 m = VECTOR_INDEX(mob->ai_plan_maps, i);
+		struct mob_ai_plan *plan = &mob->ai_plan[m];
+
+		if (plan->needed > VECTOR_CAPACITY(plan->targets)) {
+			VECTOR_ENSURE(plan->targets, plan->needed, plan->needed);
+			mob->ai_plan_map(m, NULL);
+		}
+		plan->block_changes = map->list[m].block_changes;
+	}
+}
+
+/// Empties the per-map plans filled by mob->ai_plan_searches, keeping their memory.
+static void mob_ai_plan_clear(void)
+{
+	int i;
+
+	for (i = 0; i < VECTOR_LENGTH(mob->ai_plan_maps); i++) {
+		struct mob_ai_plan *plan = &mob->ai_plan[VECTOR_INDEX(mob->ai_plan_maps, i)];
+
+		VECTOR_TRUNCATE(plan->searches);
+		VECTOR_TRUNCATE(plan->targets);
+	}
+	VECTOR_TRUNCATE(mob->ai_plan_maps);
+	VECTOR_TRUNCATE(mob->ai_searches);
+}
+
+/**
+ * Runs the hard AI of every mob in the active set once.
+ *
+ * The set is copied first, as the AI can spawn, kill or move mobs.
+ * With the map worker pool enabled, the areas the mobs search for targets
+ * are scanned in parallel first (see mob->ai_plan_searches); the AI itself
+ * then runs here on the main thread, in the same order as without it.
+ *
+ * @param tick Current tick.
+ */
+static void mob_ai_hard_active(int64 tick)
+{
+	int i;
+	bool planned = false;
+
+	VECTOR_TRUNCATE(mob->ai_active_ids);
+	VECTOR_ENSURE(mob->ai_active_ids, VECTOR_LENGTH(mob->ai_active), 256);
+	for (i = 0; i < VECTOR_LENGTH(mob->ai_active); i++)
+		VECTOR_PUSH(mob->ai_active_ids, VECTOR_INDEX(mob->ai_active, i)->bl.id);
+
+	if (map->worker_threads > 0) {
+		mob->ai_plan_searches(tick);
+		planned = true;
+	}
+
+	map->freeblock_lock();
+	for (i = 0; i < VECTOR_LENGTH(mob->ai_active_ids); i++) {
+		struct mob_data *md = map->id2md(VECTOR_INDEX(mob->ai_active_ids, i));
+
+		if (md != NULL && md->bl.prev != NULL && md->ai_active_pos != 0) {
+			if (planned)
+				mob->ai_search = &VECTOR_INDEX(mob->ai_searches, i);
+			mob->ai_hard_think(md, tick);
+			mob->ai_search = NULL;
+		}
+	}
+	map->freeblock_unlock();
+
+	if (planned)
+		mob->ai_plan_clear();
+}
+
 /*==========================================
  * Negligent mode MOB AI (PC is not in near)
  *------------------------------------------*/
@@ -2038,6 +2454,9 @@ static int mob_ai_sub_lazy(struct mob_data *md, va_list args)
 	if (battle_config.mob_ai&0x20 && map->list[md->bl.m].users>0)
 		return (int)mob->ai_sub_hard(md, tick);
 
+	if (md->ai_active_pos != 0 && !(battle_config.mob_ai&0x20))
+		return 0; // Thought by the hard AI tick
+
 	if (md->bl.prev==NULL || md->status.hp == 0)
 		return 1;
 
@@ -2104,7 +2523,7 @@ static int mob_ai_hard(int tid, int64 tick, int id, intptr_t data)
 	if (battle_config.mob_ai&0x20)
 		map->foreachmob(mob->ai_sub_lazy,tick);
 	else
-		map->foreachpc(mob->ai_sub_foreachclient,tick);
+		mob->ai_hard_active(tick);
 
 	return 0;
 }
@@ -5330,6 +5749,7 @@ static void mob_readdb(void)
 		mob->read_libconfig(filename[i], i > 0 ? true : false);
 	}
 	mob->name_constants();
+	mob->db_index_build();
 }
 
 /**
@@ -6077,6 +6497,9 @@ static int do_init_mob(bool minimal)
 	memset(mob->db_data,0,sizeof(mob->db_data)); //Clear the array
 	mob->db_data[0] = (struct mob_db*)aCalloc(1, sizeof (struct mob_db)); //This mob is used for random spawns
 	mob->makedummymobdb(0); //The first time this is invoked, it creates the dummy mob
+	mob->name_index_ci = stridb_alloc(DB_OPT_BASE, NAME_LENGTH);
+	mob->sprite_index = strdb_alloc(DB_OPT_BASE, NAME_LENGTH);
+	mob->sprite_index_ci = stridb_alloc(DB_OPT_BASE, NAME_LENGTH);
 	item_drop_ers = ers_new(sizeof(struct item_drop),"mob.c::item_drop_ers",ERS_OPT_CLEAN);
 	item_drop_list_ers = ers_new(sizeof(struct item_drop_list),"mob.c::item_drop_list_ers",ERS_OPT_NONE);
 
@@ -6131,6 +6554,10 @@ static void mob_destroy_drop_groups(void)
 static int do_final_mob(void)
 {
 	int i;
+	mob->db_index_clear();
+	db_destroy(mob->name_index_ci);
+	db_destroy(mob->sprite_index);
+	db_destroy(mob->sprite_index_ci);
 	if (mob->dummy)
 	{
 		aFree(mob->dummy);
@@ -6165,6 +6592,17 @@ static int do_final_mob(void)
 	}
 	mob->item_drop_ratio_other_db->clear(mob->item_drop_ratio_other_db, mob->final_ratio_sub);
 	db_destroy(mob->item_drop_ratio_other_db);
+	VECTOR_CLEAR(mob->ai_active);
+	VECTOR_CLEAR(mob->ai_active_ids);
+	for (i = 0; i < mob->ai_plan_count; i++) {
+		VECTOR_CLEAR(mob->ai_plan[i].searches);
+		VECTOR_CLEAR(mob->ai_plan[i].targets);
+	}
+	aFree(mob->ai_plan);
+	mob->ai_plan = NULL;
+	mob->ai_plan_count = 0;
+	VECTOR_CLEAR(mob->ai_plan_maps);
+	VECTOR_CLEAR(mob->ai_searches);
 	ers_destroy(item_drop_ers);
 	ers_destroy(item_drop_list_ers);
 	return 0;
@@ -6212,6 +6650,18 @@ void mob_defaults(void)
 	mob->item_drop_ratio_db = item_drop_ratio_db;
 	mob->item_drop_ratio_other_db = item_drop_ratio_other_db;
 
+	VECTOR_INIT(mob->ai_active);
+	VECTOR_INIT(mob->ai_active_ids);
+	VECTOR_INIT(mob->ai_searches);
+	mob->ai_plan = NULL;
+	mob->ai_plan_count = 0;
+	VECTOR_INIT(mob->ai_plan_maps);
+	mob->ai_search = NULL;
+	mob->name_index_ci = NULL;
+	mob->sprite_index = NULL;
+	mob->sprite_index_ci = NULL;
+	memset(&mob->name_trigrams, 0, sizeof(mob->name_trigrams));
+
 	/* */
 	mob->reload = mob_reload;
 	mob->reload_sub_mob = mob_reload_sub_mob;
@@ -6225,6 +6675,9 @@ void mob_defaults(void)
 	mob->skill_id2skill_idx = mob_skill_id2skill_idx;
 	mob->db_searchname = mobdb_searchname;
 	mob->db_searchname_array_sub = mobdb_searchname_array_sub;
+	mob->db_index_get = mobdb_index_get;
+	mob->db_index_build = mobdb_index_build;
+	mob->db_index_clear = mobdb_index_clear;
 	mob->mvptomb_create = mvptomb_create;
 	mob->mvptomb_destroy = mvptomb_destroy;
 	mob->mvptomb_spawn_delayed = mvptomb_spawn_delayed;
@@ -6262,8 +6715,18 @@ void mob_defaults(void)
 	mob->randomwalk = mob_randomwalk;
 	mob->warpchase = mob_warpchase;
 	mob->ai_sub_hard = mob_ai_sub_hard;
-	mob->ai_sub_hard_timer = mob_ai_sub_hard_timer;
-	mob->ai_sub_foreachclient = mob_ai_sub_foreachclient;
+	mob->ai_hard_think = mob_ai_hard_think;
+	mob->ai_active_update = mob_ai_active_update;
+	mob->ai_area_sub = mob_ai_area_sub;
+	mob->ai_area_rect = mob_ai_area_rect;
+	mob->ai_area_update = mob_ai_area_update;
+	mob->ai_area_diff = mob_ai_area_diff;
+	mob->ai_area_move = mob_ai_area_move;
+	mob->ai_search_targets = mob_ai_search_targets;
+	mob->ai_plan_map = mob_ai_plan_map;
+	mob->ai_plan_searches = mob_ai_plan_searches;
+	mob->ai_plan_clear = mob_ai_plan_clear;
+	mob->ai_hard_active = mob_ai_hard_active;
 	mob->ai_sub_lazy = mob_ai_sub_lazy;
 	mob->ai_lazy = mob_ai_lazy;
 	mob->ai_hard = mob_ai_hard;
@@ -27,6 +27,7 @@
 #include "common/hercules.h"
 #include "common/db.h"
 #include "common/mmo.h" // struct item
+#include "common/strlib.h" // struct trigram_index
 
 struct hplugin_data_store;
 
@@ -275,6 +276,8 @@ struct mob_data {
 
 	int deletetimer;
 	int master_id,master_dist;
+	int ai_nearby; ///< Players within AREA_SIZE+ACTIVE_AI_RANGE, kept up to date by the map block functions.
+	int ai_active_pos; ///< 1-based position in mob->ai_active, 0 while the mob is left to the lazy AI.
 
 	int8 skill_idx;// key of array
 	int64 skilldelay[MAX_MOBSKILL];
@@ -483,6 +486,23 @@ struct item_drop_list {
 
 VECTOR_STRUCT_DECL(mob_group, int);
 
+/// Area of a hard AI target search, scanned ahead by the map worker pool.
+struct mob_ai_search {
+	int16 m, x, y; ///< Position of the mob when the area was scanned.
+	int16 range;   ///< View range of the mob.
+	int type;      ///< Object types searched, 0 when the mob needs no search.
+	int start;     ///< First candidate in mob_ai_plan::targets.
+	int count;     ///< Number of candidates.
+};
+
+/// Hard AI target searches of the mobs of one map.
+struct mob_ai_plan {
+	VECTOR_DECL(int) searches; ///< Indexes in mob->ai_searches.
+	VECTOR_DECL(struct block_list *) targets; ///< Candidates of every search, in map->foreachinrange order.
+	int needed; ///< Candidates found by the last scan, may exceed the capacity of targets.
+	unsigned int block_changes; ///< map_data::block_changes when the map was scanned.
+};
+
 #define mob_stop_walking(md, type) (unit->stop_walking(&(md)->bl, (type)))
 #define mob_stop_attack(md)        (unit->stop_attack(&(md)->bl))
 
@@ -506,6 +526,20 @@ struct mob_interface {
 	int mora[5];
 	struct item_drop_ratio **item_drop_ratio_db;
 	struct DBMap *item_drop_ratio_other_db;
+	// Mobs with players in AI range, thought by the hard AI tick
+	VECTOR_DECL(struct mob_data *) ai_active;
+	VECTOR_DECL(int) ai_active_ids; ///< Copy of ai_active taken by each tick.
+	// Target searches scanned ahead by the map worker pool (map_configuration/worker_threads)
+	VECTOR_DECL(struct mob_ai_search) ai_searches; ///< One per entry of ai_active_ids.
+	struct mob_ai_plan *ai_plan; ///< Indexed by map id.
+	int ai_plan_count;
+	VECTOR_DECL(int16) ai_plan_maps; ///< Maps with searches in this tick.
+	const struct mob_ai_search *ai_search; ///< Search of the mob being thought, NULL if none.
+	// Name lookup indexes over non-clone mobs, rebuilt on every mob_db read; the lowest id wins a name
+	struct DBMap *name_index_ci; // const char* name and jname (case-insensitive) -> int mob id
+	struct DBMap *sprite_index; // const char* sprite -> int mob id
+	struct DBMap *sprite_index_ci; // const char* sprite (case-insensitive) -> int mob id
+	struct trigram_index name_trigrams; // trigrams of name, jname and sprite -> mob id
 	/* */
 	int (*init) (bool mimimal);
 	int (*final) (void);
@@ -519,6 +553,9 @@ struct mob_interface {
 	int (*skill_id2skill_idx) (int class_, uint16 skill_id);
 	int (*db_searchname) (const char *str);
 	int (*db_searchname_array_sub) (struct mob_db *monster, const char *str, int flag);
+	int (*db_index_get) (struct DBMap *index, const char *str);
+	void (*db_index_build) (void);
+	void (*db_index_clear) (void);
 	// MvP Tomb System
 	void (*mvptomb_spawn_delayed) (struct npc_data *nd);
 	int (*mvptomb_delayspawn) (int tid, int64 tick, int id, intptr_t data);
@@ -557,8 +594,18 @@ struct mob_interface {
 	int (*randomwalk) (struct mob_data *md, int64 tick);
 	int (*warpchase) (struct mob_data *md, struct block_list *target);
 	bool (*ai_sub_hard) (struct mob_data *md, int64 tick);
-	int (*ai_sub_hard_timer) (struct block_list *bl, va_list ap);
-	int (*ai_sub_foreachclient) (struct map_session_data *sd, va_list ap);
+	void (*ai_hard_think) (struct mob_data *md, int64 tick);
+	void (*ai_active_update) (struct mob_data *md, int delta);
+	int (*ai_area_sub) (struct block_list *bl, va_list ap);
+	void (*ai_area_rect) (struct block_list *bl, int x0, int y0, int x1, int y1, int delta);
+	void (*ai_area_update) (struct block_list *bl, int x, int y, int delta);
+	void (*ai_area_diff) (struct block_list *bl, int ax, int ay, int bx, int by, int delta);
+	void (*ai_area_move) (struct block_list *bl, int x0, int y0);
+	bool (*ai_search_targets) (struct mob_data *md, int view_range, struct block_list **target, uint32 mode);
+	void (*ai_plan_map) (int16 m, void *data);
+	void (*ai_plan_searches) (int64 tick);
+	void (*ai_plan_clear) (void);
+	void (*ai_hard_active) (int64 tick);
 	int (*ai_sub_lazy) (struct mob_data *md, va_list args);
 	int (*ai_lazy) (int tid, int64 tick, int id, intptr_t data);
 	int (*ai_hard) (int tid, int64 tick, int id, intptr_t data);
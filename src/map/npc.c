@@ -1015,6 +1015,8 @@ static int npc_touch_areanpc(struct map_session_data *sd, int16 m, int16 x, int1
 	int f = 1;
 	int i;
 	int j, found_warp = 0;
+	struct npc_touch_list *list;
+	struct npc_data *nd = NULL;
 
 	nullpo_retr(1, sd);
 	Assert_retr(1, m >= 0 && m < map->count);
@@ -1023,24 +1025,27 @@ static int npc_touch_areanpc(struct map_session_data *sd, int16 m, int16 x, int1
 		return 1;
 #endif // 0
 
-	for(i=0;i<map->list[m].npc_num;i++) {
-		if (map->list[m].npc[i]->option&OPTION_INVISIBLE) {
+	// only the NPCs whose touch area overlaps the block of the cell
+	list = npc->touch_index_get(m, x, y);
+	for (i = 0; list != NULL && i < VECTOR_LENGTH(*list); i++) {
+		nd = VECTOR_INDEX(*list, i);
+		if (nd->option&OPTION_INVISIBLE) {
 			f=0; // a npc was found, but it is disabled; don't print warning
 			continue;
 		}
-		if (map->list[m].npc[i]->dyn.isdynamic && map->list[m].npc[i]->dyn.owner_id != sd->status.char_id) {
+		if (nd->dyn.isdynamic && nd->dyn.owner_id != sd->status.char_id) {
 			f = 0;
 			continue;
 		}
 
-		switch(map->list[m].npc[i]->subtype) {
+		switch(nd->subtype) {
 		case WARP:
-			xs=map->list[m].npc[i]->u.warp.xs;
-			ys=map->list[m].npc[i]->u.warp.ys;
+			xs=nd->u.warp.xs;
+			ys=nd->u.warp.ys;
 			break;
 		case SCRIPT:
-			xs=map->list[m].npc[i]->u.scr.xs;
-			ys=map->list[m].npc[i]->u.scr.ys;
+			xs=nd->u.scr.xs;
+			ys=nd->u.scr.ys;
 			break;
 		case CASHSHOP:
 		case SHOP:
@@ -1048,35 +1053,37 @@ static int npc_touch_areanpc(struct map_session_data *sd, int16 m, int16 x, int1
 		default:
 			continue;
 		}
-		if( x >= map->list[m].npc[i]->bl.x-xs && x <= map->list[m].npc[i]->bl.x+xs
-		&&  y >= map->list[m].npc[i]->bl.y-ys && y <= map->list[m].npc[i]->bl.y+ys )
+		if( x >= nd->bl.x-xs && x <= nd->bl.x+xs
+		&&  y >= nd->bl.y-ys && y <= nd->bl.y+ys )
 			break;
 	}
-	if( i == map->list[m].npc_num ) {
+	if (list == NULL || i == VECTOR_LENGTH(*list)) {
 		if( f == 1 ) // no npc found
 			ShowError("npc_touch_areanpc : stray NPC cell/NPC not found in the block on coordinates '%s',%d,%d\n", map->list[m].name, x, y);
 		return 1;
 	}
-	switch(map->list[m].npc[i]->subtype) {
+	switch(nd->subtype) {
 		case WARP:
 			if( pc_ishiding(sd) || (sd->sc.count && sd->sc.data[SC_CAMOUFLAGE]) )
 				break; // hidden chars cannot use warps
-			pc->setpos(sd,map->list[m].npc[i]->u.warp.mapindex,map->list[m].npc[i]->u.warp.x,map->list[m].npc[i]->u.warp.y,CLR_OUTSIGHT);
+			pc->setpos(sd,nd->u.warp.mapindex,nd->u.warp.x,nd->u.warp.y,CLR_OUTSIGHT);
 			break;
 		case SCRIPT:
-			for (j = i; j < map->list[m].npc_num; j++) {
-				if (map->list[m].npc[j]->subtype != WARP) {
+			for (j = i; j < VECTOR_LENGTH(*list); j++) {
+				const struct npc_data *wnd = VECTOR_INDEX(*list, j);
+
+				if (wnd->subtype != WARP) {
 					continue;
 				}
 
-				if ((sd->bl.x >= (map->list[m].npc[j]->bl.x - map->list[m].npc[j]->u.warp.xs)
-				  && sd->bl.x <= (map->list[m].npc[j]->bl.x + map->list[m].npc[j]->u.warp.xs))
-				 && (sd->bl.y >= (map->list[m].npc[j]->bl.y - map->list[m].npc[j]->u.warp.ys)
-				  && sd->bl.y <= (map->list[m].npc[j]->bl.y + map->list[m].npc[j]->u.warp.ys))
+				if ((sd->bl.x >= (wnd->bl.x - wnd->u.warp.xs)
+				  && sd->bl.x <= (wnd->bl.x + wnd->u.warp.xs))
+				 && (sd->bl.y >= (wnd->bl.y - wnd->u.warp.ys)
+				  && sd->bl.y <= (wnd->bl.y + wnd->u.warp.ys))
 				) {
 					if( pc_ishiding(sd) || (sd->sc.count && sd->sc.data[SC_CAMOUFLAGE]) )
 						break; // hidden chars cannot use warps
-					pc->setpos(sd,map->list[m].npc[j]->u.warp.mapindex,map->list[m].npc[j]->u.warp.x,map->list[m].npc[j]->u.warp.y,CLR_OUTSIGHT);
+					pc->setpos(sd,wnd->u.warp.mapindex,wnd->u.warp.x,wnd->u.warp.y,CLR_OUTSIGHT);
 					found_warp = 1;
 					break;
 				}
@@ -1086,7 +1093,7 @@ static int npc_touch_areanpc(struct map_session_data *sd, int16 m, int16 x, int1
 				break;
 			}
 
-			if( npc->ontouch_event(sd,map->list[m].npc[i]) > 0 && npc->ontouch2_event(sd,map->list[m].npc[i]) > 0 )
+			if( npc->ontouch_event(sd,nd) > 0 && npc->ontouch2_event(sd,nd) > 0 )
 			{ // failed to run OnTouch event, so just click the npc
 				struct unit_data *ud = unit->bl2ud(&sd->bl);
 				if( ud && ud->walkpath.path_pos < ud->walkpath.path_len )
@@ -1094,8 +1101,8 @@ static int npc_touch_areanpc(struct map_session_data *sd, int16 m, int16 x, int1
 					clif->fixpos(&sd->bl);
 					ud->walkpath.path_pos = ud->walkpath.path_len;
 				}
-				sd->areanpc_id = map->list[m].npc[i]->bl.id;
-				npc->click(sd,map->list[m].npc[i]);
+				sd->areanpc_id = nd->bl.id;
+				npc->click(sd,nd);
 			}
 			break;
 		case CASHSHOP:
@@ -1137,28 +1144,35 @@ static int npc_touch_areanpc2(struct mob_data *md)
 	char eventname[EVENT_NAME_LENGTH];
 	struct event_data* ev;
 	int xs, ys;
+	struct npc_touch_list *list;
 
 	nullpo_ret(md);
 	m = md->bl.m;
 	x = md->bl.x;
 	y = md->bl.y;
 
-	for( i = 0; i < map->list[m].npc_num; i++ ) {
-		if( map->list[m].npc[i]->option&OPTION_INVISIBLE )
+	// only the NPCs whose touch area overlaps the block of the cell
+	if ((list = npc->touch_index_get(m, x, y)) == NULL)
+		return 0;
+
+	for( i = 0; i < VECTOR_LENGTH(*list); i++ ) {
+		struct npc_data *nd = VECTOR_INDEX(*list, i);
+
+		if( nd->option&OPTION_INVISIBLE )
 			continue;
-		if (map->list[m].npc[i]->dyn.isdynamic)
+		if (nd->dyn.isdynamic)
 			continue;
 
-		switch( map->list[m].npc[i]->subtype ) {
+		switch( nd->subtype ) {
 			case WARP:
 				if( !( battle_config.mob_warp&1 ) )
 					continue;
-				xs = map->list[m].npc[i]->u.warp.xs;
-				ys = map->list[m].npc[i]->u.warp.ys;
+				xs = nd->u.warp.xs;
+				ys = nd->u.warp.ys;
 				break;
 			case SCRIPT:
-				xs = map->list[m].npc[i]->u.scr.xs;
-				ys = map->list[m].npc[i]->u.scr.ys;
+				xs = nd->u.scr.xs;
+				ys = nd->u.scr.ys;
 				break;
 			case CASHSHOP:
 			case SHOP:
@@ -1167,23 +1181,23 @@ static int npc_touch_areanpc2(struct mob_data *md)
 				continue; // Keep Searching
 		}
 
-		if( x >= map->list[m].npc[i]->bl.x-xs && x <= map->list[m].npc[i]->bl.x+xs && y >= map->list[m].npc[i]->bl.y-ys && y <= map->list[m].npc[i]->bl.y+ys ) {
+		if( x >= nd->bl.x-xs && x <= nd->bl.x+xs && y >= nd->bl.y-ys && y <= nd->bl.y+ys ) {
 			// In the npc touch area
-			switch( map->list[m].npc[i]->subtype ) {
+			switch( nd->subtype ) {
 				case WARP:
-					xs = map->mapindex2mapid(map->list[m].npc[i]->u.warp.mapindex);
+					xs = map->mapindex2mapid(nd->u.warp.mapindex);
 					if( m < 0 )
 						break; // Cannot Warp between map servers
-					if( unit->warp(&md->bl, xs, map->list[m].npc[i]->u.warp.x, map->list[m].npc[i]->u.warp.y, CLR_OUTSIGHT) == 0 )
+					if( unit->warp(&md->bl, xs, nd->u.warp.x, nd->u.warp.y, CLR_OUTSIGHT) == 0 )
 						return 1; // Warped
 					break;
 				case SCRIPT:
-					if( map->list[m].npc[i]->bl.id == md->areanpc_id )
+					if( nd->bl.id == md->areanpc_id )
 						break; // Already touch this NPC
-					snprintf(eventname, ARRAYLENGTH(eventname), "%s::OnTouchNPC", map->list[m].npc[i]->exname);
+					snprintf(eventname, ARRAYLENGTH(eventname), "%s::OnTouchNPC", nd->exname);
 					if( (ev = (struct event_data*)strdb_get(npc->ev_db, eventname)) == NULL || ev->nd == NULL )
 						break; // No OnTouchNPC Event
-					md->areanpc_id = map->list[m].npc[i]->bl.id;
+					md->areanpc_id = nd->bl.id;
 					id = md->bl.id; // Stores Unique ID
 					script->run_npc(ev->nd->u.scr.script, ev->pos, md->bl.id, ev->nd->bl.id);
 					if( map->id2md(id) == NULL ) return 1; // Not Warped, but killed
@@ -1210,6 +1224,7 @@ static int npc_check_areanpc(int flag, int16 m, int16 x, int16 y, int16 range)
 	int i;
 	int x0,y0,x1,y1;
 	int xs,ys;
+	int bx,by;
 
 	Assert_retr(1, m >= 0 && m < map->count);
 
@@ -1229,41 +1244,50 @@ static int npc_check_areanpc(int flag, int16 m, int16 x, int16 y, int16 range)
 	}
 	if (!i) return 0; //No NPC_CELLs.
 
-	//Now check for the actual NPC on said range.
-	for(i=0;i<map->list[m].npc_num;i++) {
-		if (map->list[m].npc[i]->option&OPTION_INVISIBLE)
-			continue;
-		if (map->list[m].npc[i]->dyn.isdynamic)
-			continue;
+	//Now check for the actual NPC on said range, in the touch grid blocks the range overlaps.
+	if (map->list[m].npc_touch == NULL)
+		return 0;
 
-		switch(map->list[m].npc[i]->subtype) {
-			case WARP:
-				if (!(flag&1))
+	for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+		for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+			struct npc_touch_list *list = &map->list[m].npc_touch[bx + by * map->list[m].bxs];
+
+			for (i = 0; i < VECTOR_LENGTH(*list); i++) {
+				struct npc_data *nd = VECTOR_INDEX(*list, i);
+
+				if (nd->option&OPTION_INVISIBLE)
 					continue;
-				xs=map->list[m].npc[i]->u.warp.xs;
-				ys=map->list[m].npc[i]->u.warp.ys;
-				break;
-			case SCRIPT:
-				if (!(flag&2))
+				if (nd->dyn.isdynamic)
 					continue;
-				xs=map->list[m].npc[i]->u.scr.xs;
-				ys=map->list[m].npc[i]->u.scr.ys;
-				break;
-			case CASHSHOP:
-			case SHOP:
-			case TOMB:
-			default:
-				continue;
-		}
 
-		if( x1 >= map->list[m].npc[i]->bl.x-xs && x0 <= map->list[m].npc[i]->bl.x+xs
-		&&  y1 >= map->list[m].npc[i]->bl.y-ys && y0 <= map->list[m].npc[i]->bl.y+ys )
-			break; // found a npc
+				switch(nd->subtype) {
+					case WARP:
+						if (!(flag&1))
+							continue;
+						xs=nd->u.warp.xs;
+						ys=nd->u.warp.ys;
+						break;
+					case SCRIPT:
+						if (!(flag&2))
+							continue;
+						xs=nd->u.scr.xs;
+						ys=nd->u.scr.ys;
+						break;
+					case CASHSHOP:
+					case SHOP:
+					case TOMB:
+					default:
+						continue;
+				}
+
+				if( x1 >= nd->bl.x-xs && x0 <= nd->bl.x+xs
+				&&  y1 >= nd->bl.y-ys && y0 <= nd->bl.y+ys )
+					return nd->bl.id; // found a npc
+			}
+		}
 	}
-	if (i==map->list[m].npc_num)
-		return 0;
 
-	return (map->list[m].npc[i]->bl.id);
+	return 0;
 }
 
 /*==========================================
@@ -4347,6 +4371,7 @@ static void npc_setcells(struct npc_data *nd)
 	int i,j;
 
 	nullpo_retv(nd);
+	npc->touch_index_add(nd);
 	m = nd->bl.m;
 	x = nd->bl.x;
 	y = nd->bl.y;
@@ -4399,6 +4424,7 @@ static void npc_unsetcells(struct npc_data *nd)
 	int i,j, x0, x1, y0, y1;
 
 	nullpo_retv(nd);
+	npc->touch_index_remove(nd);
 	m = nd->bl.m;
 	x = nd->bl.x;
 	y = nd->bl.y;
@@ -4437,6 +4463,128 @@ static void npc_unsetcells(struct npc_data *nd)
 	map->foreachinarea( npc->unsetcells_sub, m, x0, y0, x1, y1, BL_NPC, nd->bl.id );
 }
 
+/**
+ * Registers the touch area of an NPC in the touch grid of its map, so that
+ * touch lookups only check the NPCs whose area overlaps the block of a cell.
+ * Does nothing if the NPC is already registered with the same area.
+ *
+ * @param nd The NPC.
+ */
+static void npc_touch_index_add(struct npc_data *nd)
+{
+	struct map_data *mapdata;
+	int16 xs, ys, x0, y0, x1, y1;
+	int bx, by;
+
+	nullpo_retv(nd);
+
+	switch (nd->subtype) {
+		case WARP:
+			xs = nd->u.warp.xs;
+			ys = nd->u.warp.ys;
+			break;
+		case SCRIPT:
+			xs = nd->u.scr.xs;
+			ys = nd->u.scr.ys;
+			break;
+		case CASHSHOP:
+		case SHOP:
+		case TOMB:
+		default:
+			return; // Other types doesn't have touch area
+	}
+
+	if (nd->bl.m < 0 || nd->bl.m >= map->count || xs < 0 || ys < 0) {
+		npc->touch_index_remove(nd);
+		return;
+	}
+
+	mapdata = &map->list[nd->bl.m];
+	x0 = (int16)max(nd->bl.x - xs, 0);
+	y0 = (int16)max(nd->bl.y - ys, 0);
+	x1 = (int16)min(nd->bl.x + xs, mapdata->xs - 1);
+	y1 = (int16)min(nd->bl.y + ys, mapdata->ys - 1);
+
+	if (nd->touch_index.indexed) {
+		if (nd->touch_index.m == nd->bl.m && nd->touch_index.x0 == x0 && nd->touch_index.y0 == y0
+		 && nd->touch_index.x1 == x1 && nd->touch_index.y1 == y1)
+			return; // already registered
+		npc->touch_index_remove(nd);
+	}
+
+	if (mapdata->npc_touch == NULL)
+		CREATE(mapdata->npc_touch, struct npc_touch_list, mapdata->bxs * mapdata->bys);
+
+	for (by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++) {
+		for (bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++) {
+			struct npc_touch_list *list = &mapdata->npc_touch[bx + by * mapdata->bxs];
+			VECTOR_ENSURE(*list, 1, 4);
+			VECTOR_PUSH(*list, nd);
+		}
+	}
+
+	nd->touch_index.indexed = true;
+	nd->touch_index.m = nd->bl.m;
+	nd->touch_index.x0 = x0;
+	nd->touch_index.y0 = y0;
+	nd->touch_index.x1 = x1;
+	nd->touch_index.y1 = y1;
+}
+
+/**
+ * Removes the touch area of an NPC from the touch grid of its map.
+ *
+ * @param nd The NPC.
+ */
+static void npc_touch_index_remove(struct npc_data *nd)
+{
+	struct map_data *mapdata;
+	int bx, by;
+
+	nullpo_retv(nd);
+
+	if (!nd->touch_index.indexed)
+		return;
+	nd->touch_index.indexed = false;
+
+	mapdata = &map->list[nd->touch_index.m];
+	if (mapdata->npc_touch == NULL)
+		return; // the grid was freed along with the map
+
+	for (by = nd->touch_index.y0 / BLOCK_SIZE; by <= nd->touch_index.y1 / BLOCK_SIZE; by++) {
+		for (bx = nd->touch_index.x0 / BLOCK_SIZE; bx <= nd->touch_index.x1 / BLOCK_SIZE; bx++) {
+			struct npc_touch_list *list = &mapdata->npc_touch[bx + by * mapdata->bxs];
+			int i;
+
+			ARR_FIND(0, VECTOR_LENGTH(*list), i, VECTOR_INDEX(*list, i) == nd);
+			if (i < VECTOR_LENGTH(*list))
+				VECTOR_ERASE(*list, i);
+		}
+	}
+}
+
+/**
+ * Returns the NPCs whose touch area overlaps the block of a cell, in the
+ * order they were registered. The areas must still be checked against the cell.
+ *
+ * @param m Map ID.
+ * @param x X coordinate of the cell.
+ * @param y Y coordinate of the cell.
+ * @return The list of NPCs, or NULL if there are none.
+ */
+static struct npc_touch_list *npc_touch_index_get(int16 m, int16 x, int16 y)
+{
+	struct map_data *mapdata;
+
+	Assert_retr(NULL, m >= 0 && m < map->count);
+
+	mapdata = &map->list[m];
+	if (mapdata->npc_touch == NULL || x < 0 || y < 0 || x >= mapdata->xs || y >= mapdata->ys)
+		return NULL;
+
+	return &mapdata->npc_touch[x / BLOCK_SIZE + (y / BLOCK_SIZE) * mapdata->bxs];
+}
+
 static void npc_movenpc(struct npc_data *nd, int16 x, int16 y)
 {
 	int16 m;
@@ -6174,6 +6322,9 @@ void npc_defaults(void)
 	npc->setcells = npc_setcells;
 	npc->unsetcells_sub = npc_unsetcells_sub;
 	npc->unsetcells = npc_unsetcells;
+	npc->touch_index_add = npc_touch_index_add;
+	npc->touch_index_remove = npc_touch_index_remove;
+	npc->touch_index_get = npc_touch_index_get;
 	npc->movenpc = npc_movenpc;
 	npc->setdisplayname = npc_setdisplayname;
 	npc->setclass = npc_setclass;
@@ -155,6 +155,11 @@ struct npc_data {
 		int despawn_timer;
 	} dyn;
 
+	struct {
+		bool indexed;
+		int16 m, x0, y0, x1, y1; // registered area, in cells
+	} touch_index; ///< Touch area registered in the touch grid of the map (see npc->touch_index_add)
+
 	struct hplugin_data_store *hdata; ///< HPM Plugin Data Store
 };
 
@@ -314,6 +319,9 @@ struct npc_interface {
 	void (*setcells) (struct npc_data *nd);
 	int (*unsetcells_sub) (struct block_list *bl, va_list ap);
 	void (*unsetcells) (struct npc_data *nd);
+	void (*touch_index_add) (struct npc_data *nd);
+	void (*touch_index_remove) (struct npc_data *nd);
+	struct npc_touch_list *(*touch_index_get) (int16 m, int16 x, int16 y);
 	void (*movenpc) (struct npc_data *nd, int16 x, int16 y);
 	void (*setdisplayname) (struct npc_data *nd, const char *newname);
 	void (*setclass) (struct npc_data *nd, int class_);
@@ -23,6 +23,7 @@
 #include "config/core.h" // CELL_NOSTACK, CIRCULAR_AREA
 #include "path.h"
 
+#include "map/battle.h"
 #include "map/map.h"
 #include "map/unit.h"
 #include "common/cbasetypes.h"
@@ -59,6 +60,8 @@ struct path_node {
 	short g_cost; ///< Actual cost from start to this node
 	short f_cost; ///< g_cost + heuristic(this, goal)
 	short flag; ///< SET_OPEN / SET_CLOSED
+	int heap_index; ///< Position in the open set heap (-1 when not in it)
+	unsigned int search_id; ///< Search that uses this node (see path_arena)
 };
 
 /// Binary heap of path nodes
@@ -67,11 +70,29 @@ BHEAP_STRUCT_DECL(node_heap, struct path_node *);
 /// Comparator for binary heap of path nodes (minimum cost at top)
 #define NODE_MINTOPCMP(i,j) ((i)->f_cost - (j)->f_cost)
 
+/// Swapper for binary heap of path nodes, keeps heap_index in sync
+#define NODE_SWAP(i,j) do { swap_ptr(i, j); swap((i)->heap_index, (j)->heap_index); } while (0)
+
 #define calc_index(x,y) (((x)+(y)*MAX_WALKPATH) & (MAX_WALKPATH*MAX_WALKPATH-1))
 
 /// Estimates the cost from (x0,y0) to (x1,y1).
 /// This is inadmissible (overestimating) heuristic used by game client.
 #define heuristic(x0, y0, x1, y1) (MOVE_COST * (abs((x1) - (x0)) + abs((y1) - (y0)))) // Manhattan distance
+
+/// Scratch space reused by every A* search.
+/// Nodes whose search_id differs from the current one are free, so the
+/// node table never needs clearing; the open set can't hold more than one
+/// entry per node and lives in a fixed array.
+static struct {
+	struct path_node nodes[MAX_WALKPATH * MAX_WALKPATH];
+	struct path_node *heap_data[MAX_WALKPATH * MAX_WALKPATH];
+	unsigned int search_id;
+} path_arena;
+
+/// Region id of cells that can't be reached at all (see path_region_build)
+#define PATH_REGION_NONE 0
+/// Region id used once ids run out; matches every region
+#define PATH_REGION_ANY UINT16_MAX
 /// @}
 
 // Translates dx,dy into walking direction
@@ -188,23 +209,35 @@ static bool path_search_long(struct shootpath_data *spd, struct block_list *bl,
 /// @{
 
 /// Pushes path_node to the binary node_heap.
-/// Ensures there is enough space in array to store new element.
+/// The heap is backed by path_arena and always has room for every node.
 static void heap_push_node(struct node_heap *heap, struct path_node *node)
 {
-	BHEAP_ENSURE(*heap, 1, 256);
-	BHEAP_PUSH2(*heap, node, NODE_MINTOPCMP, swap_ptr);
+	Assert_retv(BHEAP_LENGTH(*heap) < BHEAP_CAPACITY(*heap));
+	node->heap_index = BHEAP_LENGTH(*heap);
+	BHEAP_PUSH2(*heap, node, NODE_MINTOPCMP, NODE_SWAP);
+}
+
+/// Removes and returns the lowest f_cost path_node of the binary node_heap.
+static struct path_node *heap_pop_node(struct node_heap *heap)
+{
+	struct path_node *node = BHEAP_PEEK(*heap);
+
+	BHEAP_DATA(*heap)[BHEAP_LENGTH(*heap) - 1]->heap_index = 0; // the last node is moved to the top
+	BHEAP_POP2(*heap, NODE_MINTOPCMP, NODE_SWAP);
+	node->heap_index = -1;
+	return node;
 }
 
 /// Updates path_node in the binary node_heap.
 static int heap_update_node(struct node_heap *heap, struct path_node *node)
 {
-	int i;
-	ARR_FIND(0, BHEAP_LENGTH(*heap), i, BHEAP_DATA(*heap)[i] == node);
-	if (i == BHEAP_LENGTH(*heap)) {
+	int i = node->heap_index;
+
+	if (i < 0 || i >= BHEAP_LENGTH(*heap) || BHEAP_DATA(*heap)[i] != node) {
 		ShowError("heap_update_node: node not found\n");
 		return 1;
 	}
-	BHEAP_UPDATE(*heap, i, NODE_MINTOPCMP, swap_ptr);
+	BHEAP_UPDATE(*heap, i, NODE_MINTOPCMP, NODE_SWAP);
 	return 0;
 }
 
@@ -214,6 +247,19 @@ static int add_path(struct node_heap *heap, struct path_node *tp, int16 x, int16
 {
 	int i = calc_index(x, y);
 
+	if (tp[i].search_id != path_arena.search_id) {
+		// New node
+		tp[i].x = x;
+		tp[i].y = y;
+		tp[i].g_cost = g_cost;
+		tp[i].parent = parent;
+		tp[i].f_cost = g_cost + h_cost;
+		tp[i].flag = SET_OPEN;
+		tp[i].search_id = path_arena.search_id;
+		heap_push_node(heap, &tp[i]);
+		return 0;
+	}
+
 	if (tp[i].x == x && tp[i].y == y) { // We processed this node before
 		if (g_cost < tp[i].g_cost) { // New path to this node is better than old one
 			// Update costs and parent
@@ -231,18 +277,121 @@ static int add_path(struct node_heap *heap, struct path_node *tp, int16 x, int16
 		return 0;
 	}
 
-	if (tp[i].x || tp[i].y) // Index is already taken; see `tp` array FIXME for details
-		return 1;
+	return 1; // Index is already taken; see `tp` array FIXME for details
+}
 
-	// New node
-	tp[i].x = x;
-	tp[i].y = y;
-	tp[i].g_cost = g_cost;
-	tp[i].parent = parent;
-	tp[i].f_cost = g_cost + h_cost;
-	tp[i].flag = SET_OPEN;
-	heap_push_node(heap, &tp[i]);
-	return 0;
+/// Tells whether (x,y) is a cell a walkpath may go through, for labelling regions.
+static bool path_region_passable(struct map_data *md, int16 x, int16 y)
+{
+	return !md->getcellp(md, NULL, x, y, CELL_CHKNOREACH);
+}
+
+/**
+ * Labels the 4-connected areas of reachable cells of a map.
+ *
+ * A* only steps diagonally when both straight steps around it are free, so
+ * cells with different labels can never be joined by a walkpath. Cells are
+ * labelled with CELL_CHKNOREACH, which blocks no more cells than
+ * CELL_CHKNOPASS, so the labels hold for both checks.
+ *
+ * @param md Map to label.
+ */
+static void path_region_build(struct map_data *md)
+{
+	int size, i;
+	int *queue;
+	uint16 next_region = PATH_REGION_NONE + 1;
+
+	nullpo_retv(md);
+
+	if (md->path_region != NULL || md->cell == NULL)
+		return;
+
+	size = md->xs * md->ys;
+	CREATE(md->path_region, uint16, size);
+	CREATE(queue, int, size);
+
+	for (i = 0; i < size; i++) {
+		uint16 region;
+		int head = 0, tail = 0;
+
+		if (md->path_region[i] != PATH_REGION_NONE || !path_region_passable(md, i % md->xs, i / md->xs))
+			continue;
+
+		region = next_region;
+		if (next_region != PATH_REGION_ANY)
+			next_region++;
+
+		md->path_region[i] = region;
+		queue[tail++] = i;
+		while (head < tail) {
+			const int c = queue[head++];
+			const int16 x = c % md->xs;
+			const int16 y = c / md->xs;
+			const int16 nx[4] = { x + 1, x - 1, x, x };
+			const int16 ny[4] = { y, y, y + 1, y - 1 };
+			int k;
+
+			for (k = 0; k < 4; k++) {
+				int n;
+
+				if (nx[k] < 0 || nx[k] >= md->xs || ny[k] < 0 || ny[k] >= md->ys)
+					continue;
+				n = nx[k] + ny[k] * md->xs;
+				if (md->path_region[n] != PATH_REGION_NONE || !path_region_passable(md, nx[k], ny[k]))
+					continue;
+				md->path_region[n] = region;
+				queue[tail++] = n;
+			}
+		}
+	}
+
+	aFree(queue);
+}
+
+/**
+ * Drops the region labels of a map, e.g. after a cell became walkable.
+ * Cells becoming unwalkable leave the labels usable (they only get less
+ * precise), so that doesn't need to call this.
+ *
+ * @param md The map.
+ */
+static void path_region_clear(struct map_data *md)
+{
+	nullpo_retv(md);
+
+	if (md->path_region != NULL) {
+		aFree(md->path_region);
+		md->path_region = NULL;
+	}
+}
+
+/**
+ * Tells whether a walkpath between two cells may exist, using the map's
+ * region labels (built on first use). Never rejects a reachable cell.
+ *
+ * @retval false if (x1,y1) can't be reached from (x0,y0).
+ */
+static bool path_region_reachable(struct map_data *md, int16 x0, int16 y0, int16 x1, int16 y1)
+{
+	uint16 r0, r1;
+
+	nullpo_retr(true, md);
+
+	if (!battle_config.path_region_cache)
+		return true;
+
+	if (md->path_region == NULL) {
+		path->region_build(md);
+		if (md->path_region == NULL)
+			return true;
+	}
+
+	r0 = md->path_region[x0 + y0 * md->xs];
+	r1 = md->path_region[x1 + y1 * md->xs];
+	if (r0 == PATH_REGION_NONE || r1 == PATH_REGION_NONE || r0 == PATH_REGION_ANY || r1 == PATH_REGION_ANY)
+		return true; // e.g. starting from an unwalkable cell
+	return r0 == r1;
 }
 ///@}
 
@@ -322,18 +471,28 @@ static bool path_search(struct walkpath_data *wpd, struct block_list *bl, int16
 		// We always use A* for finding walkpaths because it is what game client uses.
 		// Easy pathfinding cuts corners of non-walkable cells, but client always walks around it.
 
-		BHEAP_STRUCT_VAR(node_heap, open_set); // 'Open' set
+		struct node_heap open_set; // 'Open' set
 
 		// FIXME: This array is too small to ensure all paths shorter than MAX_WALKPATH
 		// can be found without node collision: calc_index(node1) = calc_index(node2).
 		// Figure out more proper size or another way to keep track of known nodes.
-		struct path_node tp[MAX_WALKPATH * MAX_WALKPATH];
+		struct path_node *tp = path_arena.nodes;
 		struct path_node *current, *it;
 		int xs = md->xs - 1;
 		int ys = md->ys - 1;
 		int len = 0;
 		int j;
-		memset(tp, 0, sizeof(tp));
+
+		if (!path->region_reachable(md, x0, y0, x1, y1))
+			return false;
+
+		if (++path_arena.search_id == 0) { // wrapped around, forget every node
+			memset(path_arena.nodes, 0, sizeof(path_arena.nodes));
+			path_arena.search_id = 1;
+		}
+		BHEAP_INIT(open_set);
+		BHEAP_DATA(open_set) = path_arena.heap_data;
+		BHEAP_CAPACITY(open_set) = ARRAYLENGTH(path_arena.heap_data);
 
 		// Start node
 		i = calc_index(x0, y0);
@@ -343,6 +502,7 @@ static bool path_search(struct walkpath_data *wpd, struct block_list *bl, int16
 		tp[i].g_cost = 0;
 		tp[i].f_cost = heuristic(x0, y0, x1, y1);
 		tp[i].flag   = SET_OPEN;
+		tp[i].search_id = path_arena.search_id;
 
 		heap_push_node(&open_set, &tp[i]); // Put start node to 'open' set
 
@@ -359,13 +519,10 @@ static bool path_search(struct walkpath_data *wpd, struct block_list *bl, int16
 
 			int g_cost;
 
-			if (BHEAP_LENGTH(open_set) == 0) {
-				BHEAP_CLEAR(open_set);
+			if (BHEAP_LENGTH(open_set) == 0)
 				return false;
-			}
 
-			current = BHEAP_PEEK(open_set); // Look for the lowest f_cost node in the 'open' set
-			BHEAP_POP2(open_set, NODE_MINTOPCMP, swap_ptr); // Remove it from 'open' set
+			current = heap_pop_node(&open_set); // Take the lowest f_cost node out of the 'open' set
 
 			x      = current->x;
 			y      = current->y;
@@ -373,10 +530,8 @@ static bool path_search(struct walkpath_data *wpd, struct block_list *bl, int16
 
 			current->flag = SET_CLOSED; // Add current node to 'closed' set
 
-			if (x == x1 && y == y1) {
-				BHEAP_CLEAR(open_set);
+			if (x == x1 && y == y1)
 				break;
-			}
 
 			if (y < ys && !md->getcellp(md, bl, x, y+1, cell)) allowed_dirs |= DIR_NORTH;
 			if (y >  0 && !md->getcellp(md, bl, x, y-1, cell)) allowed_dirs |= DIR_SOUTH;
@@ -402,10 +557,8 @@ static bool path_search(struct walkpath_data *wpd, struct block_list *bl, int16
 			if (chk_dir(DIR_SOUTH))
 				e += add_path(&open_set, tp, x, y-1, g_cost + MOVE_COST, current, heuristic(x, y-1, x1, y1)); // (x, y-1) 4
 #undef chk_dir
-			if (e) {
-				BHEAP_CLEAR(open_set);
+			if (e)
 				return false;
-			}
 		}
 
 		for (it = current; it->parent != NULL; it = it->parent, len++);
@@ -515,4 +668,7 @@ void path_defaults(void)
 	path->distance = distance;
 	path->check_distance_client = check_distance_client;
 	path->distance_client = distance_client;
+	path->region_build = path_region_build;
+	path->region_clear = path_region_clear;
+	path->region_reachable = path_region_reachable;
 }
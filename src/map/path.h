@@ -67,6 +67,10 @@ struct path_interface {
 	unsigned int (*distance) (int dx, int dy);
 	bool (*check_distance_client) (int dx, int dy, int distance);
 	int (*distance_client) (int dx, int dy);
+	// connectivity regions used to reject unreachable targets early
+	void (*region_build) (struct map_data *md);
+	void (*region_clear) (struct map_data *md);
+	bool (*region_reachable) (struct map_data *md, int16 x0, int16 y0, int16 x1, int16 y1);
 };
 
 #ifdef HERCULES_CORE
@@ -291,6 +291,8 @@ struct map_session_data {
 	unsigned int extra_temp_permissions; /* permissions from @addperm */
 
 	struct mmo_charstatus status;
+	struct mmo_charstatus *status_base; ///< Status last sent to the char-server, base of delta saves.
+	unsigned int status_base_epoch;     ///< chrif->save_epoch when status_base was sent.
 	struct item_data *inventory_data[MAX_INVENTORY]; // direct pointers to itemdb entries (faster than doing item_id lookups)
 	struct storage_data storage; ///< Account Storage
 	enum pc_checkitem_types itemcheck;
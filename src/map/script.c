@@ -1749,7 +1749,15 @@ static const char *script_parse_subexpr(const char *p, int limit)
 			// L2:
 			script->set_label(l2, VECTOR_LENGTH(script->buf), p);
 		} else {
+			int rhs = VECTOR_LENGTH(script->buf);
 			p = script->parse_subexpr(p,opl);
+			if ((op == C_RE_EQ || op == C_RE_NE) && VECTOR_INDEX(script->buf, rhs) == C_STR) {
+				// Constant pattern, compile it once now
+				const char *pattern = (const char *)&VECTOR_INDEX(script->buf, rhs + 1);
+				const char *error;
+				if (rhs + 1 + (int)strlen(pattern) + 1 == VECTOR_LENGTH(script->buf))
+					script->regex_get(pattern, true, &error);
+			}
 			script->addc(op);
 			p = script->skip_space(p);
 		}
@@ -3086,6 +3094,8 @@ static struct script_code *parse_script(const char *src, const char *file, int l
 	VECTOR_PUSHARRAY(code->script_buf, VECTOR_DATA(script->buf), VECTOR_LENGTH(script->buf));
 	code->local.vars = NULL;
 	code->local.arrays = NULL;
+	if (script->config.predecode)
+		script->predecode(code);
 #ifdef ENABLE_CASE_CHECK
 	script->local_casecheck.clear();
 	script->parser_current_src = NULL;
@@ -3113,6 +3123,8 @@ static struct script_code *script_clone_script(struct script_code* original)
 
 	code->local.vars = NULL;
 	code->local.arrays = NULL;
+	if (original->insn != NULL)
+		script->predecode(code);
 
 	return code;
 }
@@ -4247,6 +4259,10 @@ static void script_free_code(struct script_code *code)
 	if (code->local.arrays)
 		code->local.arrays->destroy(code->local.arrays,script->array_free_db);
 	VECTOR_CLEAR(code->script_buf);
+	if (code->insn != NULL)
+		aFree(code->insn);
+	if (code->bonus_ops != NULL)
+		aFree(code->bonus_ops);
 	aFree(code);
 }
 
@@ -4404,6 +4420,113 @@ static int get_num(const struct script_buf *scriptbuf, int *pos)
 	return i+((VECTOR_INDEX(*scriptbuf, (*pos)++)&0x7f)<<j);
 }
 
+/**
+ * Lowers the bytecode of a script into an array of pre-decoded instructions,
+ * run by run_script_main instead of decoding script_buf on every step.
+ *
+ * Positions (st->pos, labels, jump targets) keep referring to script_buf;
+ * code->insn is sorted by position so a jump is resolved with a binary search.
+ *
+ * @param code The script to lower.
+ */
+static void script_predecode(struct script_code *code)
+{
+	int pos = 0, count = 0, capacity;
+	const int len = VECTOR_LENGTH(code->script_buf);
+
+	nullpo_retv(code);
+
+	if (code->insn != NULL || len == 0)
+		return;
+
+	capacity = len / 2 + 1;
+	CREATE(code->insn, struct script_insn, capacity);
+
+	while (pos < len) {
+		struct script_insn *insn;
+
+		if (count == capacity) {
+			capacity = capacity * 2;
+			RECREATE(code->insn, struct script_insn, capacity);
+		}
+		insn = &code->insn[count++];
+		insn->pos = pos;
+		insn->op = script->get_com(&code->script_buf, &pos);
+		insn->value = pos;
+
+		PRAGMA_GCC46(GCC diagnostic push)
+		PRAGMA_GCC46(GCC diagnostic ignored "-Wswitch-enum")
+		switch (insn->op) {
+		case C_INT:
+			insn->value = script->get_num(&code->script_buf, &pos);
+			break;
+		case C_POS:
+		case C_NAME:
+			if (pos + 3 > len)
+				break;
+			insn->value = GETVALUE(&code->script_buf, pos);
+			pos += 3;
+			break;
+		case C_STR:
+			while (pos < len && VECTOR_INDEX(code->script_buf, pos) != 0)
+				pos++;
+			pos++;
+			break;
+		case C_LSTR:
+			pos += (int)sizeof(int);
+			if (pos < len)
+				pos += (int)sizeof(uint8) + (int)(sizeof(char *) + sizeof(uint8)) * VECTOR_INDEX(code->script_buf, pos);
+			break;
+		default:
+			break;
+		}
+		PRAGMA_GCC46(GCC diagnostic pop)
+
+		insn->next = pos;
+	}
+
+	if (pos != len) {
+		// Truncated instruction, keep decoding this script on the fly
+		aFree(code->insn);
+		code->insn = NULL;
+		return;
+	}
+
+	RECREATE(code->insn, struct script_insn, count);
+	code->insn_count = count;
+}
+
+/**
+ * Finds the pre-decoded instruction at a position of a script.
+ *
+ * @param code The script.
+ * @param pos  The position in script_buf.
+ * @param hint Expected index (the one following the last instruction run).
+ * @return The index in code->insn, or -1 if no instruction starts at pos.
+ */
+static int script_insn_find(const struct script_code *code, int pos, int hint)
+{
+	int lo = 0, hi;
+
+	nullpo_retr(-1, code);
+
+	if (hint >= 0 && hint < code->insn_count && code->insn[hint].pos == pos)
+		return hint;
+
+	hi = code->insn_count;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (code->insn[mid].pos < pos)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < code->insn_count && code->insn[lo].pos == pos)
+		return lo;
+	return -1;
+}
+
 /// Ternary operators
 /// test ? if_true : if_false
 static void op_3(struct script_state *st, int op)
@@ -4462,6 +4585,163 @@ static void op_3(struct script_state *st, int op)
 	}
 }
 
+/// Compiled pattern of the ~= and ~! operators (see script->regex_get).
+struct script_regex {
+	char *pattern;
+	pcre *compiled;
+	pcre_extra *extra;
+	bool cached;  ///< Whether the entry is in script->regex_db (or owned by the caller).
+	bool pinned;  ///< Constant pattern of a loaded script, never evicted.
+	struct script_regex *prev, *next; ///< LRU list of the evictable entries, most recently used first.
+};
+
+static void script_regex_unlink(struct script_regex *re)
+{
+	if (re->prev != NULL)
+		re->prev->next = re->next;
+	else
+		script->regex_lru_head = re->next;
+	if (re->next != NULL)
+		re->next->prev = re->prev;
+	else
+		script->regex_lru_tail = re->prev;
+	re->prev = re->next = NULL;
+}
+
+static void script_regex_push_front(struct script_regex *re)
+{
+	re->prev = NULL;
+	re->next = script->regex_lru_head;
+	if (script->regex_lru_head != NULL)
+		script->regex_lru_head->prev = re;
+	else
+		script->regex_lru_tail = re;
+	script->regex_lru_head = re;
+}
+
+static void script_regex_free(struct script_regex *re)
+{
+	libpcre->free(re->compiled);
+	if (re->extra != NULL)
+		libpcre->free(re->extra);
+	aFree(re->pattern);
+	aFree(re);
+}
+
+/**
+ * Returns the compiled form of a regex pattern, compiling it on a cache miss.
+ *
+ * Patterns used at runtime are kept in an LRU cache of
+ * script->config.regex_cache_size entries; constant patterns found while
+ * parsing scripts are pinned until the scripts are reloaded.
+ *
+ * @param[in]  pattern The pattern.
+ * @param[in]  pinned  Whether the pattern is a constant of a script.
+ * @param[out] error   The pcre error message in case of failure.
+ * @return The compiled pattern, to give back with script->regex_release.
+ * @retval NULL if the pattern doesn't compile.
+ */
+static struct script_regex *script_regex_get(const char *pattern, bool pinned, const char **error)
+{
+	struct script_regex *re;
+	int erroffset;
+
+	nullpo_retr(NULL, pattern);
+	nullpo_retr(NULL, error);
+
+	*error = NULL;
+
+	if ((re = strdb_get(script->regex_db, pattern)) != NULL) {
+		script->regex_hits++;
+		if (!re->pinned) {
+			script_regex_unlink(re);
+			if (pinned) {
+				re->pinned = true;
+				script->regex_count--;
+			} else {
+				script_regex_push_front(re);
+			}
+		}
+		return re;
+	}
+	script->regex_misses++;
+
+	CREATE(re, struct script_regex, 1);
+	if ((re->compiled = libpcre->compile(pattern, 0, error, &erroffset, NULL)) == NULL) {
+		aFree(re);
+		return NULL;
+	}
+
+	re->extra = libpcre->study(re->compiled, 0, error);
+	if (*error != NULL) {
+		libpcre->free(re->compiled);
+		aFree(re);
+		return NULL;
+	}
+	re->pattern = aStrdup(pattern);
+
+	if (!pinned && (script->config.regex_cache_size <= 0 || strlen(pattern) > (size_t)script->config.regex_cache_max_length))
+		return re; // not worth caching, freed by script->regex_release
+
+	re->cached = true;
+	re->pinned = pinned;
+	strdb_put(script->regex_db, re->pattern, re);
+
+	if (!pinned) {
+		script_regex_push_front(re);
+		if (++script->regex_count > script->config.regex_cache_size) {
+			struct script_regex *lru = script->regex_lru_tail;
+
+			script_regex_unlink(lru);
+			strdb_remove(script->regex_db, lru->pattern);
+			script_regex_free(lru);
+			script->regex_count--;
+		}
+	}
+
+	return re;
+}
+
+/**
+ * Gives back a pattern obtained with script->regex_get.
+ */
+static void script_regex_release(struct script_regex *re)
+{
+	nullpo_retv(re);
+
+	if (!re->cached)
+		script_regex_free(re);
+}
+
+/**
+ * Empties the regex cache, including the pinned patterns.
+ */
+static void script_regex_clear(void)
+{
+	struct DBIterator *iter = db_iterator(script->regex_db);
+	struct script_regex *re;
+
+	for (re = dbi_first(iter); dbi_exists(iter); re = dbi_next(iter))
+		script_regex_free(re);
+	dbi_destroy(iter);
+
+	db_clear(script->regex_db);
+	script->regex_lru_head = script->regex_lru_tail = NULL;
+	script->regex_count = 0;
+}
+
+/**
+ * Shows the regex cache statistics.
+ */
+static void script_regex_report(void)
+{
+	if (script->regex_hits + script->regex_misses == 0)
+		return;
+
+	ShowInfo("Script regex cache: '"CL_WHITE"%u"CL_RESET"' patterns ('"CL_WHITE"%u"CL_RESET"' constant), '"CL_WHITE"%"PRIu64""CL_RESET"' hits, '"CL_WHITE"%"PRIu64""CL_RESET"' misses.\n",
+	         db_size(script->regex_db), db_size(script->regex_db) - (unsigned int)script->regex_count, script->regex_hits, script->regex_misses);
+}
+
 /// Binary string operators
 /// s1 EQ s2 -> i
 /// s1 NE s2 -> i
@@ -4489,49 +4769,34 @@ static void op_2str(struct script_state *st, int op, const char *s1, const char
 	case C_RE_NE:
 		{
 			int inputlen = (int)strlen(s1);
-			pcre *compiled_regex;
-			pcre_extra *extra_regex;
+			struct script_regex *re;
 			const char *pcre_error, *pcre_match;
-			int pcre_erroroffset, offsetcount;
+			int offsetcount;
 			int offsets[256*3]; // (max_capturing_groups+1)*3
 
-			compiled_regex = libpcre->compile(s2, 0, &pcre_error, &pcre_erroroffset, NULL);
-
-			if( compiled_regex == NULL ) {
-				ShowError("script:op2_str: Invalid regex '%s'.\n", s2);
-				script->reportsrc(st);
-				script_pushnil(st);
-				st->state = END;
-				return;
-			}
-
-			extra_regex = libpcre->study(compiled_regex, 0, &pcre_error);
-
-			if( pcre_error != NULL ) {
-				libpcre->free(compiled_regex);
-				ShowError("script:op2_str: Unable to optimize the regex '%s': %s\n", s2, pcre_error);
+			if ((re = script->regex_get(s2, false, &pcre_error)) == NULL) {
+				ShowError("script:op2_str: Invalid regex '%s': %s\n", s2, pcre_error != NULL ? pcre_error : "unknown error");
 				script->reportsrc(st);
 				script_pushnil(st);
 				st->state = END;
 				return;
 			}
 
-			offsetcount = libpcre->exec(compiled_regex, extra_regex, s1, inputlen, 0, 0, offsets, 256*3);
+			offsetcount = libpcre->exec(re->compiled, re->extra, s1, inputlen, 0, 0, offsets, 256*3);
 
 			if( offsetcount == 0 ) {
 				offsetcount = 256;
 			} else if( offsetcount == PCRE_ERROR_NOMATCH ) {
 				offsetcount = 0;
 			} else if( offsetcount < 0 ) {
-				libpcre->free(compiled_regex);
-				if( extra_regex != NULL )
-					libpcre->free(extra_regex);
+				script->regex_release(re);
 				ShowWarning("script:op2_str: Unable to process the regex '%s'.\n", s2);
 				script->reportsrc(st);
 				script_pushnil(st);
 				st->state = END;
 				return;
 			}
+			script->regex_release(re);
 
 			if (op == C_RE_EQ) {
 				int i;
@@ -4545,9 +4810,6 @@ static void op_2str(struct script_state *st, int op, const char *s1, const char
 			} else { // C_RE_NE
 				a = (offsetcount == 0);
 			}
-			libpcre->free(compiled_regex);
-			if( extra_regex != NULL )
-				libpcre->free(extra_regex);
 		}
 		break;
 	case C_ADD:
@@ -5064,6 +5326,7 @@ static void run_script_main(struct script_state *st)
 {
 	int cmdcount = script->config.check_cmdcount;
 	int gotocount = script->config.check_gotocount;
+	int insn_idx = -1;
 	struct map_session_data *sd;
 	struct script_stack *stack = st->stack;
 	struct npc_data *nd;
@@ -5088,7 +5351,24 @@ static void run_script_main(struct script_state *st)
 		st->state = RUN;
 
 	while( st->state == RUN ) {
-		enum c_op c = script->get_com(&st->script->script_buf, &st->pos);
+		enum c_op c;
+		int value = 0;
+		bool predecoded = false;
+
+		if (st->script->insn != NULL) {
+			// Only search after a jump, a call or a return
+			if (insn_idx < 0 || insn_idx >= st->script->insn_count || st->script->insn[insn_idx].pos != st->pos)
+				insn_idx = script->insn_find(st->script, st->pos, -1);
+			if (insn_idx >= 0) {
+				const struct script_insn *insn = &st->script->insn[insn_idx++];
+				c = insn->op;
+				value = insn->value;
+				st->pos = insn->next;
+				predecoded = true;
+			}
+		}
+		if (!predecoded)
+			c = script->get_com(&st->script->script_buf, &st->pos);
 		PRAGMA_GCC46(GCC diagnostic push)
 		PRAGMA_GCC46(GCC diagnostic ignored "-Wswitch-enum")
 		switch(c) {
@@ -5099,17 +5379,27 @@ static void run_script_main(struct script_state *st)
 					script->pop_stack(st, stack->defsp, stack->sp);// pop unused stack data. (unused return value)
 				break;
 			case C_INT:
-				script->push_val(stack,C_INT,script->get_num(&st->script->script_buf, &st->pos), NULL);
+				if (!predecoded)
+					value = script->get_num(&st->script->script_buf, &st->pos);
+				script->push_val(stack, C_INT, value, NULL);
 				break;
 			case C_POS:
 			case C_NAME:
-				script->push_val(stack,c,GETVALUE(&st->script->script_buf, st->pos), NULL);
-				st->pos+=3;
+				if (!predecoded) {
+					value = GETVALUE(&st->script->script_buf, st->pos);
+					st->pos += 3;
+				}
+				script->push_val(stack, c, value, NULL);
 				break;
 			case C_ARG:
 				script->push_val(stack,c,0,NULL);
 				break;
 			case C_STR:
+				if (predecoded) {
+					// value is the position of the string, st->pos is already past it
+					script->push_conststr(stack, (const char *)&VECTOR_INDEX(st->script->script_buf, value));
+					break;
+				}
 				script->push_conststr(stack, (const char *)&VECTOR_INDEX(st->script->script_buf, st->pos));
 				while (VECTOR_INDEX(st->script->script_buf, st->pos++) != 0)
 					(void)0; // Skip string
@@ -5118,7 +5408,10 @@ static void run_script_main(struct script_state *st)
 			{
 				struct map_session_data *lsd = NULL;
 				uint8 translations = 0;
-				int string_id = *((int *)(&VECTOR_INDEX(st->script->script_buf, st->pos)));
+				int string_id;
+				if (predecoded)
+					st->pos = value; // operand
+				string_id = *((int *)(&VECTOR_INDEX(st->script->script_buf, st->pos)));
 				st->pos += sizeof(string_id);
 				translations = *((uint8 *)(&VECTOR_INDEX(st->script->script_buf, st->pos)));
 				st->pos += sizeof(translations);
@@ -5287,6 +5580,9 @@ static bool script_config_read(const char *filename, bool imported)
 	libconfig->setting_lookup_int(setting, "check_gotocount", &script->config.check_gotocount);
 	libconfig->setting_lookup_int(setting, "input_min_value", &script->config.input_min_value);
 	libconfig->setting_lookup_int(setting, "input_max_value", &script->config.input_max_value);
+	libconfig->setting_lookup_bool_real(setting, "predecode", &script->config.predecode);
+	libconfig->setting_lookup_int(setting, "regex_cache_size", &script->config.regex_cache_size);
+	libconfig->setting_lookup_int(setting, "regex_cache_max_length", &script->config.regex_cache_max_length);
 
 	if (!HPM->parse_conf(&config, filename, HPCT_SCRIPT, imported))
 		retval = false;
@@ -5574,6 +5870,10 @@ static void do_final_script(void)
 	script->userfunc_db->destroy(script->userfunc_db, script->db_free_code_sub);
 	script->autobonus_db->destroy(script->autobonus_db, script->db_free_code_sub);
 
+	script->regex_report();
+	script->regex_clear();
+	db_destroy(script->regex_db);
+
 	if (script->str_data)
 		aFree(script->str_data);
 	if (script->str_buf)
@@ -6136,6 +6436,7 @@ static void do_init_script(bool minimal)
 	script->st_db = idb_alloc(DB_OPT_BASE);
 	script->userfunc_db = strdb_alloc(DB_OPT_DUP_KEY,0);
 	script->autobonus_db = strdb_alloc(DB_OPT_DUP_KEY,0);
+	script->regex_db = strdb_alloc(DB_OPT_BASE, 0);
 
 	script->st_ers = ers_new(sizeof(struct script_state), "script.c::st_ers", ERS_OPT_CLEAN|ERS_OPT_FLEX_CHUNK);
 	script->stack_ers = ers_new(sizeof(struct script_stack), "script.c::script_stack", ERS_OPT_NONE|ERS_OPT_FLEX_CHUNK);
@@ -6192,6 +6493,7 @@ static int script_reload(void)
 
 	script->userfunc_db->clear(script->userfunc_db, script->db_free_code_sub);
 	script->label_count = 0;
+	script->regex_clear();
 
 	for( i = 0; i < atcommand->binding_count; i++ ) {
 		aFree(atcommand->binding[i]->at_groups);
@@ -28848,6 +29150,211 @@ static bool script_hp_add(char *name, char *args, bool (*func)(struct script_sta
 	return script->add_builtin(&buildin, true);
 }
 
+/**
+ * Reads a constant argument of a bonus command from the bytecode.
+ *
+ * @param[in]     code The script.
+ * @param[in,out] pos  Position of the argument, moved past it.
+ * @param[out]    val  The value (for C_NUM and constants).
+ * @param[out]    str  The string (for C_STR), NULL otherwise.
+ * @retval false if the argument isn't a constant.
+ */
+static bool script_bonus_compile_arg(const struct script_code *code, int *pos, int *val, const char **str)
+{
+	int len = VECTOR_LENGTH(code->script_buf);
+	c_op op = script->get_com(&code->script_buf, pos);
+	int next;
+
+	*str = NULL;
+
+	PRAGMA_GCC46(GCC diagnostic push)
+	PRAGMA_GCC46(GCC diagnostic ignored "-Wswitch-enum")
+	switch (op) {
+	case C_INT:
+		*val = script->get_num(&code->script_buf, pos);
+		break;
+	case C_NAME:
+	{
+		int id;
+
+		if (*pos + 3 > len)
+			return false;
+		id = GETVALUE(&code->script_buf, *pos);
+		*pos += 3;
+		if (id < 0 || id >= script->str_num || script->str_data[id].type != C_INT)
+			return false; // variable, parameter or function
+		*val = script->str_data[id].val;
+		break;
+	}
+	case C_STR:
+		*str = (const char *)&VECTOR_INDEX(code->script_buf, *pos);
+		*pos += (int)strlen(*str) + 1;
+		return *pos <= len;
+	default:
+		return false;
+	}
+	PRAGMA_GCC46(GCC diagnostic pop)
+
+	// unary minus of a number
+	if (*pos < len) {
+		next = *pos;
+		if (script->get_com(&code->script_buf, &next) == C_NEG) {
+			*val = -*val;
+			*pos = next;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Checks whether a script only consists of bonus commands with constant
+ * arguments and, if so, stores them in code->bonus_ops so that
+ * script->run_bonus applies them without running the script.
+ *
+ * @param code The script.
+ */
+static void script_bonus_compile(struct script_code *code)
+{
+	struct script_bonus_op *ops = NULL;
+	int count = 0, pos = 0;
+	int len;
+	bool flat = false;
+
+	nullpo_retv(code);
+
+	code->bonus_state = SCRIPT_BONUS_VM;
+	len = VECTOR_LENGTH(code->script_buf);
+
+	while (pos < len) {
+		struct script_bonus_op op = { 0 };
+		const char *str[6];
+		int id, argc = 0;
+		c_op c = script->get_com(&code->script_buf, &pos);
+
+		if (c == C_NOP) {
+			flat = true; // end of script
+			break;
+		}
+
+		// C_NAME bonus, C_ARG, arguments, C_FUNC, C_EOL
+		if (c != C_NAME || pos + 3 > len)
+			break;
+		id = GETVALUE(&code->script_buf, pos);
+		pos += 3;
+		if (id < 0 || id >= script->str_num || script->str_data[id].type != C_FUNC || script->str_data[id].func != buildin_bonus)
+			break;
+		if (pos >= len || script->get_com(&code->script_buf, &pos) != C_ARG)
+			break;
+
+		while (pos < len) {
+			int next = pos;
+			if (script->get_com(&code->script_buf, &next) == C_FUNC) {
+				pos = next;
+				break;
+			}
+			if (argc == 6 || !script_bonus_compile_arg(code, &pos, argc == 0 ? &op.type : &op.val[argc - 1], &str[argc]))
+				break;
+			argc++;
+		}
+		if (pos >= len || script->get_com(&code->script_buf, &pos) != C_EOL)
+			break;
+
+		op.argc = argc - 1;
+		if (op.argc < 1 || op.argc > 5 || str[0] != NULL)
+			break;
+
+		// skill names are only accepted where buildin_bonus accepts them
+		if (str[1] != NULL) {
+			switch (op.type) {
+			case SP_AUTOSPELL:
+			case SP_AUTOSPELL_WHENHIT:
+			case SP_AUTOSPELL_ONSKILL:
+			case SP_SKILL_ATK:
+			case SP_SKILL_HEAL:
+			case SP_SKILL_HEAL2:
+			case SP_ADD_SKILL_BLOW:
+			case SP_CASTRATE:
+			case SP_ADDEFF_ONSKILL:
+			case SP_SKILL_USE_SP_RATE:
+			case SP_SKILL_COOLDOWN:
+			case SP_SKILL_FIXEDCAST:
+			case SP_SKILL_VARIABLECAST:
+			case SP_VARCASTRATE:
+			case SP_FIXCASTRATE:
+			case SP_SKILL_USE_SP:
+			case SP_SUB_SKILL:
+				op.val[0] = skill->name2id(str[1]);
+				break;
+			default:
+				op.argc = -1;
+				break;
+			}
+		}
+		if (op.argc > 1 && str[2] != NULL) {
+			if (op.type == SP_AUTOSPELL_ONSKILL && op.argc >= 4)
+				op.val[1] = skill->name2id(str[2]);
+			else
+				op.argc = -1;
+		}
+		if (op.argc > 2 && (str[3] != NULL || (op.argc > 3 && str[4] != NULL) || (op.argc > 4 && str[5] != NULL)))
+			op.argc = -1;
+		if (op.argc < 0)
+			break;
+
+		RECREATE(ops, struct script_bonus_op, count + 1);
+		ops[count++] = op;
+	}
+
+	if (!flat || count == 0) {
+		if (ops != NULL)
+			aFree(ops);
+		return;
+	}
+
+	code->bonus_ops = ops;
+	code->bonus_count = count;
+	code->bonus_state = SCRIPT_BONUS_FLAT;
+}
+
+/**
+ * Runs an item bonus script for a player. Scripts made only of bonus
+ * commands with constant arguments are applied without the script engine.
+ *
+ * @param code The script (may be NULL).
+ * @param sd   The player.
+ * @param oid  npc id. Can be also 0 or fake npc id.
+ */
+static void script_run_bonus(struct script_code *code, struct map_session_data *sd, int oid)
+{
+	int i;
+
+	nullpo_retv(sd);
+
+	if (code == NULL)
+		return;
+
+	if (code->bonus_state == SCRIPT_BONUS_UNCHECKED)
+		script->bonus_compile(code);
+
+	if (code->bonus_state != SCRIPT_BONUS_FLAT) {
+		script->run(code, 0, sd->bl.id, oid);
+		return;
+	}
+
+	for (i = 0; i < code->bonus_count; i++) {
+		const struct script_bonus_op *op = &code->bonus_ops[i];
+
+		switch (op->argc) {
+		case 1: pc->bonus(sd, op->type, op->val[0]); break;
+		case 2: pc->bonus2(sd, op->type, op->val[0], op->val[1]); break;
+		case 3: pc->bonus3(sd, op->type, op->val[0], op->val[1], op->val[2]); break;
+		case 4: pc->bonus4(sd, op->type, op->val[0], op->val[1], op->val[2], op->val[3]); break;
+		case 5: pc->bonus5(sd, op->type, op->val[0], op->val[1], op->val[2], op->val[3], op->val[4]); break;
+		}
+	}
+}
+
 static void script_run_use_script(struct map_session_data *sd, struct item_data *data, int oid) __attribute__((nonnull (1)));
 
 /**
@@ -28861,7 +29368,7 @@ static void script_run_use_script(struct map_session_data *sd, struct item_data
 {
 	nullpo_retv(data);
 	script->current_item_id = data->nameid;
-	script->run(data->script, 0, sd->bl.id, oid);
+	script->run_bonus(data->script, sd, oid);
 	script->current_item_id = 0;
 }
 
@@ -28877,7 +29384,7 @@ static void script_run_item_equip_script(struct map_session_data *sd, struct ite
 static void script_run_item_equip_script(struct map_session_data *sd, struct item_data *data, int oid)
 {
 	script->current_item_id = data->nameid;
-	script->run(data->equip_script, 0, sd->bl.id, oid);
+	script->run_bonus(data->equip_script, sd, oid);
 	script->current_item_id = 0;
 }
 
@@ -30793,6 +31300,10 @@ void script_defaults(void)
 	script->cleararray_pc = script_cleararray_pc;
 	script->setarray_pc = script_setarray_pc;
 	script->config_read = script_config_read;
+	script->regex_get = script_regex_get;
+	script->regex_release = script_regex_release;
+	script->regex_clear = script_regex_clear;
+	script->regex_report = script_regex_report;
 	script->add_str = script_add_str;
 	script->add_variable = script_add_variable;
 	script->get_str = script_get_str;
@@ -30814,6 +31325,8 @@ void script_defaults(void)
 	script->parse_syntax = parse_syntax;
 	script->parse_syntax_function = parse_syntax_function;
 	script->get_com = get_com;
+	script->predecode = script_predecode;
+	script->insn_find = script_insn_find;
 	script->get_num = get_num;
 	script->op2name = script_op2name;
 	script->reportsrc = script_reportsrc;
@@ -30908,6 +31421,9 @@ void script_defaults(void)
 	script->config.check_gotocount = 2048;
 	script->config.input_min_value = 0;
 	script->config.input_max_value = 10000000;
+	script->config.predecode = false;
+	script->config.regex_cache_size = 256;
+	script->config.regex_cache_max_length = 512;
 	script->config.die_event_name = "OnPCDieEvent";
 	script->config.kill_pc_event_name = "OnPCKillEvent";
 	script->config.kill_mob_event_name = "OnNPCKillEvent";
@@ -30978,6 +31494,8 @@ void script_defaults(void)
 	script->get_translation_dir_name = script_get_translation_dir_name;
 	script->parser_clean_leftovers = script_parser_clean_leftovers;
 
+	script->bonus_compile = script_bonus_compile;
+	script->run_bonus = script_run_bonus;
 	script->run_use_script = script_run_use_script;
 	script->run_item_equip_script = script_run_item_equip_script;
 	script->run_item_unequip_script = script_run_item_unequip_script;
@@ -36,6 +36,7 @@
 struct Sql; // common/sql.h
 struct eri;
 struct item_data;
+struct script_regex; // map/script.c
 
 /**
  * Defines
@@ -645,6 +646,9 @@ struct Script_Config {
 	int check_gotocount;
 	int input_min_value;
 	int input_max_value;
+	bool predecode;             ///< Whether scripts are lowered to pre-decoded instructions once parsed.
+	int regex_cache_size;       ///< Maximum number of runtime regex patterns kept compiled.
+	int regex_cache_max_length; ///< Longer runtime patterns are not cached.
 
 	const char *die_event_name;
 	const char *kill_pc_event_name;
@@ -702,10 +706,37 @@ VECTOR_STRUCT_DECL(script_buf, unsigned char);
 
 // Moved defsp from script_state to script_stack since
 // it must be saved when script state is RERUNLINE. [Eoe / jA 1094]
+/// Whether a script can be applied as a list of bonuses (see script->bonus_compile).
+enum script_bonus_state {
+	SCRIPT_BONUS_UNCHECKED = 0,
+	SCRIPT_BONUS_FLAT,  ///< Only bonus commands with constant arguments.
+	SCRIPT_BONUS_VM,    ///< Needs the script engine.
+};
+
+/// A bonus/bonus2/.../bonus5 command with constant arguments.
+struct script_bonus_op {
+	int type;
+	int argc; ///< Number of values (1 to 5).
+	int val[5];
+};
+
+/// Pre-decoded instruction of a script (see script->predecode).
+struct script_insn {
+	int pos;   ///< Position of the instruction in script_buf.
+	int next;  ///< Position of the following instruction.
+	int value; ///< Operand of C_INT, C_POS and C_NAME, position of the operand of C_STR and C_LSTR.
+	c_op op;
+};
+
 struct script_code {
 	struct script_buf script_buf;
 	struct reg_db local; ///< Local (npc) vars
 	unsigned short instances;
+	struct script_insn *insn; ///< Pre-decoded script_buf, sorted by position (NULL if not lowered).
+	int insn_count;
+	enum script_bonus_state bonus_state;
+	struct script_bonus_op *bonus_ops; ///< Bonuses of a SCRIPT_BONUS_FLAT script.
+	int bonus_count;
 };
 
 struct script_stack {
@@ -915,6 +946,11 @@ struct script_interface {
 	/* Note: This is not cleared when reloading itemdb. */
 	struct DBMap *autobonus_db; // char* script -> char* bytecode
 	struct DBMap *userfunc_db; // const char* func_name -> struct script_code*
+	/* Compiled patterns of the ~= and ~! operators */
+	struct DBMap *regex_db; // const char* pattern -> struct script_regex*
+	struct script_regex *regex_lru_head, *regex_lru_tail;
+	int regex_count; // evictable entries in regex_db
+	uint64 regex_hits, regex_misses;
 	/* */
 	int potion_flag; //For use on Alchemist improved potions/Potion Pitcher. [Skotlex]
 	int potion_hp, potion_per_hp, potion_sp, potion_per_sp;
@@ -1008,6 +1044,10 @@ struct script_interface {
 	void (*cleararray_pc) (struct map_session_data* sd, const char* varname, void* value);
 	void (*setarray_pc) (struct map_session_data* sd, const char* varname, uint32 idx, void* value, int* refcache);
 	bool (*config_read) (const char *filename, bool imported);
+	struct script_regex *(*regex_get) (const char *pattern, bool pinned, const char **error);
+	void (*regex_release) (struct script_regex *re);
+	void (*regex_clear) (void);
+	void (*regex_report) (void);
 	int (*add_str) (const char* p);
 	int (*add_variable) (const char *varname);
 	const char* (*get_str) (int id);
@@ -1028,6 +1068,8 @@ struct script_interface {
 	const char *(*parse_syntax) (const char *p);
 	const char *(*parse_syntax_function) (const char *p, bool is_public);
 	c_op (*get_com) (const struct script_buf *scriptbuf, int *pos);
+	void (*predecode) (struct script_code *code);
+	int (*insn_find) (const struct script_code *code, int pos, int hint);
 	int (*get_num) (const struct script_buf *scriptbuf, int *pos);
 	const char* (*op2name) (int op);
 	void (*reportsrc) (struct script_state *st);
@@ -1152,6 +1194,8 @@ struct script_interface {
 	uint8 (*add_language) (const char *name);
 	const char *(*get_translation_dir_name) (const char *directory);
 	void (*parser_clean_leftovers) (void);
+	void (*bonus_compile) (struct script_code *code);
+	void (*run_bonus) (struct script_code *code, struct map_session_data *sd, int oid);
 	void (*run_use_script) (struct map_session_data *sd, struct item_data *data, int oid);
 	void (*run_item_equip_script) (struct map_session_data *sd, struct item_data *data, int oid);
 	void (*run_item_unequip_script) (struct map_session_data *sd, struct item_data *data, int oid);
@@ -1701,7 +1701,7 @@ static int status_calc_pc_(struct map_session_data *sd, enum e_status_calc_opt o
 		if( j != combo->count )
 			continue;
 
-		script->run(sd->combos[i].bonus,0,sd->bl.id,0);
+		script->run_bonus(sd->combos[i].bonus, sd, 0);
 		if (!calculating) //Abort, script->run retriggered this.
 			return 1;
 	}
@@ -1793,7 +1793,7 @@ static int status_calc_pc_(struct map_session_data *sd, enum e_status_calc_opt o
 					continue;
 
 				status->current_equip_option_index = j;
-				script->run(ito->script, 0, sd->bl.id, 0);
+				script->run_bonus(ito->script, sd, 0);
 
 				if (calculating == 0) //Abort, script->run his function. [Skotlex]
 					return 1;
@@ -1816,7 +1816,7 @@ static int status_calc_pc_(struct map_session_data *sd, enum e_status_calc_opt o
 		struct pet_data *pd = sd->pd;
 
 		if (pd->petDB != NULL && pd->petDB->equip_script != NULL)
-			script->run(pd->petDB->equip_script, 0, sd->bl.id, 0);
+			script->run_bonus(pd->petDB->equip_script, sd, 0);
 
 		if (pd->pet.intimate > PET_INTIMACY_NONE && pd->state.skillbonus == 1 && pd->bonus != NULL
 		    && (battle_config.pet_equip_required == 0 || pd->pet.equip > 0)) {
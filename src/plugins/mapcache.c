@@ -29,6 +29,7 @@
 #include "common/memmgr.h"
 #include "common/md5calc.h"
 #include "common/nullpo.h"
+#include "common/strlib.h"
 #include "common/grfio.h"
 #include "common/utils.h"
 #include "map/map.h"
@@ -36,6 +37,7 @@
 #include "common/HPMDataCheck.h" /* should always be the last Hercules file included! (if you don't make it last, it'll intentionally break compile time) */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 HPExport struct hplugin_info pinfo = {
@@ -458,10 +460,172 @@ bool fix_md5_truncation(void)
 	return retval;
 }
 
+struct mapcache_pack_map {
+	struct map_cache_archive_entry entry;
+	uint8 *data;
+};
+
+static int mapcache_pack_cmp(const void *a, const void *b)
+{
+	return strncmp(((const struct mapcache_pack_map *)a)->entry.name, ((const struct mapcache_pack_map *)b)->entry.name, MAP_NAME_LENGTH);
+}
+
+/**
+ * Reads a map's version 1 mapcache file for inclusion in the archive.
+ *
+ * @param[in]  map_name The map name.
+ * @param[out] out      The archive entry and compressed cells (allocated).
+ * @return The loading success state.
+ */
+bool mapcache_pack_read(const char *map_name, struct mapcache_pack_map *out)
+{
+	struct map_cache_header mheader = { 0 };
+	char file_path[255];
+	unsigned int file_size;
+	uint8 md5buf[16];
+	FILE *fp;
+
+	nullpo_retr(false, map_name);
+	nullpo_retr(false, out);
+
+	snprintf(file_path, sizeof(file_path), "%s%s%s.%s", "maps/", DBPATH, map_name, "mcache");
+	if ((fp = fopen(file_path, "rb")) == NULL) {
+		ShowWarning("mapcache_pack: Could not open the mapcache file for map '%s' at path '%s'.\n", map_name, file_path);
+		return false;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	file_size = (unsigned int)ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if (file_size <= sizeof(mheader) || fread(&mheader, sizeof(mheader), 1, fp) < 1
+	 || mheader.version != 1 || mheader.len <= 0 || file_size < sizeof(mheader) + mheader.len
+	 || mheader.xs <= 0 || mheader.ys <= 0) {
+		ShowError("mapcache_pack: Invalid version 1 mapcache file for map '%s'.\n", map_name);
+		fclose(fp);
+		return false;
+	}
+
+	CREATE(out->data, uint8, mheader.len);
+	if (fread(out->data, mheader.len, 1, fp) < 1) {
+		ShowError("mapcache_pack: Could not load the compressed cell data for map '%s'.\n", map_name);
+		aFree(out->data);
+		out->data = NULL;
+		fclose(fp);
+		return false;
+	}
+	fclose(fp);
+
+	md5->binary(out->data, mheader.len, md5buf);
+	if (memcmp(md5buf, mheader.md5_checksum, sizeof(md5buf)) != 0) {
+		ShowError("mapcache_pack: md5 checksum check failed for map '%s'.\n", map_name);
+		aFree(out->data);
+		out->data = NULL;
+		return false;
+	}
+
+	memset(&out->entry, 0, sizeof(out->entry));
+	safestrncpy(out->entry.name, map_name, sizeof(out->entry.name));
+	memcpy(out->entry.md5_checksum, mheader.md5_checksum, sizeof(out->entry.md5_checksum));
+	out->entry.xs = mheader.xs;
+	out->entry.ys = mheader.ys;
+	out->entry.len = mheader.len;
+
+	return true;
+}
+
+/**
+ * Packs the version 1 mapcache files of every map in db/map_index.txt into
+ * a single archive (MAPCACHE_ARCHIVE_PATH), loaded by the map-server at
+ * startup in place of the individual files.
+ */
+bool mapcache_pack(void)
+{
+	struct map_cache_archive_header header = { 0 };
+	struct mapcache_pack_map *maps;
+	int i, count = 0;
+	uint32 offset;
+	bool retval = true;
+	FILE *fp;
+
+	// Already loaded when called after rebuilding the mapcache files
+	if (VECTOR_LENGTH(maplist) == 0 && mapcache_read_maplist("db/map_index.txt") == false) {
+		ShowError("mapcache_pack: Could not read maplist, aborting\n");
+		return false;
+	}
+
+	CREATE(maps, struct mapcache_pack_map, VECTOR_LENGTH(maplist));
+	for (i = 0; i < VECTOR_LENGTH(maplist); ++i) {
+		ShowStatus("Packing mapcache: %s"CL_CLL"\r", VECTOR_INDEX(maplist, i));
+		if (mapcache_pack_read(VECTOR_INDEX(maplist, i), &maps[count]))
+			count++;
+		else
+			retval = false;
+	}
+
+	qsort(maps, count, sizeof(maps[0]), mapcache_pack_cmp);
+
+	// The map-server looks maps up by binary search, names must be unique.
+	for (i = 1; i < count; ++i) {
+		if (mapcache_pack_cmp(&maps[i - 1], &maps[i]) == 0) {
+			ShowWarning("mapcache_pack: Map '%s' is listed more than once, skipping the duplicate.\n", maps[i].entry.name);
+			aFree(maps[i].data);
+			memmove(&maps[i], &maps[i + 1], sizeof(maps[0]) * (count - i - 1));
+			count--;
+			i--;
+		}
+	}
+
+	memcpy(header.magic, MAPCACHE_ARCHIVE_MAGIC, sizeof(header.magic));
+	header.version = MAPCACHE_ARCHIVE_VERSION;
+	header.map_count = count;
+
+	offset = (uint32)(sizeof(header) + sizeof(struct map_cache_archive_entry) * count);
+	for (i = 0; i < count; ++i) {
+		maps[i].entry.offset = offset;
+		offset += (uint32)maps[i].entry.len;
+	}
+
+	if ((fp = fopen(MAPCACHE_ARCHIVE_PATH, "wb")) == NULL) {
+		ShowError("mapcache_pack: Could not open '%s' for writing.\n", MAPCACHE_ARCHIVE_PATH);
+		retval = false;
+	} else {
+		fwrite(&header, sizeof(header), 1, fp);
+		for (i = 0; i < count; ++i)
+			fwrite(&maps[i].entry, sizeof(maps[i].entry), 1, fp);
+		for (i = 0; i < count; ++i)
+			fwrite(maps[i].data, maps[i].entry.len, 1, fp);
+		fclose(fp);
+		ShowStatus("Packed %d maps into '%s'.\n", count, MAPCACHE_ARCHIVE_PATH);
+	}
+
+	for (i = 0; i < count; ++i)
+		aFree(maps[i].data);
+	aFree(maps);
+
+	return retval;
+}
+
+/**
+ * Regenerates the map cache archive, if there is one, after the mapcache
+ * files were changed. The map-server prefers the archive over the files,
+ * so a stale archive would hide the changes.
+ */
+bool mapcache_pack_refresh(void)
+{
+	if (access(MAPCACHE_ARCHIVE_PATH, F_OK) != 0)
+		return true;
+
+	ShowStatus("Regenerating the map cache archive '%s'.\n", MAPCACHE_ARCHIVE_PATH);
+	return mapcache_pack();
+}
+
 CMDLINEARG(convertmapcache)
 {
 	map->minimal = true;
-	return convert_old_mapcache();
+	if (!convert_old_mapcache())
+		return false;
+	return mapcache_pack_refresh();
 }
 
 CMDLINEARG(rebuild)
@@ -469,7 +633,9 @@ CMDLINEARG(rebuild)
 	needs_grfio = true;
 	grfio->init("conf/grf-files.txt");
 	map->minimal = true;
-	return mapcache_rebuild();
+	if (!mapcache_rebuild())
+		return false;
+	return mapcache_pack_refresh();
 }
 
 CMDLINEARG(cachemap)
@@ -477,13 +643,27 @@ CMDLINEARG(cachemap)
 	needs_grfio = true;
 	grfio->init("conf/grf-files.txt");
 	map->minimal = true;
-	return mapcache_cache_map(params);
+	if (!mapcache_cache_map(params))
+		return false;
+	return mapcache_pack_refresh();
 }
 
 CMDLINEARG(fixmd5)
+{
+	bool retval;
+
+	map->minimal = true;
+	retval = fix_md5_truncation();
+	// Maps that were fixed must be repacked, even if others failed
+	if (!mapcache_pack_refresh())
+		retval = false;
+	return retval;
+}
+
+CMDLINEARG(packmapcache)
 {
 	map->minimal = true;
-	return fix_md5_truncation();
+	return mapcache_pack();
 }
 
 HPExport void server_preinit(void)
@@ -496,6 +676,8 @@ HPExport void server_preinit(void)
 			"Rebuilds an individual map's cache into maps/"DBPATH" (usage: --map <map_name_without_extension>).");
 	addArg("--fix-md5", false, fixmd5,
 			"Updates the checksum for the files in maps/"DBPATH", using db/map_index.txt as index (see PR #1981).");
+	addArg("--pack-mapcache", false, packmapcache,
+			"Packs the mapcache files in maps/"DBPATH" into a single archive loaded at startup, using db/map_index.txt as index. The other mapcache options regenerate an existing archive.");
 
 	needs_grfio = false;
 	VECTOR_INIT(maplist);
@@ -0,0 +1,189 @@
+/**
+ * This file is part of Hercules.
+ * http://herc.ws - http://github.com/HerculesWS/Hercules
+ *
+ * Copyright (C) 2024 Hercules Dev Team
+ *
+ * Hercules is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// Script VM microbenchmark.
+///
+/// Runs the OnBench label of every NPC in a script file, first decoding the
+/// bytecode on the fly and then from the pre-decoded instructions
+/// (script_configuration/predecode), and shows the fastest of a few rounds
+/// of each.
+///
+/// Usage: ./map-server --load-plugin script_bench --script-bench npc/dev/script_bench.txt [--script-bench-runs 1000]
+
+#include "common/hercules.h"
+#include "map/map.h"
+#include "map/mapreg.h"
+#include "map/npc.h"
+#include "map/script.h"
+#include "common/db.h"
+#include "common/memmgr.h"
+#include "common/nullpo.h"
+#include "common/showmsg.h"
+#include "common/strlib.h"
+#include "common/timer.h"
+
+#include "common/HPMDataCheck.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+HPExport struct hplugin_info pinfo = {
+	"script_bench",      // Plugin name
+	SERVER_TYPE_MAP,     // Which server types this plugin works with?
+	"0.1",               // Plugin version
+	HPM_VERSION,         // HPM Version (don't change, macro is automatically updated)
+};
+
+/// Number of times each mode is timed, the fastest is shown.
+#define SCRIPT_BENCH_ROUNDS 5
+
+static char *bench_file = NULL;
+static int bench_runs = 1000;
+
+/**
+ * Runs a label of an NPC bench_runs times.
+ *
+ * @param nd         The NPC.
+ * @param pos        Position of the label.
+ * @param predecoded Whether to run from the pre-decoded instructions.
+ * @return The time taken in milliseconds.
+ */
+static int64 script_bench_run(struct npc_data *nd, int pos, bool predecoded)
+{
+	struct script_code *code = nd->u.scr.script;
+	struct script_insn *insn = code->insn;
+	int64 start;
+	int i;
+
+	if (predecoded && insn == NULL) {
+		script->predecode(code);
+		insn = code->insn;
+	}
+	if (!predecoded)
+		code->insn = NULL;
+
+	start = timer->gettick_nocache();
+	for (i = 0; i < bench_runs; i++)
+		script->run(code, pos, 0, nd->bl.id);
+
+	code->insn = insn;
+	return timer->gettick_nocache() - start;
+}
+
+/**
+ * Replaces mapreg->load while the mapreg db is set up for the benchmark.
+ */
+static void script_bench_mapreg_load(void)
+{
+}
+
+static void script_bench(void)
+{
+	struct DBIterator *iter;
+	struct npc_data *nd;
+	int count = 0;
+
+	// script->init skips mapreg->init in minimal mode, but switch blocks and
+	// $@ variables are stored in the mapreg db. The map-server has no SQL
+	// connection in minimal mode, so nothing is loaded or saved.
+	if (mapreg->regs.vars == NULL) {
+		void (*load)(void) = mapreg->load;
+
+		mapreg->load = script_bench_mapreg_load;
+		mapreg->init();
+		mapreg->load = load;
+		mapreg->skip_insert = true;
+	}
+
+	if (npc->parsesrcfile(bench_file, false) != EXIT_SUCCESS) {
+		ShowError("script_bench: Failed to load '%s'.\n", bench_file);
+		return;
+	}
+
+	iter = db_iterator(npc->name_db);
+	for (nd = dbi_first(iter); dbi_exists(iter); nd = dbi_next(iter)) {
+		int i, round;
+		int64 decoded, predecoded;
+
+		if (nd->subtype != SCRIPT || nd->path == NULL || strcmp(nd->path, bench_file) != 0)
+			continue;
+
+		ARR_FIND(0, nd->u.scr.label_list_num, i, strcmp(nd->u.scr.label_list[i].name, "OnBench") == 0);
+		if (i == nd->u.scr.label_list_num)
+			continue;
+
+		// Alternate both modes and keep the fastest round of each, so that a
+		// slower moment of the machine doesn't favour one of them.
+		decoded = predecoded = INT64_MAX;
+		for (round = 0; round < SCRIPT_BENCH_ROUNDS; round++) {
+			int64 elapsed = script_bench_run(nd, nd->u.scr.label_list[i].pos, false);
+			decoded = min(decoded, elapsed);
+			elapsed = script_bench_run(nd, nd->u.scr.label_list[i].pos, true);
+			predecoded = min(predecoded, elapsed);
+		}
+		ShowInfo("script_bench: %-24s %d runs: decoding %"PRId64" ms, pre-decoded %"PRId64" ms (%d instructions).\n",
+		         nd->exname, bench_runs, decoded, predecoded, nd->u.scr.script->insn_count);
+		count++;
+	}
+	dbi_destroy(iter);
+
+	if (count == 0)
+		ShowWarning("script_bench: No NPC with an OnBench label in '%s'.\n", bench_file);
+}
+
+CMDLINEARG(scriptbench)
+{
+	map->minimal = true;
+	if (bench_file != NULL)
+		aFree(bench_file);
+	bench_file = aStrdup(params);
+	return true;
+}
+
+CMDLINEARG(scriptbenchruns)
+{
+	bench_runs = atoi(params);
+	if (bench_runs <= 0) {
+		ShowError("script_bench: --script-bench-runs expects a positive number.\n");
+		return false;
+	}
+	return true;
+}
+
+HPExport void server_preinit(void)
+{
+	addArg("--script-bench", true, scriptbench,
+			"Runs the OnBench label of the NPCs of a script file with and without pre-decoded bytecode (usage: --script-bench <file>).");
+	addArg("--script-bench-runs", true, scriptbenchruns,
+			"Number of times each OnBench label is run by --script-bench (default: 1000).");
+}
+
+HPExport void server_online(void)
+{
+	if (bench_file != NULL)
+		script_bench();
+}
+
+HPExport void plugin_final(void)
+{
+	if (bench_file != NULL)
+		aFree(bench_file);
+	bench_file = NULL;
+}
@@ -0,0 +1,305 @@
+/**
+ * This file is part of Hercules.
+ * http://herc.ws - http://github.com/HerculesWS/Hercules
+ *
+ * Copyright (C) 2026 Hercules Dev Team
+ *
+ * Hercules is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define HERCULES_CORE
+
+#include "common/cbasetypes.h"
+#include "common/core.h"
+#include "common/db.h"
+#include "common/memmgr.h"
+#include "common/showmsg.h"
+#include "common/strlib.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST(name, function) do { \
+	ShowMessage("-------------------------------------------------------------------------------\n"); \
+	ShowNotice("Testing %s...\n", (name)); \
+	if (!(function)()) { \
+		ShowError("Failed.\n"); \
+		ShowMessage("===============================================================================\n"); \
+		ShowFatalError("Failure. Aborting further tests.\n"); \
+		exit(EXIT_FAILURE); \
+	} \
+	ShowInfo("Test passed.\n"); \
+} while (false)
+
+#define context(message, ...) do { \
+	ShowNotice("\n"); \
+	ShowNotice("> " message "\n", ##__VA_ARGS__); \
+} while (false)
+
+#define expect(formatter, pass_expr, message, actual, expected, ...) do { \
+	ShowNotice("\t" message "... ", ##__VA_ARGS__); \
+	if (!(pass_expr)) { \
+		passed = false; \
+		ShowMessage("" CL_RED "Failed" CL_RESET "\n"); \
+		ShowNotice("\t\tExpected: " CL_GREEN formatter CL_RESET ",\n", expected); \
+		ShowNotice("\t\tReceived: " CL_RED formatter CL_RESET "\n", actual); \
+	} else { \
+		ShowMessage("" CL_GREEN "Passed" CL_RESET "\n"); \
+	} \
+} while (false)
+
+#define expect_int(message, actual, expected, ...) \
+	expect("%d", ((actual) == (expected)), message, (int)(actual), (int)(expected), ##__VA_ARGS__)
+
+#define TEST_DB_ENTRIES 50000
+
+static int test_db_sum_sub(union DBKey key, struct DBData *data, va_list ap)
+{
+	return DB->data2i(data);
+}
+
+static int test_db_fill_sub(union DBKey key, struct DBData *data, va_list ap)
+{
+	struct DBMap *db = va_arg(ap, struct DBMap *);
+	int *next_id = va_arg(ap, int *);
+	int *visited = va_arg(ap, int *);
+
+	if (key.i >= 0 && key.i < 1024)
+		visited[key.i]++;
+	// Fills the table while it's locked, past the point where it would be rebuilt
+	if (*next_id < 4 * TEST_DB_ENTRIES) {
+		int i;
+		for (i = 0; i < 64; i++, (*next_id)++)
+			idb_iput(db, *next_id, 0);
+	}
+	return 1;
+}
+
+static struct DBData test_db_create_sub(union DBKey key, va_list args)
+{
+	return DB->i2data(key.i * 2);
+}
+
+static bool test_db_int(enum DBOptions options)
+{
+	bool passed = true;
+	struct DBMap *db = idb_alloc(options);
+	struct DBIterator *iter;
+	struct DBData *data;
+	union DBKey key;
+	int i, count, missing, visits, next_id;
+	int visited[1024];
+
+	{
+		context("Inserting %d sequential and strided keys", TEST_DB_ENTRIES);
+		for (i = 0; i < TEST_DB_ENTRIES / 2; i++) {
+			idb_iput(db, i, i);
+			idb_iput(db, i * 1024 + TEST_DB_ENTRIES, 1);
+		}
+		expect_int("To contain every key", db_size(db), TEST_DB_ENTRIES);
+		missing = 0;
+		for (i = 0; i < TEST_DB_ENTRIES / 2; i++) {
+			if (idb_iget(db, i) != i || !idb_exists(db, i * 1024 + TEST_DB_ENTRIES))
+				missing++;
+		}
+		expect_int("To find every key", missing, 0);
+		expect_int("To not find a missing key", idb_exists(db, -1), false);
+	}
+
+	{
+		context("Replacing and removing entries");
+		struct DBData old;
+		expect_int("To report the replaced entry", db->put(db, DB->i2key(1), DB->i2data(100), &old), 1);
+		expect_int("To return the replaced data", DB->data2i(&old), 1);
+		for (i = 0; i < TEST_DB_ENTRIES / 2; i += 2)
+			idb_remove(db, i);
+		expect_int("To shrink", db_size(db), TEST_DB_ENTRIES - TEST_DB_ENTRIES / 4);
+		missing = 0;
+		for (i = 0; i < TEST_DB_ENTRIES / 2; i++) {
+			if (idb_exists(db, i) != (i % 2 == 1))
+				missing++;
+		}
+		expect_int("To only drop the removed keys", missing, 0);
+		for (i = 0; i < TEST_DB_ENTRIES / 2; i += 2)
+			idb_iput(db, i, i);
+		expect_int("To reuse the removed slots", db_size(db), TEST_DB_ENTRIES);
+	}
+
+	{
+		context("Ensuring entries");
+		data = db->ensure(db, DB->i2key(-5), test_db_create_sub);
+		expect_int("To create the missing entry", DB->data2i(data), -10);
+		data = db->ensure(db, DB->i2key(3), test_db_create_sub);
+		expect_int("To return the existing entry", DB->data2i(data), 3);
+		idb_remove(db, -5);
+	}
+
+	{
+		context("Iterating while removing entries");
+		iter = db_iterator(db);
+		count = 0;
+		for (data = iter->first(iter, NULL); iter->exists(iter); data = iter->next(iter, NULL)) {
+			count++;
+			iter->remove(iter, NULL);
+		}
+		dbi_destroy(iter);
+		expect_int("To visit every entry once", count, TEST_DB_ENTRIES);
+		expect_int("To leave the database empty", db_size(db), 0);
+	}
+
+	{
+		context("Inserting while iterating with foreach");
+		for (i = 0; i < 1024; i++)
+			idb_iput(db, i, 1);
+		memset(visited, 0, sizeof(visited));
+		next_id = 1024;
+		visits = db->foreach(db, test_db_fill_sub, db, &next_id, visited);
+		missing = 0;
+		for (i = 0; i < 1024; i++) {
+			if (visited[i] != 1)
+				missing++;
+		}
+		// Tree rotations may move nodes around a running foreach, only the hash table guarantees this
+		if ((options & DB_OPT_OPEN_ADDRESSING) != 0)
+			expect_int("To visit every original entry exactly once", missing, 0);
+		expect_int("To visit at least every original entry", visits >= 1024, true);
+		expect_int("To keep every inserted entry", db_size(db), next_id);
+		expect_int("To sum the values", db->foreach(db, test_db_sum_sub), 1024);
+		missing = 0;
+		for (i = 0; i < next_id; i++) {
+			if (!idb_exists(db, i))
+				missing++;
+		}
+		expect_int("To find every entry after the deferred rebuild", missing, 0);
+	}
+
+	{
+		context("Inserting while iterating with an iterator");
+		db_clear(db);
+		for (i = 0; i < 1024; i++)
+			idb_iput(db, i, 1);
+		memset(visited, 0, sizeof(visited));
+		next_id = 1024;
+		iter = db_iterator(db);
+		for (data = iter->first(iter, &key); iter->exists(iter); data = iter->next(iter, &key)) {
+			if (key.i >= 0 && key.i < 1024)
+				visited[key.i]++;
+			if (next_id < 4 * TEST_DB_ENTRIES) {
+				int j;
+				for (j = 0; j < 64; j++, next_id++)
+					idb_iput(db, next_id, 0);
+			}
+		}
+		dbi_destroy(iter);
+		missing = 0;
+		for (i = 0; i < 1024; i++) {
+			if (visited[i] != 1)
+				missing++;
+		}
+		expect_int("To visit every original entry exactly once", missing, 0);
+		expect_int("To keep every inserted entry", db_size(db), next_id);
+		missing = 0;
+		for (i = 0; i < next_id; i++) {
+			if (!idb_exists(db, i))
+				missing++;
+		}
+		expect_int("To find every entry after the deferred rebuild", missing, 0);
+	}
+
+	db_clear(db);
+	expect_int("To be empty after clearing", db_size(db), 0);
+	db_destroy(db);
+	return passed;
+}
+
+static bool test_db_int_tree(void)
+{
+	return test_db_int(DB_OPT_BASE);
+}
+
+static bool test_db_int_open_addressing(void)
+{
+	return test_db_int(DB_OPT_OPEN_ADDRESSING);
+}
+
+static bool test_db_string_open_addressing(void)
+{
+	bool passed = true;
+	struct DBMap *db = stridb_alloc(DB_OPT_OPEN_ADDRESSING|DB_OPT_DUP_KEY|DB_OPT_RELEASE_DATA, 32);
+	struct DBIterator *iter;
+	char name[32];
+	int i, missing;
+
+	{
+		context("Inserting case insensitive string keys");
+		for (i = 0; i < 1000; i++) {
+			int *value;
+			CREATE(value, int, 1);
+			*value = i;
+			snprintf(name, sizeof(name), "Entry_%d", i);
+			strdb_put(db, name, value);
+		}
+		missing = 0;
+		for (i = 0; i < 1000; i++) {
+			int *value;
+			snprintf(name, sizeof(name), "ENTRY_%d", i);
+			value = strdb_get(db, name);
+			if (value == NULL || *value != i)
+				missing++;
+		}
+		expect_int("To find every key regardless of the case", missing, 0);
+	}
+
+	{
+		context("Removing string keys while iterating");
+		iter = db_iterator(db);
+		for (dbi_first(iter); dbi_exists(iter); dbi_next(iter))
+			dbi_remove(iter);
+		dbi_destroy(iter);
+		expect_int("To leave the database empty", db_size(db), 0);
+		expect_int("To not find removed keys", strdb_exists(db, "entry_1"), false);
+	}
+
+	db_destroy(db);
+	return passed;
+}
+
+int do_init(int argc, char **argv)
+{
+	ShowMessage("===============================================================================\n");
+	ShowStatus("Starting tests.\n");
+
+	TEST("DB: int keys (RED-BLACK trees)", test_db_int_tree);
+	TEST("DB: int keys (open addressing)", test_db_int_open_addressing);
+	TEST("DB: string keys (open addressing)", test_db_string_open_addressing);
+
+	core->runflag = CORE_ST_STOP;
+	return EXIT_SUCCESS;
+}
+
+int do_final(void) {
+	ShowMessage("===============================================================================\n");
+	ShowStatus("All tests passed.\n");
+	return EXIT_SUCCESS;
+}
+
+void do_abort(void) { }
+
+void set_server_type(void)
+{
+	SERVER_TYPE = SERVER_TYPE_UNKNOWN;
+}
+
+void cmdline_args_init_local(void) { }
@@ -246,6 +246,7 @@ EOF
 		# run_test spinlock # Not running the spinlock test for the time being (too time consuming)
 		run_test libconfig
 		run_test chunked
+		run_test db
 		echo "run all servers without HPM"
 		run_server ./login-server
 		run_server ./char-server